@@ -1,41 +1,135 @@
 #include "Application.h"
+#include "CpuProfiler.h"
+#include "MeshAsset.h"
+#include "MeshOptimizer.h"
+#include "UploadArena.h"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
 #include <stdexcept>
+#include <string>
 
 namespace Engine
 {
-	Application::Application()
+	Application::Application(const ApplicationConfig& config)
+		: m_config(config)
 	{
+		if (m_config.framesInFlight < 1 || m_config.framesInFlight > SwapChain::MAX_FRAMES_IN_FLIGHT)
+			throw std::runtime_error("Frames in flight must be between 1 and " + std::to_string(SwapChain::MAX_FRAMES_IN_FLIGHT) + " !");
+
+		m_commandRecorder = std::make_unique<CommandRecorder>(m_device, m_scheduler, m_config.framesInFlight);
+		m_gpuProfiler = std::make_unique<GpuProfiler>(m_device, m_config.framesInFlight);
+		m_bindlessHeap = std::make_unique<BindlessHeap>(m_device, m_config.framesInFlight);
+		m_textureStreamer = std::make_unique<TextureStreamer>(m_device, *m_bindlessHeap, m_config.framesInFlight, m_config.textureBudgetMegabytes * 1024 * 1024);
+		for (const auto& path : m_config.textureFiles)
+		{
+			TextureStreamer::Handle texture = m_textureStreamer->Load(path);
+			const Texture& loaded = m_textureStreamer->GetTexture(texture);
+			std::cout << "Texture file " << path << " : " << loaded.GetAsset()->GetHeader().width << "x" << loaded.GetAsset()->GetHeader().height << ", format "
+				<< loaded.GetFormat() << ", mips " << loaded.GetFirstMip() << "+ resident, " << loaded.GetResidentBytes() << " bytes" << std::endl;
+		}
+		m_asyncLoader = std::make_unique<AsyncLoader>(m_device);
+		if (m_config.hotReloadShaders)
+			m_shaderHotReload = std::make_unique<ShaderHotReload>(m_device, m_config.framesInFlight, m_config.shaderCompiler);
 		LoadModels();
+		for (const auto& path : m_config.streamedMeshFiles)
+			m_asyncLoader->LoadMesh(path);
 		CreatePipelineLayout();
 		RecreateSwapChain();
-		CreateCommandBuffers();
+		CreateFrameResources();
 	}
 
 	Application::~Application()
 	{
+		DestroyFrameResources();
 		vkDestroyPipelineLayout(m_device.GetDevice(), m_pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(m_device.GetDevice(), m_drawUniformLayout, nullptr);
 	}
 
 	void Application::Run()
 	{
-		while (!m_window.ShouldClose())
-		{
+		while (!ShouldStop())
+			RunFrame();
+		WaitIdle();
+
+		if (m_frameStats.frameCount > 0)
+			std::cout << "Frames : " << m_frameStats.frameCount << " with " << m_config.framesInFlight << " in flight, CPU fence wait "
+				<< m_frameStats.totalFenceWaitMilliseconds / m_frameStats.frameCount << " ms average, " << m_frameStats.maxFenceWaitMilliseconds << " ms max" << std::endl;
+		if (m_gpuScene != nullptr)
+			std::cout << "GPU culling : " << m_gpuScene->GetVisibleClusterCount() << " of " << m_gpuScene->GetClusterCount() << " meshlets, "
+				<< m_gpuScene->GetVisibleTriangleCount() << " of " << m_gpuScene->GetTriangleCount() << " triangles visible" << std::endl;
+		TextureStreamingStats textureStats = m_textureStreamer->GetStats();
+		if (textureStats.textureCount > 0)
+			std::cout << "Texture streaming : " << textureStats.textureCount << " textures, " << textureStats.residentBytes << " of " << textureStats.budget << " bytes resident, "
+				<< textureStats.upgradeCount << " upgrades, " << textureStats.downgradeCount << " downgrades" << std::endl;
+	}
+
+	void Application::RunFrame()
+	{
+		// GLFW must only be called from the main thread, jobs needing it are queued until here
+		if (m_window != nullptr)
 			glfwPollEvents();
-			DrawFrame();
+		m_scheduler.PumpMainThread();
+		DrawFrame();
+	}
+
+	void Application::WaitIdle()
+	{
+		m_device.WaitIdle();
+		m_gpuProfiler->ResolvePending();
+
+		// The last frames in flight were never waited on by DrawFrame, deliver them in submission order
+		std::vector<FrameResources*> pending;
+		for (auto& frame : m_frames)
+			if (frame.readbackPending)
+				pending.push_back(&frame);
+		std::sort(pending.begin(), pending.end(), [](const FrameResources* a, const FrameResources* b) { return a->readback.frameNumber < b->readback.frameNumber; });
+		for (FrameResources* frame : pending)
+			DeliverReadback(*frame);
+	}
+
+	void Application::Resize(VkExtent2D extent)
+	{
+		if (m_window != nullptr)
+		{
+			m_window->Resize(extent);
+			return;
 		}
-		vkDeviceWaitIdle(m_device.GetDevice());
+		m_config.extent = extent;
+		m_resizeRequested = true;
 	}
 
 	void Application::CreatePipelineLayout()
 	{
+		// Set 1 is the per draw uniform : a single descriptor on the frame arena, draws only change its dynamic offset
+		VkDescriptorSetLayoutBinding drawUniformBinding = {};
+		drawUniformBinding.binding = 0;
+		drawUniformBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		drawUniformBinding.descriptorCount = 1;
+		drawUniformBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &drawUniformBinding;
+
+		if (vkCreateDescriptorSetLayout(m_device.GetDevice(), &layoutInfo, nullptr, &m_drawUniformLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create draw uniform descriptor set layout !");
+
+		// Vertex positions are quantized, every model pushes the decode of its mesh. The pipelines are checked against the same ranges
+		m_pushConstantRanges = { PushConstantRange<Model::PositionDecode>() };
+
+		std::array<VkDescriptorSetLayout, 2> setLayouts = { m_bindlessHeap->GetLayout(), m_drawUniformLayout };
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0;
-		pipelineLayoutInfo.pSetLayouts = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(m_pushConstantRanges.size());
+		pipelineLayoutInfo.pPushConstantRanges = m_pushConstantRanges.data();
 
 		if (vkCreatePipelineLayout(m_device.GetDevice(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create pipeline layout !");
@@ -43,145 +137,558 @@ namespace Engine
 
 	void Application::CreatePipeline()
 	{
-		assert(m_swapChain != nullptr && "Cannot create swap chain before swap chain !");
+		PROFILE_FUNCTION();
+		assert(m_renderGraph != nullptr && "Cannot create pipeline before render graph !");
 		assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout !");
 
 		PipelineConfigInfo pipelineConfig = {};
 		Pipeline::DefaultPipelineConfig(pipelineConfig);
-		pipelineConfig.renderPass = m_swapChain->GetRenderPass();
+		pipelineConfig.renderPass = m_renderGraph->GetRenderPass(m_mainPass);
 		pipelineConfig.pipelineLayout = m_pipelineLayout;
+		pipelineConfig.pushConstantRanges = m_pushConstantRanges;
+		if (m_config.backfaceCulling)
+			pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+
+		m_pipeline = std::make_unique<Pipeline>(m_device, "shaders/simple_shader.vert.spv", "shaders/simple_shader.frag.spv", pipelineConfig);
+
+		// The GPU scene draws through the instance binding too, the object index selects its instance
+		if (m_instancedModel != nullptr || m_gpuScene != nullptr)
+		{
+			auto instanceBindings = Model::Instance::GetBindingDescriptions();
+			auto instanceAttributes = Model::Instance::GetAttributeDescriptions();
+			pipelineConfig.bindingDescriptions.insert(pipelineConfig.bindingDescriptions.end(), instanceBindings.begin(), instanceBindings.end());
+			pipelineConfig.attributeDescriptions.insert(pipelineConfig.attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+			m_instancedPipeline = std::make_unique<Pipeline>(m_device, "shaders/instanced_shader.vert.spv", "shaders/simple_shader.frag.spv", pipelineConfig);
+		}
 
-		m_pipeline = std::make_unique<Pipeline>(m_device, "shaders\\simple_shader.vert.spv", "shaders\\simple_shader.frag.spv", pipelineConfig);
+		if (m_shaderHotReload != nullptr)
+		{
+			m_shaderHotReload->Watch(*m_pipeline);
+			if (m_instancedPipeline != nullptr)
+				m_shaderHotReload->Watch(*m_instancedPipeline);
+		}
 	}
 
-	void Application::CreateCommandBuffers()
+	void Application::CreateFrameResources()
 	{
-		m_commandBuffers.resize(m_swapChain->ImageCount());
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = m_device.GetCommandPool();
-		allocInfo.commandBufferCount = static_cast<uint32_t>(m_commandBuffers.size());
-		allocInfo.pNext = nullptr;
+		m_frames.resize(m_config.framesInFlight);
+		for (auto& frame : m_frames)
+		{
+			// Transient pool reset as a whole every frame, cheaper than resetting command buffers one by one
+			VkCommandPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = m_device.FindPhysicalQueueFamilies().graphicsFamily;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			if (vkCreateCommandPool(m_device.GetDevice(), &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create frame command pool !");
 
-		if (vkAllocateCommandBuffers(m_device.GetDevice(), &allocInfo, m_commandBuffers.data()) != VK_SUCCESS)
-			throw std::runtime_error("Failed to allocate command buffers !");
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = frame.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(m_device.GetDevice(), &allocInfo, &frame.commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate command buffers !");
+
+			// Instances are streamed through the arena, it grows with them
+			frame.arena = std::make_unique<FrameArena>(m_device, FrameArena::DEFAULT_CAPACITY + m_instances.size() * sizeof(Model::Instance));
+			frame.descriptors = std::make_unique<DescriptorAllocator>(m_device);
+		}
+	}
+
+	void Application::AllocateDrawUniformSet(FrameResources& frame)
+	{
+		frame.drawUniformSet = frame.descriptors->Allocate(m_drawUniformLayout);
+
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = frame.arena->GetBuffer();
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(Model::Instance);
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = frame.drawUniformSet;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(m_device.GetDevice(), 1, &descriptorWrite, 0, nullptr);
+	}
+
+	void Application::DestroyFrameResources()
+	{
+		for (auto& frame : m_frames)
+		{
+			vkDestroyCommandPool(m_device.GetDevice(), frame.commandPool, nullptr);
+			if (frame.readbackBuffer != VK_NULL_HANDLE)
+			{
+				vkDestroyBuffer(m_device.GetDevice(), frame.readbackBuffer, nullptr);
+				m_device.FreeMemory(frame.readbackMemory);
+			}
+		}
+		m_frames.clear();
+	}
+
+	void Application::DeliverReadback(FrameResources& frame)
+	{
+		PROFILE_FUNCTION();
+		frame.readbackPending = false;
+		frame.readback.pixels = static_cast<const uint8_t*>(frame.readbackMemory.mappedData);
+		m_config.onFrameReadback(frame.readback);
+	}
+
+	void Application::RecordReadback(FrameResources& frame, uint32_t imageIndex)
+	{
+		// Each frame in flight copies into its own buffer, read once its fence is signaled so the CPU never stalls on the copy
+		VkDeviceSize size = m_swapChain->GetReadbackSize();
+		if (frame.readbackCapacity < size)
+		{
+			if (frame.readbackBuffer != VK_NULL_HANDLE)
+			{
+				vkDestroyBuffer(m_device.GetDevice(), frame.readbackBuffer, nullptr);
+				m_device.FreeMemory(frame.readbackMemory);
+			}
+			m_device.CreateReadbackBuffer(size, frame.readbackBuffer, frame.readbackMemory);
+			frame.readbackCapacity = size;
+		}
+
+		m_swapChain->RecordReadback(frame.commandBuffer, imageIndex, frame.readbackBuffer);
+		frame.readback.extent = m_swapChain->GetSwapChainExtent();
+		frame.readback.format = m_swapChain->GetSwapChainImageFormat();
+		frame.readback.frameNumber = m_frameStats.frameCount;
+		frame.readbackPending = true;
+	}
+
+	bool Application::ShouldStop()
+	{
+		if (m_config.frameLimit > 0 && m_frameStats.frameCount >= m_config.frameLimit)
+			return true;
+		return m_window != nullptr && m_window->ShouldClose();
+	}
+
+	void Application::CollectStreamedModels()
+	{
+		for (LoadedModel& loaded : m_asyncLoader->CollectCompleted())
+		{
+			if (loaded.model == nullptr)
+			{
+				std::cerr << "Streaming " << loaded.path << " failed : " << loaded.error << std::endl;
+				continue;
+			}
+
+			m_triangleCount += loaded.triangleCount;
+			m_models.push_back(std::move(loaded.model));
+			std::cout << "Streamed " << loaded.path << " : " << loaded.triangleCount << " triangles, frame " << m_frameStats.frameCount << std::endl;
+		}
+	}
+
+	void Application::CullModels()
+	{
+		PROFILE_FUNCTION();
+		// Positions are in clip space, one unit covers half the viewport
+		VkExtent2D extent = m_swapChain->GetSwapChainExtent();
+		float pixelsPerUnit = std::max(extent.width, extent.height) * 0.5f;
+		float lodPixelError = m_config.lodPixelError;
+		auto selectLod = [&](const Model& model, float scale) { return lodPixelError > 0.0f ? model.SelectLod(pixelsPerUnit * scale, lodPixelError) : 0u; };
+
+		m_modelVisibility.resize(m_models.size());
+		m_modelLods.resize(m_models.size());
+		m_scheduler.ParallelFor(m_models.size(), CULLING_BATCH_SIZE, [&](size_t begin, size_t end)
+		{
+			// Positions are already in clip space, a model is visible if its bounds overlap the [-1, 1] square
+			for (size_t i = begin; i < end; i++)
+			{
+				glm::vec2 boundsMin = m_models[i]->GetTransformedBoundsMin();
+				glm::vec2 boundsMax = m_models[i]->GetTransformedBoundsMax();
+				m_modelVisibility[i] = boundsMax.x >= -1.0f && boundsMin.x <= 1.0f && boundsMax.y >= -1.0f && boundsMin.y <= 1.0f;
+				glm::vec2 scale = m_models[i]->GetTransform().scale;
+				m_modelLods[i] = selectLod(*m_models[i], std::max(std::abs(scale.x), std::abs(scale.y)));
+			}
+		});
+
+		if (m_instancedModel != nullptr)
+		{
+			m_instanceLods.resize(m_instances.size());
+			m_scheduler.ParallelFor(m_instances.size(), CULLING_BATCH_SIZE, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+					m_instanceLods[i] = selectLod(*m_instancedModel, std::max(std::abs(m_instances[i].scale.x), std::abs(m_instances[i].scale.y)));
+			});
+		}
+
+		// Compacted on the main thread so the draw order does not depend on job scheduling
+		m_drawList.clear();
+		m_drawLods.clear();
+		m_drawnTriangleCount = m_gpuScene != nullptr ? m_gpuScene->GetVisibleTriangleCount() : 0;
+		for (size_t i = 0; i < m_models.size(); i++)
+			if (m_modelVisibility[i])
+			{
+				m_drawList.push_back(m_models[i].get());
+				m_drawLods.push_back(m_modelLods[i]);
+				m_drawnTriangleCount += m_models[i]->GetTriangleCount(m_modelLods[i]);
+			}
 	}
 
 	void Application::DrawFrame()
 	{
+		PROFILE_FUNCTION();
+		using Clock = std::chrono::high_resolution_clock;
+		auto elapsedMilliseconds = [](Clock::time_point begin) { return std::chrono::duration<double, std::milli>(Clock::now() - begin).count(); };
+
+		auto frameStart = Clock::now();
+		FrameTiming timing;
+
 		uint32_t imageIndex;
 		auto result = m_swapChain->AcquireNextImage(&imageIndex);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
+			auto recreateStart = Clock::now();
 			RecreateSwapChain();
+			timing.recreateMilliseconds = elapsedMilliseconds(recreateStart);
+			timing.frameMilliseconds = elapsedMilliseconds(frameStart);
+			if (m_config.onFrameTiming)
+				m_config.onFrameTiming(timing);
 			return;
 		}
 		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 			throw std::runtime_error("Failed to acquire swap chain image !");
 
-		RecordCommandBuffer(imageIndex);
-		result = m_swapChain->SubmitCommandBuffers(&m_commandBuffers[imageIndex], &imageIndex);
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_window.HasWindowResized())
+		double fenceWait = m_swapChain->GetLastFenceWaitMilliseconds();
+		m_frameStats.frameCount++;
+		m_frameStats.totalFenceWaitMilliseconds += fenceWait;
+		m_frameStats.maxFenceWaitMilliseconds = std::max(m_frameStats.maxFenceWaitMilliseconds, fenceWait);
+		timing.frameNumber = m_frameStats.frameCount;
+		timing.fenceWaitMilliseconds = fenceWait;
+
+		// The fence of this frame in flight is signaled, everything keyed by it can be reused
+		FrameResources& frame = m_frames[m_swapChain->GetCurrentFrame()];
+		vkResetCommandPool(m_device.GetDevice(), frame.commandPool, 0);
+		frame.arena->Reset();
+		frame.descriptors->Reset();
+		AllocateDrawUniformSet(frame);
+		if (m_config.onTextureRequests)
+			m_config.onTextureRequests(*m_textureStreamer, m_frameStats.frameCount);
+		m_textureStreamer->Update(m_frameStats.frameCount);
+		m_bindlessHeap->BeginFrame(m_swapChain->GetCurrentFrame(), m_frameStats.frameCount);
+		if (frame.readbackPending)
+			DeliverReadback(frame);
+		if (m_shaderHotReload != nullptr)
+			m_shaderHotReload->Update(m_frameStats.frameCount);
+
+		auto recordStart = Clock::now();
+		CollectStreamedModels();
+		CullModels();
+		RecordCommandBuffer(frame, imageIndex);
+		timing.recordMilliseconds = elapsedMilliseconds(recordStart);
+
+		auto submitStart = Clock::now();
+		result = m_swapChain->SubmitCommandBuffers(&frame.commandBuffer, &imageIndex);
+		timing.submitMilliseconds = elapsedMilliseconds(submitStart);
+
+		if (result != VK_SUCCESS && result != VK_ERROR_OUT_OF_DATE_KHR && result != VK_SUBOPTIMAL_KHR)
+			throw std::runtime_error("Failed to submit command buffer !");
+
+		if (result != VK_SUCCESS || m_resizeRequested || (m_window != nullptr && m_window->HasWindowResized()))
 		{
-			m_window.ResetWindowResizedFlag();
+			if (m_window != nullptr)
+				m_window->ResetWindowResizedFlag();
+			m_resizeRequested = false;
+
+			auto recreateStart = Clock::now();
 			RecreateSwapChain();
-			return;
+			timing.recreateMilliseconds = elapsedMilliseconds(recreateStart);
 		}
 
-		if (result != VK_SUCCESS)
-			throw std::runtime_error("Failed to submit command buffer !");
+		timing.frameMilliseconds = elapsedMilliseconds(frameStart);
+		if (m_config.onFrameTiming)
+			m_config.onFrameTiming(timing);
 	}
 
 	void Application::LoadModels()
 	{
-		std::vector<Model::Vertex> vertices{
-			{{0.0f, -0.5f}, {1, 0, 0}},
-			{{0.5f, 0.5f}, {0, 1, 0}},
-			{{-0.5f, 0.5f}, {0, 0, 1}}
-		};
+		PROFILE_FUNCTION();
+		std::vector<std::vector<Model::Vertex>> meshes = std::move(m_config.meshes);
+		if (meshes.empty() && m_config.meshFiles.empty())
+		{
+			meshes.push_back({
+				{{0.0f, -0.5f}, {1, 0, 0}},
+				{{0.5f, 0.5f}, {0, 1, 0}},
+				{{-0.5f, 0.5f}, {0, 0, 1}}
+			});
+		}
 
-		m_model = std::make_unique<Model>(m_device, vertices);
+		bool gpuCulling = m_config.gpuCulling && GpuScene::IsSupported(m_device);
+		if (m_config.gpuCulling && !gpuCulling)
+			std::cerr << "GPU culling : drawIndirectFirstInstance is not supported, meshes are culled on the CPU" << std::endl;
+
+		// Every mesh is optimized by its own job and uploaded as a model, or kept for the GPU scene which packs them in shared buffers
+		std::vector<VertexCacheStats> cacheStats(meshes.size());
+		std::vector<size_t> triangleCounts(meshes.size());
+		std::vector<std::vector<uint32_t>> sceneIndices(gpuCulling ? meshes.size() : 0);
+		m_models.resize(gpuCulling ? 0 : meshes.size());
+		m_scheduler.ParallelFor(meshes.size(), 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				std::vector<uint32_t> indices;
+				MeshOptimizer::Optimize(meshes[i], indices);
+				cacheStats[i] = MeshOptimizer::AnalyzeVertexCache(indices, meshes[i].size());
+				triangleCounts[i] = indices.size() / 3;
+				if (gpuCulling)
+				{
+					sceneIndices[i] = std::move(indices);
+					continue;
+				}
+
+				std::vector<MeshLod> lods;
+				if (m_config.generateLods)
+					lods = MeshOptimizer::BuildLodChain(meshes[i], indices);
+				m_models[i] = std::make_unique<Model>(m_device, meshes[i], indices, lods);
+			}
+		});
+
+		// Vertices are already placed in clip space, every mesh is a single object with an identity transform
+		if (gpuCulling)
+		{
+			m_gpuScene = std::make_unique<GpuScene>(m_device, m_config.framesInFlight, m_config.backfaceCulling);
+			for (size_t i = 0; i < meshes.size(); i++)
+				m_gpuScene->AddObject(m_gpuScene->AddMesh(meshes[i], sceneIndices[i]), Model::Instance());
+			m_gpuScene->Build();
+		}
+
+		m_triangleCount = 0;
+		for (size_t i = 0; i < meshes.size(); i++)
+			m_triangleCount += triangleCounts[i];
+
+		// Large scenes would flood the output, only the first models are listed
+		for (size_t i = 0; i < std::min<size_t>(meshes.size(), MAX_LOGGED_MODELS); i++)
+			std::cout << "Model " << i << " : " << meshes[i].size() << " vertices, " << triangleCounts[i] << " triangles, ACMR " << cacheStats[i].acmr << ", ATVR " << cacheStats[i].atvr << std::endl;
+
+		// Mesh files are stored optimized and packed, they skip the optimizer and are copied from their mapping
+		for (const auto& path : m_config.meshFiles)
+		{
+			MeshAsset asset(path);
+			m_models.push_back(std::make_unique<Model>(m_device, asset));
+			m_triangleCount += m_models.back()->GetTriangleCount();
+			std::cout << "Mesh file " << path << " : " << asset.GetHeader().vertexCount << " vertices, " << m_models.back()->GetTriangleCount() << " triangles, "
+				<< asset.GetLodCount() << " LODs, " << asset.GetFileSize() << " bytes" << std::endl;
+		}
+
+		if (!m_config.instancedMesh.empty())
+		{
+			std::vector<uint32_t> indices;
+			MeshOptimizer::Optimize(m_config.instancedMesh, indices);
+			std::vector<MeshLod> lods;
+			if (m_config.generateLods)
+				lods = MeshOptimizer::BuildLodChain(m_config.instancedMesh, indices);
+			m_instancedModel = std::make_unique<Model>(m_device, m_config.instancedMesh, indices, lods);
+			m_instances = std::move(m_config.instances);
+			m_triangleCount += static_cast<uint64_t>(m_instancedModel->GetTriangleCount()) * m_instances.size();
+			std::cout << "Instanced model : " << m_config.instancedMesh.size() << " vertices, " << m_instancedModel->GetTriangleCount() << " triangles, "
+				<< m_instancedModel->GetLodCount() << " LODs, " << m_instances.size() << " instances" << std::endl;
+		}
+
+		// Every model upload of the scene goes to the GPU in a single submission
+		m_device.GetUploadArena().Flush();
 	}
 
 	void Application::RecreateSwapChain()
 	{
-		auto extent = m_window.GetExtent();
-		while (extent.width == 0 || extent.height == 0)
+		PROFILE_FUNCTION();
+		VkExtent2D extent = m_config.extent;
+		if (m_window != nullptr)
+		{
+			extent = m_window->GetExtent();
+			while (extent.width == 0 || extent.height == 0)
+			{
+				extent = m_window->GetExtent();
+				glfwWaitEvents();
+			}
+		}
+		m_device.WaitIdle();
+
+		// Rebuilds use the render pass of the old graph, they must be done before it is destroyed. Pipelines are then
+		// recreated with the new render pass
+		bool rewatchPipelines = m_shaderHotReload != nullptr && m_pipeline != nullptr;
+		if (rewatchPipelines)
 		{
-			extent = m_window.GetExtent();
-			glfwWaitEvents();
+			m_shaderHotReload->Unwatch(*m_pipeline);
+			if (m_instancedPipeline != nullptr)
+				m_shaderHotReload->Unwatch(*m_instancedPipeline);
 		}
-		vkDeviceWaitIdle(m_device.GetDevice());
+
+		RenderPassKey previousRenderPassKey = m_renderGraph != nullptr ? m_renderGraph->GetRenderPassKey(m_mainPass) : RenderPassKey();
 		if (m_swapChain == nullptr)
 		{
-			m_swapChain = std::make_unique<SwapChain>(m_device, extent);
+			m_swapChain = std::make_unique<SwapChain>(m_device, extent, m_config.framesInFlight);
 		}
 		else
 		{
-			m_swapChain = std::make_unique<SwapChain>(m_device, extent, std::move(m_swapChain));
-			if (m_swapChain->ImageCount() != m_commandBuffers.size())
-			{
-				FreeCommandBuffers();
-				CreateCommandBuffers();
-			}
+			m_swapChain = std::make_unique<SwapChain>(m_device, extent, m_config.framesInFlight, std::move(m_swapChain));
 		}
 
-		// FIXME : Check if render passes are compatible
-		CreatePipeline();
+		BuildRenderGraph();
+
+		// Viewport and scissor are dynamic, a pipeline stays valid with any compatible render pass even once its own pass is destroyed
+		if (m_pipeline == nullptr || rewatchPipelines || !m_renderGraph->GetRenderPassKey(m_mainPass).IsCompatibleWith(previousRenderPassKey))
+			CreatePipeline();
 	}
 
-	void Application::RecordCommandBuffer(int imageIndex)
+	void Application::BuildRenderGraph()
 	{
+		// The previous graph goes first, its transient memory is free for the new one
+		m_renderGraph = nullptr;
+		m_renderGraph = std::make_unique<RenderGraph>(m_device);
+		VkExtent2D extent = m_swapChain->GetSwapChainExtent();
+
+		// Acquired images come back undefined, the submit waits for the acquire at the color output stage. Offscreen images
+		// are left ready for the readback copy
+		VkImageLayout finalLayout = m_swapChain->IsOffscreen() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		m_backbuffer = m_renderGraph->ImportImage("Backbuffer", m_swapChain->GetSwapChainImageFormat(), extent, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, finalLayout);
+		RenderGraphResource depth = m_renderGraph->CreateImage("Depth", m_swapChain->FindDepthFormat(), extent);
+
+		m_mainPass = m_renderGraph->AddPass("MainPass", [this](const RenderGraphPassContext& context) { RecordMainPass(context); })
+			.WriteColor(m_backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, { 0.1f, 0.1f, 0.1f, 1.0f })
+			.WriteDepth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR)
+			.UseSecondaryCommandBuffers()
+			.GetIndex();
+		m_renderGraph->Compile();
+	}
+
+	void Application::RecordCommandBuffer(FrameResources& frame, uint32_t imageIndex)
+	{
+		PROFILE_FUNCTION();
+		VkCommandBuffer commandBuffer = frame.commandBuffer;
 		VkCommandBufferBeginInfo beginInfo = {};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-		if (vkBeginCommandBuffer(m_commandBuffers[imageIndex], &beginInfo) != VK_SUCCESS)
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
 			throw std::runtime_error("Failed to begin recording command buffer !");
+		m_gpuProfiler->BeginFrame(commandBuffer, m_swapChain->GetCurrentFrame(), m_frameStats.frameCount);
 
-		VkRenderPassBeginInfo renderInfo = {};
-		renderInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderInfo.renderPass = m_swapChain->GetRenderPass();
-		renderInfo.framebuffer = m_swapChain->GetFrameBuffer(imageIndex);
-		renderInfo.renderArea.offset = { 0, 0 };
-		renderInfo.renderArea.extent = m_swapChain->GetSwapChainExtent();
+		// Models collected this frame change queue family before their first draw
+		m_asyncLoader->RecordAcquireBarriers(commandBuffer);
 
-		std::array<VkClearValue, 2> clearValues = {};
-		clearValues[0].color = { 0.1f, 0.1f, 0.1f, 1.0f };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+		// Dispatches cannot be recorded inside a render pass, the draws of the GPU scene are written before it begins
+		if (m_gpuScene != nullptr)
+		{
+			GpuProfiler::Scope cullingScope(*m_gpuProfiler, commandBuffer, "Culling");
+			m_gpuScene->RecordCulling(commandBuffer, m_swapChain->GetCurrentFrame());
+		}
 
-		renderInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderInfo.pClearValues = clearValues.data();
+		// Instances are rewritten every frame into this frame's arena, the GPU reads them straight from host memory. They are
+		// counting sorted by LOD on the way, every LOD then draws its contiguous range with one call
+		m_mainPassInputs = {};
+		m_mainPassInputs.drawInstances = m_instancedModel != nullptr && !m_instances.empty();
+		if (m_mainPassInputs.drawInstances)
+		{
+			auto& lodFirstInstances = m_mainPassInputs.lodFirstInstances;
+			VkDeviceSize instanceBytes = m_instances.size() * sizeof(Model::Instance);
+			m_mainPassInputs.instanceAllocation = frame.arena->Allocate(instanceBytes);
 
-		vkCmdBeginRenderPass(m_commandBuffers[imageIndex], &renderInfo, VK_SUBPASS_CONTENTS_INLINE);
+			for (uint32_t lod : m_instanceLods)
+				lodFirstInstances[lod + 1]++;
+			for (uint32_t lod = 0; lod < m_instancedModel->GetLodCount(); lod++)
+			{
+				m_drawnTriangleCount += static_cast<uint64_t>(lodFirstInstances[lod + 1]) * m_instancedModel->GetTriangleCount(lod);
+				lodFirstInstances[lod + 1] += lodFirstInstances[lod];
+			}
 
+			std::array<uint32_t, MeshOptimizer::MAX_LOD_COUNT> cursors;
+			std::copy(lodFirstInstances.begin(), lodFirstInstances.end() - 1, cursors.begin());
+			auto* destination = static_cast<Model::Instance*>(m_mainPassInputs.instanceAllocation.mappedData);
+			for (size_t i = 0; i < m_instances.size(); i++)
+				destination[cursors[m_instanceLods[i]]++] = m_instances[i];
+		}
+
+		// Layout transitions of the swap chain image and the depth buffer are barriers of the graph, each pass gets its own profiler scope
+		m_renderGraph->SetImportedImage(m_backbuffer, m_swapChain->GetImage(imageIndex), m_swapChain->GetImageView(imageIndex));
+		m_renderGraph->Execute(commandBuffer, m_gpuProfiler.get());
+
+		if (m_config.onFrameReadback && m_swapChain->SupportsReadback())
+		{
+			GpuProfiler::Scope readbackScope(*m_gpuProfiler, commandBuffer, "Readback");
+			RecordReadback(frame, imageIndex);
+		}
+
+		m_gpuProfiler->EndFrame(commandBuffer);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to record command buffer !");
+	}
+
+	void Application::RecordMainPass(const RenderGraphPassContext& context)
+	{
 		VkViewport viewportInfo = {};
 		viewportInfo.x = 0;
 		viewportInfo.y = 0;
-		viewportInfo.width = static_cast<float>(m_swapChain->GetSwapChainExtent().width);
-		viewportInfo.height = static_cast<float>(m_swapChain->GetSwapChainExtent().height);
+		viewportInfo.width = static_cast<float>(context.extent.width);
+		viewportInfo.height = static_cast<float>(context.extent.height);
 		viewportInfo.minDepth = 0.0f;
 		viewportInfo.maxDepth = 1.0f;
 
 		VkRect2D scissorInfo = {};
 		scissorInfo.offset = { 0, 0 };
-		scissorInfo.extent = m_swapChain->GetSwapChainExtent();
+		scissorInfo.extent = context.extent;
 
-		vkCmdSetViewport(m_commandBuffers[imageIndex], 0, 1, &viewportInfo);
-		vkCmdSetScissor(m_commandBuffers[imageIndex], 0, 1, &scissorInfo);
+		VkCommandBufferInheritanceInfo inheritanceInfo = {};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = context.renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = context.framebuffer;
 
-		m_pipeline->Bind(m_commandBuffers[imageIndex]);
-		m_model->Bind(m_commandBuffers[imageIndex]);
-		m_model->Draw(m_commandBuffers[imageIndex]);
+		// Dynamic state and bound sets are not inherited, every secondary command buffer sets them again
+		const MainPassInputs& inputs = m_mainPassInputs;
+		FrameResources& frame = m_frames[m_swapChain->GetCurrentFrame()];
+		VkDescriptorSet bindlessSet = m_bindlessHeap->GetSet(m_swapChain->GetCurrentFrame());
+		auto recordDraws = [&](VkCommandBuffer secondaryBuffer, size_t firstDraw, size_t drawCount)
+		{
+			vkCmdSetViewport(secondaryBuffer, 0, 1, &viewportInfo);
+			vkCmdSetScissor(secondaryBuffer, 0, 1, &scissorInfo);
+			m_pipeline->Bind(secondaryBuffer);
+			vkCmdBindDescriptorSets(secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &bindlessSet, 0, nullptr);
 
-		vkCmdEndRenderPass(m_commandBuffers[imageIndex]);
-		if (vkEndCommandBuffer(m_commandBuffers[imageIndex]) != VK_SUCCESS)
-			throw std::runtime_error("Failed to record command buffer !");
-	}
+			for (size_t i = firstDraw; i < firstDraw + drawCount; i++)
+			{
+				// The only per draw state besides the mesh itself is one dynamic offset into the frame arena
+				if (i < m_drawList.size())
+				{
+					FrameAllocation drawUniform = frame.arena->Allocate(sizeof(Model::Instance));
+					std::memcpy(drawUniform.mappedData, &m_drawList[i]->GetTransform(), sizeof(Model::Instance));
+					uint32_t dynamicOffset = static_cast<uint32_t>(drawUniform.offset);
+					vkCmdBindDescriptorSets(secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 1, 1, &frame.drawUniformSet, 1, &dynamicOffset);
+					m_drawList[i]->Bind(secondaryBuffer, m_pipelineLayout);
+					m_drawList[i]->Draw(secondaryBuffer, m_drawLods[i]);
+					continue;
+				}
 
-	void Application::FreeCommandBuffers()
-	{
-		vkFreeCommandBuffers(m_device.GetDevice(), m_device.GetCommandPool(), static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
+				// Draws after the draw list are batches of a single call each : the instanced model, then the GPU scene
+				m_instancedPipeline->Bind(secondaryBuffer);
+				if (i == m_drawList.size() && inputs.drawInstances)
+				{
+					m_instancedModel->Bind(secondaryBuffer, m_pipelineLayout);
+					for (uint32_t lod = 0; lod < m_instancedModel->GetLodCount(); lod++)
+					{
+						uint32_t instanceCount = inputs.lodFirstInstances[lod + 1] - inputs.lodFirstInstances[lod];
+						if (instanceCount > 0)
+							m_instancedModel->DrawInstanced(secondaryBuffer, inputs.instanceAllocation.buffer, inputs.instanceAllocation.offset + inputs.lodFirstInstances[lod] * sizeof(Model::Instance), instanceCount, lod);
+					}
+				}
+				else
+				{
+					m_gpuScene->Draw(secondaryBuffer, m_swapChain->GetCurrentFrame(), m_pipelineLayout);
+				}
+			}
+		};
+
+		size_t drawCount = m_drawList.size() + (inputs.drawInstances ? 1 : 0) + (m_gpuScene != nullptr ? 1 : 0);
+		const auto& secondaryBuffers = m_commandRecorder->RecordSecondaries(m_swapChain->GetCurrentFrame(), inheritanceInfo, drawCount, recordDraws);
+		if (!secondaryBuffers.empty())
+			vkCmdExecuteCommands(context.commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
 	}
 }
@@ -1,44 +1,225 @@
 #pragma once
 
+#include "AsyncLoader.h"
+#include "BindlessHeap.h"
+#include "CommandRecorder.h"
+#include "DescriptorAllocator.h"
 #include "Device.h"
+#include "FrameArena.h"
+#include "GpuProfiler.h"
+#include "GpuScene.h"
+#include "JobScheduler.h"
 #include "Model.h"
 #include "Pipeline.h"
+#include "RenderGraph.h"
+#include "ShaderHotReload.h"
 #include "SwapChain.h"
+#include "TextureStreamer.h"
 #include "Window.h"
 
+#include <array>
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace Engine
 {
+	struct ReadbackFrame
+	{
+		const uint8_t* pixels;
+		VkExtent2D extent;
+		VkFormat format;
+		uint64_t frameNumber;
+	};
+
+	// CPU side durations of a single DrawFrame, the frame time includes every other field
+	struct FrameTiming
+	{
+		uint64_t frameNumber = 0;
+		double frameMilliseconds = 0.0;
+		double fenceWaitMilliseconds = 0.0;
+		double recordMilliseconds = 0.0;
+		double submitMilliseconds = 0.0;
+		double recreateMilliseconds = 0.0;
+	};
+
+	struct ApplicationConfig
+	{
+		// 1 gives the lowest latency, each extra frame lets the CPU run further ahead of the GPU
+		uint32_t framesInFlight = SwapChain::DEFAULT_FRAMES_IN_FLIGHT;
+
+		// Headless runs without GLFW, on any Vulkan driver including software ones (lavapipe, SwiftShader)
+		bool headless = false;
+		VkExtent2D extent = { 640, 480 };
+		// Stops Run after this many frames, 0 runs until the window is closed
+		uint64_t frameLimit = 0;
+
+		// Meshes loaded at startup, a single triangle when empty
+		std::vector<std::vector<Model::Vertex>> meshes;
+		// Mesh files (see MeshAsset) mapped and uploaded as they are, always drawn through the CPU culled draw list
+		std::vector<std::string> meshFiles;
+		// Mesh files streamed in by background threads once the application runs, each appears in the first frame after its copy completed
+		std::vector<std::string> streamedMeshFiles;
+		// Texture files (see TextureAsset) registered in the bindless heap with their small mips, finer ones stream in within the budget once requested
+		std::vector<std::string> textureFiles;
+		// 0 uses half of the largest device local heap
+		uint64_t textureBudgetMegabytes = 0;
+		// Called every frame with its number before the texture streamer updates, requests the mips the frame samples. Without
+		// it nothing asks for finer mips and every texture keeps its resident tail
+		std::function<void(TextureStreamer&, uint64_t)> onTextureRequests;
+		// Drawn once per instance in a single draw call, the instances are streamed to the GPU every frame
+		std::vector<Model::Vertex> instancedMesh;
+		std::vector<Model::Instance> instances;
+		// Meshes are split into meshlets, culled by a compute shader and drawn with indirect draws, falls back to CPU culling when unsupported
+		bool gpuCulling = false;
+		// Clockwise triangles are front facing. GPU culling then also drops meshlets facing away
+		bool backfaceCulling = false;
+		// Builds a LOD chain for the meshes given at startup and the instanced mesh. The GPU scene always draws LOD 0
+		bool generateLods = true;
+		// Largest simplification error allowed on screen, in pixels. Each model and each instance picks its coarsest LOD under it, 0 always draws LOD 0
+		float lodPixelError = 1.0f;
+
+		// Recompiles edited shaders and swaps the rebuilt pipelines in while running, compiler is invoked as : compiler "source" -o "spirv"
+		bool hotReloadShaders = false;
+		std::string shaderCompiler = "glslc";
+
+		// Called with the pixels of every frame once the GPU is done with it, the pointer is only valid during the call
+		std::function<void(const ReadbackFrame&)> onFrameReadback;
+		// Called at the end of every DrawFrame, used by the benchmark
+		std::function<void(const FrameTiming&)> onFrameTiming;
+	};
+
+	struct FrameStats
+	{
+		uint64_t frameCount = 0;
+		double totalFenceWaitMilliseconds = 0.0;
+		double maxFenceWaitMilliseconds = 0.0;
+	};
+
 	class Application
 	{
 	public:
-		Application();
+		Application(const ApplicationConfig& config = {});
 		~Application();
 
 		Application(const Application&) = delete;
 		Application& operator=(const Application&) = delete;
 
 		void Run();
+		// Polls events and draws a single frame, for callers driving their own loop
+		void RunFrame();
+		// Waits for the GPU and delivers the readbacks of the frames still in flight
+		void WaitIdle();
+		// Resizes the window, or the offscreen images when headless, the swap chain is recreated by the next frame
+		void Resize(VkExtent2D extent);
+		// Streams a mesh file in without blocking, the model is drawn from the first frame after its copy completed
+		void LoadMeshAsync(const std::string& path) { m_asyncLoader->LoadMesh(path); }
+		size_t GetPendingLoadCount() { return m_asyncLoader->GetPendingCount(); }
+
+		Device& GetDevice() { return m_device; }
+		GpuProfiler& GetGpuProfiler() { return *m_gpuProfiler; }
+		// Set 0 of the pipeline layout, textures and buffers registered here are visible to every shader
+		BindlessHeap& GetBindlessHeap() { return *m_bindlessHeap; }
+		// Textures of the bindless heap, their indices change whenever resident mips do
+		TextureStreamer& GetTextureStreamer() { return *m_textureStreamer; }
+		const FrameStats& GetFrameStats() const { return m_frameStats; }
+		size_t GetModelCount() const { return m_models.size(); }
+		// Updated instances are picked up by the next frame, the count must not grow past the one given at startup
+		std::vector<Model::Instance>& GetInstances() { return m_instances; }
+		uint64_t GetTriangleCount() const { return m_triangleCount; }
+		// Triangles of the LODs drawn in the last frame, the GPU scene counts its visible meshlets
+		uint64_t GetDrawnTriangleCount() const { return m_drawnTriangleCount; }
+		// Draws of the last frame : models with CPU culling, meshlets with GPU culling whose results arrive framesInFlight frames late
+		size_t GetVisibleDrawCount() const { return m_gpuScene != nullptr ? m_gpuScene->GetVisibleClusterCount() : m_drawList.size(); }
+		// Null unless GPU culling is enabled and supported
+		const GpuScene* GetGpuScene() const { return m_gpuScene.get(); }
+
 	private:
 		void CreatePipelineLayout();
 		void CreatePipeline();
-		void CreateCommandBuffers();
+		void BuildRenderGraph();
+		void CreateFrameResources();
+		void DestroyFrameResources();
+		void CollectStreamedModels();
+		void CullModels();
 		void DrawFrame();
 		void LoadModels();
 		void RecreateSwapChain();
-		void RecordCommandBuffer(int imageIndex);
-		void FreeCommandBuffers();
+		bool ShouldStop();
 
 	private:
-		Window m_window{ 640, 480, "Hello Vulkan" };
-		Device m_device{ m_window };
+		static constexpr size_t CULLING_BATCH_SIZE = 256;
+		static constexpr size_t MAX_LOGGED_MODELS = 8;
+
+		// Everything the CPU rewrites each frame, reused once the fence of the same frame in flight is signaled
+		struct FrameResources
+		{
+			VkCommandPool commandPool;
+			VkCommandBuffer commandBuffer;
+			std::unique_ptr<FrameArena> arena;
+			std::unique_ptr<DescriptorAllocator> descriptors;
+			// Points at the arena, each draw selects its Model::Instance with a dynamic offset
+			VkDescriptorSet drawUniformSet = VK_NULL_HANDLE;
+
+			VkBuffer readbackBuffer = VK_NULL_HANDLE;
+			MemoryAllocation readbackMemory;
+			VkDeviceSize readbackCapacity = 0;
+			bool readbackPending = false;
+			ReadbackFrame readback = {};
+		};
+
+		// Written by RecordCommandBuffer before the render graph runs the main pass
+		struct MainPassInputs
+		{
+			FrameAllocation instanceAllocation;
+			std::array<uint32_t, MeshOptimizer::MAX_LOD_COUNT + 1> lodFirstInstances = {};
+			bool drawInstances = false;
+		};
+
+		void RecordCommandBuffer(FrameResources& frame, uint32_t imageIndex);
+		void RecordMainPass(const RenderGraphPassContext& context);
+		void AllocateDrawUniformSet(FrameResources& frame);
+		void RecordReadback(FrameResources& frame, uint32_t imageIndex);
+		void DeliverReadback(FrameResources& frame);
+
+		ApplicationConfig m_config;
+		JobScheduler m_scheduler;
+		std::unique_ptr<Window> m_window = m_config.headless ? nullptr : std::make_unique<Window>(m_config.extent.width, m_config.extent.height, "Hello Vulkan");
+		Device m_device{ m_window.get() };
 		std::unique_ptr<Pipeline> m_pipeline;
+		std::unique_ptr<Pipeline> m_instancedPipeline;
+		// Declared after the pipelines so it stops watching before they are destroyed
+		std::unique_ptr<ShaderHotReload> m_shaderHotReload;
 		std::unique_ptr<SwapChain> m_swapChain;
-		std::unique_ptr<Model> m_model;
+		// Rebuilt with the swap chain, the main pass draws into the imported swap chain image
+		std::unique_ptr<RenderGraph> m_renderGraph;
+		RenderGraphResource m_backbuffer = 0;
+		uint32_t m_mainPass = 0;
+		MainPassInputs m_mainPassInputs;
+		std::unique_ptr<CommandRecorder> m_commandRecorder;
+		std::unique_ptr<GpuProfiler> m_gpuProfiler;
+		std::unique_ptr<BindlessHeap> m_bindlessHeap;
+		std::unique_ptr<TextureStreamer> m_textureStreamer;
+		std::vector<std::unique_ptr<Model>> m_models;
+		std::vector<Model*> m_drawList;
+		std::vector<uint32_t> m_drawLods;
+		std::vector<uint8_t> m_modelVisibility;
+		std::vector<uint32_t> m_modelLods;
+		std::unique_ptr<Model> m_instancedModel;
+		std::vector<Model::Instance> m_instances;
+		std::vector<uint32_t> m_instanceLods;
+		std::unique_ptr<GpuScene> m_gpuScene;
+		std::unique_ptr<AsyncLoader> m_asyncLoader;
 
+		VkDescriptorSetLayout m_drawUniformLayout;
 		VkPipelineLayout m_pipelineLayout;
-		std::vector<VkCommandBuffer> m_commandBuffers;
+		// What m_pipelineLayout was created with, given to every pipeline using it
+		std::vector<VkPushConstantRange> m_pushConstantRanges;
+		std::vector<FrameResources> m_frames;
+		FrameStats m_frameStats;
+		uint64_t m_triangleCount = 0;
+		uint64_t m_drawnTriangleCount = 0;
+		bool m_resizeRequested = false;
 	};
 }
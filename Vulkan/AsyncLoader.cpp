@@ -0,0 +1,315 @@
+#include "AsyncLoader.h"
+#include "CpuProfiler.h"
+#include "MeshAsset.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace Engine
+{
+	AsyncLoader::AsyncLoader(Device& device, uint32_t workerCount)
+		: m_device(device)
+	{
+		if (m_device.SupportsTimelineSemaphores())
+		{
+			VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+			typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			typeInfo.initialValue = 0;
+
+			VkSemaphoreCreateInfo semaphoreInfo = {};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphoreInfo.pNext = &typeInfo;
+			if (vkCreateSemaphore(m_device.GetDevice(), &semaphoreInfo, nullptr, &m_timeline) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create loader timeline semaphore !");
+		}
+
+		for (uint32_t i = 0; i < workerCount; i++)
+			m_workers.emplace_back(&AsyncLoader::WorkerLoop, this, i);
+	}
+
+	AsyncLoader::~AsyncLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_condition.notify_all();
+		for (auto& worker : m_workers)
+			worker.join();
+
+		// Queued loads never started, the copies already submitted must finish before their buffers go away
+		if (m_timeline != VK_NULL_HANDLE)
+			m_device.WaitSemaphore(m_timeline, m_submittedValue);
+		for (auto& load : m_inFlight)
+		{
+			if (load->fence != VK_NULL_HANDLE)
+				vkWaitForFences(m_device.GetDevice(), 1, &load->fence, VK_TRUE, UINT64_MAX);
+			Release(*load);
+		}
+
+		if (m_timeline != VK_NULL_HANDLE)
+			vkDestroySemaphore(m_device.GetDevice(), m_timeline, nullptr);
+	}
+
+	uint64_t AsyncLoader::LoadMesh(const std::string& path)
+	{
+		auto load = std::make_unique<Load>();
+		load->path = path;
+
+		uint64_t id;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			id = load->id = m_nextId++;
+			m_queue.push_back(std::move(load));
+		}
+		m_condition.notify_one();
+		return id;
+	}
+
+	std::vector<LoadedModel> AsyncLoader::CollectCompleted()
+	{
+		PROFILE_FUNCTION();
+		// A single counter read covers every load, without timeline semaphores each fence is polled
+		uint64_t completedValue = m_timeline != VK_NULL_HANDLE ? m_device.GetSemaphoreCounterValue(m_timeline) : 0;
+
+		std::vector<LoadedModel> completed;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (size_t i = 0; i < m_inFlight.size();)
+		{
+			Load& load = *m_inFlight[i];
+			if (!IsComplete(load, completedValue))
+			{
+				i++;
+				continue;
+			}
+
+			if (load.model != nullptr && m_device.HasDedicatedTransferQueue())
+			{
+				for (VkBuffer buffer : { load.model->GetVertexBuffer(), load.model->GetIndexBuffer() })
+				{
+					VkBufferMemoryBarrier barrier = {};
+					barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+					barrier.srcAccessMask = 0;
+					barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+					barrier.srcQueueFamilyIndex = m_device.TransferFamily();
+					barrier.dstQueueFamilyIndex = m_device.GraphicsFamily();
+					barrier.buffer = buffer;
+					barrier.offset = 0;
+					barrier.size = VK_WHOLE_SIZE;
+					m_pendingAcquires.push_back(barrier);
+				}
+			}
+
+			Release(load);
+			LoadedModel result;
+			result.id = load.id;
+			result.path = std::move(load.path);
+			result.model = std::move(load.model);
+			result.triangleCount = load.triangleCount;
+			result.error = std::move(load.error);
+			completed.push_back(std::move(result));
+
+			m_inFlight[i] = std::move(m_inFlight.back());
+			m_inFlight.pop_back();
+		}
+		return completed;
+	}
+
+	void AsyncLoader::RecordAcquireBarriers(VkCommandBuffer commandBuffer)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_pendingAcquires.empty())
+			return;
+
+		// The release was observed on the host before this submission, nothing is left to wait on
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(m_pendingAcquires.size()), m_pendingAcquires.data(), 0, nullptr);
+		m_pendingAcquires.clear();
+	}
+
+	size_t AsyncLoader::GetPendingCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_queue.size() + m_processingCount + m_inFlight.size();
+	}
+
+	void AsyncLoader::WorkerLoop(uint32_t workerIndex)
+	{
+		PROFILE_THREAD_NAME("Loader " + std::to_string(workerIndex));
+		while (true)
+		{
+			std::unique_ptr<Load> load;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [&]() { return m_stopping || !m_queue.empty(); });
+				if (m_stopping)
+					return;
+				load = std::move(m_queue.front());
+				m_queue.pop_front();
+				m_processingCount++;
+			}
+
+			// A broken file must not take the application down, the error is reported by CollectCompleted
+			try
+			{
+				Process(*load);
+			}
+			catch (const std::exception& exception)
+			{
+				Release(*load);
+				load->model.reset();
+				load->error = exception.what();
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_processingCount--;
+			m_inFlight.push_back(std::move(load));
+		}
+	}
+
+	void AsyncLoader::Process(Load& load)
+	{
+		PROFILE_FUNCTION();
+		MeshAsset asset(load.path);
+		const MeshFileHeader& header = asset.GetHeader();
+		VkDeviceSize vertexBytes = static_cast<VkDeviceSize>(header.vertexCount) * header.vertexStride;
+		VkDeviceSize indexBytes = static_cast<VkDeviceSize>(header.indexCount) * header.indexSize;
+
+		load.model = std::make_unique<Model>(m_device, asset, false);
+		load.triangleCount = asset.GetLods()[0].indexCount / 3;
+
+		// One staging buffer per load, the mapping is copied into it directly and it is freed once the copy completed
+		m_device.CreateBuffer(vertexBytes + indexBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, load.stagingBuffer, load.stagingMemory);
+		char* staging = static_cast<char*>(load.stagingMemory.mappedData);
+		std::memcpy(staging, asset.GetVertices(), static_cast<size_t>(vertexBytes));
+		std::memcpy(staging + vertexBytes, asset.GetIndices(), static_cast<size_t>(indexBytes));
+
+		// Command pools are externally synchronized, each load owns a transient one so workers never share a pool
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = m_device.TransferFamily();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		if (vkCreateCommandPool(m_device.GetDevice(), &poolInfo, nullptr, &load.commandPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create loader command pool !");
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = load.commandPool;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(m_device.GetDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate loader command buffer !");
+
+		RecordCopies(load, commandBuffer, vertexBytes, indexBytes);
+		Submit(load, commandBuffer);
+	}
+
+	void AsyncLoader::RecordCopies(Load& load, VkCommandBuffer commandBuffer, VkDeviceSize vertexBytes, VkDeviceSize indexBytes)
+	{
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		VkBufferCopy vertexCopy = { 0, 0, vertexBytes };
+		VkBufferCopy indexCopy = { vertexBytes, 0, indexBytes };
+		vkCmdCopyBuffer(commandBuffer, load.stagingBuffer, load.model->GetVertexBuffer(), 1, &vertexCopy);
+		vkCmdCopyBuffer(commandBuffer, load.stagingBuffer, load.model->GetIndexBuffer(), 1, &indexCopy);
+
+		if (m_device.HasDedicatedTransferQueue())
+		{
+			// Release half of the ownership transfer, the graphics queue acquires the buffers in RecordAcquireBarriers
+			VkBufferMemoryBarrier barriers[2] = {};
+			VkBuffer buffers[2] = { load.model->GetVertexBuffer(), load.model->GetIndexBuffer() };
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barriers[i].dstAccessMask = 0;
+				barriers[i].srcQueueFamilyIndex = m_device.TransferFamily();
+				barriers[i].dstQueueFamilyIndex = m_device.GraphicsFamily();
+				barriers[i].buffer = buffers[i];
+				barriers[i].offset = 0;
+				barriers[i].size = VK_WHOLE_SIZE;
+			}
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 2, barriers, 0, nullptr);
+		}
+		else
+		{
+			// Same queue as the draws, a plain barrier makes the copies visible to every later submission
+			VkMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to record loader command buffer !");
+	}
+
+	void AsyncLoader::Submit(Load& load, VkCommandBuffer commandBuffer)
+	{
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		if (m_timeline == VK_NULL_HANDLE)
+		{
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			if (vkCreateFence(m_device.GetDevice(), &fenceInfo, nullptr, &load.fence) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create loader fence !");
+			if (m_device.QueueSubmit(m_device.TransferQueue(), 1, &submitInfo, load.fence) != VK_SUCCESS)
+				throw std::runtime_error("Failed to submit loader copy !");
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_submitMutex);
+		load.timelineValue = m_submittedValue + 1;
+
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &load.timelineValue;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &m_timeline;
+
+		if (m_device.QueueSubmit(m_device.TransferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit loader copy !");
+		m_submittedValue = load.timelineValue;
+	}
+
+	bool AsyncLoader::IsComplete(const Load& load, uint64_t completedValue)
+	{
+		if (!load.error.empty())
+			return true;
+		if (load.fence != VK_NULL_HANDLE)
+			return vkGetFenceStatus(m_device.GetDevice(), load.fence) == VK_SUCCESS;
+		return load.timelineValue <= completedValue;
+	}
+
+	void AsyncLoader::Release(Load& load)
+	{
+		if (load.stagingBuffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(m_device.GetDevice(), load.stagingBuffer, nullptr);
+			m_device.FreeMemory(load.stagingMemory);
+			load.stagingBuffer = VK_NULL_HANDLE;
+		}
+		if (load.commandPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(m_device.GetDevice(), load.commandPool, nullptr);
+			load.commandPool = VK_NULL_HANDLE;
+		}
+		if (load.fence != VK_NULL_HANDLE)
+		{
+			vkDestroyFence(m_device.GetDevice(), load.fence, nullptr);
+			load.fence = VK_NULL_HANDLE;
+		}
+	}
+}
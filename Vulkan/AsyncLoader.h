@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Device.h"
+#include "Model.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Engine
+{
+	struct LoadedModel
+	{
+		uint64_t id = 0;
+		std::string path;
+		// Null when the load failed, error then says why
+		std::unique_ptr<Model> model;
+		uint64_t triangleCount = 0;
+		std::string error;
+	};
+
+	// Streams mesh files in while the render loop keeps running. Worker threads map the file, copy it to a staging buffer and
+	// submit the copy to the transfer queue, completion is signaled on a timeline semaphore (one fence per load without
+	// VK_KHR_timeline_semaphore). The render loop polls completions and never waits on a load
+	class AsyncLoader
+	{
+	public:
+		static constexpr uint32_t DEFAULT_WORKER_COUNT = 2;
+
+		AsyncLoader(Device& device, uint32_t workerCount = DEFAULT_WORKER_COUNT);
+		// Waits for the copies in flight, completed models that were never collected are destroyed
+		~AsyncLoader();
+
+		AsyncLoader(const AsyncLoader&) = delete;
+		AsyncLoader& operator=(const AsyncLoader&) = delete;
+
+		// Returns the id of the load, reported back by CollectCompleted
+		uint64_t LoadMesh(const std::string& path);
+
+		// Hands over the loads whose copies completed, or that failed, without blocking. Must be followed by
+		// RecordAcquireBarriers in a graphics command buffer submitted before the first draw of the returned models
+		std::vector<LoadedModel> CollectCompleted();
+		// Acquire half of the queue family ownership transfers of the collected models, nothing without a dedicated transfer queue
+		void RecordAcquireBarriers(VkCommandBuffer commandBuffer);
+
+		// Queued, loading or waiting on the GPU
+		size_t GetPendingCount();
+		bool UsesTimelineSemaphore() const { return m_timeline != VK_NULL_HANDLE; }
+
+	private:
+		struct Load
+		{
+			uint64_t id;
+			std::string path;
+			std::unique_ptr<Model> model;
+			uint64_t triangleCount = 0;
+			std::string error;
+
+			VkBuffer stagingBuffer = VK_NULL_HANDLE;
+			MemoryAllocation stagingMemory;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			uint64_t timelineValue = 0;
+		};
+
+		void WorkerLoop(uint32_t workerIndex);
+		void Process(Load& load);
+		void RecordCopies(Load& load, VkCommandBuffer commandBuffer, VkDeviceSize vertexBytes, VkDeviceSize indexBytes);
+		void Submit(Load& load, VkCommandBuffer commandBuffer);
+		bool IsComplete(const Load& load, uint64_t completedValue);
+		void Release(Load& load);
+
+	private:
+		Device& m_device;
+		VkSemaphore m_timeline = VK_NULL_HANDLE;
+		// Timeline values must be signaled in increasing order, picking the value and submitting happen under one lock
+		std::mutex m_submitMutex;
+		uint64_t m_submittedValue = 0;
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stopping = false;
+		uint64_t m_nextId = 1;
+		std::deque<std::unique_ptr<Load>> m_queue;
+		size_t m_processingCount = 0;
+		std::vector<std::unique_ptr<Load>> m_inFlight;
+		std::vector<VkBufferMemoryBarrier> m_pendingAcquires;
+		std::vector<std::thread> m_workers;
+	};
+}
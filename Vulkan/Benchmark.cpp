@@ -0,0 +1,729 @@
+#include "Benchmark.h"
+#include "BindlessHeap.h"
+#include "CpuProfiler.h"
+#include "MeshAsset.h"
+#include "MeshOptimizer.h"
+#include "Texture.h"
+#include "TextureStreamer.h"
+#include "UploadArena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace Engine
+{
+	namespace
+	{
+		struct SceneResult
+		{
+			std::string name;
+			std::string error;
+			std::string deviceName;
+			uint64_t triangleCount = 0;
+			size_t modelCount = 0;
+			size_t visibleDrawCount = 0;
+			uint64_t drawnTriangleCount = 0;
+			size_t streamedCount = 0;
+			bool gpuCulling = false;
+			uint32_t clusterCount = 0;
+			uint64_t visibleTriangleCount = 0;
+			uint64_t frameCount = 0;
+			uint64_t recreationCount = 0;
+			double framesPerSecond = 0.0;
+			TextureStreamingStats textures;
+			VkDeviceSize peakTextureBytes = 0;
+
+			BenchmarkMetric frame;
+			BenchmarkMetric fenceWait;
+			BenchmarkMetric record;
+			BenchmarkMetric submit;
+			BenchmarkMetric recreate;
+			BenchmarkMetric gpuFrame;
+		};
+
+		// Generated inputs, written under the temporary directory and removed with the set
+		class TemporaryFiles
+		{
+		public:
+			TemporaryFiles() = default;
+			~TemporaryFiles()
+			{
+				for (const auto& path : m_paths)
+				{
+					std::error_code error;
+					std::filesystem::remove(path, error);
+				}
+			}
+
+			TemporaryFiles(const TemporaryFiles&) = delete;
+			TemporaryFiles& operator=(const TemporaryFiles&) = delete;
+
+			std::string Add(const std::string& name)
+			{
+				m_paths.push_back((std::filesystem::temp_directory_path() / name).string());
+				return m_paths.back();
+			}
+
+		private:
+			std::vector<std::string> m_paths;
+		};
+
+		std::string EscapeJson(const std::string& value)
+		{
+			std::string escaped;
+			for (char c : value)
+			{
+				if (c == '"' || c == '\\')
+					escaped += '\\';
+				if (static_cast<unsigned char>(c) >= 0x20)
+					escaped += c;
+			}
+			return escaped;
+		}
+
+		void WriteMetric(std::ostream& out, const char* name, const BenchmarkMetric& metric, bool last)
+		{
+			out << "        \"" << name << "\": { \"mean\": " << metric.mean << ", \"min\": " << metric.min << ", \"max\": " << metric.max
+				<< ", \"p50\": " << metric.p50 << ", \"p90\": " << metric.p90 << ", \"p99\": " << metric.p99 << " }" << (last ? "\n" : ",\n");
+		}
+
+		void WriteReport(std::ostream& out, const BenchmarkConfig& config, const std::vector<SceneResult>& results)
+		{
+			out << std::fixed << std::setprecision(4);
+			out << "{\n";
+			out << "  \"framesInFlight\": " << config.application.framesInFlight << ",\n";
+			out << "  \"headless\": " << (config.application.headless ? "true" : "false") << ",\n";
+			out << "  \"gpuCulling\": " << (config.application.gpuCulling ? "true" : "false") << ",\n";
+			out << "  \"backfaceCulling\": " << (config.application.backfaceCulling ? "true" : "false") << ",\n";
+			out << "  \"warmupFrames\": " << config.warmupFrames << ",\n";
+			out << "  \"measuredFrames\": " << config.measuredFrames << ",\n";
+			out << "  \"scenes\": [\n";
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				const SceneResult& result = results[i];
+				out << "    {\n";
+				out << "      \"name\": \"" << EscapeJson(result.name) << "\",\n";
+				if (!result.error.empty())
+				{
+					out << "      \"error\": \"" << EscapeJson(result.error) << "\"\n";
+				}
+				else
+				{
+					out << "      \"device\": \"" << EscapeJson(result.deviceName) << "\",\n";
+					out << "      \"triangles\": " << result.triangleCount << ",\n";
+					out << "      \"models\": " << result.modelCount << ",\n";
+					out << "      \"visibleDraws\": " << result.visibleDrawCount << ",\n";
+					out << "      \"drawnTriangles\": " << result.drawnTriangleCount << ",\n";
+					if (result.streamedCount > 0)
+						out << "      \"streamedModels\": " << result.streamedCount << ",\n";
+					out << "      \"gpuCulling\": " << (result.gpuCulling ? "true" : "false") << ",\n";
+					if (result.gpuCulling)
+					{
+						out << "      \"meshlets\": " << result.clusterCount << ",\n";
+						out << "      \"visibleTriangles\": " << result.visibleTriangleCount << ",\n";
+					}
+					out << "      \"frames\": " << result.frameCount << ",\n";
+					out << "      \"recreations\": " << result.recreationCount << ",\n";
+					out << "      \"framesPerSecond\": " << result.framesPerSecond << ",\n";
+					if (result.textures.textureCount > 0)
+					{
+						out << "      \"textures\": { \"count\": " << result.textures.textureCount << ", \"budget\": " << result.textures.budget << ", \"peakResidentBytes\": "
+							<< result.peakTextureBytes << ", \"upgrades\": " << result.textures.upgradeCount << ", \"downgrades\": " << result.textures.downgradeCount << " },\n";
+					}
+					out << "      \"milliseconds\": {\n";
+					WriteMetric(out, "frame", result.frame, false);
+					WriteMetric(out, "fenceWait", result.fenceWait, false);
+					WriteMetric(out, "record", result.record, false);
+					WriteMetric(out, "submit", result.submit, false);
+					WriteMetric(out, "recreate", result.recreate, false);
+					WriteMetric(out, "gpuFrame", result.gpuFrame, true);
+					out << "      }\n";
+				}
+				out << "    }" << (i + 1 < results.size() ? ",\n" : "\n");
+			}
+			out << "  ]\n";
+			out << "}\n";
+		}
+
+		SceneResult RunScene(const BenchmarkConfig& config, const BenchmarkScene& scene)
+		{
+			SceneResult result;
+			result.name = scene.name;
+
+			std::vector<FrameTiming> timings;
+			timings.reserve(config.warmupFrames + config.measuredFrames);
+
+			// Outlives the application, its models map the files until it is destroyed
+			TemporaryFiles temporaryFiles;
+			std::vector<std::string> streamedFiles;
+			for (size_t i = 0; i < scene.streamedMeshes.size(); i++)
+			{
+				streamedFiles.push_back(temporaryFiles.Add("benchmark_stream_" + std::to_string(i) + ".mesh"));
+				MeshAsset::Write(streamedFiles.back(), scene.streamedMeshes[i], {});
+			}
+
+			ApplicationConfig applicationConfig = config.application;
+			applicationConfig.meshes = scene.meshes;
+			applicationConfig.instancedMesh = scene.instancedMesh;
+			applicationConfig.instances = scene.instances;
+			applicationConfig.frameLimit = 0;
+			applicationConfig.onFrameTiming = [&](const FrameTiming& timing) { timings.push_back(timing); };
+			if (!scene.textures.empty())
+			{
+				applicationConfig.textureFiles.clear();
+				for (size_t i = 0; i < scene.textures.size(); i++)
+				{
+					applicationConfig.textureFiles.push_back(temporaryFiles.Add("benchmark_texture_" + std::to_string(i) + ".tex"));
+					TextureAsset::Write(applicationConfig.textureFiles.back(), scene.textures[i], true);
+				}
+				applicationConfig.textureBudgetMegabytes = scene.textureBudgetMegabytes;
+				// Handles follow the order of the files, the streamer has no other texture
+				applicationConfig.onTextureRequests = [&](TextureStreamer& streamer, uint64_t frameNumber)
+				{
+					result.peakTextureBytes = std::max(result.peakTextureBytes, streamer.GetStats().residentBytes);
+					uint64_t first = frameNumber / scene.textureFocusInterval;
+					for (uint32_t i = 0; i < scene.textureFocusCount; i++)
+						streamer.Request(static_cast<TextureStreamer::Handle>((first + i) % streamer.GetTextureCount()), 0);
+				};
+			}
+
+			Application application(applicationConfig);
+			result.deviceName = application.GetDevice().Properties.deviceName;
+			result.triangleCount = application.GetTriangleCount();
+			result.modelCount = application.GetModelCount();
+
+			auto measureStart = std::chrono::high_resolution_clock::now();
+			for (uint64_t frame = 0; frame < config.warmupFrames + config.measuredFrames; frame++)
+			{
+				if (frame == config.warmupFrames)
+				{
+					timings.clear();
+					measureStart = std::chrono::high_resolution_clock::now();
+					for (const auto& path : streamedFiles)
+						application.LoadMeshAsync(path);
+				}
+
+				if (scene.resizeInterval > 0 && !scene.resizeExtents.empty() && frame > 0 && frame % scene.resizeInterval == 0)
+					application.Resize(scene.resizeExtents[(frame / scene.resizeInterval) % scene.resizeExtents.size()]);
+				application.RunFrame();
+			}
+			application.WaitIdle();
+			double measuredSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - measureStart).count();
+			result.visibleDrawCount = application.GetVisibleDrawCount();
+			result.drawnTriangleCount = application.GetDrawnTriangleCount();
+			result.streamedCount = application.GetModelCount() - result.modelCount;
+			result.textures = application.GetTextureStreamer().GetStats();
+			result.peakTextureBytes = std::max(result.peakTextureBytes, result.textures.residentBytes);
+			if (const GpuScene* gpuScene = application.GetGpuScene())
+			{
+				result.gpuCulling = true;
+				result.clusterCount = gpuScene->GetClusterCount();
+				result.visibleTriangleCount = gpuScene->GetVisibleTriangleCount();
+			}
+
+			std::vector<double> frame, fenceWait, record, submit, recreate;
+			for (const FrameTiming& timing : timings)
+			{
+				frame.push_back(timing.frameMilliseconds);
+				fenceWait.push_back(timing.fenceWaitMilliseconds);
+				record.push_back(timing.recordMilliseconds);
+				submit.push_back(timing.submitMilliseconds);
+				if (timing.recreateMilliseconds > 0.0)
+					recreate.push_back(timing.recreateMilliseconds);
+			}
+
+			result.frameCount = timings.size();
+			result.recreationCount = recreate.size();
+			result.framesPerSecond = measuredSeconds > 0.0 ? timings.size() / measuredSeconds : 0.0;
+			result.frame = BenchmarkMetric::FromSamples(std::move(frame));
+			result.fenceWait = BenchmarkMetric::FromSamples(std::move(fenceWait));
+			result.record = BenchmarkMetric::FromSamples(std::move(record));
+			result.submit = BenchmarkMetric::FromSamples(std::move(submit));
+			result.recreate = BenchmarkMetric::FromSamples(std::move(recreate));
+
+			// Frame numbers start at 1, the profiler only keeps its last HISTORY_SIZE frames
+			std::vector<double> gpuFrame;
+			for (const GpuFrameResult& gpuResult : application.GetGpuProfiler().GetHistory())
+				if (gpuResult.frameNumber > config.warmupFrames)
+					gpuFrame.push_back(gpuResult.root.durationMilliseconds);
+			result.gpuFrame = BenchmarkMetric::FromSamples(std::move(gpuFrame));
+			return result;
+		}
+	}
+
+	BenchmarkMetric BenchmarkMetric::FromSamples(std::vector<double> samples)
+	{
+		BenchmarkMetric metric;
+		if (samples.empty())
+			return metric;
+
+		std::sort(samples.begin(), samples.end());
+		// Nearest rank, always one of the measured values
+		auto percentile = [&](double p) { return samples[std::clamp<size_t>(static_cast<size_t>(std::ceil(p * samples.size())), 1, samples.size()) - 1]; };
+
+		double sum = 0.0;
+		for (double sample : samples)
+			sum += sample;
+
+		metric.mean = sum / samples.size();
+		metric.min = samples.front();
+		metric.max = samples.back();
+		metric.p50 = percentile(0.50);
+		metric.p90 = percentile(0.90);
+		metric.p99 = percentile(0.99);
+		return metric;
+	}
+
+	std::vector<Model::Vertex> Benchmark::GenerateGrid(size_t triangleCount, glm::vec2 boundsMin, glm::vec2 boundsMax)
+	{
+		// Two triangles per cell, in a grid as square as possible
+		size_t cellCount = (triangleCount + 1) / 2;
+		size_t columns = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(cellCount)))));
+		size_t rows = std::max<size_t>(1, (cellCount + columns - 1) / columns);
+		glm::vec2 cellSize = (boundsMax - boundsMin) / glm::vec2(static_cast<float>(columns), static_cast<float>(rows));
+
+		std::vector<Model::Vertex> vertices;
+		vertices.reserve(triangleCount * 3);
+		for (size_t cell = 0; cell < cellCount; cell++)
+		{
+			glm::vec2 uv = glm::vec2(static_cast<float>(cell % columns) / columns, static_cast<float>(cell / columns) / rows);
+			glm::vec2 corner = boundsMin + cellSize * glm::vec2(static_cast<float>(cell % columns), static_cast<float>(cell / columns));
+			glm::vec3 color = { uv.x, uv.y, 1.0f - uv.x };
+
+			Model::Vertex topLeft = { corner, color };
+			Model::Vertex topRight = { corner + glm::vec2(cellSize.x, 0.0f), color };
+			Model::Vertex bottomLeft = { corner + glm::vec2(0.0f, cellSize.y), color };
+			Model::Vertex bottomRight = { corner + cellSize, color };
+
+			vertices.insert(vertices.end(), { topLeft, topRight, bottomLeft });
+			if (vertices.size() < triangleCount * 3)
+				vertices.insert(vertices.end(), { topRight, bottomRight, bottomLeft });
+		}
+		return vertices;
+	}
+
+	std::vector<Model::Vertex> Benchmark::GenerateSmoothGrid(size_t triangleCount, glm::vec2 boundsMin, glm::vec2 boundsMax)
+	{
+		size_t cellCount = (triangleCount + 1) / 2;
+		size_t columns = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(cellCount)))));
+		size_t rows = std::max<size_t>(1, (cellCount + columns - 1) / columns);
+
+		// Corners are computed from their grid coordinates, neighbor cells produce identical vertices that Optimize merges
+		auto corner = [&](size_t x, size_t y)
+		{
+			glm::vec2 uv = glm::vec2(static_cast<float>(x) / columns, static_cast<float>(y) / rows);
+			return Model::Vertex{ boundsMin + (boundsMax - boundsMin) * uv, { uv.x, uv.y, 1.0f - uv.x } };
+		};
+
+		std::vector<Model::Vertex> vertices;
+		vertices.reserve(triangleCount * 3);
+		for (size_t cell = 0; cell < cellCount; cell++)
+		{
+			size_t x = cell % columns, y = cell / columns;
+			vertices.insert(vertices.end(), { corner(x, y), corner(x + 1, y), corner(x, y + 1) });
+			if (vertices.size() < triangleCount * 3)
+				vertices.insert(vertices.end(), { corner(x + 1, y), corner(x + 1, y + 1), corner(x, y + 1) });
+		}
+		return vertices;
+	}
+
+	TextureImage Benchmark::GenerateTexture(uint32_t size)
+	{
+		// Smooth gradients with hard edged rings, the content block compression has to trade off
+		TextureImage image;
+		image.width = size;
+		image.height = size;
+		image.texels.resize(static_cast<size_t>(size) * size * 4);
+		for (uint32_t y = 0; y < size; y++)
+			for (uint32_t x = 0; x < size; x++)
+			{
+				glm::vec2 uv = glm::vec2(static_cast<float>(x), static_cast<float>(y)) / static_cast<float>(size);
+				float ring = std::fmod(glm::length(uv - 0.5f) * 24.0f, 1.0f) < 0.5f ? 1.0f : 0.6f;
+				uint8_t* texel = &image.texels[(static_cast<size_t>(y) * size + x) * 4];
+				texel[0] = static_cast<uint8_t>(255.0f * uv.x * ring);
+				texel[1] = static_cast<uint8_t>(255.0f * uv.y * ring);
+				texel[2] = static_cast<uint8_t>(255.0f * (1.0f - uv.x) * ring);
+				texel[3] = 255;
+			}
+		return image;
+	}
+
+	std::vector<BenchmarkScene> Benchmark::DefaultScenes()
+	{
+		std::vector<BenchmarkScene> scenes;
+		for (size_t triangleCount : { 1000, 10000, 100000 })
+			scenes.push_back({ "triangles_" + std::to_string(triangleCount / 1000) + "k", { GenerateGrid(triangleCount, { -1.0f, -1.0f }, { 1.0f, 1.0f }) } });
+
+		// Draw call bound : 32x32 quads spread past the screen edges, so culling drops the outer ring
+		BenchmarkScene smallModels = { "small_models_1k" };
+		const int side = 32;
+		const float spacing = 3.0f / side;
+		for (int y = 0; y < side; y++)
+			for (int x = 0; x < side; x++)
+			{
+				glm::vec2 corner = { -1.5f + x * spacing, -1.5f + y * spacing };
+				smallModels.meshes.push_back(GenerateGrid(2, corner, corner + glm::vec2(spacing * 0.8f)));
+			}
+		scenes.push_back(std::move(smallModels));
+
+		// 100k copies of one small quad in a single instanced draw call
+		BenchmarkScene instances = { "instances_100k" };
+		instances.instancedMesh = GenerateGrid(2, { -0.5f, -0.5f }, { 0.5f, 0.5f });
+		const int instanceSide = 317;
+		for (int y = 0; y < instanceSide && instances.instances.size() < 100000; y++)
+			for (int x = 0; x < instanceSide && instances.instances.size() < 100000; x++)
+			{
+				Model::Instance instance;
+				instance.offset = { -1.0f + (x + 0.5f) * 2.0f / instanceSide, -1.0f + (y + 0.5f) * 2.0f / instanceSide };
+				instance.scale = glm::vec2(1.6f / instanceSide);
+				instance.color = { static_cast<float>(x) / instanceSide, static_cast<float>(y) / instanceSide, 1.0f, 1.0f };
+				instances.instances.push_back(instance);
+			}
+		scenes.push_back(std::move(instances));
+
+		// A 20k triangle mesh drawn 1024 times, shrinking from a quarter of the screen to a few pixels : each instance picks its
+		// LOD, compare drawnTriangles with triangles
+		BenchmarkScene lodInstances = { "lod_instances_1k" };
+		lodInstances.instancedMesh = GenerateSmoothGrid(20000, { -0.5f, -0.5f }, { 0.5f, 0.5f });
+		const int lodSide = 32;
+		for (int i = 0; i < lodSide * lodSide; i++)
+		{
+			Model::Instance instance;
+			instance.offset = { -1.0f + (i % lodSide + 0.5f) * 2.0f / lodSide, -1.0f + (i / lodSide + 0.5f) * 2.0f / lodSide };
+			instance.scale = glm::vec2(0.5f * std::pow(0.01f, static_cast<float>(i) / (lodSide * lodSide)));
+			lodInstances.instances.push_back(instance);
+		}
+		scenes.push_back(std::move(lodInstances));
+
+		// One huge mesh, only a quarter of it on screen : with GPU culling the GPU cost follows the visible meshlets
+		scenes.push_back({ "large_mesh_1m", { GenerateGrid(1000000, { -3.0f, -3.0f }, { 1.0f, 1.0f }) } });
+
+		// 8 meshes of 250k triangles streamed in while rendering, the frame time percentiles show any hitch
+		BenchmarkScene streaming = { "streaming", { GenerateGrid(1000, { -1.0f, -1.0f }, { 1.0f, 1.0f }) } };
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec2 corner = { -1.0f + (i % 4) * 0.5f, -1.0f + (i / 4) * 1.0f };
+			streaming.streamedMeshes.push_back(GenerateGrid(250000, corner, corner + glm::vec2(0.45f, 0.9f)));
+		}
+		scenes.push_back(std::move(streaming));
+
+		// Swap chain recreation every other frame, through extents of different sizes and aspect ratios
+		BenchmarkScene resizeStorm = { "resize_storm", { GenerateGrid(1000, { -1.0f, -1.0f }, { 1.0f, 1.0f }) } };
+		resizeStorm.resizeInterval = 2;
+		resizeStorm.resizeExtents = { { 640, 480 }, { 1280, 720 }, { 320, 240 }, { 1920, 1080 }, { 800, 600 } };
+		scenes.push_back(std::move(resizeStorm));
+
+		// 8 textures of 1024x1024 and a budget too small for all their chains : 2 of them are requested at a time, the window
+		// moves every 60 frames so textures upgrade as it reaches them and fall back to their tail once it has moved on
+		BenchmarkScene textureStreaming = { "texture_streaming", { GenerateGrid(1000, { -1.0f, -1.0f }, { 1.0f, 1.0f }) } };
+		textureStreaming.textures.assign(8, GenerateTexture(1024));
+		textureStreaming.textureBudgetMegabytes = 8;
+		textureStreaming.textureFocusCount = 2;
+		textureStreaming.textureFocusInterval = 60;
+		scenes.push_back(std::move(textureStreaming));
+		return scenes;
+	}
+
+	bool Benchmark::Run(const BenchmarkConfig& config)
+	{
+		std::vector<SceneResult> results;
+		bool success = true;
+		for (const BenchmarkScene& scene : DefaultScenes())
+		{
+			if (!config.scenes.empty() && std::find(config.scenes.begin(), config.scenes.end(), scene.name) == config.scenes.end())
+				continue;
+
+			std::cerr << "Benchmark : running " << scene.name << std::endl;
+			try
+			{
+				results.push_back(RunScene(config, scene));
+			}
+			catch (const std::exception& exception)
+			{
+				SceneResult result;
+				result.name = scene.name;
+				result.error = exception.what();
+				results.push_back(result);
+				success = false;
+			}
+		}
+
+		if (results.empty())
+		{
+			std::cerr << "Benchmark : no scene matches the requested names" << std::endl;
+			return false;
+		}
+
+		std::ofstream file(config.outputPath);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open benchmark output " + config.outputPath + " !");
+		WriteReport(file, config, results);
+		std::cerr << "Benchmark : report written to " << config.outputPath << std::endl;
+		return success;
+	}
+
+	void Benchmark::RunMeshLoad(const std::string& path, uint32_t iterations)
+	{
+		TemporaryFiles temporaryFiles;
+		std::string meshPath = path;
+		if (meshPath.empty())
+		{
+			meshPath = temporaryFiles.Add("mesh_load_benchmark.mesh");
+			MeshAsset::Write(meshPath, GenerateGrid(1000000, glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, 1.0f)), {});
+		}
+
+		Device device(nullptr);
+		UploadArena& uploadArena = device.GetUploadArena();
+		using Clock = std::chrono::steady_clock;
+
+		// Both paths read a warm page cache, the numbers compare copies and not the disk
+		size_t fileSize = MeshAsset(meshPath).GetFileSize();
+
+		std::vector<double> mappedSeconds;
+		std::vector<double> bufferedSeconds;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			auto start = Clock::now();
+			{
+				MeshAsset asset(meshPath);
+				Model model(device, asset);
+				uploadArena.Wait(uploadArena.Flush());
+			}
+			mappedSeconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+
+			// Baseline : the usual read of the whole file into a vector, then the same bytes uploaded from it
+			start = Clock::now();
+			{
+				std::ifstream file(meshPath, std::ios::ate | std::ios::binary);
+				std::vector<char> data(static_cast<size_t>(file.tellg()));
+				file.seekg(0);
+				file.read(data.data(), data.size());
+
+				VkBuffer buffer;
+				MemoryAllocation memory;
+				device.CreateBuffer(data.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+				uploadArena.Upload(buffer, 0, data.data(), data.size());
+				uploadArena.Wait(uploadArena.Flush());
+				vkDestroyBuffer(device.GetDevice(), buffer, nullptr);
+				device.FreeMemory(memory);
+			}
+			bufferedSeconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+		}
+
+		auto report = [&](const char* name, const std::vector<double>& seconds)
+		{
+			BenchmarkMetric metric = BenchmarkMetric::FromSamples(seconds);
+			std::cout << std::fixed << std::setprecision(2) << "  " << name << " : p50 " << metric.p50 * 1000.0 << " ms, "
+				<< fileSize / metric.p50 / 1e6 << " MB/s (best " << fileSize / metric.min / 1e6 << " MB/s)" << std::endl;
+		};
+
+		std::cout << "Mesh load : " << meshPath << ", " << fileSize << " bytes, " << iterations << " iterations, load and upload to the GPU" << std::endl;
+		report("mapped  ", mappedSeconds);
+		report("buffered", bufferedSeconds);
+	}
+
+	void Benchmark::RunTextureLoad(const std::string& path, uint32_t iterations)
+	{
+		TemporaryFiles temporaryFiles;
+		std::string texturePath = path;
+		if (texturePath.empty())
+		{
+			texturePath = temporaryFiles.Add("texture_load_benchmark.tex");
+			TextureAsset::Write(texturePath, GenerateTexture(2048), true);
+		}
+
+		Device device(nullptr);
+		UploadArena& uploadArena = device.GetUploadArena();
+		using Clock = std::chrono::steady_clock;
+
+		auto probe = std::make_shared<const TextureAsset>(texturePath);
+		uint32_t tailMip = TextureStreamer::ComputeTailMip(*probe);
+		// The baseline needs the RGBA8 texels, what a PNG decoder would hand over
+		int32_t rgbaEncoding = -1;
+		for (uint32_t i = 0; i < probe->GetEncodingCount(); i++)
+			if (probe->GetFormat(i) == VK_FORMAT_R8G8B8A8_SRGB || probe->GetFormat(i) == VK_FORMAT_R8G8B8A8_UNORM)
+				rgbaEncoding = static_cast<int32_t>(i);
+		TextureImage image;
+		if (rgbaEncoding >= 0)
+		{
+			const uint8_t* texels = probe->GetMipData(rgbaEncoding, 0);
+			image.width = probe->GetHeader().width;
+			image.height = probe->GetHeader().height;
+			image.texels.assign(texels, texels + probe->GetMipSize(rgbaEncoding, 0));
+		}
+
+		std::vector<double> fullSeconds;
+		std::vector<double> tailSeconds;
+		std::vector<double> generatedSeconds;
+		VkDeviceSize fullBytes = 0;
+		VkDeviceSize tailBytes = 0;
+		VkDeviceSize generatedBytes = 0;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			// Opening the file is part of the load, the page cache is warm after the first iteration
+			auto start = Clock::now();
+			{
+				Texture texture(device, std::make_shared<const TextureAsset>(texturePath), 0);
+				uploadArena.Wait(uploadArena.Flush());
+				fullBytes = texture.GetResidentBytes();
+				format = texture.GetFormat();
+			}
+			fullSeconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+
+			start = Clock::now();
+			{
+				Texture texture(device, std::make_shared<const TextureAsset>(texturePath), tailMip);
+				uploadArena.Wait(uploadArena.Flush());
+				tailBytes = texture.GetResidentBytes();
+			}
+			tailSeconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+
+			if (rgbaEncoding < 0)
+				continue;
+			start = Clock::now();
+			{
+				Texture texture(device, image, probe->IsSrgb(), true);
+				uploadArena.Wait(uploadArena.Flush());
+				generatedBytes = texture.GetResidentBytes();
+			}
+			generatedSeconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+		}
+
+		auto report = [&](const char* name, const std::vector<double>& seconds, VkDeviceSize bytes)
+		{
+			BenchmarkMetric metric = BenchmarkMetric::FromSamples(seconds);
+			std::cout << std::fixed << std::setprecision(2) << "  " << name << " : p50 " << metric.p50 * 1000.0 << " ms (best " << metric.min * 1000.0 << " ms), "
+				<< bytes / (1024.0 * 1024.0) << " MB of device memory" << std::endl;
+		};
+
+		std::cout << "Texture load : " << texturePath << ", " << probe->GetHeader().width << "x" << probe->GetHeader().height << ", " << probe->GetMipCount()
+			<< " mips, format " << format << ", " << iterations << " iterations, load and upload to the GPU" << std::endl;
+		report("full chain   ", fullSeconds, fullBytes);
+		report("tail only    ", tailSeconds, tailBytes);
+		if (rgbaEncoding >= 0)
+			report("RGBA8 + blits", generatedSeconds, generatedBytes);
+		else
+			std::cout << "  RGBA8 + blits : skipped, the file has no RGBA8 encoding" << std::endl;
+	}
+
+	bool Benchmark::RunTextureStreamingTest(uint64_t budgetMegabytes)
+	{
+		bool success = true;
+		auto check = [&](bool condition, const char* name)
+		{
+			if (!condition)
+				std::cerr << "Texture streaming self test failed : " << name << std::endl;
+			success &= condition;
+		};
+
+		const uint32_t textureCount = 8;
+		TemporaryFiles temporaryFiles;
+		std::string texturePath = temporaryFiles.Add("texture_streaming_test.tex");
+		TextureAsset::Write(texturePath, GenerateTexture(2048), true);
+
+		Device device(nullptr);
+		UploadArena& uploadArena = device.GetUploadArena();
+		BindlessHeap bindlessHeap(device, 1);
+		VkDeviceSize budget = budgetMegabytes * 1024 * 1024;
+		TextureStreamer streamer(device, bindlessHeap, 1, budget);
+		std::vector<TextureStreamer::Handle> handles;
+		for (uint32_t i = 0; i < textureCount; i++)
+			handles.push_back(streamer.Load(texturePath));
+
+		const Texture& first = streamer.GetTexture(handles[0]);
+		uint32_t tailMip = first.GetFirstMip();
+		check(tailMip > 0, "tail smaller than the texture");
+		check(first.QueryResidentBytes(0) * textureCount > budget, "budget smaller than every full chain");
+
+		// Each Update stands for a frame, its copies complete before the next one like a frame in flight
+		bool withinBudget = true;
+		uint64_t frameNumber = 1;
+		auto runFrames = [&](uint64_t frameCount, uint32_t requestedCount)
+		{
+			for (uint64_t i = 0; i < frameCount; i++, frameNumber++)
+			{
+				for (uint32_t j = 0; j < requestedCount; j++)
+					streamer.Request(handles[j], 0);
+				streamer.Update(frameNumber);
+				uploadArena.WaitIdle();
+				withinBudget &= streamer.GetStats().residentBytes <= budget;
+			}
+		};
+
+		// Every texture wants its whole chain, the budget keeps the least recently requested ones coarser
+		runFrames(60, textureCount);
+		TextureStreamingStats stats = streamer.GetStats();
+		check(stats.upgradeCount > 0, "upgrades");
+		bool coarsened = false;
+		for (TextureStreamer::Handle handle : handles)
+			coarsened |= streamer.GetTexture(handle).GetFirstMip() > 0;
+		check(coarsened, "coarsened to fit the budget");
+
+		// The others are no longer requested and fall back to their tail, the first one takes what they leave
+		runFrames(TextureStreamer::EVICTION_DELAY_FRAMES + 2, 1);
+		stats = streamer.GetStats();
+		check(stats.downgradeCount > 0, "downgrades");
+		check(streamer.GetTexture(handles[0]).GetFirstMip() < tailMip, "upgrade of the requested texture");
+		bool evicted = true;
+		for (uint32_t i = 1; i < textureCount; i++)
+			evicted &= streamer.GetTexture(handles[i]).GetFirstMip() == tailMip;
+		check(evicted, "eviction");
+		check(withinBudget, "resident bytes within the budget");
+
+		std::cout << "Texture streaming : " << stats.residentBytes << " of " << stats.budget << " bytes resident, " << stats.upgradeCount << " upgrades, "
+			<< stats.downgradeCount << " downgrades" << std::endl;
+		if (success)
+			std::cout << "Texture streaming self test passed" << std::endl;
+		return success;
+	}
+
+	void Benchmark::RunSimplify()
+	{
+		using Clock = std::chrono::steady_clock;
+		for (bool ring : { false, true })
+			for (size_t triangleCount : { 10000, 100000, 1000000 })
+			{
+				std::vector<Model::Vertex> vertices = GenerateSmoothGrid(triangleCount, { 0.0f, 0.0f }, { 1.0f, 1.0f });
+				// Three quarters of an annulus, its borders are arcs and an interior collapse can no longer be free
+				if (ring)
+					for (auto& vertex : vertices)
+					{
+						float angle = vertex.position.x * 4.712389f;
+						float radius = 0.5f + 0.5f * vertex.position.y;
+						vertex.position = { radius * std::cos(angle), radius * std::sin(angle) };
+					}
+
+				std::vector<uint32_t> indices;
+				MeshOptimizer::Optimize(vertices, indices);
+				std::vector<uint32_t> original = indices;
+
+				auto start = Clock::now();
+				std::vector<MeshLod> lods;
+				{
+					PROFILE_SCOPE("BuildLodChain");
+					lods = MeshOptimizer::BuildLodChain(vertices, indices);
+				}
+				double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+				std::cout << std::fixed << std::setprecision(2) << "Simplify " << (ring ? "ring" : "grid") << " " << original.size() / 3 << " triangles : "
+					<< seconds * 1000.0 << " ms, " << original.size() / 3 / seconds / 1e6 << " M triangles/s, " << lods.size() << " LODs" << std::endl;
+
+				// Errors are in mesh units, the mesh spans 1 unit (2 for the ring)
+				for (size_t i = 0; i < lods.size(); i++)
+				{
+					std::vector<uint32_t> lodIndices(indices.begin() + lods[i].firstIndex, indices.begin() + lods[i].firstIndex + lods[i].indexCount);
+					SimplificationError error = MeshOptimizer::MeasureSimplificationError(vertices, original, lodIndices);
+					std::cout << std::setprecision(5) << "  LOD " << i << " : " << lods[i].indexCount / 3 << " triangles, error " << lods[i].error
+						<< ", measured distance " << error.maxDistance << ", color rms " << error.attributeRms << " max " << error.attributeMax
+						<< ", coverage " << error.coverage * 100.0f << "%" << std::endl;
+				}
+			}
+	}
+}
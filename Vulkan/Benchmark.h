@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Application.h"
+#include "TextureEncoder.h"
+
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	// A deterministic workload, generated in code so every run and every machine draws exactly the same thing
+	struct BenchmarkScene
+	{
+		std::string name;
+		std::vector<std::vector<Model::Vertex>> meshes;
+		std::vector<Model::Vertex> instancedMesh;
+		std::vector<Model::Instance> instances;
+		// Written to mesh files before the scene starts, then streamed in from the first measured frame
+		std::vector<std::vector<Model::Vertex>> streamedMeshes;
+		// Resizes every N frames, cycling through resizeExtents, 0 never resizes
+		uint32_t resizeInterval = 0;
+		std::vector<VkExtent2D> resizeExtents;
+		// Written to texture files and streamed within textureBudgetMegabytes. Every frame requests mip 0 of textureFocusCount
+		// consecutive textures, a window that moves on by one texture every textureFocusInterval frames
+		std::vector<TextureImage> textures;
+		uint64_t textureBudgetMegabytes = 0;
+		uint32_t textureFocusCount = 0;
+		uint32_t textureFocusInterval = 1;
+	};
+
+	struct BenchmarkConfig
+	{
+		// Base configuration of every scene, meshes and callbacks are replaced by the benchmark
+		ApplicationConfig application;
+		// Not measured, covers pipeline creation, first uploads and driver warm up
+		uint64_t warmupFrames = 30;
+		uint64_t measuredFrames = 500;
+		// Runs every scene when empty
+		std::vector<std::string> scenes;
+		// The application logs to stdout, the JSON report always goes to a file
+		std::string outputPath = "benchmark.json";
+	};
+
+	struct BenchmarkMetric
+	{
+		double mean = 0.0;
+		double min = 0.0;
+		double max = 0.0;
+		double p50 = 0.0;
+		double p90 = 0.0;
+		double p99 = 0.0;
+
+		static BenchmarkMetric FromSamples(std::vector<double> samples);
+	};
+
+	class Benchmark
+	{
+	public:
+		static std::vector<BenchmarkScene> DefaultScenes();
+		// Runs the scenes one after the other, each in its own application, and writes the report. Returns false if a scene failed
+		static bool Run(const BenchmarkConfig& config);
+		// Loads a mesh file through its mapping and through a buffered read into a vector, both uploaded to the GPU, and
+		// prints the throughput of each in MB/s. An empty path writes and loads a generated 1M triangle mesh, removed afterwards
+		static void RunMeshLoad(const std::string& path, uint32_t iterations = 20);
+		// Loads a texture file with its whole chain in the best encoding the device samples, with only the streaming tail
+		// resident, and as RGBA8 with mips generated on the GPU, prints the time and device memory of each. An empty path
+		// writes and loads a generated 2048x2048 texture, removed afterwards
+		static void RunTextureLoad(const std::string& path, uint32_t iterations = 20);
+		// Streams generated 2048x2048 textures within the budget : requests mip 0 of all of them, then of the first only until
+		// the others are evicted. Checks the upgrades, the downgrades and that the resident bytes never exceed the budget
+		static bool RunTextureStreamingTest(uint64_t budgetMegabytes = 16);
+		// CPU only : builds the LOD chain of grids from 10k to 1M triangles, flat and bent into a ring so borders curve, prints
+		// the simplifier throughput in triangles/s and the error of every LOD measured against the original mesh
+		static void RunSimplify();
+
+	private:
+		static std::vector<Model::Vertex> GenerateGrid(size_t triangleCount, glm::vec2 boundsMin, glm::vec2 boundsMax);
+		// Same layout with shared corners and colors varying per vertex, a mesh the simplifier can reduce
+		static std::vector<Model::Vertex> GenerateSmoothGrid(size_t triangleCount, glm::vec2 boundsMin, glm::vec2 boundsMax);
+		static TextureImage GenerateTexture(uint32_t size);
+	};
+}
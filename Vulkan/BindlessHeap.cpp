@@ -0,0 +1,318 @@
+#include "BindlessHeap.h"
+#include "Device.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace Engine
+{
+	namespace
+	{
+		// Properties left at 0 were not reported, the heap then keeps its default capacity
+		uint32_t ClampCapacity(uint32_t capacity, uint32_t limit)
+		{
+			return limit > 0 ? std::min(capacity, limit) : capacity;
+		}
+	}
+
+	BindlessHeap::BindlessHeap(Device& device, uint32_t framesInFlight)
+		: m_device(device), m_framesInFlight(framesInFlight), m_updateAfterBind(device.SupportsDescriptorIndexing())
+	{
+		if (m_updateAfterBind)
+		{
+			const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& properties = m_device.GetDescriptorIndexingProperties();
+			m_textureCapacity = ClampCapacity(ClampCapacity(DEFAULT_TEXTURE_CAPACITY, properties.maxPerStageDescriptorUpdateAfterBindSampledImages), properties.maxDescriptorSetUpdateAfterBindSampledImages);
+			m_bufferCapacity = ClampCapacity(ClampCapacity(DEFAULT_BUFFER_CAPACITY, properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers), properties.maxDescriptorSetUpdateAfterBindStorageBuffers);
+		}
+		else
+		{
+			const VkPhysicalDeviceLimits& limits = m_device.Properties.limits;
+			m_textureCapacity = std::min(FALLBACK_CAPACITY, limits.maxPerStageDescriptorSampledImages);
+			m_bufferCapacity = std::min(FALLBACK_CAPACITY, limits.maxPerStageDescriptorStorageBuffers);
+			CreatePlaceholders();
+		}
+
+		CreateLayout();
+		CreateSets();
+		std::cout << "Bindless heap : " << m_textureCapacity << " textures, " << m_bufferCapacity << " buffers, "
+			<< (m_updateAfterBind ? "update after bind" : "one set per frame in flight") << std::endl;
+	}
+
+	BindlessHeap::~BindlessHeap()
+	{
+		VkDevice device = m_device.GetDevice();
+		vkDestroyDescriptorPool(device, m_pool, nullptr);
+		vkDestroyDescriptorSetLayout(device, m_layout, nullptr);
+		if (m_placeholderSampler != VK_NULL_HANDLE)
+		{
+			m_device.GetResourceCache().ReleaseImage(m_placeholderImage);
+			vkDestroyImage(device, m_placeholderImage, nullptr);
+			m_device.FreeMemory(m_placeholderImageMemory);
+			vkDestroyBuffer(device, m_placeholderBuffer, nullptr);
+			m_device.FreeMemory(m_placeholderBufferMemory);
+		}
+	}
+
+	uint32_t BindlessHeap::RegisterTexture(VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		PendingWrite write = {};
+		write.binding = TEXTURE_BINDING;
+		write.index = AllocateIndex(m_freeTextures, m_nextTexture, m_textureCapacity, "textures");
+		write.imageInfo = { sampler, imageView, layout };
+		Write(write);
+		return write.index;
+	}
+
+	uint32_t BindlessHeap::RegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		PendingWrite write = {};
+		write.binding = BUFFER_BINDING;
+		write.index = AllocateIndex(m_freeBuffers, m_nextBuffer, m_bufferCapacity, "buffers");
+		write.bufferInfo = { buffer, offset, range };
+		Write(write);
+		return write.index;
+	}
+
+	void BindlessHeap::ReleaseTexture(uint32_t index)
+	{
+		assert(index < m_nextTexture && "Releasing a texture that was never registered !");
+		Release(TEXTURE_BINDING, index);
+	}
+
+	void BindlessHeap::ReleaseBuffer(uint32_t index)
+	{
+		assert(index < m_nextBuffer && "Releasing a buffer that was never registered !");
+		Release(BUFFER_BINDING, index);
+	}
+
+	void BindlessHeap::BeginFrame(uint32_t frameIndex, uint64_t frameNumber)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_frameNumber = frameNumber;
+		if (!m_updateAfterBind)
+		{
+			Apply(m_sets[frameIndex], m_pendingWrites[frameIndex]);
+			m_pendingWrites[frameIndex].clear();
+		}
+
+		// Released while frame N was the last one recorded, which completed once frame N + framesInFlight starts
+		auto completed = [&](const ReleasedIndex& released) { return frameNumber >= released.frameNumber + m_framesInFlight; };
+		for (const ReleasedIndex& released : m_released)
+			if (completed(released))
+				(released.binding == TEXTURE_BINDING ? m_freeTextures : m_freeBuffers).push_back(released.index);
+		m_released.erase(std::remove_if(m_released.begin(), m_released.end(), completed), m_released.end());
+	}
+
+	void BindlessHeap::CreateLayout()
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+		bindings[0].binding = TEXTURE_BINDING;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = m_textureCapacity;
+		bindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[1].binding = BUFFER_BINDING;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount = m_bufferCapacity;
+		bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+		// Slots may be empty, and written while the set is bound in command buffers that do not read them
+		VkDescriptorBindingFlagsEXT bindingFlag = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+			| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+		std::array<VkDescriptorBindingFlagsEXT, 2> bindingFlags = { bindingFlag, bindingFlag };
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		if (m_updateAfterBind)
+		{
+			layoutInfo.pNext = &bindingFlagsInfo;
+			layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		}
+
+		if (vkCreateDescriptorSetLayout(m_device.GetDevice(), &layoutInfo, nullptr, &m_layout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create bindless descriptor set layout !");
+	}
+
+	void BindlessHeap::CreateSets()
+	{
+		uint32_t setCount = m_updateAfterBind ? 1 : m_framesInFlight;
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+		poolSizes[0] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_textureCapacity * setCount };
+		poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_bufferCapacity * setCount };
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = m_updateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0;
+		poolInfo.maxSets = setCount;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		if (vkCreateDescriptorPool(m_device.GetDevice(), &poolInfo, nullptr, &m_pool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create bindless descriptor pool !");
+
+		std::vector<VkDescriptorSetLayout> layouts(setCount, m_layout);
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_pool;
+		allocInfo.descriptorSetCount = setCount;
+		allocInfo.pSetLayouts = layouts.data();
+
+		m_sets.resize(setCount);
+		if (vkAllocateDescriptorSets(m_device.GetDevice(), &allocInfo, m_sets.data()) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate bindless descriptor sets !");
+
+		if (m_updateAfterBind)
+			return;
+
+		// Nothing is bound yet, the placeholders are written to every slot of every set right away
+		std::vector<PendingWrite> placeholders;
+		for (uint32_t i = 0; i < m_textureCapacity; i++)
+			placeholders.push_back({ TEXTURE_BINDING, i, { m_placeholderSampler, m_placeholderView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }, {} });
+		for (uint32_t i = 0; i < m_bufferCapacity; i++)
+			placeholders.push_back({ BUFFER_BINDING, i, {}, { m_placeholderBuffer, 0, VK_WHOLE_SIZE } });
+		for (VkDescriptorSet set : m_sets)
+			Apply(set, placeholders);
+		m_pendingWrites.resize(setCount);
+	}
+
+	void BindlessHeap::CreatePlaceholders()
+	{
+		m_device.CreateBuffer(256, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_placeholderBuffer, m_placeholderBufferMemory);
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageInfo.extent = { 1, 1, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		m_device.CreateImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_placeholderImage, m_placeholderImageMemory);
+
+		// Cleared to black so a shader reading an empty slot gets a defined value
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = m_placeholderImage;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		VkCommandBuffer commandBuffer = m_device.BeginSingleTimeCommands();
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		VkClearColorValue black = {};
+		vkCmdClearColorImage(commandBuffer, m_placeholderImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &barrier.subresourceRange);
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+		m_device.EndSingleTimeCommands(commandBuffer);
+
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = m_placeholderImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = imageInfo.format;
+		viewInfo.subresourceRange = barrier.subresourceRange;
+		m_placeholderView = m_device.GetResourceCache().GetImageView(viewInfo);
+
+		VkSamplerCreateInfo samplerInfo = {};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		m_placeholderSampler = m_device.GetResourceCache().GetSampler(samplerInfo);
+	}
+
+	uint32_t BindlessHeap::AllocateIndex(std::vector<uint32_t>& freeIndices, uint32_t& nextIndex, uint32_t capacity, const char* kind)
+	{
+		if (!freeIndices.empty())
+		{
+			uint32_t index = freeIndices.back();
+			freeIndices.pop_back();
+			return index;
+		}
+		if (nextIndex == capacity)
+			throw std::runtime_error("Bindless heap is full, " + std::to_string(capacity) + " " + kind + " !");
+		return nextIndex++;
+	}
+
+	void BindlessHeap::Write(const PendingWrite& write)
+	{
+		// A new index was never read by a submitted frame, writing it while the set is bound is allowed
+		if (m_updateAfterBind)
+		{
+			Apply(m_sets[0], { write });
+			return;
+		}
+		for (auto& pendingWrites : m_pendingWrites)
+			pendingWrites.push_back(write);
+	}
+
+	void BindlessHeap::Release(uint32_t binding, uint32_t index)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_released.push_back({ binding, index, m_frameNumber });
+
+		// The fully written sets must not keep a descriptor of a resource about to be destroyed
+		if (!m_updateAfterBind)
+		{
+			if (binding == TEXTURE_BINDING)
+				Write({ binding, index, { m_placeholderSampler, m_placeholderView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }, {} });
+			else
+				Write({ binding, index, {}, { m_placeholderBuffer, 0, VK_WHOLE_SIZE } });
+		}
+	}
+
+	void BindlessHeap::Apply(VkDescriptorSet set, const std::vector<PendingWrite>& writes)
+	{
+		if (writes.empty())
+			return;
+
+		std::vector<VkWriteDescriptorSet> descriptorWrites(writes.size());
+		for (size_t i = 0; i < writes.size(); i++)
+		{
+			VkWriteDescriptorSet& descriptorWrite = descriptorWrites[i];
+			descriptorWrite = {};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = set;
+			descriptorWrite.dstBinding = writes[i].binding;
+			descriptorWrite.dstArrayElement = writes[i].index;
+			descriptorWrite.descriptorCount = 1;
+			if (writes[i].binding == TEXTURE_BINDING)
+			{
+				descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				descriptorWrite.pImageInfo = &writes[i].imageInfo;
+			}
+			else
+			{
+				descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				descriptorWrite.pBufferInfo = &writes[i].bufferInfo;
+			}
+		}
+		vkUpdateDescriptorSets(m_device.GetDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
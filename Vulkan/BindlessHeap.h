@@ -0,0 +1,107 @@
+#pragma once
+
+#include "MemoryAllocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <vector>
+
+namespace Engine
+{
+	class Device;
+
+	// The global descriptor set : every texture and storage buffer of the scene is written once in a large array and shaders
+	// index it, so draws never allocate or update descriptor sets. Layout for shaders :
+	//   layout(set = 0, binding = 0) uniform sampler2D textures[];
+	//   layout(set = 0, binding = 1) buffer Buffers { ... } buffers[];
+	// With VK_EXT_descriptor_indexing there is a single update after bind set. Without it, there is one set per frame in
+	// flight and a write reaches each of them in BeginFrame of its frame, once no submitted frame uses it anymore. Unused
+	// slots then hold a placeholder since every descriptor of the arrays must be valid
+	class BindlessHeap
+	{
+	public:
+		static constexpr uint32_t TEXTURE_BINDING = 0;
+		static constexpr uint32_t BUFFER_BINDING = 1;
+		static constexpr uint32_t DEFAULT_TEXTURE_CAPACITY = 4096;
+		static constexpr uint32_t DEFAULT_BUFFER_CAPACITY = 4096;
+		// Fully written sets are capped well below the guaranteed limits, the placeholders are written to every slot
+		static constexpr uint32_t FALLBACK_CAPACITY = 256;
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+
+		BindlessHeap(Device& device, uint32_t framesInFlight);
+		~BindlessHeap();
+
+		BindlessHeap(const BindlessHeap&) = delete;
+		BindlessHeap& operator=(const BindlessHeap&) = delete;
+
+		// Thread safe. Returns the index shaders use, the view must stay alive until the index is released
+		uint32_t RegisterTexture(VkImageView imageView, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		uint32_t RegisterBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		// The index is reused once the frames in flight that could read it completed
+		void ReleaseTexture(uint32_t index);
+		void ReleaseBuffer(uint32_t index);
+
+		// Render thread, once the fence of the frame is signaled and before recording
+		void BeginFrame(uint32_t frameIndex, uint64_t frameNumber);
+
+		VkDescriptorSetLayout GetLayout() const { return m_layout; }
+		VkDescriptorSet GetSet(uint32_t frameIndex) const { return m_sets[m_updateAfterBind ? 0 : frameIndex]; }
+		bool IsUpdateAfterBind() const { return m_updateAfterBind; }
+		uint32_t GetTextureCapacity() const { return m_textureCapacity; }
+		uint32_t GetBufferCapacity() const { return m_bufferCapacity; }
+
+	private:
+		struct PendingWrite
+		{
+			uint32_t binding;
+			uint32_t index;
+			VkDescriptorImageInfo imageInfo;
+			VkDescriptorBufferInfo bufferInfo;
+		};
+
+		struct ReleasedIndex
+		{
+			uint32_t binding;
+			uint32_t index;
+			uint64_t frameNumber;
+		};
+
+		void CreateLayout();
+		void CreateSets();
+		void CreatePlaceholders();
+		uint32_t AllocateIndex(std::vector<uint32_t>& freeIndices, uint32_t& nextIndex, uint32_t capacity, const char* kind);
+		void Write(const PendingWrite& write);
+		void Release(uint32_t binding, uint32_t index);
+		void Apply(VkDescriptorSet set, const std::vector<PendingWrite>& writes);
+
+	private:
+		Device& m_device;
+		uint32_t m_framesInFlight;
+		bool m_updateAfterBind;
+		uint32_t m_textureCapacity;
+		uint32_t m_bufferCapacity;
+
+		VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+		VkDescriptorPool m_pool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> m_sets;
+
+		// Placeholders of the fallback path, also written over released slots
+		VkImage m_placeholderImage = VK_NULL_HANDLE;
+		MemoryAllocation m_placeholderImageMemory;
+		VkImageView m_placeholderView = VK_NULL_HANDLE;
+		VkSampler m_placeholderSampler = VK_NULL_HANDLE;
+		VkBuffer m_placeholderBuffer = VK_NULL_HANDLE;
+		MemoryAllocation m_placeholderBufferMemory;
+
+		std::mutex m_mutex;
+		uint64_t m_frameNumber = 0;
+		uint32_t m_nextTexture = 0;
+		uint32_t m_nextBuffer = 0;
+		std::vector<uint32_t> m_freeTextures;
+		std::vector<uint32_t> m_freeBuffers;
+		std::vector<ReleasedIndex> m_released;
+		// Fallback only, the writes each frame set has not received yet
+		std::vector<std::vector<PendingWrite>> m_pendingWrites;
+	};
+}
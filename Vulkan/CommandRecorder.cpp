@@ -0,0 +1,191 @@
+#include "CommandRecorder.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace Engine
+{
+	CommandRecorder::CommandRecorder(Device& device, JobScheduler& scheduler, uint32_t framesInFlight)
+		: m_device(device), m_scheduler(scheduler), m_workerCount(scheduler.WorkerCount())
+	{
+		m_workerFrames.resize(framesInFlight, std::vector<WorkerFrame>(m_workerCount));
+
+		for (auto& frame : m_workerFrames)
+		{
+			for (auto& workerFrame : frame)
+			{
+				VkCommandPoolCreateInfo poolInfo = {};
+				poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+				poolInfo.queueFamilyIndex = m_device.FindPhysicalQueueFamilies().graphicsFamily;
+				poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+				if (vkCreateCommandPool(m_device.GetDevice(), &poolInfo, nullptr, &workerFrame.commandPool) != VK_SUCCESS)
+					throw std::runtime_error("Failed to create worker command pool !");
+			}
+		}
+	}
+
+	CommandRecorder::~CommandRecorder()
+	{
+		for (auto& frame : m_workerFrames)
+			for (auto& workerFrame : frame)
+				vkDestroyCommandPool(m_device.GetDevice(), workerFrame.commandPool, nullptr);
+	}
+
+	const std::vector<VkCommandBuffer>& CommandRecorder::RecordSecondaries(uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo, size_t drawCount, const RecordFunction& record)
+	{
+		assert(frameIndex < m_workerFrames.size() && "Frame index out of range !");
+
+		// No job of this frame is running yet, the pools can be reset from the calling thread
+		for (auto& workerFrame : m_workerFrames[frameIndex])
+		{
+			vkResetCommandPool(m_device.GetDevice(), workerFrame.commandPool, 0);
+			workerFrame.usedCount = 0;
+		}
+
+		std::vector<DrawRange> ranges = PartitionDraws(drawCount, m_workerCount);
+		m_recordedBuffers.assign(ranges.size(), VK_NULL_HANDLE);
+
+		// Each range lands in its own slot so the execution order stays the draw order, whichever worker recorded it
+		m_scheduler.ParallelFor(ranges.size(), 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				m_recordedBuffers[i] = RecordRange(frameIndex, inheritanceInfo, ranges[i], record);
+		});
+		return m_recordedBuffers;
+	}
+
+	uint32_t CommandRecorder::DefaultWorkerCount()
+	{
+		return std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+	}
+
+	std::vector<DrawRange> CommandRecorder::PartitionDraws(size_t drawCount, uint32_t workerCount, size_t minDrawsPerWorker)
+	{
+		std::vector<DrawRange> ranges;
+		if (drawCount == 0 || workerCount == 0)
+			return ranges;
+
+		// Do not wake workers for a handful of draws, the secondary command buffer overhead would dominate
+		size_t rangeCount = std::min<size_t>(workerCount, (drawCount + minDrawsPerWorker - 1) / std::max<size_t>(minDrawsPerWorker, 1));
+		size_t baseCount = drawCount / rangeCount;
+		size_t remainder = drawCount % rangeCount;
+
+		size_t first = 0;
+		for (size_t i = 0; i < rangeCount; i++)
+		{
+			size_t count = baseCount + (i < remainder ? 1 : 0);
+			ranges.push_back({ first, count });
+			first += count;
+		}
+		return ranges;
+	}
+
+	bool CommandRecorder::RunPartitionSelfTest()
+	{
+		bool success = true;
+		const uint32_t threadCount = DefaultWorkerCount();
+
+		for (uint32_t workerCount = 1; workerCount <= 16; workerCount++)
+		{
+			for (size_t drawCount : { 0, 1, 31, 32, 33, 100, 1000, 4097, 100000 })
+			{
+				std::vector<DrawRange> ranges = PartitionDraws(drawCount, workerCount);
+
+				// Ranges must be contiguous, cover every draw exactly once and differ by at most one draw
+				size_t expectedFirst = 0;
+				size_t minCount = drawCount, maxCount = 0;
+				for (const auto& range : ranges)
+				{
+					success &= range.first == expectedFirst && range.count > 0;
+					expectedFirst += range.count;
+					minCount = std::min(minCount, range.count);
+					maxCount = std::max(maxCount, range.count);
+				}
+				success &= expectedFirst == drawCount && ranges.size() <= workerCount;
+				success &= ranges.empty() || maxCount - minCount <= 1;
+
+				// Concurrent workers claiming their range must always produce the same draw ownership
+				std::vector<uint32_t> reference(drawCount);
+				for (uint32_t worker = 0; worker < ranges.size(); worker++)
+					for (size_t i = 0; i < ranges[worker].count; i++)
+						reference[ranges[worker].first + i] = worker;
+
+				for (int run = 0; run < 4; run++)
+				{
+					std::vector<DrawRange> concurrentRanges;
+					std::vector<std::atomic<uint32_t>> owners(drawCount);
+					std::vector<std::thread> threads;
+					std::atomic<uint32_t> nextWorker = 0;
+
+					concurrentRanges = PartitionDraws(drawCount, workerCount);
+					success &= concurrentRanges == ranges;
+
+					for (uint32_t t = 0; t < threadCount; t++)
+					{
+						threads.emplace_back([&]() {
+							for (uint32_t worker = nextWorker++; worker < concurrentRanges.size(); worker = nextWorker++)
+								for (size_t i = 0; i < concurrentRanges[worker].count; i++)
+									owners[concurrentRanges[worker].first + i].store(worker);
+						});
+					}
+					for (auto& thread : threads)
+						thread.join();
+
+					for (size_t i = 0; i < drawCount; i++)
+						success &= owners[i].load() == reference[i];
+				}
+
+				if (!success)
+				{
+					std::cerr << "Draw partitioning failed for " << drawCount << " draws on " << workerCount << " workers" << std::endl;
+					return false;
+				}
+			}
+		}
+
+		std::cout << "Draw partitioning self test passed" << std::endl;
+		return success;
+	}
+
+	VkCommandBuffer CommandRecorder::RecordRange(uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo, const DrawRange& range, const RecordFunction& record)
+	{
+		PROFILE_FUNCTION();
+		uint32_t workerIndex = JobScheduler::CurrentWorkerIndex();
+		assert(workerIndex < m_workerCount && "Draws must be recorded from a scheduler worker !");
+
+		WorkerFrame& workerFrame = m_workerFrames[frameIndex][workerIndex];
+		if (workerFrame.usedCount == workerFrame.commandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = workerFrame.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(m_device.GetDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate secondary command buffer !");
+			workerFrame.commandBuffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = workerFrame.commandBuffers[workerFrame.usedCount++];
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+			throw std::runtime_error("Failed to begin recording secondary command buffer !");
+
+		record(commandBuffer, range.first, range.count);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to record secondary command buffer !");
+		return commandBuffer;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Device.h"
+#include "JobScheduler.h"
+
+#include <functional>
+#include <vector>
+
+namespace Engine
+{
+	struct DrawRange
+	{
+		size_t first;
+		size_t count;
+
+		bool operator==(const DrawRange& other) const { return first == other.first && count == other.count; }
+	};
+
+	class CommandRecorder
+	{
+	public:
+		using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, size_t firstDraw, size_t drawCount)>;
+
+		static constexpr size_t MIN_DRAWS_PER_WORKER = 32;
+
+		CommandRecorder(Device& device, JobScheduler& scheduler, uint32_t framesInFlight);
+		~CommandRecorder();
+
+		CommandRecorder(const CommandRecorder&) = delete;
+		CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+		// Records the draw list into one secondary command buffer per range as scheduler jobs, the caller executes them inside its render pass.
+		// Must be called from the main thread or a scheduler worker
+		const std::vector<VkCommandBuffer>& RecordSecondaries(uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo, size_t drawCount, const RecordFunction& record);
+
+		uint32_t WorkerCount() const { return m_workerCount; }
+		static uint32_t DefaultWorkerCount();
+
+		// Splits [0, drawCount) in contiguous, balanced ranges. Only depends on its arguments, so every frame records the same partition
+		static std::vector<DrawRange> PartitionDraws(size_t drawCount, uint32_t workerCount, size_t minDrawsPerWorker = MIN_DRAWS_PER_WORKER);
+
+		// CPU only check of the partitioning, does not need a Vulkan device
+		static bool RunPartitionSelfTest();
+
+	private:
+		VkCommandBuffer RecordRange(uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo, const DrawRange& range, const RecordFunction& record);
+
+	private:
+		struct WorkerFrame
+		{
+			VkCommandPool commandPool;
+			// A worker may steal several ranges in a frame, it takes one buffer per range
+			std::vector<VkCommandBuffer> commandBuffers;
+			size_t usedCount = 0;
+		};
+
+		Device& m_device;
+		JobScheduler& m_scheduler;
+		uint32_t m_workerCount;
+
+		// m_workerFrames[frameIndex][workerIndex], a pool is only ever touched by the worker thread it belongs to
+		std::vector<std::vector<WorkerFrame>> m_workerFrames;
+		std::vector<VkCommandBuffer> m_recordedBuffers;
+	};
+}
@@ -0,0 +1,150 @@
+#include "CpuProfiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace Engine
+{
+	namespace
+	{
+		constexpr uint64_t NO_SEQUENCE = ~0ull;
+
+		// The low bit of the packed timestamp tells begin (0) from end (1). The sequence is the index of the event the slot
+		// holds, NO_SEQUENCE while it is being written
+		struct Event
+		{
+			std::atomic<uint64_t> sequence = NO_SEQUENCE;
+			std::atomic<const char*> name;
+			std::atomic<uint64_t> packed;
+		};
+
+		struct ThreadBuffer
+		{
+			uint32_t id;
+			std::string name;
+			std::unique_ptr<Event[]> events = std::make_unique<Event[]>(CpuProfiler::EVENTS_PER_THREAD);
+			std::atomic<uint64_t> writeIndex = 0;
+		};
+
+		// Buffers outlive their threads, so the events of finished threads are still written
+		std::mutex s_registryMutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> s_threadBuffers;
+		const auto s_origin = std::chrono::steady_clock::now();
+		thread_local ThreadBuffer* t_buffer = nullptr;
+
+		ThreadBuffer& GetThreadBuffer()
+		{
+			if (t_buffer == nullptr)
+			{
+				std::lock_guard<std::mutex> lock(s_registryMutex);
+				auto buffer = std::make_unique<ThreadBuffer>();
+				buffer->id = static_cast<uint32_t>(s_threadBuffers.size());
+				buffer->name = "Thread " + std::to_string(buffer->id);
+				t_buffer = buffer.get();
+				s_threadBuffers.push_back(std::move(buffer));
+			}
+			return *t_buffer;
+		}
+
+		void Record(const char* name, bool end)
+		{
+			ThreadBuffer& buffer = GetThreadBuffer();
+			uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_origin).count();
+			uint64_t index = buffer.writeIndex.load(std::memory_order_relaxed);
+
+			// The fence keeps the cleared sequence ahead of the new fields, a reader that copies any of them sees the slot change
+			Event& event = buffer.events[index % CpuProfiler::EVENTS_PER_THREAD];
+			event.sequence.store(NO_SEQUENCE, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			event.name.store(name, std::memory_order_relaxed);
+			event.packed.store((nanoseconds << 1) | (end ? 1 : 0), std::memory_order_relaxed);
+			event.sequence.store(index, std::memory_order_release);
+			buffer.writeIndex.store(index + 1, std::memory_order_release);
+		}
+	}
+
+	std::atomic<bool> CpuProfiler::s_enabled = true;
+
+	void CpuProfiler::BeginEvent(const char* name)
+	{
+		if (IsEnabled())
+			Record(name, false);
+	}
+
+	void CpuProfiler::EndEvent()
+	{
+		if (IsEnabled())
+			Record(nullptr, true);
+	}
+
+	void CpuProfiler::SetThreadName(const std::string& name)
+	{
+		ThreadBuffer& buffer = GetThreadBuffer();
+		std::lock_guard<std::mutex> lock(s_registryMutex);
+		buffer.name = name;
+	}
+
+	void CpuProfiler::WriteChromeTrace(const std::string& path)
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open CPU trace " + path + " !");
+
+		file << std::fixed << std::setprecision(3);
+		file << "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [";
+
+		std::lock_guard<std::mutex> lock(s_registryMutex);
+		bool first = true;
+		for (const auto& buffer : s_threadBuffers)
+		{
+			file << (first ? "\n" : ",\n") << "    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->id << ", \"args\": { \"name\": \"" << buffer->name << "\" } }";
+			first = false;
+
+			// A slot whose sequence is not the expected index before and after the copy was overwritten meanwhile. The owning
+			// thread writes in order, so everything copied before it is older and dropped too
+			uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+			uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+			std::vector<std::pair<const char*, uint64_t>> events;
+			events.reserve(end - begin);
+			for (uint64_t i = begin; i < end; i++)
+			{
+				const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+				uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+				const char* name = event.name.load(std::memory_order_relaxed);
+				uint64_t packed = event.packed.load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence != i || event.sequence.load(std::memory_order_relaxed) != i)
+				{
+					events.clear();
+					continue;
+				}
+				events.emplace_back(name, packed);
+			}
+
+			// Begin/end pairs become complete events, ends whose begin was overwritten and scopes still open are dropped
+			std::vector<std::pair<const char*, uint64_t>> openScopes;
+			for (size_t i = 0; i < events.size(); i++)
+			{
+				uint64_t nanoseconds = events[i].second >> 1;
+				if ((events[i].second & 1) == 0)
+				{
+					openScopes.emplace_back(events[i].first, nanoseconds);
+					continue;
+				}
+				if (openScopes.empty())
+					continue;
+
+				auto [name, start] = openScopes.back();
+				openScopes.pop_back();
+				file << ",\n    { \"name\": \"" << name << "\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id
+					<< ", \"ts\": " << start / 1000.0 << ", \"dur\": " << (nanoseconds - start) / 1000.0 << " }";
+			}
+		}
+		file << "\n  ]\n}\n";
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Build with ENGINE_PROFILING=0 to compile every PROFILE_* macro out
+#ifndef ENGINE_PROFILING
+#define ENGINE_PROFILING 1
+#endif
+
+namespace Engine
+{
+	// Begin/end events of CPU scopes, recorded in one ring buffer per thread. Only the owning thread writes its ring, each slot
+	// carries the index of its event so a reader drops the ones overwritten while it copies. Recording takes no lock and
+	// allocates nothing after the first event of a thread.
+	// Old events are overwritten, the last EVENTS_PER_THREAD events of every thread are kept
+	class CpuProfiler
+	{
+	public:
+		static constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+		// Names must outlive the profiler (string literals, __FUNCTION__)
+		static void BeginEvent(const char* name);
+		static void EndEvent();
+		static void SetThreadName(const std::string& name);
+
+		static void SetEnabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+		static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+		// Chrome trace event JSON, opened by chrome://tracing and ui.perfetto.dev. Safe to call while other threads record
+		static void WriteChromeTrace(const std::string& path);
+
+	private:
+		static std::atomic<bool> s_enabled;
+	};
+
+	class CpuProfileScope
+	{
+	public:
+		CpuProfileScope(const char* name) { CpuProfiler::BeginEvent(name); }
+		~CpuProfileScope() { CpuProfiler::EndEvent(); }
+
+		CpuProfileScope(const CpuProfileScope&) = delete;
+		CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+	};
+}
+
+#if ENGINE_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ::Engine::CpuProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD_NAME(name) ::Engine::CpuProfiler::SetThreadName(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(name)
+#endif
@@ -0,0 +1,91 @@
+#include "DescriptorAllocator.h"
+#include "Device.h"
+
+#include <array>
+#include <stdexcept>
+
+namespace Engine
+{
+	DescriptorAllocator::DescriptorAllocator(Device& device)
+		: m_device(device)
+	{
+	}
+
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		for (VkDescriptorPool pool : m_usedPools)
+			vkDestroyDescriptorPool(m_device.GetDevice(), pool, nullptr);
+		for (VkDescriptorPool pool : m_freePools)
+			vkDestroyDescriptorPool(m_device.GetDevice(), pool, nullptr);
+	}
+
+	VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_usedPools.empty())
+			m_usedPools.push_back(AcquirePool());
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_usedPools.back();
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(m_device.GetDevice(), &allocInfo, &set);
+
+		// A full pool is left as it is until Reset, the allocation is retried once from a recycled or new pool. Vulkan 1.0 drivers
+		// without VK_KHR_maintenance1 report a full pool with any error, not only VK_ERROR_OUT_OF_POOL_MEMORY
+		if (result != VK_SUCCESS)
+		{
+			m_usedPools.push_back(AcquirePool());
+			allocInfo.descriptorPool = m_usedPools.back();
+			result = vkAllocateDescriptorSets(m_device.GetDevice(), &allocInfo, &set);
+		}
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate frame descriptor set !");
+
+		m_allocatedSetCount++;
+		return set;
+	}
+
+	void DescriptorAllocator::Reset()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (VkDescriptorPool pool : m_usedPools)
+		{
+			vkResetDescriptorPool(m_device.GetDevice(), pool, 0);
+			m_freePools.push_back(pool);
+		}
+		m_usedPools.clear();
+		m_allocatedSetCount = 0;
+	}
+
+	VkDescriptorPool DescriptorAllocator::AcquirePool()
+	{
+		if (!m_freePools.empty())
+		{
+			VkDescriptorPool pool = m_freePools.back();
+			m_freePools.pop_back();
+			return pool;
+		}
+
+		// Room for the usual per frame sets : dynamic uniforms per draw, a few buffers and textures per pass
+		std::array<VkDescriptorPoolSize, 4> poolSizes = {};
+		poolSizes[0] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, SETS_PER_POOL };
+		poolSizes[1] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SETS_PER_POOL };
+		poolSizes[2] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SETS_PER_POOL * 2 };
+		poolSizes[3] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SETS_PER_POOL * 2 };
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = SETS_PER_POOL;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(m_device.GetDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create frame descriptor pool !");
+		return pool;
+	}
+}
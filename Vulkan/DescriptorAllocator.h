@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <vector>
+
+namespace Engine
+{
+	class Device;
+
+	// Descriptor sets that live for a single frame. There is one allocator per frame in flight : once the fence of its frame
+	// is signaled, Reset recycles every pool with one vkResetDescriptorPool each instead of freeing sets one by one.
+	// Pools are only created when the ones already there are full, a steady frame never creates any
+	class DescriptorAllocator
+	{
+	public:
+		static constexpr uint32_t SETS_PER_POOL = 256;
+
+		DescriptorAllocator(Device& device);
+		~DescriptorAllocator();
+
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+		DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+		// Thread safe, the set stays valid until the next Reset
+		VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+		void Reset();
+
+		size_t GetPoolCount() const { return m_usedPools.size() + m_freePools.size(); }
+		uint32_t GetAllocatedSetCount() const { return m_allocatedSetCount; }
+
+	private:
+		VkDescriptorPool AcquirePool();
+
+	private:
+		Device& m_device;
+
+		std::mutex m_mutex;
+		// The last used pool is the one sets are allocated from
+		std::vector<VkDescriptorPool> m_usedPools;
+		std::vector<VkDescriptorPool> m_freePools;
+		uint32_t m_allocatedSetCount = 0;
+	};
+}
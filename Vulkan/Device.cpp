@@ -1,5 +1,7 @@
 #include "Device.h"
+#include "UploadArena.h"
 
+#include <cassert>
 #include <string>
 #include <iostream>
 #include <set>
@@ -29,7 +31,7 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 
 namespace Engine
 {
-	Device::Device(Window& window) : m_window{ window }
+	Device::Device(Window* window) : m_window{ window }
 	{
 		CreateInstance();
 		SetupDebugMessenger();
@@ -37,17 +39,29 @@ namespace Engine
 		PickPhysicalDevice();
 		CreateLogicalDevice();
 		CreateCommandPool();
+		CreateAllocator();
+		CreateUploadArena();
+		CreatePipelineCache();
+		CreateShaderCache();
+		CreateResourceCache();
 	}
 
 	Device::~Device()
 	{
+		m_resourceCache.reset();
+		m_shaderCache.reset();
+		// Saves the cache to disk for the next run
+		m_pipelineCache.reset();
+		m_uploadArena.reset();
+		m_allocator.reset();
 		vkDestroyCommandPool(m_device, m_commandPool, nullptr);
 		vkDestroyDevice(m_device, nullptr);
 
 		if (enableValidationLayers)
 			DestroyDebugUtilsMessengerEXT(m_instance, m_debugMessenger, nullptr);
 
-		vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+		if (m_surface != VK_NULL_HANDLE)
+			vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
 		vkDestroyInstance(m_instance, nullptr);
 	}
 
@@ -124,7 +138,7 @@ namespace Engine
 		QueueFamilyIndices indices = FindQueueFamilies(m_physicalDevice);
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily, indices.transferFamily };
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -137,18 +151,98 @@ namespace Engine
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
-		VkPhysicalDeviceFeatures deviceFeatures = {};
-		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		// Indirect draw features are optional, only GPU driven rendering needs them
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+		m_enabledFeatures.samplerAnisotropy = VK_TRUE;
+		m_enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		m_enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+		// Block compressed textures fall back to RGBA8 encodings when the device cannot sample them
+		m_enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+		m_enabledFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		bool drawIndirectCountSupported = false;
+		bool timelineSemaphoreSupported = false;
+		bool descriptorIndexingSupported = false;
+		bool maintenance3Supported = false;
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+		for (const auto& extension : availableExtensions)
+		{
+			if (std::string(extension.extensionName) == VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)
+				drawIndirectCountSupported = true;
+			if (std::string(extension.extensionName) == VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)
+				timelineSemaphoreSupported = m_physicalDeviceProperties2Supported;
+			if (std::string(extension.extensionName) == VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+				descriptorIndexingSupported = m_physicalDeviceProperties2Supported;
+			if (std::string(extension.extensionName) == VK_KHR_MAINTENANCE3_EXTENSION_NAME)
+				maintenance3Supported = true;
+		}
+		descriptorIndexingSupported &= maintenance3Supported;
+		if (drawIndirectCountSupported)
+			enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+		// The extension being listed is not enough, the feature itself must be supported and enabled
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexingFeatures = {};
+		supportedIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		supportedIndexingFeatures.pNext = &timelineFeatures;
+		if (timelineSemaphoreSupported || descriptorIndexingSupported)
+		{
+			auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceFeatures2KHR"));
+			VkPhysicalDeviceFeatures2KHR features2 = {};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features2.pNext = &supportedIndexingFeatures;
+			if (getFeatures2 != nullptr)
+				getFeatures2(m_physicalDevice, &features2);
+			timelineSemaphoreSupported &= timelineFeatures.timelineSemaphore == VK_TRUE;
+			// What the bindless heap needs : arrays indexed in shaders, updated while bound, with unused slots left empty
+			descriptorIndexingSupported &= supportedIndexingFeatures.runtimeDescriptorArray && supportedIndexingFeatures.descriptorBindingPartiallyBound
+				&& supportedIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind && supportedIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+				&& supportedIndexingFeatures.descriptorBindingUpdateUnusedWhilePending && supportedIndexingFeatures.shaderSampledImageArrayNonUniformIndexing
+				&& supportedIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+		}
+
+		// Only the features in use are enabled, the chain holds the structures of the supported extensions
+		void* featureChain = nullptr;
+		if (timelineSemaphoreSupported)
+		{
+			enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineFeatures.pNext = featureChain;
+			featureChain = &timelineFeatures;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		if (descriptorIndexingSupported)
+		{
+			enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+			indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+			indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			indexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+			indexingFeatures.pNext = featureChain;
+			featureChain = &indexingFeatures;
+		}
 
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.pNext = featureChain;
 
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.pEnabledFeatures = &m_enabledFeatures;
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		// FIXME : Device specific validation layers have been deprecated
 		if (enableValidationLayers)
@@ -166,6 +260,35 @@ namespace Engine
 
 		vkGetDeviceQueue(m_device, indices.graphicsFamily, 0, &m_graphicsQueue);
 		vkGetDeviceQueue(m_device, indices.presentFamily, 0, &m_presentQueue);
+		vkGetDeviceQueue(m_device, indices.transferFamily, 0, &m_transferQueue);
+		m_transferFamily = indices.transferFamily;
+		m_graphicsFamily = indices.graphicsFamily;
+		if (HasDedicatedTransferQueue())
+			std::cout << "Transfer queue : dedicated family " << m_transferFamily << std::endl;
+
+		if (drawIndirectCountSupported)
+			m_cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(m_device, "vkCmdDrawIndexedIndirectCountKHR"));
+		m_descriptorIndexingSupported = descriptorIndexingSupported;
+		if (descriptorIndexingSupported)
+			QueryDescriptorIndexingProperties();
+		if (timelineSemaphoreSupported)
+		{
+			m_getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(m_device, "vkGetSemaphoreCounterValueKHR"));
+			m_waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(m_device, "vkWaitSemaphoresKHR"));
+		}
+	}
+
+	void Device::QueryDescriptorIndexingProperties()
+	{
+		m_descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2KHR properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		properties2.pNext = &m_descriptorIndexingProperties;
+
+		auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceProperties2KHR"));
+		if (getProperties2 != nullptr)
+			getProperties2(m_physicalDevice, &properties2);
+		m_descriptorIndexingProperties.pNext = nullptr;
 	}
 
 	void Device::CreateCommandPool()
@@ -181,17 +304,62 @@ namespace Engine
 			throw std::runtime_error("Failed to create command pool !");
 	}
 
+	void Device::CreateAllocator()
+	{
+		m_allocator = std::make_unique<MemoryAllocator>(m_device, m_physicalDevice);
+	}
+
+	void Device::CreateUploadArena()
+	{
+		m_uploadArena = std::make_unique<UploadArena>(*this);
+	}
+
+	void Device::CreatePipelineCache()
+	{
+		m_pipelineCache = std::make_unique<PipelineCache>(m_device, Properties);
+	}
+
+	void Device::CreateShaderCache()
+	{
+		m_shaderCache = std::make_unique<ShaderCache>(m_device);
+	}
+
+	void Device::CreateResourceCache()
+	{
+		m_resourceCache = std::make_unique<ResourceCache>(m_device);
+	}
+
 	void Device::CreateSurface()
 	{
-		m_window.CreateWindowSurface(m_instance, &m_surface);
+		if (m_window != nullptr)
+		{
+			m_window->CreateWindowSurface(m_instance, &m_surface);
+			return;
+		}
+
+		if (m_headlessSurfaceSupported)
+		{
+			VkHeadlessSurfaceCreateInfoEXT surfaceInfo = {};
+			surfaceInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+			auto createHeadlessSurface = (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(m_instance, "vkCreateHeadlessSurfaceEXT");
+			if (createHeadlessSurface == nullptr || createHeadlessSurface(m_instance, &surfaceInfo, nullptr, &m_surface) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create headless surface !");
+			std::cout << "Headless surface" << std::endl;
+			return;
+		}
+
+		// Pure offscreen rendering : nothing is presented, so the swap chain extension is not needed either
+		std::cout << "No headless surface support, rendering to offscreen images" << std::endl;
+		deviceExtensions.clear();
 	}
 
 	bool Device::IsDeviceSuitable(VkPhysicalDevice device) {
 		QueueFamilyIndices indices = FindQueueFamilies(device);
 		bool extensionsSupported = CheckDeviceExtensionSupport(device);
-		bool swapChainAdequate = false;
+		bool swapChainAdequate = !CanPresent();
 
-		if (extensionsSupported)
+		if (extensionsSupported && CanPresent())
 		{
 			SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
 			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -251,9 +419,42 @@ namespace Engine
 
 	std::vector<const char*> Device::GetRequiredExtensions()
 	{
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		std::vector<const char*> extensions;
+		uint32_t extensionCount = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> available(extensionCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, available.data());
+
+		if (m_window != nullptr)
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
+		else
+		{
+			// Headless surfaces are optional, software drivers such as lavapipe or SwiftShader expose them but not every driver does
+			bool hasSurface = false;
+			for (const auto& extension : available)
+			{
+				hasSurface |= strcmp(extension.extensionName, VK_KHR_SURFACE_EXTENSION_NAME) == 0;
+				m_headlessSurfaceSupported |= strcmp(extension.extensionName, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME) == 0;
+			}
+			m_headlessSurfaceSupported &= hasSurface;
+
+			if (m_headlessSurfaceSupported)
+			{
+				extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+				extensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+			}
+		}
+
+		// Needed to query and enable the features of device extensions such as VK_KHR_timeline_semaphore on a 1.0 instance
+		m_physicalDeviceProperties2Supported = false;
+		for (const auto& extension : available)
+			m_physicalDeviceProperties2Supported |= strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0;
+		if (m_physicalDeviceProperties2Supported)
+			extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
 		if (enableValidationLayers)
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -315,8 +516,12 @@ namespace Engine
 				indices.graphicsFamilyHasValue = true;
 			}
 
+			// Without a surface nothing is presented, the graphics queue stands in for the present queue
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+			if (CanPresent())
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+			else
+				presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
 			if (queueFamily.queueCount > 0 && presentSupport)
 			{
 				indices.presentFamily = i;
@@ -327,6 +532,26 @@ namespace Engine
 				break;
 			i++;
 		}
+
+		// A transfer only family maps to the copy engines of discrete GPUs, its copies overlap rendering. A family without
+		// graphics comes next, the graphics family is the fallback
+		indices.transferFamily = indices.graphicsFamily;
+		indices.transferFamilyHasValue = indices.graphicsFamilyHasValue;
+		int bestScore = 0;
+		for (uint32_t family = 0; family < queueFamilyCount; family++)
+		{
+			// Compute queues support transfers even without the bit
+			VkQueueFlags flags = queueFamilies[family].queueFlags;
+			if (queueFamilies[family].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT) || (flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) == 0)
+				continue;
+
+			int score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+			if (score > bestScore)
+			{
+				bestScore = score;
+				indices.transferFamily = family;
+			}
+		}
 		return indices;
 	}
 
@@ -375,10 +600,9 @@ namespace Engine
 		throw std::runtime_error("Failed to find suitable memory type !");
 	}
 
-	void Device::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+	void Device::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory)
 	{
 		VkBufferCreateInfo bufferInfo = {};
-		VkMemoryAllocateInfo allocInfo = {};
 		VkMemoryRequirements memRequirements;
 
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -390,13 +614,8 @@ namespace Engine
 			throw std::runtime_error("Failed to create vertex buffer !");
 
 		vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(m_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-			throw std::runtime_error("Failed to allocate vertex buffer memory !");
-		vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
+		bufferMemory = m_allocator->Allocate(memRequirements, properties, true);
+		vkBindBufferMemory(m_device, buffer, bufferMemory.memory, bufferMemory.offset);
 	}
 
 	VkCommandBuffer Device::BeginSingleTimeCommands()
@@ -427,8 +646,16 @@ namespace Engine
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(m_graphicsQueue);
+		// Only wait for this submission, not for everything else running on the graphics queue
+		VkFenceCreateInfo fenceInfo = {};
+		VkFence fence;
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(m_device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create single time command fence !");
+
+		QueueSubmit(m_graphicsQueue, 1, &submitInfo, fence);
+		vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX);
+		vkDestroyFence(m_device, fence, nullptr);
 		vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
 	}
 
@@ -466,22 +693,72 @@ namespace Engine
 		EndSingleTimeCommands(commandBuffer);
 	}
 
-	void Device::CreateImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+	void Device::CreateReadbackBuffer(VkDeviceSize size, VkBuffer& buffer, MemoryAllocation& bufferMemory)
+	{
+		// The CPU reads this memory, cached memory avoids uncached reads which are an order of magnitude slower
+		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+		{
+			if ((memProperties.memoryTypes[i].propertyFlags & (properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) == (properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+			{
+				properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+				break;
+			}
+		}
+
+		CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, buffer, bufferMemory);
+	}
+
+	void Device::CreateImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory) {
 		if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create image !");
 
-		VkMemoryAllocateInfo allocInfo = {};
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+		imageMemory = m_allocator->Allocate(memRequirements, properties, imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
 
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+		if (vkBindImageMemory(m_device, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS)
+			throw std::runtime_error("Failed to bind image memory !");
+	}
 
-		if (vkAllocateMemory(m_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-			throw std::runtime_error("Failed to allocate image memory !");
+	VkResult Device::QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence)
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		return vkQueueSubmit(queue, submitCount, submits, fence);
+	}
 
-		if (vkBindImageMemory(m_device, image, imageMemory, 0) != VK_SUCCESS)
-			throw std::runtime_error("Failed to bind image memory !");
+	VkResult Device::QueuePresent(const VkPresentInfoKHR& presentInfo)
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		return vkQueuePresentKHR(m_presentQueue, &presentInfo);
+	}
+
+	void Device::WaitIdle()
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		vkDeviceWaitIdle(m_device);
+	}
+
+	uint64_t Device::GetSemaphoreCounterValue(VkSemaphore semaphore)
+	{
+		assert(SupportsTimelineSemaphores() && "Timeline semaphores are not supported !");
+		uint64_t value = 0;
+		if (m_getSemaphoreCounterValue(m_device, semaphore, &value) != VK_SUCCESS)
+			throw std::runtime_error("Failed to read timeline semaphore value !");
+		return value;
+	}
+
+	void Device::WaitSemaphore(VkSemaphore semaphore, uint64_t value)
+	{
+		assert(SupportsTimelineSemaphores() && "Timeline semaphores are not supported !");
+		VkSemaphoreWaitInfoKHR waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+		if (m_waitSemaphores(m_device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+			throw std::runtime_error("Failed to wait on timeline semaphore !");
 	}
 }
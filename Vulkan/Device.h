@@ -1,12 +1,20 @@
 #pragma once
 
+#include "MemoryAllocator.h"
+#include "PipelineCache.h"
+#include "ResourceCache.h"
+#include "ShaderCache.h"
 #include "Window.h"
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace Engine
 {
+	class UploadArena;
+
 	struct SwapChainSupportDetails
 	{
 		VkSurfaceCapabilitiesKHR capabilities;
@@ -18,15 +26,19 @@ namespace Engine
 	{
 		uint32_t graphicsFamily;
 		uint32_t presentFamily;
+		// Always set once graphicsFamily is, to the graphics family when there is no better one
+		uint32_t transferFamily;
 		bool graphicsFamilyHasValue = false;
 		bool presentFamilyHasValue = false;
+		bool transferFamilyHasValue = false;
 		bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 	};
 
 	class Device
 	{
 	public:
-		Device(Window& window);
+		// A null window selects headless rendering : VK_EXT_headless_surface when available, offscreen images otherwise
+		Device(Window* window);
 		~Device();
 
 		Device(const Device&) = delete;
@@ -35,9 +47,47 @@ namespace Engine
 
 		VkCommandPool GetCommandPool() { return m_commandPool; }
 		VkDevice GetDevice() { return m_device; }
+		VkPhysicalDevice GetPhysicalDevice() { return m_physicalDevice; }
 		VkSurfaceKHR Surface() { return m_surface; }
+		bool IsHeadless() { return m_window == nullptr; }
+		// False in pure offscreen mode : no surface, nothing is presented
+		bool CanPresent() { return m_surface != VK_NULL_HANDLE; }
 		VkQueue GraphicsQueue() { return m_graphicsQueue; }
 		VkQueue PresentQueue() { return m_presentQueue; }
+		// The graphics queue itself when there is no dedicated transfer family
+		VkQueue TransferQueue() { return m_transferQueue; }
+		uint32_t GraphicsFamily() { return m_graphicsFamily; }
+		uint32_t TransferFamily() { return m_transferFamily; }
+		// Buffers written on a dedicated transfer queue must change queue family ownership before the graphics queue reads them
+		bool HasDedicatedTransferQueue() { return m_transferFamily != m_graphicsFamily; }
+
+		// Queues may be shared between the render loop and background threads, every submit and present goes through these
+		VkResult QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence);
+		VkResult QueuePresent(const VkPresentInfoKHR& presentInfo);
+		// vkDeviceWaitIdle needs every queue externally synchronized, it waits with the queue lock held
+		void WaitIdle();
+		MemoryAllocator& GetAllocator() { return *m_allocator; }
+		UploadArena& GetUploadArena() { return *m_uploadArena; }
+		PipelineCache& GetPipelineCache() { return *m_pipelineCache; }
+		ShaderCache& GetShaderCache() { return *m_shaderCache; }
+		ResourceCache& GetResourceCache() { return *m_resourceCache; }
+		const VkPhysicalDeviceFeatures& GetEnabledFeatures() { return m_enabledFeatures; }
+
+		// VK_KHR_draw_indirect_count is optional, GPU driven paths fall back to a fixed draw count without it
+		bool SupportsDrawIndirectCount() { return m_cmdDrawIndexedIndirectCount != nullptr; }
+		void CmdDrawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride)
+		{
+			m_cmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+		}
+
+		// VK_KHR_timeline_semaphore is optional, callers fall back to fences without it
+		bool SupportsTimelineSemaphores() { return m_getSemaphoreCounterValue != nullptr && m_waitSemaphores != nullptr; }
+		uint64_t GetSemaphoreCounterValue(VkSemaphore semaphore);
+		void WaitSemaphore(VkSemaphore semaphore, uint64_t value);
+
+		// VK_EXT_descriptor_indexing is optional, the bindless heap falls back to one fully written set per frame in flight without it
+		bool SupportsDescriptorIndexing() { return m_descriptorIndexingSupported; }
+		const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& GetDescriptorIndexingProperties() { return m_descriptorIndexingProperties; }
 
 		SwapChainSupportDetails GetSwapChainSupport() { return QuerySwapChainSupport(m_physicalDevice); }
 		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -46,11 +96,13 @@ namespace Engine
 
 		// Buffer Helper Functions
 		VkCommandBuffer BeginSingleTimeCommands();
-		void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+		void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory);
 		void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
 		void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 		void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
-		void CreateImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+		void CreateReadbackBuffer(VkDeviceSize size, VkBuffer& buffer, MemoryAllocation& bufferMemory);
+		void CreateImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory);
+		void FreeMemory(MemoryAllocation& allocation) { m_allocator->Free(allocation); }
 
 		VkPhysicalDeviceProperties Properties;
 
@@ -61,6 +113,12 @@ namespace Engine
 		void PickPhysicalDevice();
 		void CreateLogicalDevice();
 		void CreateCommandPool();
+		void CreateAllocator();
+		void CreateUploadArena();
+		void CreatePipelineCache();
+		void CreateShaderCache();
+		void CreateResourceCache();
+		void QueryDescriptorIndexingProperties();
 
 		// Helper Functions
 		QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
@@ -82,16 +140,33 @@ namespace Engine
 		VkInstance m_instance;
 		VkDebugUtilsMessengerEXT m_debugMessenger;
 		VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
-		Window& m_window;
+		Window* m_window;
+		bool m_headlessSurfaceSupported = false;
+		bool m_physicalDeviceProperties2Supported = false;
+		bool m_descriptorIndexingSupported = false;
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT m_descriptorIndexingProperties = {};
 		VkCommandPool m_commandPool;
 
 		VkDevice m_device;
-		VkSurfaceKHR m_surface;
+		VkSurfaceKHR m_surface = VK_NULL_HANDLE;
 		VkQueue m_graphicsQueue;
 		VkQueue m_presentQueue;
+		VkQueue m_transferQueue;
+		uint32_t m_graphicsFamily = 0;
+		uint32_t m_transferFamily = 0;
+		std::mutex m_queueMutex;
+		std::unique_ptr<MemoryAllocator> m_allocator;
+		std::unique_ptr<UploadArena> m_uploadArena;
+		std::unique_ptr<PipelineCache> m_pipelineCache;
+		std::unique_ptr<ShaderCache> m_shaderCache;
+		std::unique_ptr<ResourceCache> m_resourceCache;
+		VkPhysicalDeviceFeatures m_enabledFeatures = {};
+		PFN_vkCmdDrawIndexedIndirectCountKHR m_cmdDrawIndexedIndirectCount = nullptr;
+		PFN_vkGetSemaphoreCounterValueKHR m_getSemaphoreCounterValue = nullptr;
+		PFN_vkWaitSemaphoresKHR m_waitSemaphores = nullptr;
 
 		const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
-		const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 	};
 
 }
\ No newline at end of file
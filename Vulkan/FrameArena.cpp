@@ -0,0 +1,52 @@
+#include "FrameArena.h"
+#include "Device.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Engine
+{
+	FrameArena::FrameArena(Device& device, VkDeviceSize capacity)
+		: m_device(device), m_capacity(capacity)
+	{
+		const VkPhysicalDeviceLimits& limits = m_device.Properties.limits;
+		m_defaultAlignment = std::max({ limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, VkDeviceSize(16) });
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+			| VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		m_device.CreateBuffer(m_capacity, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_buffer, m_memory);
+	}
+
+	FrameArena::~FrameArena()
+	{
+		vkDestroyBuffer(m_device.GetDevice(), m_buffer, nullptr);
+		m_device.FreeMemory(m_memory);
+	}
+
+	FrameAllocation FrameArena::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		if (alignment == 0)
+			alignment = m_defaultAlignment;
+
+		VkDeviceSize offset = m_offset.load(std::memory_order_relaxed);
+		VkDeviceSize alignedOffset;
+		do
+		{
+			alignedOffset = (offset + alignment - 1) / alignment * alignment;
+			if (alignedOffset + size > m_capacity)
+				throw std::runtime_error("Frame arena out of memory !");
+		} while (!m_offset.compare_exchange_weak(offset, alignedOffset + size, std::memory_order_relaxed));
+
+		FrameAllocation allocation;
+		allocation.buffer = m_buffer;
+		allocation.offset = alignedOffset;
+		allocation.mappedData = static_cast<char*>(m_memory.mappedData) + alignedOffset;
+		return allocation;
+	}
+
+	void FrameArena::Reset()
+	{
+		m_peakBytes = std::max(m_peakBytes, m_offset.load(std::memory_order_relaxed));
+		m_offset.store(0, std::memory_order_relaxed);
+	}
+}
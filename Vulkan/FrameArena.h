@@ -0,0 +1,53 @@
+#pragma once
+
+#include "MemoryAllocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+
+namespace Engine
+{
+	class Device;
+
+	struct FrameAllocation
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		void* mappedData = nullptr;
+	};
+
+	// Linear allocator for data written by the CPU once per frame (uniforms, dynamic vertices, ...).
+	// There is one arena per frame in flight, it is reset once the fence of its frame is signaled
+	class FrameArena
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_CAPACITY = 4ull * 1024 * 1024;
+
+		FrameArena(Device& device, VkDeviceSize capacity = DEFAULT_CAPACITY);
+		~FrameArena();
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		// Thread safe, the allocation stays valid until the next Reset
+		FrameAllocation Allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+		void Reset();
+
+		// Fixed for the lifetime of the arena, descriptors may point at it once
+		VkBuffer GetBuffer() const { return m_buffer; }
+		VkDeviceSize GetCapacity() const { return m_capacity; }
+		VkDeviceSize GetUsedBytes() const { return m_offset.load(std::memory_order_relaxed); }
+		VkDeviceSize GetPeakBytes() const { return m_peakBytes; }
+
+	private:
+		Device& m_device;
+		VkBuffer m_buffer;
+		MemoryAllocation m_memory;
+		VkDeviceSize m_capacity;
+		VkDeviceSize m_defaultAlignment;
+
+		std::atomic<VkDeviceSize> m_offset = 0;
+		VkDeviceSize m_peakBytes = 0;
+	};
+}
@@ -0,0 +1,192 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace Engine
+{
+	GpuProfiler::Scope::Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+		: m_profiler(profiler), m_commandBuffer(commandBuffer), m_scope(profiler.BeginScope(commandBuffer, name))
+	{
+	}
+
+	GpuProfiler::Scope::~Scope()
+	{
+		m_profiler.EndScope(m_commandBuffer, m_scope);
+	}
+
+	GpuProfiler::GpuProfiler(Device& device, uint32_t framesInFlight)
+		: m_device(device)
+	{
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_device.GetPhysicalDevice(), &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_device.GetPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+		uint32_t validBits = queueFamilies[m_device.FindPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+		if (validBits == 0)
+		{
+			std::cerr << "GPU profiler : the graphics queue does not support timestamps, profiling is disabled" << std::endl;
+			return;
+		}
+
+		m_supported = true;
+		m_timestampPeriod = m_device.Properties.limits.timestampPeriod;
+		m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+		m_frames.resize(framesInFlight);
+		for (auto& frame : m_frames)
+		{
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = MAX_SCOPES_PER_FRAME * 2;
+
+			if (vkCreateQueryPool(m_device.GetDevice(), &queryPoolInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create timestamp query pool !");
+			frame.scopes.reserve(MAX_SCOPES_PER_FRAME);
+		}
+	}
+
+	GpuProfiler::~GpuProfiler()
+	{
+		for (auto& frame : m_frames)
+			vkDestroyQueryPool(m_device.GetDevice(), frame.queryPool, nullptr);
+	}
+
+	void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint64_t frameNumber)
+	{
+		if (!m_supported)
+			return;
+
+		assert(m_currentFrame == nullptr && "GPU profiler frame already began !");
+		FrameQueries& frame = m_frames[frameIndex];
+		if (frame.pending)
+			ResolveFrame(frame);
+
+		vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, MAX_SCOPES_PER_FRAME * 2);
+		frame.scopes.clear();
+		frame.frameNumber = frameNumber;
+		m_currentFrame = &frame;
+		m_openScope = NO_PARENT;
+		BeginScope(commandBuffer, "Frame");
+	}
+
+	void GpuProfiler::EndFrame(VkCommandBuffer commandBuffer)
+	{
+		if (!m_supported)
+			return;
+
+		assert(m_openScope == 0 && "GPU scopes still open at the end of the frame !");
+		EndScope(commandBuffer, 0);
+		m_currentFrame->pending = true;
+		m_currentFrame = nullptr;
+	}
+
+	uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name)
+	{
+		// Scopes past the limit are dropped, the tree stays consistent since their children are dropped too
+		if (m_currentFrame == nullptr || m_currentFrame->scopes.size() >= MAX_SCOPES_PER_FRAME)
+			return NO_PARENT;
+
+		uint32_t scope = static_cast<uint32_t>(m_currentFrame->scopes.size());
+		m_currentFrame->scopes.push_back({ name, m_openScope, false });
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_currentFrame->queryPool, scope * 2);
+		m_openScope = scope;
+		return scope;
+	}
+
+	void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scope)
+	{
+		if (m_currentFrame == nullptr || scope == NO_PARENT)
+			return;
+
+		assert(scope == m_openScope && "GPU scopes must end in the reverse order they began !");
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_currentFrame->queryPool, scope * 2 + 1);
+		m_currentFrame->scopes[scope].ended = true;
+		m_openScope = m_currentFrame->scopes[scope].parent;
+	}
+
+	void GpuProfiler::ResolveFrame(FrameQueries& frame)
+	{
+		frame.pending = false;
+
+		// The fence of the frame was waited on, every query is available and this never blocks
+		std::vector<uint64_t> timestamps(frame.scopes.size() * 2);
+		VkResult result = vkGetQueryPoolResults(m_device.GetDevice(), frame.queryPool, 0, static_cast<uint32_t>(timestamps.size()),
+			timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS)
+			return;
+
+		for (auto& timestamp : timestamps)
+			timestamp &= m_timestampMask;
+
+		if (!m_hasOrigin)
+		{
+			m_originTimestamp = timestamps[0];
+			m_hasOrigin = true;
+		}
+
+		// timestampPeriod is in nanoseconds per tick
+		auto toMilliseconds = [&](uint64_t timestamp) { return static_cast<double>(static_cast<int64_t>(timestamp - m_originTimestamp)) * m_timestampPeriod / 1e6; };
+
+		std::vector<std::vector<uint32_t>> children(frame.scopes.size());
+		for (uint32_t i = 1; i < frame.scopes.size(); i++)
+			children[frame.scopes[i].parent].push_back(i);
+
+		std::function<GpuScopeResult(uint32_t)> build = [&](uint32_t scope)
+		{
+			GpuScopeResult scopeResult;
+			scopeResult.name = frame.scopes[scope].name;
+			scopeResult.startMilliseconds = toMilliseconds(timestamps[scope * 2]);
+			scopeResult.durationMilliseconds = toMilliseconds(timestamps[scope * 2 + 1]) - scopeResult.startMilliseconds;
+			for (uint32_t child : children[scope])
+				scopeResult.children.push_back(build(child));
+			return scopeResult;
+		};
+
+		m_history.push_back({ frame.frameNumber, build(0) });
+		if (m_history.size() > HISTORY_SIZE)
+			m_history.pop_front();
+	}
+
+	void GpuProfiler::ResolvePending()
+	{
+		std::vector<FrameQueries*> pending;
+		for (auto& frame : m_frames)
+			if (frame.pending)
+				pending.push_back(&frame);
+		std::sort(pending.begin(), pending.end(), [](const FrameQueries* a, const FrameQueries* b) { return a->frameNumber < b->frameNumber; });
+		for (FrameQueries* frame : pending)
+			ResolveFrame(*frame);
+	}
+
+	void GpuProfiler::WriteChromeTrace(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open GPU trace " + path + " !");
+
+		file << std::fixed << std::setprecision(3);
+		file << "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [\n";
+		file << "    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": 0, \"args\": { \"name\": \"GPU graphics queue\" } }";
+
+		// Complete events ("ph": "X") in microseconds, nesting is rebuilt by the viewer from the time ranges
+		std::function<void(const GpuScopeResult&, uint64_t)> writeScope = [&](const GpuScopeResult& scope, uint64_t frameNumber)
+		{
+			file << ",\n    { \"name\": \"" << scope.name << "\", \"cat\": \"gpu\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, \"ts\": " << scope.startMilliseconds * 1000.0
+				<< ", \"dur\": " << scope.durationMilliseconds * 1000.0 << ", \"args\": { \"frame\": " << frameNumber << " } }";
+			for (const auto& child : scope.children)
+				writeScope(child, frameNumber);
+		};
+
+		for (const auto& frame : m_history)
+			writeScope(frame.root, frame.frameNumber);
+		file << "\n  ]\n}\n";
+	}
+}
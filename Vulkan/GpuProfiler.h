@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Device.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	struct GpuScopeResult
+	{
+		std::string name;
+		// Relative to the first profiled frame, so scopes of different frames share a timeline
+		double startMilliseconds = 0.0;
+		double durationMilliseconds = 0.0;
+		std::vector<GpuScopeResult> children;
+	};
+
+	struct GpuFrameResult
+	{
+		uint64_t frameNumber = 0;
+		// The "Frame" scope, covering the whole command buffer, every other scope is nested in it
+		GpuScopeResult root;
+	};
+
+	// Timestamp queries around scopes of a frame. Every frame in flight has its own query pool, read back once the fence
+	// of that frame is signaled, so results arrive framesInFlight frames late but never stall the CPU
+	class GpuProfiler
+	{
+	public:
+		static constexpr uint32_t MAX_SCOPES_PER_FRAME = 128;
+		static constexpr size_t HISTORY_SIZE = 600;
+
+		class Scope
+		{
+		public:
+			Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name);
+			~Scope();
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			GpuProfiler& m_profiler;
+			VkCommandBuffer m_commandBuffer;
+			uint32_t m_scope;
+		};
+
+		GpuProfiler(Device& device, uint32_t framesInFlight);
+		~GpuProfiler();
+
+		GpuProfiler(const GpuProfiler&) = delete;
+		GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+		// Must be recorded outside of any render pass, after the fence of frameIndex was waited on
+		void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint64_t frameNumber);
+		void EndFrame(VkCommandBuffer commandBuffer);
+		// Reads every submitted frame, only once the device is idle
+		void ResolvePending();
+
+		// Scopes may nest, names must outlive the frame (string literals)
+		uint32_t BeginScope(VkCommandBuffer commandBuffer, const char* name);
+		void EndScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+		bool IsSupported() const { return m_supported; }
+		// Latest frame with results, empty until framesInFlight frames were submitted
+		const GpuFrameResult* GetLastFrame() const { return m_history.empty() ? nullptr : &m_history.back(); }
+		const std::deque<GpuFrameResult>& GetHistory() const { return m_history; }
+		// Writes the history in the Chrome trace event format, viewable in chrome://tracing or Perfetto
+		void WriteChromeTrace(const std::string& path) const;
+
+	private:
+		struct ScopeRecord
+		{
+			const char* name;
+			uint32_t parent;
+			bool ended;
+		};
+
+		struct FrameQueries
+		{
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			std::vector<ScopeRecord> scopes;
+			uint64_t frameNumber = 0;
+			bool pending = false;
+		};
+
+		void ResolveFrame(FrameQueries& frame);
+
+	private:
+		static constexpr uint32_t NO_PARENT = ~0u;
+
+		Device& m_device;
+		bool m_supported = false;
+		double m_timestampPeriod = 1.0;
+		uint64_t m_timestampMask = ~0ull;
+		bool m_hasOrigin = false;
+		uint64_t m_originTimestamp = 0;
+
+		std::vector<FrameQueries> m_frames;
+		FrameQueries* m_currentFrame = nullptr;
+		uint32_t m_openScope = NO_PARENT;
+		std::deque<GpuFrameResult> m_history;
+	};
+}
@@ -0,0 +1,325 @@
+#include "GpuScene.h"
+#include "CpuProfiler.h"
+#include "MeshOptimizer.h"
+#include "UploadArena.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace Engine
+{
+	GpuScene::GpuScene(Device& device, uint32_t framesInFlight, bool cullBackfaces)
+		: m_device(device), m_framesInFlight(framesInFlight), m_compact(device.SupportsDrawIndirectCount()), m_cullBackfaces(cullBackfaces)
+	{
+		assert(IsSupported(m_device) && "GPU driven rendering is not supported by this device !");
+		CreateLayouts();
+		m_cullingPipeline = std::make_unique<ComputePipeline>(m_device, "shaders/cull_clusters.comp.spv", m_pipelineLayout);
+	}
+
+	GpuScene::~GpuScene()
+	{
+		VkDevice device = m_device.GetDevice();
+		m_cullingPipeline.reset();
+		vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+
+		for (auto& frame : m_frames)
+		{
+			vkDestroyBuffer(device, frame.drawBuffer, nullptr);
+			m_device.FreeMemory(frame.drawMemory);
+			vkDestroyBuffer(device, frame.countBuffer, nullptr);
+			m_device.FreeMemory(frame.countMemory);
+		}
+
+		if (m_built)
+		{
+			vkDestroyBuffer(device, m_vertexBuffer, nullptr);
+			m_device.FreeMemory(m_vertexMemory);
+			vkDestroyBuffer(device, m_indexBuffer, nullptr);
+			m_device.FreeMemory(m_indexMemory);
+			vkDestroyBuffer(device, m_clusterBuffer, nullptr);
+			m_device.FreeMemory(m_clusterMemory);
+			vkDestroyBuffer(device, m_instanceBuffer, nullptr);
+			m_device.FreeMemory(m_instanceMemory);
+		}
+	}
+
+	bool GpuScene::IsSupported(Device& device)
+	{
+		return device.GetEnabledFeatures().drawIndirectFirstInstance == VK_TRUE;
+	}
+
+	uint32_t GpuScene::AddMesh(const std::vector<Model::Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		PROFILE_FUNCTION();
+		assert(!m_built && "Cannot add meshes to a built GPU scene !");
+		assert(!vertices.empty() && !indices.empty() && "GPU scene meshes must be indexed !");
+
+		MeshletData meshlets;
+		MeshOptimizer::BuildMeshlets(meshlets, vertices, indices);
+
+		Mesh mesh = {};
+		mesh.firstCluster = static_cast<uint32_t>(m_meshClusters.size());
+		mesh.clusterCount = static_cast<uint32_t>(meshlets.meshlets.size());
+		mesh.vertexOffset = static_cast<int32_t>(m_vertices.size());
+		mesh.triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		glm::vec2 boundsMin = vertices[0].position;
+		glm::vec2 boundsMax = vertices[0].position;
+		for (const auto& vertex : vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
+		mesh.positionDecode = Model::PositionDecode::FromBounds(boundsMin, boundsMax);
+
+		// Without mesh shaders a meshlet is drawn as a contiguous range of the index buffer, its local indices are expanded back
+		for (const Meshlet& meshlet : meshlets.meshlets)
+		{
+			MeshCluster cluster = {};
+			cluster.firstIndex = static_cast<uint32_t>(m_indices.size());
+			cluster.indexCount = meshlet.triangleCount * 3;
+			cluster.center = { meshlet.center[0], meshlet.center[1] };
+			cluster.radius = meshlet.radius;
+			cluster.cone = { meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2], meshlet.coneCutoff };
+			for (uint32_t i = 0; i < cluster.indexCount; i++)
+				m_indices.push_back(meshlets.vertices[meshlet.vertexOffset + meshlets.triangles[meshlet.triangleOffset * 3 + i]]);
+			m_meshClusters.push_back(cluster);
+		}
+
+		for (const auto& vertex : vertices)
+			m_vertices.push_back(mesh.positionDecode.Pack(vertex));
+		m_meshes.push_back(mesh);
+		return static_cast<uint32_t>(m_meshes.size() - 1);
+	}
+
+	void GpuScene::AddObject(uint32_t mesh, const Model::Instance& instance)
+	{
+		assert(!m_built && "Cannot add objects to a built GPU scene !");
+		assert(mesh < m_meshes.size() && "Unknown GPU scene mesh !");
+
+		// Objects never move, the bounds of their clusters are moved to clip space once here
+		const Mesh& source = m_meshes[mesh];
+		float scale = std::max(std::abs(instance.scale.x), std::abs(instance.scale.y));
+		// Positions are 2D so normals are along z, a mirroring scale flips them
+		float facing = instance.scale.x * instance.scale.y < 0.0f ? -1.0f : 1.0f;
+		for (uint32_t i = 0; i < source.clusterCount; i++)
+		{
+			const MeshCluster& meshCluster = m_meshClusters[source.firstCluster + i];
+			glm::vec2 center = meshCluster.center * instance.scale + instance.offset;
+
+			SceneCluster cluster = {};
+			cluster.sphere = glm::vec4(center.x, center.y, meshCluster.radius * scale, 0.0f);
+			cluster.cone = glm::vec4(meshCluster.cone.x, meshCluster.cone.y, meshCluster.cone.z * facing, meshCluster.cone.w);
+			cluster.indexCount = meshCluster.indexCount;
+			cluster.firstIndex = meshCluster.firstIndex;
+			cluster.vertexOffset = source.vertexOffset;
+			cluster.instanceIndex = m_objectCount;
+			m_clusters.push_back(cluster);
+		}
+
+		// The decode of the mesh runs before the instance transform, both are folded into a single instance
+		Model::Instance objectInstance = instance;
+		objectInstance.scale = source.positionDecode.scale * instance.scale;
+		objectInstance.offset = source.positionDecode.offset * instance.scale + instance.offset;
+		m_instances.push_back(objectInstance);
+		m_objectCount++;
+		m_triangleCount += source.triangleCount;
+	}
+
+	void GpuScene::Build()
+	{
+		PROFILE_FUNCTION();
+		assert(!m_built && "GPU scene already built !");
+		if (m_clusters.empty())
+			return;
+
+		VkDeviceSize vertexSize = m_vertices.size() * sizeof(Model::PackedVertex);
+		VkDeviceSize indexSize = m_indices.size() * sizeof(uint32_t);
+		VkDeviceSize clusterSize = m_clusters.size() * sizeof(SceneCluster);
+		VkDeviceSize instanceSize = m_instances.size() * sizeof(Model::Instance);
+
+		m_device.CreateBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexMemory);
+		m_device.CreateBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexMemory);
+		m_device.CreateBuffer(clusterSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_clusterBuffer, m_clusterMemory);
+		m_device.CreateBuffer(instanceSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_instanceBuffer, m_instanceMemory);
+		m_built = true;
+
+		UploadArena& uploadArena = m_device.GetUploadArena();
+		uploadArena.Upload(m_vertexBuffer, 0, m_vertices.data(), vertexSize);
+		uploadArena.Upload(m_indexBuffer, 0, m_indices.data(), indexSize);
+		uploadArena.Upload(m_clusterBuffer, 0, m_clusters.data(), clusterSize);
+		uploadArena.Upload(m_instanceBuffer, 0, m_instances.data(), instanceSize);
+
+		// Only the cluster count is needed from now on, the GPU owns the rest
+		m_vertices = {};
+		m_indices = {};
+		m_instances = {};
+		m_meshClusters = {};
+
+		CreateFrameBuffers();
+		std::cout << "GPU scene : " << m_meshes.size() << " meshes, " << m_objectCount << " objects, " << m_clusters.size() << " clusters, " << m_triangleCount << " triangles, "
+			<< (m_compact ? "draw indirect count" : "fixed indirect draw count") << std::endl;
+	}
+
+	void GpuScene::CreateLayouts()
+	{
+		std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(m_device.GetDevice(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create culling descriptor set layout !");
+
+		VkPushConstantRange pushConstantRange = PushConstantRange<CullingConstants>();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(m_device.GetDevice(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create culling pipeline layout !");
+
+		VkDescriptorPoolSize poolSize = {};
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount = static_cast<uint32_t>(bindings.size()) * m_framesInFlight;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = m_framesInFlight;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		if (vkCreateDescriptorPool(m_device.GetDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create culling descriptor pool !");
+	}
+
+	void GpuScene::CreateFrameBuffers()
+	{
+		// Each frame in flight writes its own draws, the culling of a frame never races with the draws of the previous one
+		VkDeviceSize drawSize = m_clusters.size() * sizeof(VkDrawIndexedIndirectCommand);
+		m_frames.resize(m_framesInFlight);
+		for (auto& frame : m_frames)
+		{
+			m_device.CreateBuffer(drawSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.drawBuffer, frame.drawMemory);
+			m_device.CreateBuffer(sizeof(CullingStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.countBuffer, frame.countMemory);
+
+			VkDescriptorSetAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocInfo.descriptorPool = m_descriptorPool;
+			allocInfo.descriptorSetCount = 1;
+			allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+			if (vkAllocateDescriptorSets(m_device.GetDevice(), &allocInfo, &frame.descriptorSet) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate culling descriptor set !");
+
+			std::array<VkDescriptorBufferInfo, 3> bufferInfos = {};
+			bufferInfos[0] = { m_clusterBuffer, 0, VK_WHOLE_SIZE };
+			bufferInfos[1] = { frame.drawBuffer, 0, VK_WHOLE_SIZE };
+			bufferInfos[2] = { frame.countBuffer, 0, VK_WHOLE_SIZE };
+
+			std::array<VkWriteDescriptorSet, 3> writes = {};
+			for (uint32_t i = 0; i < writes.size(); i++)
+			{
+				writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writes[i].dstSet = frame.descriptorSet;
+				writes[i].dstBinding = i;
+				writes[i].descriptorCount = 1;
+				writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				writes[i].pBufferInfo = &bufferInfos[i];
+			}
+			vkUpdateDescriptorSets(m_device.GetDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		}
+	}
+
+	void GpuScene::RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		PROFILE_FUNCTION();
+		if (!m_built)
+			return;
+
+		// The fence of this frame was waited on, its stats hold the result of framesInFlight frames ago
+		FrameBuffers& frame = m_frames[frameIndex];
+		if (frame.pending)
+		{
+			const CullingStats* stats = static_cast<const CullingStats*>(frame.countMemory.mappedData);
+			m_visibleClusterCount = stats->visibleCount;
+			m_visibleTriangleCount = stats->visibleTriangles;
+		}
+		frame.pending = true;
+
+		vkCmdFillBuffer(commandBuffer, frame.countBuffer, 0, sizeof(CullingStats), 0);
+		if (!m_compact)
+			vkCmdFillBuffer(commandBuffer, frame.drawBuffer, 0, VK_WHOLE_SIZE, 0);
+
+		VkMemoryBarrier clearBarrier = {};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		CullingConstants constants = { GetClusterCount(), m_compact ? 1u : 0u, m_cullBackfaces ? 1u : 0u };
+		m_cullingPipeline->Bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+		Pipeline::PushConstants(commandBuffer, m_pipelineLayout, constants);
+		vkCmdDispatch(commandBuffer, (GetClusterCount() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+		// The count is read twice : by the indirect draw and by the CPU once the frame fence is signaled
+		VkMemoryBarrier cullingBarrier = {};
+		cullingBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullingBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullingBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cullingBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void GpuScene::Draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkPipelineLayout pipelineLayout)
+	{
+		if (!m_built)
+			return;
+
+		Model::PositionDecode identity;
+		Pipeline::PushConstants(commandBuffer, pipelineLayout, identity);
+
+		const FrameBuffers& frame = m_frames[frameIndex];
+		VkBuffer buffers[] = { m_vertexBuffer, m_instanceBuffer };
+		VkDeviceSize offsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		if (m_compact)
+		{
+			m_device.CmdDrawIndexedIndirectCount(commandBuffer, frame.drawBuffer, 0, frame.countBuffer, 0, GetClusterCount(), stride);
+		}
+		else if (m_device.GetEnabledFeatures().multiDrawIndirect == VK_TRUE)
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, 0, GetClusterCount(), stride);
+		}
+		else
+		{
+			// Without multiDrawIndirect the draw count must be 0 or 1, the commands still come from the GPU
+			for (uint32_t i = 0; i < GetClusterCount(); i++)
+				vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, i * stride, 1, stride);
+		}
+	}
+}
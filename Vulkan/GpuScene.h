@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Device.h"
+#include "Model.h"
+#include "Pipeline.h"
+
+#include <memory>
+#include <vector>
+
+namespace Engine
+{
+	// Static objects culled and drawn by the GPU. Every mesh lives in one shared vertex and index buffer, split into meshlets.
+	// A compute shader tests the bounds and normal cone of every meshlet of every object and writes the indirect draws of the
+	// visible ones, so recording a frame costs the same whatever the object count and the GPU only draws visible clusters
+	class GpuScene
+	{
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+		// Back facing clusters are only culled when the pipeline culls back faces, otherwise they would still be visible
+		GpuScene(Device& device, uint32_t framesInFlight, bool cullBackfaces);
+		~GpuScene();
+
+		GpuScene(const GpuScene&) = delete;
+		GpuScene& operator=(const GpuScene&) = delete;
+
+		// Instance selection through firstInstance needs drawIndirectFirstInstance, the CPU path is used without it
+		static bool IsSupported(Device& device);
+
+		// Returns the mesh index, meshes and objects must all be added before Build. Indices should be cache optimized,
+		// meshlets are cut in index order
+		uint32_t AddMesh(const std::vector<Model::Vertex>& vertices, const std::vector<uint32_t>& indices);
+		void AddObject(uint32_t mesh, const Model::Instance& instance);
+		// Queues the scene upload in the upload arena, the caller flushes it
+		void Build();
+
+		// Must be recorded outside of any render pass, after the fence of frameIndex was waited on
+		void RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		// Draws with a pipeline taking Model::PackedVertex at binding 0 and Model::Instance at binding 1, bound by the caller.
+		// Position decodes are folded into the instances, an identity decode is pushed
+		void Draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkPipelineLayout pipelineLayout);
+
+		uint32_t GetObjectCount() const { return m_objectCount; }
+		uint32_t GetClusterCount() const { return static_cast<uint32_t>(m_clusters.size()); }
+		uint64_t GetTriangleCount() const { return m_triangleCount; }
+		// Read back from the culling of framesInFlight frames ago
+		uint32_t GetVisibleClusterCount() const { return m_visibleClusterCount; }
+		uint64_t GetVisibleTriangleCount() const { return m_visibleTriangleCount; }
+
+	private:
+		// Meshlet of a mesh, in mesh space
+		struct MeshCluster
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			glm::vec2 center;
+			float radius;
+			glm::vec4 cone;
+		};
+
+		struct Mesh
+		{
+			uint32_t firstCluster;
+			uint32_t clusterCount;
+			int32_t vertexOffset;
+			uint32_t triangleCount;
+			Model::PositionDecode positionDecode;
+		};
+
+		// Matches Cluster of cull_clusters.comp (std430, 48 bytes)
+		struct SceneCluster
+		{
+			glm::vec4 sphere;
+			glm::vec4 cone;
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+			uint32_t instanceIndex;
+		};
+
+		// Matches Stats of cull_clusters.comp
+		struct CullingStats
+		{
+			uint32_t visibleCount;
+			uint32_t visibleTriangles;
+		};
+
+		struct CullingConstants
+		{
+			static constexpr VkShaderStageFlags PUSH_CONSTANT_STAGES = VK_SHADER_STAGE_COMPUTE_BIT;
+			static constexpr uint32_t PUSH_CONSTANT_OFFSET = 0;
+
+			uint32_t clusterCount;
+			uint32_t compact;
+			uint32_t cullBackfaces;
+		};
+
+		struct FrameBuffers
+		{
+			VkBuffer drawBuffer = VK_NULL_HANDLE;
+			MemoryAllocation drawMemory;
+			// Host visible, the stats are read on the CPU once the fence of the frame is signaled
+			VkBuffer countBuffer = VK_NULL_HANDLE;
+			MemoryAllocation countMemory;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			bool pending = false;
+		};
+
+		void CreateLayouts();
+		void CreateFrameBuffers();
+
+	private:
+		Device& m_device;
+		uint32_t m_framesInFlight;
+		// With VK_KHR_draw_indirect_count the visible draws are packed and counted, without it every cluster keeps its slot
+		// and culled slots are zeroed draws
+		bool m_compact;
+		bool m_cullBackfaces;
+
+		std::vector<Model::PackedVertex> m_vertices;
+		std::vector<uint32_t> m_indices;
+		std::vector<Mesh> m_meshes;
+		std::vector<MeshCluster> m_meshClusters;
+		std::vector<SceneCluster> m_clusters;
+		std::vector<Model::Instance> m_instances;
+		uint32_t m_objectCount = 0;
+		uint64_t m_triangleCount = 0;
+		uint32_t m_visibleClusterCount = 0;
+		uint64_t m_visibleTriangleCount = 0;
+		bool m_built = false;
+
+		VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+		MemoryAllocation m_vertexMemory;
+		VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+		MemoryAllocation m_indexMemory;
+		VkBuffer m_clusterBuffer = VK_NULL_HANDLE;
+		MemoryAllocation m_clusterMemory;
+		VkBuffer m_instanceBuffer = VK_NULL_HANDLE;
+		MemoryAllocation m_instanceMemory;
+		std::vector<FrameBuffers> m_frames;
+
+		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+		VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<ComputePipeline> m_cullingPipeline;
+	};
+}
@@ -0,0 +1,655 @@
+#include "JobScheduler.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace Engine
+{
+	static constexpr uint32_t INVALID_WORKER = std::numeric_limits<uint32_t>::max();
+	static constexpr uint32_t SPINS_BEFORE_YIELD = 64;
+	static constexpr uint32_t YIELDS_BEFORE_SLEEP = 16;
+
+	static thread_local const JobScheduler* t_scheduler = nullptr;
+	static thread_local uint32_t t_workerIndex = INVALID_WORKER;
+
+	WorkStealingDeque::WorkStealingDeque(int64_t capacity)
+	{
+		assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "Deque capacity must be a power of two !");
+		m_buffers.push_back(std::make_unique<Buffer>(capacity));
+		m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+	}
+
+	WorkStealingDeque::~WorkStealingDeque() = default;
+
+	void WorkStealingDeque::Push(Job* job)
+	{
+		int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		int64_t top = m_top.load(std::memory_order_acquire);
+		Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+
+		if (bottom - top > buffer->capacity - 1)
+			buffer = Grow(buffer, bottom, top);
+
+		// Release stores instead of a release fence, same cost on x86 and visible to thread sanitizers
+		buffer->Put(bottom, job);
+		m_bottom.store(bottom + 1, std::memory_order_release);
+	}
+
+	Job* WorkStealingDeque::Pop()
+	{
+		int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = m_top.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* job = buffer->Get(bottom);
+		if (top == bottom)
+		{
+			// Last job, race against the thieves for it
+			if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = nullptr;
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	Job* WorkStealingDeque::Steal()
+	{
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+		if (top >= bottom)
+			return nullptr;
+
+		Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+		Job* job = buffer->Get(top);
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return job;
+	}
+
+	bool WorkStealingDeque::Empty() const
+	{
+		return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+	}
+
+	WorkStealingDeque::Buffer* WorkStealingDeque::Grow(Buffer* buffer, int64_t bottom, int64_t top)
+	{
+		auto grown = std::make_unique<Buffer>(buffer->capacity * 2);
+		for (int64_t i = top; i < bottom; i++)
+			grown->Put(i, buffer->Get(i));
+
+		m_buffers.push_back(std::move(grown));
+		m_buffer.store(m_buffers.back().get(), std::memory_order_release);
+		return m_buffers.back().get();
+	}
+
+	JobScheduler::JobScheduler(uint32_t workerCount)
+		: m_workerCount(workerCount != 0 ? workerCount : std::max(std::thread::hardware_concurrency(), 1u)), m_mainThreadId(std::this_thread::get_id())
+	{
+		for (uint32_t i = 0; i < m_workerCount; i++)
+		{
+			m_deques.push_back(std::make_unique<WorkStealingDeque>());
+			m_workerStats.push_back(std::make_unique<WorkerStats>());
+		}
+
+		// Worker 0 is the main thread, it runs jobs while waiting on counters
+		t_scheduler = this;
+		t_workerIndex = 0;
+		PROFILE_THREAD_NAME("Main thread");
+		for (uint32_t i = 1; i < m_workerCount; i++)
+			m_threads.emplace_back(&JobScheduler::WorkerLoop, this, i);
+	}
+
+	JobScheduler::~JobScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_stopping = true;
+		}
+		m_sleepCondition.notify_all();
+		for (auto& thread : m_threads)
+			thread.join();
+
+		// Jobs still queued were never waited on, drop them
+		for (auto& deque : m_deques)
+			while (Job* job = deque->Pop())
+				delete job;
+		for (Job* job : m_externalJobs)
+			delete job;
+		for (Job* job : m_mainThreadJobs)
+			delete job;
+
+		if (t_scheduler == this)
+		{
+			t_scheduler = nullptr;
+			t_workerIndex = INVALID_WORKER;
+		}
+	}
+
+	void JobScheduler::Schedule(std::function<void()> function, JobCounter* counter, JobCounter* dependency)
+	{
+		if (counter != nullptr)
+			counter->m_value.fetch_add(1, std::memory_order_acq_rel);
+		Submit(new Job{ std::move(function), counter, false }, dependency);
+	}
+
+	void JobScheduler::ScheduleOnMainThread(std::function<void()> function, JobCounter* counter, JobCounter* dependency)
+	{
+		if (counter != nullptr)
+			counter->m_value.fetch_add(1, std::memory_order_acq_rel);
+		Submit(new Job{ std::move(function), counter, true }, dependency);
+	}
+
+	void JobScheduler::ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& function)
+	{
+		if (count == 0)
+			return;
+		batchSize = std::max<size_t>(batchSize, 1);
+
+		JobCounter counter;
+		for (size_t begin = batchSize; begin < count; begin += batchSize)
+		{
+			size_t end = std::min(begin + batchSize, count);
+			Schedule([&function, begin, end]() { function(begin, end); }, &counter);
+		}
+
+		// The first batch runs on the calling thread while the others are stolen
+		function(0, std::min(batchSize, count));
+		Wait(counter);
+	}
+
+	void JobScheduler::Wait(JobCounter& counter)
+	{
+		uint32_t workerIndex = t_scheduler == this ? t_workerIndex : INVALID_WORKER;
+		bool mainThread = IsMainThread();
+
+		while (!counter.IsDone())
+		{
+			if (mainThread)
+				PumpMainThread();
+
+			if (workerIndex == INVALID_WORKER || !TryRunOneJob(workerIndex))
+				std::this_thread::yield();
+		}
+
+		// The thread which released the counter may still hold its lock
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(counter.m_mutex);
+			std::swap(error, counter.m_error);
+		}
+		if (error != nullptr)
+			std::rethrow_exception(error);
+	}
+
+	void JobScheduler::PumpMainThread()
+	{
+		assert(IsMainThread() && "Main thread jobs can only be pumped from the main thread !");
+
+		std::deque<Job*> jobs;
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			jobs.swap(m_mainThreadJobs);
+		}
+		for (Job* job : jobs)
+			Execute(job, 0);
+	}
+
+	uint32_t JobScheduler::CurrentWorkerIndex()
+	{
+		return t_workerIndex;
+	}
+
+	JobSchedulerStats JobScheduler::GetStats() const
+	{
+		JobSchedulerStats stats;
+		for (const auto& workerStats : m_workerStats)
+		{
+			stats.executedJobs += workerStats->executedJobs.load(std::memory_order_relaxed);
+			stats.stealAttempts += workerStats->stealAttempts.load(std::memory_order_relaxed);
+			stats.successfulSteals += workerStats->successfulSteals.load(std::memory_order_relaxed);
+		}
+		return stats;
+	}
+
+	void JobScheduler::ResetStats()
+	{
+		for (auto& workerStats : m_workerStats)
+		{
+			workerStats->executedJobs.store(0, std::memory_order_relaxed);
+			workerStats->stealAttempts.store(0, std::memory_order_relaxed);
+			workerStats->successfulSteals.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void JobScheduler::Submit(Job* job, JobCounter* dependency)
+	{
+		if (dependency != nullptr)
+		{
+			// Checked under the lock, the last job of the dependency releases its continuations under the same lock
+			std::lock_guard<std::mutex> lock(dependency->m_mutex);
+			if (dependency->m_value.load(std::memory_order_acquire) != 0)
+			{
+				dependency->m_continuations.push_back(job);
+				return;
+			}
+		}
+		Enqueue(job);
+	}
+
+	void JobScheduler::Enqueue(Job* job)
+	{
+		if (job->mainThreadOnly)
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			m_mainThreadJobs.push_back(job);
+			return;
+		}
+
+		if (t_scheduler == this)
+		{
+			m_deques[t_workerIndex]->Push(job);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			m_externalJobs.push_back(job);
+		}
+
+		// Pairs with the fence of a worker going to sleep : either it sees the job or we see it sleeping
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_sleepingWorkers.load(std::memory_order_relaxed) > 0)
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_sleepCondition.notify_one();
+		}
+	}
+
+	bool JobScheduler::TryRunOneJob(uint32_t workerIndex)
+	{
+		Job* job = FindJob(workerIndex);
+		if (job == nullptr)
+			return false;
+
+		Execute(job, workerIndex);
+		return true;
+	}
+
+	Job* JobScheduler::FindJob(uint32_t workerIndex)
+	{
+		if (Job* job = m_deques[workerIndex]->Pop())
+			return job;
+
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			if (!m_externalJobs.empty())
+			{
+				Job* job = m_externalJobs.front();
+				m_externalJobs.pop_front();
+				return job;
+			}
+		}
+
+		// Start from a different victim on every call so thieves spread over the deques
+		static thread_local uint32_t randomState = 0x9E3779B9u ^ static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		randomState ^= randomState << 13;
+		randomState ^= randomState >> 17;
+		randomState ^= randomState << 5;
+
+		WorkerStats& stats = *m_workerStats[workerIndex];
+		for (uint32_t i = 0; i < m_workerCount; i++)
+		{
+			uint32_t victim = (randomState + i) % m_workerCount;
+			if (victim == workerIndex)
+				continue;
+
+			stats.stealAttempts.fetch_add(1, std::memory_order_relaxed);
+			if (Job* job = m_deques[victim]->Steal())
+			{
+				stats.successfulSteals.fetch_add(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	void JobScheduler::Execute(Job* job, uint32_t workerIndex)
+	{
+		PROFILE_SCOPE("Job");
+		std::exception_ptr error;
+		try
+		{
+			job->function();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		m_workerStats[workerIndex]->executedJobs.fetch_add(1, std::memory_order_relaxed);
+
+		JobCounter* counter = job->counter;
+		delete job;
+
+		if (counter == nullptr)
+		{
+			if (error != nullptr)
+			{
+				try
+				{
+					std::rethrow_exception(error);
+				}
+				catch (const std::exception& exception)
+				{
+					std::cerr << "Unhandled exception in job : " << exception.what() << std::endl;
+				}
+			}
+			return;
+		}
+
+		std::vector<Job*> continuations;
+		{
+			std::lock_guard<std::mutex> lock(counter->m_mutex);
+			if (error != nullptr && counter->m_error == nullptr)
+				counter->m_error = error;
+			if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				continuations.swap(counter->m_continuations);
+		}
+
+		for (Job* continuation : continuations)
+			Enqueue(continuation);
+	}
+
+	void JobScheduler::WorkerLoop(uint32_t workerIndex)
+	{
+		t_scheduler = this;
+		t_workerIndex = workerIndex;
+		PROFILE_THREAD_NAME("Worker " + std::to_string(workerIndex));
+
+		uint32_t idleRounds = 0;
+		while (!m_stopping.load(std::memory_order_acquire))
+		{
+			if (TryRunOneJob(workerIndex))
+			{
+				idleRounds = 0;
+				continue;
+			}
+
+			idleRounds++;
+			if (idleRounds < SPINS_BEFORE_YIELD)
+				continue;
+			if (idleRounds < SPINS_BEFORE_YIELD + YIELDS_BEFORE_SLEEP)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			m_sleepingWorkers.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			{
+				std::unique_lock<std::mutex> lock(m_sleepMutex);
+				bool hasWork = false;
+				{
+					std::lock_guard<std::mutex> queueLock(m_queueMutex);
+					hasWork = !m_externalJobs.empty();
+				}
+				for (const auto& deque : m_deques)
+					hasWork |= !deque->Empty();
+
+				// The timeout only guards against a missed notification, it is not needed for correctness
+				if (!hasWork && !m_stopping)
+					m_sleepCondition.wait_for(lock, std::chrono::milliseconds(10));
+			}
+			m_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+			idleRounds = 0;
+		}
+
+		t_scheduler = nullptr;
+		t_workerIndex = INVALID_WORKER;
+	}
+
+	bool JobScheduler::RunSelfTest()
+	{
+		bool success = true;
+		auto check = [&](bool condition, const char* name)
+		{
+			if (!condition)
+				std::cerr << "Job scheduler self test failed : " << name << std::endl;
+			success &= condition;
+		};
+
+		// Owner only : LIFO order and growth past the initial capacity
+		{
+			WorkStealingDeque deque(16);
+			std::vector<Job> jobs(1000);
+			for (auto& job : jobs)
+				deque.Push(&job);
+
+			bool ordered = true;
+			for (size_t i = jobs.size(); i-- > 0;)
+				ordered &= deque.Pop() == &jobs[i];
+			check(ordered && deque.Pop() == nullptr && deque.Empty(), "deque LIFO order");
+		}
+
+		// Owner pushing and popping against concurrent thieves : every job is taken exactly once
+		{
+			constexpr size_t jobCount = 200000;
+			WorkStealingDeque deque(64);
+			std::vector<Job> jobs(jobCount);
+			std::vector<std::atomic<uint32_t>> taken(jobCount);
+			std::atomic<bool> ownerDone = false;
+
+			auto take = [&](Job* job) { taken[job - jobs.data()].fetch_add(1, std::memory_order_relaxed); };
+
+			std::vector<std::thread> thieves;
+			for (int i = 0; i < 3; i++)
+			{
+				thieves.emplace_back([&]() {
+					while (!ownerDone.load() || !deque.Empty())
+						if (Job* job = deque.Steal())
+							take(job);
+				});
+			}
+
+			for (size_t i = 0; i < jobCount; i++)
+			{
+				deque.Push(&jobs[i]);
+				if (i % 3 == 0)
+					if (Job* job = deque.Pop())
+						take(job);
+			}
+			while (Job* job = deque.Pop())
+				take(job);
+			ownerDone = true;
+			for (auto& thief : thieves)
+				thief.join();
+
+			bool exactlyOnce = true;
+			for (auto& count : taken)
+				exactlyOnce &= count.load() == 1;
+			check(exactlyOnce, "deque concurrent steals");
+		}
+
+		JobScheduler scheduler(4);
+
+		// Counters reach zero only once every job ran
+		{
+			std::atomic<uint32_t> sum = 0;
+			JobCounter counter;
+			for (uint32_t i = 0; i < 10000; i++)
+				scheduler.Schedule([&sum]() { sum.fetch_add(1, std::memory_order_relaxed); }, &counter);
+			scheduler.Wait(counter);
+			check(sum.load() == 10000 && counter.IsDone(), "job counters");
+		}
+
+		// Dependent jobs never start before their dependency is done
+		{
+			std::atomic<uint32_t> firstStage = 0, secondStage = 0, orderViolations = 0;
+			JobCounter first, second;
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				scheduler.Schedule([&]() {
+					std::this_thread::yield();
+					firstStage.fetch_add(1);
+				}, &first);
+			}
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				scheduler.Schedule([&]() {
+					if (firstStage.load() != 256)
+						orderViolations.fetch_add(1);
+					secondStage.fetch_add(1);
+				}, &second, &first);
+			}
+			scheduler.Wait(second);
+			check(orderViolations.load() == 0 && secondStage.load() == 256, "job dependencies");
+		}
+
+		// Jobs waiting on their own children keep the workers busy instead of blocking them
+		{
+			std::function<uint64_t(uint32_t)> sumTree = [&](uint32_t depth) -> uint64_t {
+				if (depth == 0)
+					return 1;
+
+				uint64_t left = 0, right = 0;
+				JobCounter children;
+				scheduler.Schedule([&]() { left = sumTree(depth - 1); }, &children);
+				scheduler.Schedule([&]() { right = sumTree(depth - 1); }, &children);
+				scheduler.Wait(children);
+				return left + right;
+			};
+
+			uint64_t leaves = 0;
+			JobCounter root;
+			scheduler.Schedule([&]() { leaves = sumTree(12); }, &root);
+			scheduler.Wait(root);
+			check(leaves == 4096, "nested jobs");
+		}
+
+		// Main thread jobs only ever run on the main thread, even when scheduled from workers
+		{
+			std::atomic<uint32_t> wrongThread = 0, ran = 0;
+			std::thread::id mainThread = std::this_thread::get_id();
+			JobCounter counter;
+			for (uint32_t i = 0; i < 64; i++)
+			{
+				scheduler.Schedule([&]() {
+					scheduler.ScheduleOnMainThread([&]() {
+						if (std::this_thread::get_id() != mainThread)
+							wrongThread.fetch_add(1);
+						ran.fetch_add(1);
+					}, &counter);
+				}, &counter);
+			}
+			scheduler.Wait(counter);
+			check(wrongThread.load() == 0 && ran.load() == 64, "main thread affinity");
+		}
+
+		// Exceptions are rethrown by the waiter
+		{
+			JobCounter counter;
+			scheduler.Schedule([]() { throw std::runtime_error("Expected job failure !"); }, &counter);
+			bool rethrown = false;
+			try
+			{
+				scheduler.Wait(counter);
+			}
+			catch (const std::runtime_error&)
+			{
+				rethrown = true;
+			}
+			check(rethrown, "exception propagation");
+		}
+
+		// Parallel for covers every index exactly once
+		{
+			std::vector<std::atomic<uint32_t>> visits(100003);
+			scheduler.ParallelFor(visits.size(), 1000, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+					visits[i].fetch_add(1, std::memory_order_relaxed);
+			});
+
+			bool exactlyOnce = true;
+			for (auto& count : visits)
+				exactlyOnce &= count.load() == 1;
+			check(exactlyOnce, "parallel for");
+		}
+
+		if (success)
+			std::cout << "Job scheduler self test passed" << std::endl;
+		return success;
+	}
+
+	void JobScheduler::RunBenchmark()
+	{
+		std::vector<uint32_t> workerCounts = { 1, 2, 4 };
+		uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		if (hardwareThreads > 4)
+			workerCounts.push_back(hardwareThreads);
+
+		auto report = [](const char* name, uint32_t workerCount, const JobSchedulerStats& stats, double seconds)
+		{
+			double stealRate = stats.executedJobs > 0 ? static_cast<double>(stats.successfulSteals) / static_cast<double>(stats.executedJobs) : 0.0;
+			std::cout << std::left << std::setw(8) << name << " workers " << std::setw(3) << workerCount
+				<< " jobs " << std::setw(9) << stats.executedJobs
+				<< " jobs/s " << std::setw(12) << static_cast<uint64_t>(static_cast<double>(stats.executedJobs) / seconds)
+				<< " steal rate " << std::fixed << std::setprecision(3) << stealRate
+				<< " steal attempts " << stats.stealAttempts << std::endl;
+		};
+
+		for (uint32_t workerCount : workerCounts)
+		{
+			JobScheduler scheduler(workerCount);
+
+			// Flat : the main thread produces every job, the other workers can only get work by stealing
+			{
+				constexpr uint32_t jobCount = 1000000;
+				std::atomic<uint64_t> sink = 0;
+				JobCounter counter;
+
+				scheduler.ResetStats();
+				auto start = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; i < jobCount; i++)
+					scheduler.Schedule([&sink, i]() { sink.fetch_add(i, std::memory_order_relaxed); }, &counter);
+				scheduler.Wait(counter);
+				double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+				report("flat", workerCount, scheduler.GetStats(), seconds);
+			}
+
+			// Nested : binary job tree, work is spawned everywhere as in a recursive culling pass
+			{
+				std::function<void(uint32_t)> spawn = [&](uint32_t depth) {
+					if (depth == 0)
+						return;
+					JobCounter children;
+					scheduler.Schedule([&, depth]() { spawn(depth - 1); }, &children);
+					scheduler.Schedule([&, depth]() { spawn(depth - 1); }, &children);
+					scheduler.Wait(children);
+				};
+
+				scheduler.ResetStats();
+				auto start = std::chrono::high_resolution_clock::now();
+				JobCounter root;
+				scheduler.Schedule([&]() { spawn(18); }, &root);
+				scheduler.Wait(root);
+				double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+				report("nested", workerCount, scheduler.GetStats(), seconds);
+			}
+		}
+	}
+}
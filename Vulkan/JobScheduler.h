@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Engine
+{
+	class JobCounter;
+
+	struct Job
+	{
+		std::function<void()> function;
+		JobCounter* counter = nullptr;
+		bool mainThreadOnly = false;
+	};
+
+	// Counts unfinished jobs. Jobs scheduled with a dependency on a counter only start once it drops to zero
+	class JobCounter
+	{
+	public:
+		JobCounter() = default;
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool IsDone() const { return m_value.load(std::memory_order_acquire) == 0; }
+		uint32_t Value() const { return m_value.load(std::memory_order_acquire); }
+
+	private:
+		friend class JobScheduler;
+
+		std::atomic<uint32_t> m_value = 0;
+		std::mutex m_mutex;
+		std::vector<Job*> m_continuations;
+		std::exception_ptr m_error;
+	};
+
+	// Chase-Lev work stealing deque (Le et al. 2013). The owner pushes and pops at the bottom, thieves steal from the top
+	class WorkStealingDeque
+	{
+	public:
+		WorkStealingDeque(int64_t capacity = 1024);
+		~WorkStealingDeque();
+
+		WorkStealingDeque(const WorkStealingDeque&) = delete;
+		WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+		void Push(Job* job);
+		Job* Pop();
+		Job* Steal();
+		bool Empty() const;
+
+	private:
+		struct Buffer
+		{
+			Buffer(int64_t capacity) : capacity(capacity), mask(capacity - 1), jobs(new std::atomic<Job*>[capacity]) {}
+
+			Job* Get(int64_t index) const { return jobs[index & mask].load(std::memory_order_acquire); }
+			void Put(int64_t index, Job* job) { jobs[index & mask].store(job, std::memory_order_release); }
+
+			int64_t capacity;
+			int64_t mask;
+			std::unique_ptr<std::atomic<Job*>[]> jobs;
+		};
+
+		Buffer* Grow(Buffer* buffer, int64_t bottom, int64_t top);
+
+	private:
+		alignas(64) std::atomic<int64_t> m_top = 0;
+		alignas(64) std::atomic<int64_t> m_bottom = 0;
+		alignas(64) std::atomic<Buffer*> m_buffer;
+
+		// Thieves may still read from a replaced buffer, they are only released with the deque
+		std::vector<std::unique_ptr<Buffer>> m_buffers;
+	};
+
+	struct JobSchedulerStats
+	{
+		uint64_t executedJobs = 0;
+		uint64_t stealAttempts = 0;
+		uint64_t successfulSteals = 0;
+	};
+
+	class JobScheduler
+	{
+	public:
+		// workerCount includes the main thread, 0 picks one worker per hardware thread
+		JobScheduler(uint32_t workerCount = 0);
+		~JobScheduler();
+
+		JobScheduler(const JobScheduler&) = delete;
+		JobScheduler& operator=(const JobScheduler&) = delete;
+
+		void Schedule(std::function<void()> function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+		void ScheduleOnMainThread(std::function<void()> function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+		// Splits [0, count) into batches of batchSize and runs them as jobs, returns once every batch is done
+		void ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& function);
+
+		// Runs other jobs while waiting, so it never deadlocks when called from a job
+		void Wait(JobCounter& counter);
+		// Runs the jobs that must execute on the main thread (GLFW calls, ...)
+		void PumpMainThread();
+
+		uint32_t WorkerCount() const { return m_workerCount; }
+		static uint32_t CurrentWorkerIndex();
+		bool IsMainThread() const { return std::this_thread::get_id() == m_mainThreadId; }
+
+		JobSchedulerStats GetStats() const;
+		void ResetStats();
+
+		// CPU only checks and benchmark, usable on machines without a GPU
+		static bool RunSelfTest();
+		static void RunBenchmark();
+
+	private:
+		void Submit(Job* job, JobCounter* dependency);
+		void Enqueue(Job* job);
+		bool TryRunOneJob(uint32_t workerIndex);
+		Job* FindJob(uint32_t workerIndex);
+		void Execute(Job* job, uint32_t workerIndex);
+		void WorkerLoop(uint32_t workerIndex);
+
+	private:
+		struct alignas(64) WorkerStats
+		{
+			std::atomic<uint64_t> executedJobs = 0;
+			std::atomic<uint64_t> stealAttempts = 0;
+			std::atomic<uint64_t> successfulSteals = 0;
+		};
+
+		uint32_t m_workerCount;
+		std::thread::id m_mainThreadId;
+		std::vector<std::unique_ptr<WorkStealingDeque>> m_deques;
+		std::vector<std::unique_ptr<WorkerStats>> m_workerStats;
+		std::vector<std::thread> m_threads;
+
+		// Jobs pushed from threads which are not workers, and main thread only jobs
+		std::mutex m_queueMutex;
+		std::deque<Job*> m_externalJobs;
+		std::deque<Job*> m_mainThreadJobs;
+
+		std::mutex m_sleepMutex;
+		std::condition_variable m_sleepCondition;
+		std::atomic<uint32_t> m_sleepingWorkers = 0;
+		std::atomic<bool> m_stopping = false;
+	};
+}
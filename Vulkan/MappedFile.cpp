@@ -0,0 +1,101 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Engine
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& path)
+		: m_path(path)
+	{
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Failed to open file " + path + " !");
+		m_file = file;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			throw std::runtime_error("Failed to get the size of " + path + " !");
+		}
+		m_size = static_cast<size_t>(size.QuadPart);
+		// Empty files cannot be mapped, they are simply empty
+		if (m_size == 0)
+			return;
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map file " + path + " !");
+		}
+		m_mapping = mapping;
+
+		m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (m_data == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map file " + path + " !");
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_data != nullptr)
+			UnmapViewOfFile(m_data);
+		if (m_mapping != nullptr)
+			CloseHandle(m_mapping);
+		CloseHandle(m_file);
+	}
+#else
+	MappedFile::MappedFile(const std::string& path)
+		: m_path(path)
+	{
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			throw std::runtime_error("Failed to open file " + path + " !");
+
+		struct stat status;
+		if (fstat(file, &status) != 0)
+		{
+			close(file);
+			throw std::runtime_error("Failed to get the size of " + path + " !");
+		}
+		m_size = static_cast<size_t>(status.st_size);
+		if (m_size == 0)
+		{
+			close(file);
+			return;
+		}
+
+		// The mapping keeps its own reference to the file, the descriptor is not needed past this point
+		void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		if (data == MAP_FAILED)
+			throw std::runtime_error("Failed to map file " + path + " !");
+
+		// Assets are read front to back once, let the kernel read ahead
+		madvise(data, m_size, MADV_SEQUENTIAL);
+		m_data = static_cast<const uint8_t*>(data);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_data != nullptr)
+			munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+#endif
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Engine
+{
+	// Read only memory mapping of a whole file, pages are loaded by the OS on first access and never copied into the process heap
+	class MappedFile
+	{
+	public:
+		MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const uint8_t* GetData() const { return m_data; }
+		size_t GetSize() const { return m_size; }
+		const std::string& GetPath() const { return m_path; }
+
+	private:
+		std::string m_path;
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+}
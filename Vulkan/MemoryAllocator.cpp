@@ -0,0 +1,322 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace Engine
+{
+	MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice)
+		: m_device(device)
+	{
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+		m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+		m_dedicatedCounts.resize(m_memoryProperties.memoryTypeCount, 0);
+		m_dedicatedBytes.resize(m_memoryProperties.memoryTypeCount, 0);
+
+		for (uint32_t i = 0; i < m_pools.size(); i++)
+		{
+			uint32_t memoryTypeIndex = i / 2;
+			VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+
+			// Small heaps (e.g. the 256MB BAR heap) get smaller blocks so a single block never eats a large part of them
+			VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE;
+			while (blockSize > MIN_ALLOCATION_SIZE && blockSize > heapSize / 8)
+				blockSize /= 2;
+
+			m_pools[i].memoryTypeIndex = memoryTypeIndex;
+			m_pools[i].blockSize = blockSize;
+		}
+	}
+
+	MemoryAllocator::~MemoryAllocator()
+	{
+		for (auto& pool : m_pools)
+		{
+			for (auto& block : pool.blocks)
+			{
+				if (!block->allocatedLevels.empty())
+					std::cerr << "Memory allocator destroyed with " << block->allocatedLevels.size() << " live allocations !" << std::endl;
+				DestroyBlock(*block);
+			}
+		}
+	}
+
+	MemoryAllocation MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linearResource)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		uint32_t memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
+		uint32_t poolIndex = memoryTypeIndex * 2 + (linearResource ? 0 : 1);
+		Pool& pool = m_pools[poolIndex];
+
+		// Buddy nodes are aligned on their own size, so rounding up to the alignment is enough to satisfy it
+		VkDeviceSize size = std::max({ requirements.size, requirements.alignment, MIN_ALLOCATION_SIZE });
+		if (size > pool.blockSize / 2)
+			return AllocateDedicated(requirements.size, memoryTypeIndex);
+
+		MemoryAllocation allocation;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.size = requirements.size;
+
+		for (auto& block : pool.blocks)
+		{
+			if (AllocateFromBlock(*block, size, allocation.offset))
+			{
+				allocation.block = block.get();
+				break;
+			}
+		}
+
+		if (allocation.block == nullptr)
+		{
+			MemoryBlock* block = CreateBlock(poolIndex);
+			if (!AllocateFromBlock(*block, size, allocation.offset))
+				throw std::runtime_error("Failed to sub-allocate memory from a new block !");
+			allocation.block = block;
+		}
+
+		allocation.memory = allocation.block->memory;
+		if (allocation.block->mappedData != nullptr)
+			allocation.mappedData = static_cast<char*>(allocation.block->mappedData) + allocation.offset;
+		return allocation;
+	}
+
+	void MemoryAllocator::Free(MemoryAllocation& allocation)
+	{
+		if (allocation.memory == VK_NULL_HANDLE)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (allocation.block == nullptr)
+		{
+			if (allocation.mappedData != nullptr)
+				vkUnmapMemory(m_device, allocation.memory);
+			vkFreeMemory(m_device, allocation.memory, nullptr);
+			m_dedicatedCounts[allocation.memoryTypeIndex]--;
+			m_dedicatedBytes[allocation.memoryTypeIndex] -= allocation.size;
+		}
+		else
+		{
+			FreeFromBlock(*allocation.block, allocation.offset);
+		}
+		allocation = {};
+	}
+
+	void MemoryAllocator::Defragment()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& pool : m_pools)
+		{
+			// Fill the densest blocks first so sparse ones drain and can be released
+			std::stable_sort(pool.blocks.begin(), pool.blocks.end(), [](const auto& lhs, const auto& rhs) { return lhs->usedBytes > rhs->usedBytes; });
+
+			// Keep one empty block around to avoid allocate/free thrashing at the edge of a block
+			bool keptEmptyBlock = false;
+			for (auto it = pool.blocks.begin(); it != pool.blocks.end();)
+			{
+				if (!(*it)->allocatedLevels.empty() || !keptEmptyBlock)
+				{
+					keptEmptyBlock |= (*it)->allocatedLevels.empty();
+					++it;
+					continue;
+				}
+				DestroyBlock(**it);
+				it = pool.blocks.erase(it);
+			}
+		}
+	}
+
+	MemoryStats MemoryAllocator::GetStats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		MemoryStats stats;
+		for (const auto& pool : m_pools)
+			AccumulateStats(pool, stats);
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+		{
+			stats.dedicatedAllocationCount += m_dedicatedCounts[i];
+			stats.allocationCount += m_dedicatedCounts[i];
+			stats.reservedBytes += m_dedicatedBytes[i];
+			stats.usedBytes += m_dedicatedBytes[i];
+		}
+		return stats;
+	}
+
+	MemoryStats MemoryAllocator::GetStats(uint32_t memoryTypeIndex)
+	{
+		assert(memoryTypeIndex < m_memoryProperties.memoryTypeCount && "Invalid memory type index !");
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		MemoryStats stats;
+		AccumulateStats(m_pools[memoryTypeIndex * 2], stats);
+		AccumulateStats(m_pools[memoryTypeIndex * 2 + 1], stats);
+		stats.dedicatedAllocationCount = m_dedicatedCounts[memoryTypeIndex];
+		stats.allocationCount += m_dedicatedCounts[memoryTypeIndex];
+		stats.reservedBytes += m_dedicatedBytes[memoryTypeIndex];
+		stats.usedBytes += m_dedicatedBytes[memoryTypeIndex];
+		return stats;
+	}
+
+	void MemoryAllocator::PrintStats()
+	{
+		std::cout << "GPU memory :" << std::endl;
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+		{
+			MemoryStats stats = GetStats(i);
+			if (stats.reservedBytes == 0)
+				continue;
+
+			std::cout << "\tType " << i << " : " << stats.allocationCount << " allocations in " << stats.blockCount << " blocks (+" << stats.dedicatedAllocationCount << " dedicated), "
+				<< stats.usedBytes / 1024 << " KB used / " << stats.reservedBytes / 1024 << " KB reserved, largest free range " << stats.largestFreeRange / 1024 << " KB" << std::endl;
+		}
+	}
+
+	uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+	{
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+			if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+				return i;
+		throw std::runtime_error("Failed to find suitable memory type !");
+	}
+
+	MemoryAllocation MemoryAllocator::AllocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex)
+	{
+		MemoryAllocation allocation;
+		allocation.size = size;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		if (vkAllocateMemory(m_device, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate dedicated memory !");
+
+		if (IsHostVisible(memoryTypeIndex) && vkMapMemory(m_device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mappedData) != VK_SUCCESS)
+			throw std::runtime_error("Failed to map dedicated memory !");
+
+		m_dedicatedCounts[memoryTypeIndex]++;
+		m_dedicatedBytes[memoryTypeIndex] += size;
+		return allocation;
+	}
+
+	MemoryBlock* MemoryAllocator::CreateBlock(uint32_t poolIndex)
+	{
+		Pool& pool = m_pools[poolIndex];
+		auto block = std::make_unique<MemoryBlock>();
+		block->size = pool.blockSize;
+		block->poolIndex = poolIndex;
+
+		block->levelCount = 1;
+		while ((block->size >> block->levelCount) >= MIN_ALLOCATION_SIZE)
+			block->levelCount++;
+		block->freeLists.resize(block->levelCount);
+		block->freeLists[0].insert(0);
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block->size;
+		allocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+		if (vkAllocateMemory(m_device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate memory block !");
+
+		// Host visible blocks stay persistently mapped : a VkDeviceMemory can only be mapped once, whatever the sub-allocation
+		if (IsHostVisible(pool.memoryTypeIndex) && vkMapMemory(m_device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mappedData) != VK_SUCCESS)
+			throw std::runtime_error("Failed to map memory block !");
+
+		pool.blocks.push_back(std::move(block));
+		return pool.blocks.back().get();
+	}
+
+	bool MemoryAllocator::AllocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize& offset)
+	{
+		if (size > block.size)
+			return false;
+
+		uint32_t level = 0;
+		while (level + 1 < block.levelCount && (block.size >> (level + 1)) >= size)
+			level++;
+
+		int32_t freeLevel = static_cast<int32_t>(level);
+		while (freeLevel >= 0 && block.freeLists[freeLevel].empty())
+			freeLevel--;
+		if (freeLevel < 0)
+			return false;
+
+		// Lowest offset first keeps live allocations packed at the start of the block
+		VkDeviceSize nodeOffset = *block.freeLists[freeLevel].begin();
+		block.freeLists[freeLevel].erase(block.freeLists[freeLevel].begin());
+
+		// Split the node down to the requested level, the upper halves become free buddies
+		for (uint32_t i = static_cast<uint32_t>(freeLevel); i < level; i++)
+			block.freeLists[i + 1].insert(nodeOffset + (block.size >> (i + 1)));
+
+		block.allocatedLevels[nodeOffset] = level;
+		block.usedBytes += block.size >> level;
+		offset = nodeOffset;
+		return true;
+	}
+
+	void MemoryAllocator::FreeFromBlock(MemoryBlock& block, VkDeviceSize offset)
+	{
+		auto it = block.allocatedLevels.find(offset);
+		assert(it != block.allocatedLevels.end() && "Freeing an allocation that does not belong to this block !");
+
+		uint32_t level = it->second;
+		block.allocatedLevels.erase(it);
+		block.usedBytes -= block.size >> level;
+
+		// Merge with the buddy as long as it is free
+		while (level > 0)
+		{
+			VkDeviceSize buddy = offset ^ (block.size >> level);
+			auto buddyIt = block.freeLists[level].find(buddy);
+			if (buddyIt == block.freeLists[level].end())
+				break;
+
+			block.freeLists[level].erase(buddyIt);
+			offset = std::min(offset, buddy);
+			level--;
+		}
+		block.freeLists[level].insert(offset);
+	}
+
+	void MemoryAllocator::DestroyBlock(MemoryBlock& block)
+	{
+		if (block.mappedData != nullptr)
+			vkUnmapMemory(m_device, block.memory);
+		vkFreeMemory(m_device, block.memory, nullptr);
+		block.memory = VK_NULL_HANDLE;
+		block.mappedData = nullptr;
+	}
+
+	void MemoryAllocator::AccumulateStats(const Pool& pool, MemoryStats& stats)
+	{
+		for (const auto& block : pool.blocks)
+		{
+			stats.blockCount++;
+			stats.allocationCount += static_cast<uint32_t>(block->allocatedLevels.size());
+			stats.reservedBytes += block->size;
+			stats.usedBytes += block->usedBytes;
+
+			for (uint32_t level = 0; level < block->levelCount; level++)
+			{
+				if (!block->freeLists[level].empty())
+				{
+					stats.largestFreeRange = std::max(stats.largestFreeRange, block->size >> level);
+					break;
+				}
+			}
+		}
+	}
+
+	bool MemoryAllocator::IsHostVisible(uint32_t memoryTypeIndex)
+	{
+		return (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	}
+}
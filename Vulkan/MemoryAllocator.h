@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine
+{
+	struct MemoryBlock;
+
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* mappedData = nullptr;
+
+		// Owning block, nullptr for dedicated allocations
+		MemoryBlock* block = nullptr;
+		uint32_t memoryTypeIndex = 0;
+	};
+
+	struct MemoryStats
+	{
+		uint32_t blockCount = 0;
+		uint32_t dedicatedAllocationCount = 0;
+		uint32_t allocationCount = 0;
+		VkDeviceSize reservedBytes = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize largestFreeRange = 0;
+	};
+
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* mappedData = nullptr;
+		uint32_t poolIndex = 0;
+		uint32_t levelCount = 0;
+
+		// Buddy allocator state : one free list per level (level 0 is the whole block), and the level of every live allocation
+		std::vector<std::set<VkDeviceSize>> freeLists;
+		std::unordered_map<VkDeviceSize, uint32_t> allocatedLevels;
+		VkDeviceSize usedBytes = 0;
+	};
+
+	class MemoryAllocator
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+		static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+
+		MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+		~MemoryAllocator();
+
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+		MemoryAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linearResource);
+		void Free(MemoryAllocation& allocation);
+		void Defragment();
+
+		MemoryStats GetStats();
+		MemoryStats GetStats(uint32_t memoryTypeIndex);
+		void PrintStats();
+
+	private:
+		struct Pool
+		{
+			uint32_t memoryTypeIndex = 0;
+			VkDeviceSize blockSize = 0;
+			std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		};
+
+		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		MemoryAllocation AllocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex);
+		MemoryBlock* CreateBlock(uint32_t poolIndex);
+		bool AllocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize& offset);
+		void FreeFromBlock(MemoryBlock& block, VkDeviceSize offset);
+		void DestroyBlock(MemoryBlock& block);
+		void AccumulateStats(const Pool& pool, MemoryStats& stats);
+		bool IsHostVisible(uint32_t memoryTypeIndex);
+
+	private:
+		VkDevice m_device;
+		VkPhysicalDeviceMemoryProperties m_memoryProperties;
+		std::mutex m_mutex;
+
+		// Linear (buffers) and optimal (images) resources live in separate pools so bufferImageGranularity never applies
+		std::vector<Pool> m_pools;
+		std::vector<uint32_t> m_dedicatedCounts;
+		std::vector<VkDeviceSize> m_dedicatedBytes;
+	};
+}
@@ -0,0 +1,224 @@
+#include "MeshAsset.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace Engine
+{
+	namespace
+	{
+		uint64_t AlignUp(uint64_t value)
+		{
+			return (value + MeshAsset::ALIGNMENT - 1) / MeshAsset::ALIGNMENT * MeshAsset::ALIGNMENT;
+		}
+
+		void WritePadded(std::ofstream& file, const void* data, uint64_t size, uint64_t& position)
+		{
+			static const char padding[MeshAsset::ALIGNMENT] = {};
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+			position += size;
+			uint64_t aligned = AlignUp(position);
+			file.write(padding, static_cast<std::streamsize>(aligned - position));
+			position = aligned;
+		}
+	}
+
+	MeshAsset::MeshAsset(const std::string& path)
+		: m_file(path)
+	{
+		PROFILE_FUNCTION();
+		if (m_file.GetSize() < sizeof(MeshFileHeader))
+			throw std::runtime_error("Mesh file " + path + " is too small !");
+		m_header = reinterpret_cast<const MeshFileHeader*>(m_file.GetData());
+		Validate();
+	}
+
+	void MeshAsset::Validate() const
+	{
+		const MeshFileHeader& header = *m_header;
+		const std::string& path = m_file.GetPath();
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+			throw std::runtime_error(path + " is not a mesh file !");
+		if (header.version != VERSION)
+			throw std::runtime_error("Mesh file " + path + " has version " + std::to_string(header.version) + ", expected " + std::to_string(VERSION) + " !");
+		if (header.vertexStride != sizeof(Model::PackedVertex))
+			throw std::runtime_error("Mesh file " + path + " uses another vertex format !");
+		if (header.indexSize != sizeof(uint16_t) && header.indexSize != sizeof(uint32_t))
+			throw std::runtime_error("Mesh file " + path + " has an invalid index size !");
+		if (header.vertexCount < 3 || header.indexCount == 0 || header.indexCount % 3 != 0 || header.lodCount == 0)
+			throw std::runtime_error("Mesh file " + path + " has no triangles !");
+
+		// Blobs must be aligned and inside the file, computed in 64 bits so no count can overflow them
+		auto checkBlob = [&](uint64_t offset, uint64_t size)
+		{
+			if (offset % ALIGNMENT != 0 || offset < sizeof(MeshFileHeader) || offset + size > m_file.GetSize())
+				throw std::runtime_error("Mesh file " + path + " is truncated or corrupted !");
+		};
+		checkBlob(header.lodOffset, static_cast<uint64_t>(header.lodCount) * sizeof(MeshLod));
+		checkBlob(header.vertexOffset, static_cast<uint64_t>(header.vertexCount) * header.vertexStride);
+		checkBlob(header.indexOffset, static_cast<uint64_t>(header.indexCount) * header.indexSize);
+
+		for (uint32_t i = 0; i < header.lodCount; i++)
+		{
+			const MeshLod& lod = GetLods()[i];
+			if (lod.indexCount % 3 != 0 || static_cast<uint64_t>(lod.firstIndex) + lod.indexCount > header.indexCount)
+				throw std::runtime_error("Mesh file " + path + " has an invalid LOD !");
+		}
+
+		// Out of range indices would read past the vertex buffer on the GPU, checked in every build since files may be corrupt
+		// or hostile. Streamed meshes pay for this pass on the loader workers, off the render thread
+		uint32_t maxIndex = 0;
+		if (header.indexSize == sizeof(uint16_t))
+		{
+			const uint16_t* indices = static_cast<const uint16_t*>(GetIndices());
+			for (uint32_t i = 0; i < header.indexCount; i++)
+				maxIndex = std::max<uint32_t>(maxIndex, indices[i]);
+		}
+		else
+		{
+			const uint32_t* indices = static_cast<const uint32_t*>(GetIndices());
+			for (uint32_t i = 0; i < header.indexCount; i++)
+				maxIndex = std::max(maxIndex, indices[i]);
+		}
+		if (maxIndex >= header.vertexCount)
+			throw std::runtime_error("Mesh file " + path + " has an out of range index !");
+	}
+
+	Model::PositionDecode MeshAsset::GetPositionDecode() const
+	{
+		Model::PositionDecode decode;
+		decode.scale = { m_header->decodeScale[0], m_header->decodeScale[1] };
+		decode.offset = { m_header->decodeOffset[0], m_header->decodeOffset[1] };
+		return decode;
+	}
+
+	void MeshAsset::Write(const std::string& path, std::vector<Model::Vertex> vertices, std::vector<uint32_t> indices, bool generateLods)
+	{
+		PROFILE_FUNCTION();
+		MeshOptimizer::Optimize(vertices, indices);
+		if (vertices.size() < 3 || indices.empty())
+			throw std::runtime_error("Cannot write a mesh without triangles to " + path + " !");
+
+		// Simplified from the full precision positions, the LODs share the vertices of LOD 0
+		std::vector<MeshLod> lods = { { 0, static_cast<uint32_t>(indices.size()), 0.0f, 0 } };
+		if (generateLods)
+			lods = MeshOptimizer::BuildLodChain(vertices, indices);
+
+		glm::vec2 boundsMin = vertices[0].position;
+		glm::vec2 boundsMax = vertices[0].position;
+		for (const auto& vertex : vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
+
+		Model::PositionDecode decode = Model::PositionDecode::FromBounds(boundsMin, boundsMax);
+		std::vector<Model::PackedVertex> packedVertices(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+			packedVertices[i] = decode.Pack(vertices[i]);
+
+		// Same index width as Model picks for vertices given at runtime
+		std::vector<uint16_t> shortIndices;
+		bool useShortIndices = vertices.size() <= std::numeric_limits<uint16_t>::max() + 1u;
+		if (useShortIndices)
+			shortIndices.assign(indices.begin(), indices.end());
+
+		MeshFileHeader header = {};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.vertexCount = static_cast<uint32_t>(packedVertices.size());
+		header.vertexStride = sizeof(Model::PackedVertex);
+		header.indexCount = static_cast<uint32_t>(indices.size());
+		header.indexSize = useShortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+		header.lodCount = static_cast<uint32_t>(lods.size());
+		header.boundsMin[0] = boundsMin.x;
+		header.boundsMin[1] = boundsMin.y;
+		header.boundsMax[0] = boundsMax.x;
+		header.boundsMax[1] = boundsMax.y;
+		header.decodeScale[0] = decode.scale.x;
+		header.decodeScale[1] = decode.scale.y;
+		header.decodeOffset[0] = decode.offset.x;
+		header.decodeOffset[1] = decode.offset.y;
+		header.lodOffset = AlignUp(sizeof(MeshFileHeader));
+		header.vertexOffset = AlignUp(header.lodOffset + sizeof(MeshLod) * header.lodCount);
+		header.indexOffset = AlignUp(header.vertexOffset + static_cast<uint64_t>(header.vertexStride) * header.vertexCount);
+		header.fileSize = AlignUp(header.indexOffset + static_cast<uint64_t>(header.indexSize) * header.indexCount);
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open mesh file " + path + " for writing !");
+
+		uint64_t position = 0;
+		WritePadded(file, &header, sizeof(header), position);
+		WritePadded(file, lods.data(), lods.size() * sizeof(MeshLod), position);
+		WritePadded(file, packedVertices.data(), packedVertices.size() * sizeof(Model::PackedVertex), position);
+		if (useShortIndices)
+			WritePadded(file, shortIndices.data(), shortIndices.size() * sizeof(uint16_t), position);
+		else
+			WritePadded(file, indices.data(), indices.size() * sizeof(uint32_t), position);
+
+		if (!file.good() || position != header.fileSize)
+			throw std::runtime_error("Failed to write mesh file " + path + " !");
+	}
+
+	void MeshAsset::ConvertObj(const std::string& objPath, const std::string& meshPath)
+	{
+		PROFILE_FUNCTION();
+		std::ifstream file(objPath);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open OBJ file " + objPath + " !");
+
+		std::vector<Model::Vertex> positions;
+		std::vector<Model::Vertex> vertices;
+		std::string line;
+		size_t lineNumber = 0;
+		while (std::getline(file, line))
+		{
+			lineNumber++;
+			std::istringstream stream(line);
+			std::string keyword;
+			stream >> keyword;
+
+			if (keyword == "v")
+			{
+				float z;
+				Model::Vertex vertex = { { 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+				if (!(stream >> vertex.position.x >> vertex.position.y >> z))
+					throw std::runtime_error(objPath + ":" + std::to_string(lineNumber) + " : invalid vertex !");
+				glm::vec3 color;
+				if (stream >> color.x >> color.y >> color.z)
+					vertex.color = color;
+				positions.push_back(vertex);
+			}
+			else if (keyword == "f")
+			{
+				// "f v", "f v/vt", "f v//vn" or "f v/vt/vn", negative indices count back from the last vertex
+				std::vector<uint32_t> polygon;
+				std::string corner;
+				while (stream >> corner)
+				{
+					long index = std::stol(corner.substr(0, corner.find('/')));
+					long resolved = index < 0 ? static_cast<long>(positions.size()) + index : index - 1;
+					if (resolved < 0 || resolved >= static_cast<long>(positions.size()))
+						throw std::runtime_error(objPath + ":" + std::to_string(lineNumber) + " : face index out of range !");
+					polygon.push_back(static_cast<uint32_t>(resolved));
+				}
+
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					vertices.push_back(positions[polygon[0]]);
+					vertices.push_back(positions[polygon[i - 1]]);
+					vertices.push_back(positions[polygon[i]]);
+				}
+			}
+		}
+
+		// Identical corners are merged back by the optimizer
+		Write(meshPath, std::move(vertices), {});
+	}
+}
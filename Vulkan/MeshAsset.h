@@ -0,0 +1,75 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "Model.h"
+
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	// Little endian, every blob starts on a MeshAsset::ALIGNMENT boundary so it is copied straight from the mapping
+	struct MeshFileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t vertexCount;
+		// sizeof(Model::PackedVertex) when written, files with another vertex format are rejected
+		uint32_t vertexStride;
+		uint32_t indexCount;
+		// 2 or 4 bytes, as the model would pick on its own
+		uint32_t indexSize;
+		uint32_t lodCount;
+		uint32_t reserved;
+		float boundsMin[2];
+		float boundsMax[2];
+		float decodeScale[2];
+		float decodeOffset[2];
+		uint64_t lodOffset;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t fileSize;
+	};
+
+	// A mesh file mapped in memory. Vertices are stored already optimized and quantized, loading is a validation of the
+	// header and one copy per blob from the mapping to the staging ring
+	class MeshAsset
+	{
+	public:
+		static constexpr char MAGIC[4] = { 'V', 'K', 'M', 'S' };
+		static constexpr uint32_t VERSION = 1;
+		static constexpr uint64_t ALIGNMENT = 64;
+
+		// Throws if the file is not a valid mesh file
+		MeshAsset(const std::string& path);
+
+		MeshAsset(const MeshAsset&) = delete;
+		MeshAsset& operator=(const MeshAsset&) = delete;
+
+		const MeshFileHeader& GetHeader() const { return *m_header; }
+		const Model::PackedVertex* GetVertices() const { return reinterpret_cast<const Model::PackedVertex*>(m_file.GetData() + m_header->vertexOffset); }
+		const void* GetIndices() const { return m_file.GetData() + m_header->indexOffset; }
+		VkIndexType GetIndexType() const { return m_header->indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32; }
+		const MeshLod* GetLods() const { return reinterpret_cast<const MeshLod*>(m_file.GetData() + m_header->lodOffset); }
+		uint32_t GetLodCount() const { return m_header->lodCount; }
+
+		glm::vec2 GetBoundsMin() const { return { m_header->boundsMin[0], m_header->boundsMin[1] }; }
+		glm::vec2 GetBoundsMax() const { return { m_header->boundsMax[0], m_header->boundsMax[1] }; }
+		Model::PositionDecode GetPositionDecode() const;
+		size_t GetFileSize() const { return m_file.GetSize(); }
+
+		// Optimizes the mesh for the vertex cache and fetch, quantizes it and writes it with its LOD chain, or LOD 0 alone
+		static void Write(const std::string& path, std::vector<Model::Vertex> vertices, std::vector<uint32_t> indices, bool generateLods = true);
+		// Wavefront OBJ : x and y of the positions, vertex colors when present ("v x y z r g b"), white otherwise.
+		// Polygons are triangulated as fans, texture coordinates and normals are ignored
+		static void ConvertObj(const std::string& objPath, const std::string& meshPath);
+
+	private:
+		void Validate() const;
+
+	private:
+		MappedFile m_file;
+		const MeshFileHeader* m_header = nullptr;
+	};
+}
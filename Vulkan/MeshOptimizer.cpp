@@ -0,0 +1,862 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace Engine
+{
+	namespace MeshOptimizer
+	{
+		static constexpr uint32_t UNUSED_VERTEX = std::numeric_limits<uint32_t>::max();
+
+		static uint64_t HashBytes(const unsigned char* data, size_t size)
+		{
+			// FNV-1a
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= data[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		size_t GenerateVertexRemap(std::vector<uint32_t>& remap, const void* vertices, size_t vertexCount, size_t vertexSize)
+		{
+			const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+			std::unordered_multimap<uint64_t, uint32_t> uniqueByHash;
+			std::vector<uint32_t> firstOccurrence;
+
+			remap.assign(vertexCount, UNUSED_VERTEX);
+			uniqueByHash.reserve(vertexCount);
+
+			for (size_t i = 0; i < vertexCount; i++)
+			{
+				const unsigned char* vertex = bytes + i * vertexSize;
+				uint64_t hash = HashBytes(vertex, vertexSize);
+
+				auto range = uniqueByHash.equal_range(hash);
+				for (auto it = range.first; it != range.second; ++it)
+				{
+					if (memcmp(vertex, bytes + firstOccurrence[it->second] * vertexSize, vertexSize) == 0)
+					{
+						remap[i] = it->second;
+						break;
+					}
+				}
+
+				if (remap[i] == UNUSED_VERTEX)
+				{
+					remap[i] = static_cast<uint32_t>(firstOccurrence.size());
+					uniqueByHash.emplace(hash, remap[i]);
+					firstOccurrence.push_back(static_cast<uint32_t>(i));
+				}
+			}
+			return firstOccurrence.size();
+		}
+
+		void RemapVertices(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const std::vector<uint32_t>& remap)
+		{
+			assert(destination != vertices && "Vertices cannot be remapped in place !");
+
+			unsigned char* dst = static_cast<unsigned char*>(destination);
+			const unsigned char* src = static_cast<const unsigned char*>(vertices);
+			for (size_t i = 0; i < vertexCount; i++)
+				if (remap[i] != UNUSED_VERTEX)
+					memcpy(dst + remap[i] * vertexSize, src + i * vertexSize, vertexSize);
+		}
+
+		void RemapIndices(std::vector<uint32_t>& indices, const std::vector<uint32_t>& remap)
+		{
+			for (auto& index : indices)
+			{
+				assert(remap[index] != UNUSED_VERTEX && "Index references a removed vertex !");
+				index = remap[index];
+			}
+		}
+
+		size_t GenerateFetchRemap(std::vector<uint32_t>& remap, const std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			remap.assign(vertexCount, UNUSED_VERTEX);
+
+			uint32_t nextVertex = 0;
+			for (uint32_t index : indices)
+				if (remap[index] == UNUSED_VERTEX)
+					remap[index] = nextVertex++;
+			return nextVertex;
+		}
+
+		static int32_t SkipDeadEnd(const std::vector<uint32_t>& liveTriangles, std::vector<uint32_t>& deadEndStack, uint32_t& cursor, size_t vertexCount)
+		{
+			// Most recently referenced vertices first, they are likely still in the cache
+			while (!deadEndStack.empty())
+			{
+				uint32_t vertex = deadEndStack.back();
+				deadEndStack.pop_back();
+				if (liveTriangles[vertex] > 0)
+					return static_cast<int32_t>(vertex);
+			}
+
+			// Otherwise the next vertex in input order which still has triangles
+			while (cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+					return static_cast<int32_t>(cursor);
+				cursor++;
+			}
+			return -1;
+		}
+
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+		{
+			assert(indices.size() % 3 == 0 && "Index buffer must be a triangle list !");
+			size_t triangleCount = indices.size() / 3;
+			if (triangleCount == 0)
+				return;
+
+			// Vertex to triangle adjacency, stored as a compact CSR table
+			std::vector<uint32_t> liveTriangles(vertexCount, 0);
+			for (uint32_t index : indices)
+				liveTriangles[index]++;
+
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t i = 0; i < vertexCount; i++)
+				adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangles[i];
+
+			std::vector<uint32_t> adjacency(indices.size());
+			std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+				adjacency[fillOffsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+			std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> deadEndStack;
+			std::vector<uint32_t> candidates;
+			std::vector<uint32_t> output;
+			output.reserve(indices.size());
+
+			uint32_t timestamp = cacheSize + 1;
+			uint32_t cursor = 0;
+			int32_t fanningVertex = SkipDeadEnd(liveTriangles, deadEndStack, cursor, vertexCount);
+
+			while (fanningVertex >= 0)
+			{
+				candidates.clear();
+				for (uint32_t i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; i++)
+				{
+					uint32_t triangle = adjacency[i];
+					if (emitted[triangle])
+						continue;
+
+					for (uint32_t corner = 0; corner < 3; corner++)
+					{
+						uint32_t vertex = indices[triangle * 3 + corner];
+						output.push_back(vertex);
+						deadEndStack.push_back(vertex);
+						candidates.push_back(vertex);
+						liveTriangles[vertex]--;
+
+						if (timestamp - cacheTimestamps[vertex] > cacheSize)
+							cacheTimestamps[vertex] = timestamp++;
+					}
+					emitted[triangle] = true;
+				}
+
+				// Pick the candidate that will still be in the cache after its remaining triangles are emitted, the oldest one first
+				int32_t nextVertex = -1;
+				int32_t bestPriority = -1;
+				for (uint32_t vertex : candidates)
+				{
+					if (liveTriangles[vertex] == 0)
+						continue;
+
+					int32_t priority = 0;
+					if (timestamp - cacheTimestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+						priority = static_cast<int32_t>(timestamp - cacheTimestamps[vertex]);
+
+					if (priority > bestPriority)
+					{
+						bestPriority = priority;
+						nextVertex = static_cast<int32_t>(vertex);
+					}
+				}
+
+				if (nextVertex == -1)
+					nextVertex = SkipDeadEnd(liveTriangles, deadEndStack, cursor, vertexCount);
+				fanningVertex = nextVertex;
+			}
+
+			assert(output.size() == indices.size() && "Tipsify dropped triangles !");
+			indices.swap(output);
+		}
+
+		VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+		{
+			VertexCacheStats stats;
+			if (indices.empty())
+				return stats;
+
+			// FIFO cache simulation : a vertex is a hit if it entered the cache less than cacheSize misses ago
+			std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+			std::vector<bool> referenced(vertexCount, false);
+			uint32_t timestamp = cacheSize + 1;
+			size_t misses = 0;
+			size_t uniqueVertices = 0;
+
+			for (uint32_t index : indices)
+			{
+				if (timestamp - cacheTimestamps[index] > cacheSize)
+				{
+					cacheTimestamps[index] = timestamp++;
+					misses++;
+				}
+
+				if (!referenced[index])
+				{
+					referenced[index] = true;
+					uniqueVertices++;
+				}
+			}
+
+			stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+			stats.atvr = static_cast<float>(misses) / static_cast<float>(uniqueVertices);
+			return stats;
+		}
+
+		static void ComputeMeshletBounds(Meshlet& meshlet, const MeshletData& meshlets, const float* positions, size_t vertexStride, size_t positionComponents)
+		{
+			auto position = [&](uint32_t vertex, float out[3])
+			{
+				const float* source = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex * vertexStride);
+				out[0] = source[0];
+				out[1] = source[1];
+				out[2] = positionComponents > 2 ? source[2] : 0.0f;
+			};
+
+			// Sphere around the center of the bounding box, not minimal but cheap and within a few percent on compact meshlets
+			float boundsMin[3] = { INFINITY, INFINITY, INFINITY };
+			float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+			{
+				float p[3];
+				position(meshlets.vertices[meshlet.vertexOffset + i], p);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					boundsMin[axis] = std::min(boundsMin[axis], p[axis]);
+					boundsMax[axis] = std::max(boundsMax[axis], p[axis]);
+				}
+			}
+
+			float radiusSquared = 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+				meshlet.center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+			{
+				float p[3];
+				position(meshlets.vertices[meshlet.vertexOffset + i], p);
+				float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+				radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+			}
+			meshlet.radius = std::sqrt(radiusSquared);
+
+			// Cone axis is the average normal, its half angle reaches the normal furthest from it
+			std::vector<std::array<float, 3>> normals;
+			normals.reserve(meshlet.triangleCount);
+			float axis[3] = {};
+			for (uint32_t i = 0; i < meshlet.triangleCount; i++)
+			{
+				float a[3], b[3], c[3];
+				const uint8_t* triangle = &meshlets.triangles[(meshlet.triangleOffset + i) * 3];
+				position(meshlets.vertices[meshlet.vertexOffset + triangle[0]], a);
+				position(meshlets.vertices[meshlet.vertexOffset + triangle[1]], b);
+				position(meshlets.vertices[meshlet.vertexOffset + triangle[2]], c);
+
+				float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+				float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+				std::array<float, 3> normal = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+				float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				// Degenerate triangles are never rasterized, they do not constrain the cone
+				if (length == 0.0f)
+					continue;
+
+				for (int k = 0; k < 3; k++)
+				{
+					normal[k] /= length;
+					axis[k] += normal[k];
+				}
+				normals.push_back(normal);
+			}
+
+			float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+			if (normals.empty() || axisLength == 0.0f)
+				return;
+
+			float minDot = 1.0f;
+			for (int k = 0; k < 3; k++)
+				meshlet.coneAxis[k] = axis[k] / axisLength;
+			for (const auto& normal : normals)
+				minDot = std::min(minDot, normal[0] * meshlet.coneAxis[0] + normal[1] * meshlet.coneAxis[1] + normal[2] * meshlet.coneAxis[2]);
+
+			// Every normal faces away from d when the angle between the axis and d is below 90 degrees minus the cone half angle
+			if (minDot > 0.0f)
+				meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+
+		void BuildMeshlets(MeshletData& meshlets, const std::vector<uint32_t>& indices, const float* positions, size_t vertexCount, size_t vertexStride, size_t positionComponents,
+			size_t maxVertices, size_t maxTriangles)
+		{
+			assert(indices.size() % 3 == 0 && "Meshlets need a triangle list !");
+			assert(maxVertices >= 3 && maxVertices <= 256 && "Meshlet local indices are 8 bit !");
+			assert(maxTriangles >= 1 && "Meshlets need at least one triangle !");
+
+			meshlets.meshlets.clear();
+			meshlets.vertices.clear();
+			meshlets.triangles.clear();
+			if (indices.empty())
+				return;
+
+			// Local index of every mesh vertex in the meshlet being built
+			std::vector<uint32_t> localIndices(vertexCount, UNUSED_VERTEX);
+			Meshlet current;
+
+			auto closeMeshlet = [&]()
+			{
+				ComputeMeshletBounds(current, meshlets, positions, vertexStride, positionComponents);
+				for (uint32_t i = 0; i < current.vertexCount; i++)
+					localIndices[meshlets.vertices[current.vertexOffset + i]] = UNUSED_VERTEX;
+				meshlets.meshlets.push_back(current);
+
+				current = Meshlet();
+				current.vertexOffset = static_cast<uint32_t>(meshlets.vertices.size());
+				current.triangleOffset = static_cast<uint32_t>(meshlets.triangles.size() / 3);
+			};
+
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				size_t newVertices = 0;
+				for (size_t k = 0; k < 3; k++)
+					if (localIndices[indices[i + k]] == UNUSED_VERTEX)
+						newVertices++;
+
+				if (current.vertexCount + newVertices > maxVertices || current.triangleCount >= maxTriangles)
+					closeMeshlet();
+
+				for (size_t k = 0; k < 3; k++)
+				{
+					uint32_t& local = localIndices[indices[i + k]];
+					if (local == UNUSED_VERTEX)
+					{
+						local = current.vertexCount++;
+						meshlets.vertices.push_back(indices[i + k]);
+					}
+					meshlets.triangles.push_back(static_cast<uint8_t>(local));
+				}
+				current.triangleCount++;
+			}
+			closeMeshlet();
+		}
+
+		// Symmetric 3x3 quadric over (x, y, 1), the sum of weighted squared distances to lines
+		struct Quadric
+		{
+			double xx = 0.0, xy = 0.0, x1 = 0.0, yy = 0.0, y1 = 0.0, c = 0.0;
+			double weight = 0.0;
+
+			void AddLine(double nx, double ny, double d, double lineWeight)
+			{
+				xx += nx * nx * lineWeight;
+				xy += nx * ny * lineWeight;
+				x1 += nx * d * lineWeight;
+				yy += ny * ny * lineWeight;
+				y1 += ny * d * lineWeight;
+				c += d * d * lineWeight;
+				weight += lineWeight;
+			}
+
+			void Add(const Quadric& other)
+			{
+				xx += other.xx;
+				xy += other.xy;
+				x1 += other.x1;
+				yy += other.yy;
+				y1 += other.y1;
+				c += other.c;
+				weight += other.weight;
+			}
+
+			// Weighted mean of the squared distances
+			double Evaluate(double x, double y) const
+			{
+				if (weight == 0.0)
+					return 0.0;
+				double error = xx * x * x + 2.0 * xy * x * y + 2.0 * x1 * x + yy * y * y + 2.0 * y1 * y + c;
+				return std::max(error, 0.0) / weight;
+			}
+		};
+
+		static const float* VertexFloats(const float* data, size_t vertex, size_t stride)
+		{
+			return reinterpret_cast<const float*>(reinterpret_cast<const char*>(data) + vertex * stride);
+		}
+
+		static float AttributeDistance(const float* a, const float* b, size_t count)
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < count; i++)
+				sum += (a[i] - b[i]) * (a[i] - b[i]);
+			return std::sqrt(sum);
+		}
+
+		// Twice the signed area
+		static double TriangleArea(const double* a, const double* b, const double* c)
+		{
+			return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+		}
+
+		float Simplify(std::vector<uint32_t>& destination, const std::vector<uint32_t>& indices, const float* positions, size_t vertexCount, size_t vertexStride,
+			const float* attributes, size_t attributeCount, size_t targetIndexCount, float targetError)
+		{
+			assert(indices.size() % 3 == 0 && "Simplification needs a triangle list !");
+			destination = indices;
+			if (indices.size() <= targetIndexCount || vertexCount == 0)
+				return 0.0f;
+
+			// Errors are computed on positions scaled to a unit extent, so the thresholds do not depend on the mesh size
+			double boundsMin[2] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+			double boundsMax[2] = { std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest() };
+			for (size_t i = 0; i < vertexCount; i++)
+				for (int axis = 0; axis < 2; axis++)
+				{
+					boundsMin[axis] = std::min(boundsMin[axis], static_cast<double>(VertexFloats(positions, i, vertexStride)[axis]));
+					boundsMax[axis] = std::max(boundsMax[axis], static_cast<double>(VertexFloats(positions, i, vertexStride)[axis]));
+				}
+			double extent = std::max(boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1]);
+			double scale = extent > 0.0 ? 1.0 / extent : 1.0;
+
+			std::vector<double> points(vertexCount * 2);
+			for (size_t i = 0; i < vertexCount; i++)
+				for (int axis = 0; axis < 2; axis++)
+					points[i * 2 + axis] = (VertexFloats(positions, i, vertexStride)[axis] - boundsMin[axis]) * scale;
+
+			// Vertices sharing a position are wedges of one corner : topology and collapses work on positions, attributes stay on the wedges
+			std::vector<uint32_t> weld(vertexCount);
+			std::unordered_map<uint64_t, uint32_t> firstWedge;
+			firstWedge.reserve(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++)
+			{
+				uint32_t bits[2];
+				std::memcpy(bits, VertexFloats(positions, i, vertexStride), sizeof(bits));
+				weld[i] = firstWedge.emplace((static_cast<uint64_t>(bits[0]) << 32) | bits[1], static_cast<uint32_t>(i)).first->second;
+			}
+
+			std::vector<uint32_t> wedgeOffsets(vertexCount + 1, 0);
+			std::vector<uint32_t> wedges(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++)
+				wedgeOffsets[weld[i] + 1]++;
+			for (size_t i = 0; i < vertexCount; i++)
+				wedgeOffsets[i + 1] += wedgeOffsets[i];
+			{
+				std::vector<uint32_t> cursor(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+				for (size_t i = 0; i < vertexCount; i++)
+					wedges[cursor[weld[i]]++] = static_cast<uint32_t>(i);
+			}
+
+			// Wedge of target whose attributes are the closest to the ones of wedge, and the distance between them
+			auto matchWedge = [&](uint32_t wedge, uint32_t target, float& distance)
+			{
+				distance = 0.0f;
+				if (attributes == nullptr || wedgeOffsets[target + 1] - wedgeOffsets[target] == 1)
+				{
+					if (attributes != nullptr)
+						distance = AttributeDistance(VertexFloats(attributes, wedge, vertexStride), VertexFloats(attributes, target, vertexStride), attributeCount);
+					return target;
+				}
+
+				uint32_t best = target;
+				distance = std::numeric_limits<float>::max();
+				for (uint32_t i = wedgeOffsets[target]; i < wedgeOffsets[target + 1]; i++)
+				{
+					float d = AttributeDistance(VertexFloats(attributes, wedge, vertexStride), VertexFloats(attributes, wedges[i], vertexStride), attributeCount);
+					if (d < distance)
+					{
+						distance = d;
+						best = wedges[i];
+					}
+				}
+				return best;
+			};
+
+			// Triangles around every position, rebuilt at the start of each pass
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+			std::vector<uint32_t> adjacency;
+			auto buildAdjacency = [&]()
+			{
+				std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+				for (uint32_t index : destination)
+					adjacencyOffsets[weld[index] + 1]++;
+				for (size_t i = 0; i < vertexCount; i++)
+					adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+
+				adjacency.resize(destination.size());
+				std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < destination.size(); i++)
+					adjacency[cursor[weld[destination[i]]]++] = static_cast<uint32_t>(i / 3);
+			};
+
+			// Neighbor positions of a position with the number of triangles sharing the edge to them, 1 on a border
+			std::vector<std::pair<uint32_t, uint32_t>> neighbors;
+			auto gatherNeighbors = [&](uint32_t vertex)
+			{
+				neighbors.clear();
+				for (uint32_t i = adjacencyOffsets[vertex]; i < adjacencyOffsets[vertex + 1]; i++)
+					for (int k = 0; k < 3; k++)
+					{
+						uint32_t other = weld[destination[adjacency[i] * 3 + k]];
+						if (other == vertex)
+							continue;
+						auto it = std::find_if(neighbors.begin(), neighbors.end(), [&](const auto& neighbor) { return neighbor.first == other; });
+						if (it != neighbors.end())
+							it->second++;
+						else
+							neighbors.push_back({ other, 1 });
+					}
+			};
+
+			enum VertexKind : uint8_t { INTERIOR, BORDER, LOCKED };
+			std::vector<uint8_t> kinds(vertexCount, LOCKED);
+			std::vector<Quadric> quadrics(vertexCount);
+			std::vector<float> attributeErrors(vertexCount, 0.0f);
+
+			// Borders keep their shape through line quadrics, interior collapses of a flat mesh only cost attribute error
+			buildAdjacency();
+			for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+			{
+				if (weld[vertex] != vertex)
+					continue;
+				gatherNeighbors(vertex);
+				for (const auto& [other, count] : neighbors)
+				{
+					if (count != 1)
+						continue;
+					double dx = points[other * 2] - points[vertex * 2];
+					double dy = points[other * 2 + 1] - points[vertex * 2 + 1];
+					double length = std::sqrt(dx * dx + dy * dy);
+					if (length == 0.0)
+						continue;
+					double nx = -dy / length, ny = dx / length;
+					quadrics[vertex].AddLine(nx, ny, -(nx * points[vertex * 2] + ny * points[vertex * 2 + 1]), length);
+				}
+			}
+
+			struct Collapse
+			{
+				double cost;
+				uint32_t from;
+				uint32_t to;
+				float attributeError;
+			};
+
+			const double attributeWeight = attributes != nullptr ? ATTRIBUTE_ERROR_WEIGHT : 0.0;
+			const double errorLimit = static_cast<double>(targetError) * scale * static_cast<double>(targetError) * scale;
+			const size_t targetTriangles = targetIndexCount / 3;
+			size_t liveTriangles = destination.size() / 3;
+			double reachedError = 0.0;
+			std::vector<Collapse> collapses;
+			std::vector<uint8_t> touched(vertexCount);
+
+			for (int pass = 0; pass < 64 && liveTriangles > targetTriangles; pass++)
+			{
+				buildAdjacency();
+
+				// Junctions of several borders and non manifold edges stay put
+				for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+				{
+					if (weld[vertex] != vertex || adjacencyOffsets[vertex] == adjacencyOffsets[vertex + 1])
+						continue;
+					gatherNeighbors(vertex);
+					size_t borderEdges = 0;
+					bool manifold = true;
+					for (const auto& neighbor : neighbors)
+					{
+						borderEdges += neighbor.second == 1;
+						manifold &= neighbor.second <= 2;
+					}
+					kinds[vertex] = !manifold ? LOCKED : borderEdges == 0 ? INTERIOR : borderEdges == 2 ? BORDER : LOCKED;
+				}
+
+				// Cheapest collapse of every position
+				collapses.clear();
+				for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+				{
+					if (weld[vertex] != vertex || kinds[vertex] == LOCKED || adjacencyOffsets[vertex] == adjacencyOffsets[vertex + 1])
+						continue;
+					gatherNeighbors(vertex);
+
+					Collapse best = { std::numeric_limits<double>::max(), vertex, vertex, 0.0f };
+					for (const auto& [other, count] : neighbors)
+					{
+						if (kinds[vertex] == BORDER && (count != 1 || kinds[other] == INTERIOR))
+							continue;
+
+						Quadric quadric = quadrics[vertex];
+						quadric.Add(quadrics[other]);
+						float wedgeDistance = 0.0f;
+						for (uint32_t i = wedgeOffsets[vertex]; i < wedgeOffsets[vertex + 1]; i++)
+						{
+							float distance;
+							matchWedge(wedges[i], other, distance);
+							wedgeDistance = std::max(wedgeDistance, distance);
+						}
+
+						float attributeError = std::max(attributeErrors[other], attributeErrors[vertex] + wedgeDistance);
+						double cost = quadric.Evaluate(points[other * 2], points[other * 2 + 1]) + attributeWeight * attributeError * attributeWeight * attributeError;
+						if (cost < best.cost)
+							best = { cost, vertex, other, attributeError };
+					}
+					if (best.to != vertex)
+						collapses.push_back(best);
+				}
+				if (collapses.empty())
+					break;
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+				// Collapses of a pass never touch the same triangles, every one is checked against the mesh as it was at the start
+				std::fill(touched.begin(), touched.end(), 0);
+				size_t collapsedCount = 0;
+				for (const Collapse& collapse : collapses)
+				{
+					if (collapse.cost > errorLimit || liveTriangles <= targetTriangles)
+						break;
+					if (touched[collapse.from] || touched[collapse.to])
+						continue;
+
+					const double* target = &points[collapse.to * 2];
+					bool flips = false;
+					for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1] && !flips; i++)
+					{
+						const uint32_t* triangle = &destination[adjacency[i] * 3];
+						const double* corners[3];
+						bool removed = false;
+						for (int k = 0; k < 3; k++)
+						{
+							removed |= weld[triangle[k]] == collapse.to;
+							corners[k] = &points[weld[triangle[k]] * 2];
+						}
+						if (removed)
+							continue;
+
+						double before = TriangleArea(corners[0], corners[1], corners[2]);
+						for (int k = 0; k < 3; k++)
+							if (weld[triangle[k]] == collapse.from)
+								corners[k] = target;
+						double after = TriangleArea(corners[0], corners[1], corners[2]);
+						flips = before * after <= 0.0 || std::abs(after) < 1e-12;
+					}
+					if (flips)
+						continue;
+
+					for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1]; i++)
+					{
+						uint32_t* triangle = &destination[adjacency[i] * 3];
+						bool removed = false;
+						for (int k = 0; k < 3; k++)
+						{
+							removed |= weld[triangle[k]] == collapse.to;
+							touched[weld[triangle[k]]] = 1;
+						}
+						for (int k = 0; k < 3; k++)
+						{
+							float distance;
+							if (weld[triangle[k]] == collapse.from)
+								triangle[k] = matchWedge(triangle[k], collapse.to, distance);
+						}
+						liveTriangles -= removed;
+					}
+
+					quadrics[collapse.to].Add(quadrics[collapse.from]);
+					attributeErrors[collapse.to] = collapse.attributeError;
+					reachedError = std::max(reachedError, collapse.cost);
+					collapsedCount++;
+				}
+
+				// Triangles that had both ends of a collapsed edge are now degenerate
+				size_t writeIndex = 0;
+				for (size_t i = 0; i < destination.size(); i += 3)
+				{
+					uint32_t a = weld[destination[i]], b = weld[destination[i + 1]], c = weld[destination[i + 2]];
+					if (a == b || b == c || a == c)
+						continue;
+					for (int k = 0; k < 3; k++)
+						destination[writeIndex++] = destination[i + k];
+				}
+				destination.resize(writeIndex);
+				liveTriangles = destination.size() / 3;
+
+				if (collapsedCount == 0)
+					break;
+			}
+			return static_cast<float>(std::sqrt(reachedError) / scale);
+		}
+
+		std::vector<MeshLod> BuildLodChain(std::vector<uint32_t>& indices, const float* positions, size_t vertexCount, size_t vertexStride, const float* attributes, size_t attributeCount)
+		{
+			std::vector<MeshLod> lods = { { 0, static_cast<uint32_t>(indices.size()), 0.0f, 0 } };
+			std::vector<uint32_t> current = indices;
+			std::vector<uint32_t> simplified;
+			float error = 0.0f;
+			while (lods.size() < MAX_LOD_COUNT)
+			{
+				// Every level is simplified from the previous one, its error adds to theirs
+				float levelError = Simplify(simplified, current, positions, vertexCount, vertexStride, attributes, attributeCount, current.size() / 2, std::numeric_limits<float>::max());
+				if (simplified.empty() || simplified.size() > current.size() * 3 / 4)
+					break;
+
+				OptimizeVertexCache(simplified, vertexCount);
+				error += levelError;
+				lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), error, 0 });
+				indices.insert(indices.end(), simplified.begin(), simplified.end());
+				current.swap(simplified);
+			}
+			return lods;
+		}
+
+		static double PointSegmentDistance(const double* p, const double* a, const double* b)
+		{
+			double abx = b[0] - a[0], aby = b[1] - a[1];
+			double lengthSquared = abx * abx + aby * aby;
+			double t = lengthSquared > 0.0 ? std::clamp(((p[0] - a[0]) * abx + (p[1] - a[1]) * aby) / lengthSquared, 0.0, 1.0) : 0.0;
+			double dx = a[0] + abx * t - p[0], dy = a[1] + aby * t - p[1];
+			return std::sqrt(dx * dx + dy * dy);
+		}
+
+		SimplificationError MeasureSimplificationError(const std::vector<uint32_t>& original, const std::vector<uint32_t>& simplified, const float* positions, size_t vertexCount, size_t vertexStride,
+			const float* attributes, size_t attributeCount)
+		{
+			assert(original.size() % 3 == 0 && simplified.size() % 3 == 0 && "Simplification error needs triangle lists !");
+			assert((attributes != nullptr || attributeCount == 0) && "Attribute count given without attributes !");
+			assert(std::all_of(original.begin(), original.end(), [&](uint32_t index) { return index < vertexCount; }) && "Original index out of range !");
+			assert(std::all_of(simplified.begin(), simplified.end(), [&](uint32_t index) { return index < vertexCount; }) && "Simplified index out of range !");
+
+			SimplificationError result;
+			if (original.empty() || simplified.empty())
+				return result;
+
+			auto position = [&](uint32_t vertex, double* p)
+			{
+				p[0] = VertexFloats(positions, vertex, vertexStride)[0];
+				p[1] = VertexFloats(positions, vertex, vertexStride)[1];
+			};
+
+			// Uniform grid of about one simplified triangle per cell, triangles are listed in every cell their bounds overlap
+			double boundsMin[2] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+			double boundsMax[2] = { std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest() };
+			for (uint32_t index : original)
+			{
+				double p[2];
+				position(index, p);
+				for (int axis = 0; axis < 2; axis++)
+				{
+					boundsMin[axis] = std::min(boundsMin[axis], p[axis]);
+					boundsMax[axis] = std::max(boundsMax[axis], p[axis]);
+				}
+			}
+
+			size_t triangleCount = simplified.size() / 3;
+			size_t gridSize = std::clamp<size_t>(static_cast<size_t>(std::sqrt(static_cast<double>(triangleCount))), 1, 1024);
+			double cellSize[2] = { std::max(boundsMax[0] - boundsMin[0], 1e-12) / gridSize, std::max(boundsMax[1] - boundsMin[1], 1e-12) / gridSize };
+			auto cellOf = [&](double value, int axis) { return std::clamp<int64_t>(static_cast<int64_t>((value - boundsMin[axis]) / cellSize[axis]), 0, gridSize - 1); };
+
+			std::vector<std::vector<uint32_t>> cells(gridSize * gridSize);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				double a[2], b[2], c[2];
+				position(simplified[t * 3], a);
+				position(simplified[t * 3 + 1], b);
+				position(simplified[t * 3 + 2], c);
+				for (int64_t y = cellOf(std::min({ a[1], b[1], c[1] }), 1); y <= cellOf(std::max({ a[1], b[1], c[1] }), 1); y++)
+					for (int64_t x = cellOf(std::min({ a[0], b[0], c[0] }), 0); x <= cellOf(std::max({ a[0], b[0], c[0] }), 0); x++)
+						cells[y * gridSize + x].push_back(static_cast<uint32_t>(t));
+			}
+
+			std::vector<float> sample(attributeCount), interpolated(attributeCount);
+			double attributeSquaredSum = 0.0;
+			size_t covered = 0;
+			for (size_t i = 0; i < original.size(); i += 3)
+			{
+				double p[2] = {};
+				std::fill(sample.begin(), sample.end(), 0.0f);
+				for (int k = 0; k < 3; k++)
+				{
+					double corner[2];
+					position(original[i + k], corner);
+					p[0] += corner[0] / 3.0;
+					p[1] += corner[1] / 3.0;
+					for (size_t j = 0; j < attributeCount; j++)
+						sample[j] += VertexFloats(attributes, original[i + k], vertexStride)[j] / 3.0f;
+				}
+
+				int64_t cellX = cellOf(p[0], 0), cellY = cellOf(p[1], 1);
+				bool inside = false;
+				for (uint32_t t : cells[cellY * gridSize + cellX])
+				{
+					double a[2], b[2], c[2];
+					position(simplified[t * 3], a);
+					position(simplified[t * 3 + 1], b);
+					position(simplified[t * 3 + 2], c);
+					double area = TriangleArea(a, b, c);
+					if (area == 0.0)
+						continue;
+					double wa = TriangleArea(p, b, c) / area, wb = TriangleArea(a, p, c) / area, wc = TriangleArea(a, b, p) / area;
+					const double epsilon = -1e-9;
+					if (wa < epsilon || wb < epsilon || wc < epsilon)
+						continue;
+
+					inside = true;
+					float distance = 0.0f;
+					if (attributes != nullptr)
+					{
+						for (size_t j = 0; j < attributeCount; j++)
+							interpolated[j] = static_cast<float>(wa * VertexFloats(attributes, simplified[t * 3], vertexStride)[j]
+								+ wb * VertexFloats(attributes, simplified[t * 3 + 1], vertexStride)[j] + wc * VertexFloats(attributes, simplified[t * 3 + 2], vertexStride)[j]);
+						distance = AttributeDistance(sample.data(), interpolated.data(), attributeCount);
+					}
+					attributeSquaredSum += distance * distance;
+					result.attributeMax = std::max(result.attributeMax, distance);
+					break;
+				}
+
+				if (inside)
+				{
+					covered++;
+					continue;
+				}
+
+				// Outside the simplified mesh : distance to the closest edge, searching rings of cells until one holds a triangle
+				double closest = std::numeric_limits<double>::max();
+				for (int64_t ring = 0; ring < static_cast<int64_t>(gridSize) && closest == std::numeric_limits<double>::max(); ring++)
+					for (int64_t y = std::max<int64_t>(cellY - ring, 0); y <= std::min<int64_t>(cellY + ring, gridSize - 1); y++)
+						for (int64_t x = std::max<int64_t>(cellX - ring, 0); x <= std::min<int64_t>(cellX + ring, gridSize - 1); x++)
+							for (uint32_t t : cells[y * gridSize + x])
+								for (int k = 0; k < 3; k++)
+								{
+									double a[2], b[2];
+									position(simplified[t * 3 + k], a);
+									position(simplified[t * 3 + (k + 1) % 3], b);
+									closest = std::min(closest, PointSegmentDistance(p, a, b));
+								}
+				if (closest != std::numeric_limits<double>::max())
+					result.maxDistance = std::max(result.maxDistance, static_cast<float>(closest));
+			}
+
+			size_t sampleCount = original.size() / 3;
+			result.coverage = static_cast<float>(covered) / sampleCount;
+			result.attributeRms = covered > 0 ? static_cast<float>(std::sqrt(attributeSquaredSum / covered)) : 0.0f;
+			return result;
+		}
+	}
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+	struct VertexCacheStats
+	{
+		// Average cache miss ratio : transformed vertices per triangle (0.5 is ideal on large grids, 3 is the worst case)
+		float acmr = 0.0f;
+		// Average transform to vertex ratio : transformed vertices per unique vertex (1 is ideal)
+		float atvr = 0.0f;
+	};
+
+	// A cluster of triangles small enough to be culled as a whole. Triangles index the meshlet vertices, which index the mesh vertices
+	struct Meshlet
+	{
+		uint32_t vertexOffset = 0;
+		uint32_t vertexCount = 0;
+		uint32_t triangleOffset = 0;
+		uint32_t triangleCount = 0;
+
+		// Bounding sphere of the meshlet vertices
+		float center[3] = {};
+		float radius = 0.0f;
+		// Every triangle normal is within the cone around coneAxis, the meshlet faces away from a view direction d when dot(coneAxis, d) > coneCutoff.
+		// A cutoff of 1 never culls : the normals spread over more than a half space
+		float coneAxis[3] = {};
+		float coneCutoff = 1.0f;
+	};
+
+	// A range of an index buffer shared by every level of detail of a mesh, all of them index the same vertices
+	struct MeshLod
+	{
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		// Simplification error in mesh units, 0 for LOD 0
+		float error = 0.0f;
+		uint32_t reserved = 0;
+	};
+
+	// Simplified mesh against its original, sampled at the centroid of every original triangle
+	struct SimplificationError
+	{
+		// Largest distance from a sample to the simplified mesh, in mesh units
+		float maxDistance = 0.0f;
+		// Attribute distance between a sample and the simplified mesh interpolated at the same point
+		float attributeRms = 0.0f;
+		float attributeMax = 0.0f;
+		// Fraction of the samples inside the simplified mesh
+		float coverage = 0.0f;
+	};
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> vertices;
+		// Three meshlet local vertex indices per triangle
+		std::vector<uint8_t> triangles;
+	};
+
+	namespace MeshOptimizer
+	{
+		constexpr uint32_t DEFAULT_CACHE_SIZE = 16;
+		// The sizes NVIDIA recommends for mesh shaders, 124 triangles keeps 3 local indices per triangle in 372 bytes
+		constexpr size_t MAX_MESHLET_VERTICES = 64;
+		constexpr size_t MAX_MESHLET_TRIANGLES = 124;
+		constexpr size_t MAX_LOD_COUNT = 8;
+		// In the simplification error, an attribute distance of 1 weighs as much as this fraction of the mesh extent
+		constexpr float ATTRIBUTE_ERROR_WEIGHT = 0.02f;
+
+		// Byte level implementations, vertices are compared and moved as opaque blobs of vertexSize bytes
+		size_t GenerateVertexRemap(std::vector<uint32_t>& remap, const void* vertices, size_t vertexCount, size_t vertexSize);
+		void RemapVertices(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const std::vector<uint32_t>& remap);
+		void RemapIndices(std::vector<uint32_t>& indices, const std::vector<uint32_t>& remap);
+		size_t GenerateFetchRemap(std::vector<uint32_t>& remap, const std::vector<uint32_t>& indices, size_t vertexCount);
+
+		// Tipsify (Sander et al. 2007) : reorders triangles so consecutive ones reuse the post-transform cache
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+		VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+		// Splits the triangles in index order, so a cache optimized index buffer gives compact meshlets. Positions are read as
+		// positionComponents floats (2 or 3, a missing z is 0), every vertexStride bytes from positions
+		void BuildMeshlets(MeshletData& meshlets, const std::vector<uint32_t>& indices, const float* positions, size_t vertexCount, size_t vertexStride, size_t positionComponents,
+			size_t maxVertices = MAX_MESHLET_VERTICES, size_t maxTriangles = MAX_MESHLET_TRIANGLES);
+
+		// Quadric error edge collapse (Garland and Heckbert 1997) of a 2D mesh, until the index count reaches targetIndexCount or
+		// the next collapse would exceed targetError (mesh units). Vertices are only removed, never moved, so the result indexes
+		// the same vertex buffer. Borders only collapse along themselves and triangles never flip. attributes, read every
+		// vertexStride bytes like the positions, add their distance to the error, nullptr ignores them. Returns the error reached
+		float Simplify(std::vector<uint32_t>& destination, const std::vector<uint32_t>& indices, const float* positions, size_t vertexCount, size_t vertexStride,
+			const float* attributes, size_t attributeCount, size_t targetIndexCount, float targetError);
+
+		// Appends LODs of halved triangle counts to indices and returns every range, LOD 0 being the given indices. Stops after
+		// MAX_LOD_COUNT levels or once a level removes less than a quarter of the triangles
+		std::vector<MeshLod> BuildLodChain(std::vector<uint32_t>& indices, const float* positions, size_t vertexCount, size_t vertexStride, const float* attributes, size_t attributeCount);
+
+		SimplificationError MeasureSimplificationError(const std::vector<uint32_t>& original, const std::vector<uint32_t>& simplified, const float* positions, size_t vertexCount, size_t vertexStride,
+			const float* attributes, size_t attributeCount);
+
+		// Merges identical vertices and builds the matching index buffer. An empty index buffer means a non indexed triangle list
+		template<typename Vertex>
+		void Deduplicate(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			if (indices.empty())
+			{
+				indices.resize(vertices.size());
+				for (uint32_t i = 0; i < indices.size(); i++)
+					indices[i] = i;
+			}
+
+			std::vector<uint32_t> remap;
+			size_t uniqueCount = GenerateVertexRemap(remap, vertices.data(), vertices.size(), sizeof(Vertex));
+
+			std::vector<Vertex> uniqueVertices(uniqueCount);
+			RemapVertices(uniqueVertices.data(), vertices.data(), vertices.size(), sizeof(Vertex), remap);
+			RemapIndices(indices, remap);
+			vertices.swap(uniqueVertices);
+		}
+
+		// Reorders vertices in the order they are first referenced so vertex fetches walk memory linearly
+		template<typename Vertex>
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			std::vector<uint32_t> remap;
+			size_t usedCount = GenerateFetchRemap(remap, indices, vertices.size());
+
+			std::vector<Vertex> orderedVertices(usedCount);
+			RemapVertices(orderedVertices.data(), vertices.data(), vertices.size(), sizeof(Vertex), remap);
+			RemapIndices(indices, remap);
+			vertices.swap(orderedVertices);
+		}
+
+		template<typename Vertex>
+		void BuildMeshlets(MeshletData& meshlets, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+		{
+			BuildMeshlets(meshlets, indices, &vertices[0].position[0], vertices.size(), sizeof(Vertex), sizeof(vertices[0].position) / sizeof(float));
+		}
+
+		// Vertices need a 2D position and a color
+		template<typename Vertex>
+		std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			return BuildLodChain(indices, &vertices[0].position[0], vertices.size(), sizeof(Vertex), &vertices[0].color[0], sizeof(vertices[0].color) / sizeof(float));
+		}
+
+		template<typename Vertex>
+		SimplificationError MeasureSimplificationError(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& original, const std::vector<uint32_t>& simplified)
+		{
+			return MeasureSimplificationError(original, simplified, &vertices[0].position[0], vertices.size(), sizeof(Vertex), &vertices[0].color[0], sizeof(vertices[0].color) / sizeof(float));
+		}
+
+		// Full load time pipeline : deduplication, triangle reordering for the cache, then vertex reordering for fetch
+		template<typename Vertex>
+		void Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t cacheSize = DEFAULT_CACHE_SIZE)
+		{
+			Deduplicate(vertices, indices);
+			OptimizeVertexCache(indices, vertices.size(), cacheSize);
+			OptimizeVertexFetch(vertices, indices);
+		}
+	}
+}
@@ -1,69 +1,193 @@
 #include "Model.h"
+#include "CpuProfiler.h"
+#include "MeshAsset.h"
+#include "Pipeline.h"
+#include "UploadArena.h"
 
 #include <cassert>
+#include <limits>
 
 namespace Engine
 {
-	Model::Model(Device& device, const std::vector<Vertex>& verticies)
+	namespace
+	{
+		using PackedVertexLayout = VertexLayout<Model::PackedVertex, VERTEX_ATTRIBUTE(Model::PackedVertex, position), VERTEX_ATTRIBUTE(Model::PackedVertex, color)>;
+		using InstanceLayout = VertexLayout<Model::Instance, VERTEX_ATTRIBUTE(Model::Instance, offset), VERTEX_ATTRIBUTE(Model::Instance, scale), VERTEX_ATTRIBUTE(Model::Instance, color)>;
+	}
+
+	Model::Model(Device& device, const std::vector<Vertex>& verticies, const std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods)
 		: m_device(device)
 	{
 		CreateVertexBuffer(verticies);
+		CreateIndexBuffer(indices);
+
+		m_lods = lods;
+		if (m_lods.empty())
+			m_lods.push_back({ 0, m_hasIndexBuffer ? m_indexCount : m_vertexCount, 0.0f, 0 });
+	}
+
+	Model::Model(Device& device, const MeshAsset& asset, bool uploadData)
+		: m_device(device)
+	{
+		PROFILE_FUNCTION();
+		m_boundsMin = asset.GetBoundsMin();
+		m_boundsMax = asset.GetBoundsMax();
+		m_positionDecode = asset.GetPositionDecode();
+
+		// Every LOD lives in the one index blob
+		const MeshFileHeader& header = asset.GetHeader();
+		UploadVertices(uploadData ? asset.GetVertices() : nullptr, header.vertexCount);
+		UploadIndices(uploadData ? asset.GetIndices() : nullptr, header.indexCount, asset.GetIndexType());
+		m_lods.assign(asset.GetLods(), asset.GetLods() + asset.GetLodCount());
 	}
 
 	Model::~Model()
 	{
 		vkDestroyBuffer(m_device.GetDevice(), m_vertexBuffer, nullptr);
-		vkFreeMemory(m_device.GetDevice(), m_vertexBufferMemory, nullptr);
+		m_device.FreeMemory(m_vertexBufferMemory);
+
+		if (m_hasIndexBuffer)
+		{
+			vkDestroyBuffer(m_device.GetDevice(), m_indexBuffer, nullptr);
+			m_device.FreeMemory(m_indexBufferMemory);
+		}
 	}
 
-	void Model::Bind(VkCommandBuffer commandBuffer)
+	void Model::Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
 	{
+		Pipeline::PushConstants(commandBuffer, pipelineLayout, m_positionDecode);
+
 		VkBuffer buffers[] = { m_vertexBuffer };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+
+		if (m_hasIndexBuffer)
+			vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, m_indexType);
+	}
+
+	void Model::Draw(VkCommandBuffer commandBuffer, uint32_t lod)
+	{
+		assert(lod < m_lods.size() && "LOD out of range !");
+		if (m_hasIndexBuffer)
+			vkCmdDrawIndexed(commandBuffer, m_lods[lod].indexCount, 1, m_lods[lod].firstIndex, 0, 0);
+		else
+			vkCmdDraw(commandBuffer, m_lods[lod].indexCount, 1, m_lods[lod].firstIndex, 0);
+	}
+
+	void Model::DrawInstanced(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, VkDeviceSize instanceOffset, uint32_t instanceCount, uint32_t lod)
+	{
+		assert(lod < m_lods.size() && "LOD out of range !");
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &instanceOffset);
+
+		if (m_hasIndexBuffer)
+			vkCmdDrawIndexed(commandBuffer, m_lods[lod].indexCount, instanceCount, m_lods[lod].firstIndex, 0, 0);
+		else
+			vkCmdDraw(commandBuffer, m_lods[lod].indexCount, instanceCount, m_lods[lod].firstIndex, 0);
 	}
 
-	void Model::Draw(VkCommandBuffer commandBuffer)
+	uint32_t Model::SelectLod(float pixelsPerUnit, float maxPixelError) const
 	{
-		vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
+		// Errors grow with the LOD index
+		uint32_t lod = 0;
+		while (lod + 1 < m_lods.size() && m_lods[lod + 1].error * pixelsPerUnit <= maxPixelError)
+			lod++;
+		return lod;
 	}
 
 	void Model::CreateVertexBuffer(const std::vector<Vertex>& vertices)
 	{
+		PROFILE_FUNCTION();
 		assert(vertices.size() >= 3 && "Model must have at least 3 vertices !");
 
-		m_vertexCount = static_cast<uint32_t>(vertices.size());
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
-		m_device.CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_vertexBuffer, m_vertexBufferMemory);
-		void* data;
+		m_boundsMin = m_boundsMax = vertices[0].position;
+		for (const auto& vertex : vertices)
+		{
+			m_boundsMin = glm::min(m_boundsMin, vertex.position);
+			m_boundsMax = glm::max(m_boundsMax, vertex.position);
+		}
 
-		vkMapMemory(m_device.GetDevice(), m_vertexBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-		vkUnmapMemory(m_device.GetDevice(), m_vertexBufferMemory);
+		m_positionDecode = PositionDecode::FromBounds(m_boundsMin, m_boundsMax);
+		std::vector<PackedVertex> packedVertices(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+			packedVertices[i] = m_positionDecode.Pack(vertices[i]);
+
+		UploadVertices(packedVertices.data(), static_cast<uint32_t>(packedVertices.size()));
 	}
 
-	std::vector<VkVertexInputBindingDescription> Model::Vertex::GetBindingDescriptions()
+	void Model::CreateIndexBuffer(const std::vector<uint32_t>& indices)
 	{
-		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-		bindingDescriptions[0].binding = 0;
-		bindingDescriptions[0].stride = sizeof(Vertex);
-		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescriptions;
+		PROFILE_FUNCTION();
+		if (indices.empty())
+			return;
+
+		// 16 bit indices halve the index fetch bandwidth whenever every vertex can be addressed with them
+		if (m_vertexCount <= std::numeric_limits<uint16_t>::max() + 1u)
+		{
+			std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+			UploadIndices(shortIndices.data(), static_cast<uint32_t>(shortIndices.size()), VK_INDEX_TYPE_UINT16);
+		}
+		else
+			UploadIndices(indices.data(), static_cast<uint32_t>(indices.size()), VK_INDEX_TYPE_UINT32);
 	}
 
-	std::vector<VkVertexInputAttributeDescription> Model::Vertex::GetAttributeDescriptions()
+	void Model::UploadVertices(const PackedVertex* vertices, uint32_t vertexCount)
 	{
-		std::vector<VkVertexInputAttributeDescription> attriuteDescription(2);
-		attriuteDescription[0].binding = 0;
-		attriuteDescription[0].location = 0;
-		attriuteDescription[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attriuteDescription[0].offset = offsetof(Vertex, position);
+		m_vertexCount = vertexCount;
+		VkDeviceSize bufferSize = sizeof(PackedVertex) * m_vertexCount;
+		m_device.CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory);
+		if (vertices != nullptr)
+			m_device.GetUploadArena().Upload(m_vertexBuffer, 0, vertices, bufferSize);
+	}
+
+	void Model::UploadIndices(const void* indices, uint32_t indexCount, VkIndexType indexType)
+	{
+		assert(indexCount % 3 == 0 && "Model indices must describe a triangle list !");
+		m_indexCount = indexCount;
+		m_indexType = indexType;
+		m_hasIndexBuffer = true;
+
+		VkDeviceSize bufferSize = (indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)) * static_cast<VkDeviceSize>(m_indexCount);
+		m_device.CreateBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory);
+		if (indices != nullptr)
+			m_device.GetUploadArena().Upload(m_indexBuffer, 0, indices, bufferSize);
+	}
+
+	Model::PositionDecode Model::PositionDecode::FromBounds(glm::vec2 boundsMin, glm::vec2 boundsMax)
+	{
+		// A flat axis keeps a scale of 1, every vertex then quantizes to 0 on it
+		PositionDecode decode;
+		glm::vec2 halfExtent = (boundsMax - boundsMin) * 0.5f;
+		decode.scale = glm::vec2(halfExtent.x > 0.0f ? halfExtent.x : 1.0f, halfExtent.y > 0.0f ? halfExtent.y : 1.0f);
+		decode.offset = (boundsMin + boundsMax) * 0.5f;
+		return decode;
+	}
+
+	Model::PackedVertex Model::PositionDecode::Pack(const Vertex& vertex) const
+	{
+		PackedVertex packed;
+		packed.position = Quantize::ToSnorm16x2((vertex.position - offset) / scale);
+		packed.color = Quantize::ToUnorm8x4(glm::vec4(vertex.color, 1.0f));
+		return packed;
+	}
+
+	std::vector<VkVertexInputBindingDescription> Model::PackedVertex::GetBindingDescriptions()
+	{
+		return PackedVertexLayout::GetBindingDescriptions(0, VK_VERTEX_INPUT_RATE_VERTEX);
+	}
+
+	std::vector<VkVertexInputAttributeDescription> Model::PackedVertex::GetAttributeDescriptions()
+	{
+		return PackedVertexLayout::GetAttributeDescriptions(0, 0);
+	}
 
-		attriuteDescription[1].binding = 0;
-		attriuteDescription[1].location = 1;
-		attriuteDescription[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attriuteDescription[1].offset = offsetof(Vertex, color);
+	std::vector<VkVertexInputBindingDescription> Model::Instance::GetBindingDescriptions()
+	{
+		return InstanceLayout::GetBindingDescriptions(1, VK_VERTEX_INPUT_RATE_INSTANCE);
+	}
 
-		return attriuteDescription;
+	std::vector<VkVertexInputAttributeDescription> Model::Instance::GetAttributeDescriptions()
+	{
+		// Locations 0 and 1 are taken by the vertex
+		return InstanceLayout::GetAttributeDescriptions(1, 2);
 	}
 }
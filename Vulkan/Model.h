@@ -5,39 +5,119 @@
 #include <glm/glm.hpp>
 
 #include "Device.h"
+#include "MeshOptimizer.h"
+#include "VertexLayout.h"
 
 #include <vector>
 
 namespace Engine
 {
+	class MeshAsset;
+
 	class Model
 	{
 	public:
 
+		// Load time format, quantized to a PackedVertex when the model is created
 		struct Vertex
 		{
 			glm::vec2 position;
 			glm::vec3 color;
+		};
+
+		// What the GPU reads, 8 bytes instead of 20 : positions are quantized over the bounds of the mesh, colors to 8 bits
+		struct PackedVertex
+		{
+			Snorm16x2 position;
+			Unorm8x4 color;
+			static std::vector<VkVertexInputBindingDescription> GetBindingDescriptions();
+			static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
+		};
+		static_assert(sizeof(PackedVertex) == 8, "Packed vertices must stay 8 bytes !");
+
+		// Vertex shader push constant turning packed positions back into mesh positions : position * scale + offset
+		struct PositionDecode
+		{
+			static constexpr VkShaderStageFlags PUSH_CONSTANT_STAGES = VK_SHADER_STAGE_VERTEX_BIT;
+			static constexpr uint32_t PUSH_CONSTANT_OFFSET = 0;
+
+			glm::vec2 scale = { 1.0f, 1.0f };
+			glm::vec2 offset = { 0.0f, 0.0f };
+
+			static PositionDecode FromBounds(glm::vec2 boundsMin, glm::vec2 boundsMax);
+			PackedVertex Pack(const Vertex& vertex) const;
+		};
+
+		// Per instance data of DrawInstanced, read from vertex binding 1. Also the per draw uniform of Draw, see SetTransform
+		struct Instance
+		{
+			glm::vec2 offset = { 0.0f, 0.0f };
+			glm::vec2 scale = { 1.0f, 1.0f };
+			glm::vec4 color = { 1.0f, 1.0f, 1.0f, 1.0f };
 			static std::vector<VkVertexInputBindingDescription> GetBindingDescriptions();
 			static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
 		};
+		static_assert(sizeof(Instance) == 32, "Instances must match the std140 DrawData block of the shaders !");
 
-		Model(Device& device, const std::vector<Vertex>& verticies);
+		// lods index into indices, see MeshOptimizer::BuildLodChain. Without them the whole mesh is the only LOD
+		Model(Device& device, const std::vector<Vertex>& verticies, const std::vector<uint32_t>& indices = {}, const std::vector<MeshLod>& lods = {});
+		// Copies the already packed blobs straight from the asset mapping to the staging ring, no intermediate buffer.
+		// Without uploadData the buffers are only created and the caller fills them, see AsyncLoader
+		Model(Device& device, const MeshAsset& asset, bool uploadData = true);
 		~Model();
 
 		Model(const Model&) = delete;
 		Model& operator=(const Model&) = delete;
 
-		void Bind(VkCommandBuffer commandBuffer);
-		void Draw(VkCommandBuffer commandBuffer);
+		// Also pushes the position decode, the pipeline layout must have a vertex stage PositionDecode range at offset 0
+		void Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+		void Draw(VkCommandBuffer commandBuffer, uint32_t lod = 0);
+		// Binds instanceBuffer at binding 1 and draws every instance in a single call, Bind must be called first
+		void DrawInstanced(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, VkDeviceSize instanceOffset, uint32_t instanceCount, uint32_t lod = 0);
+
+		// Coarsest LOD whose error stays under maxPixelError once projected, pixelsPerUnit being the screen size of one mesh unit
+		uint32_t SelectLod(float pixelsPerUnit, float maxPixelError) const;
+		uint32_t GetLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+		const MeshLod& GetLod(uint32_t lod) const { return m_lods[lod]; }
+		uint32_t GetTriangleCount(uint32_t lod = 0) const { return m_lods[lod].indexCount / 3; }
+
+		// Placement and tint of Draw, written to the per draw uniform every frame. Ignored by DrawInstanced
+		void SetTransform(const Instance& transform) { m_transform = transform; }
+		const Instance& GetTransform() const { return m_transform; }
+
+		// Axis aligned bounds of the vertex positions, used for culling
+		glm::vec2 GetBoundsMin() const { return m_boundsMin; }
+		glm::vec2 GetBoundsMax() const { return m_boundsMax; }
+		// Bounds once the transform is applied, a negative scale swaps the corners
+		glm::vec2 GetTransformedBoundsMin() const { return glm::min(m_boundsMin * m_transform.scale, m_boundsMax * m_transform.scale) + m_transform.offset; }
+		glm::vec2 GetTransformedBoundsMax() const { return glm::max(m_boundsMin * m_transform.scale, m_boundsMax * m_transform.scale) + m_transform.offset; }
+		const PositionDecode& GetPositionDecode() const { return m_positionDecode; }
+		VkBuffer GetVertexBuffer() const { return m_vertexBuffer; }
+		VkBuffer GetIndexBuffer() const { return m_indexBuffer; }
 
 	private:
 		void CreateVertexBuffer(const std::vector<Vertex>& vertices);
+		void CreateIndexBuffer(const std::vector<uint32_t>& indices);
+		// Null data only creates the buffer
+		void UploadVertices(const PackedVertex* vertices, uint32_t vertexCount);
+		void UploadIndices(const void* indices, uint32_t indexCount, VkIndexType indexType);
 
 	private:
 		Device& m_device;
 		VkBuffer m_vertexBuffer;
-		VkDeviceMemory m_vertexBufferMemory;
+		MemoryAllocation m_vertexBufferMemory;
 		uint32_t m_vertexCount;
+		glm::vec2 m_boundsMin;
+		glm::vec2 m_boundsMax;
+		PositionDecode m_positionDecode;
+		Instance m_transform;
+
+		bool m_hasIndexBuffer = false;
+		VkBuffer m_indexBuffer;
+		MemoryAllocation m_indexBufferMemory;
+		uint32_t m_indexCount;
+		VkIndexType m_indexType;
+		// Vertex ranges for models without index buffer
+		std::vector<MeshLod> m_lods;
 	};
 }
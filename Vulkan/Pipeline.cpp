@@ -1,24 +1,25 @@
 #include "Pipeline.h"
+#include "CpuProfiler.h"
 #include "Model.h"
 
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 
 namespace Engine
 {
 	Pipeline::Pipeline(Device& device, const std::string& vertexShaderPath, const std::string fragmentShaderPath, const PipelineConfigInfo& configInfos)
-		: m_device(device)
+		: m_device(device), m_vertexShaderPath(vertexShaderPath), m_fragmentShaderPath(fragmentShaderPath)
 	{
-		CreateGraphicsPipeline(vertexShaderPath, fragmentShaderPath, configInfos);
+		CopyConfig(configInfos, m_configInfo);
+		m_graphicsPipeline = CreateGraphicsPipeline();
 	}
 
 	Pipeline::~Pipeline()
 	{
-		vkDestroyShaderModule(m_device.GetDevice(), m_vertexShaderModule, nullptr);
-		vkDestroyShaderModule(m_device.GetDevice(), m_fragmentShaderModule, nullptr);
 		vkDestroyPipeline(m_device.GetDevice(), m_graphicsPipeline, nullptr);
+		if (m_pendingPipeline != VK_NULL_HANDLE)
+			vkDestroyPipeline(m_device.GetDevice(), m_pendingPipeline, nullptr);
 	}
 
 	void Pipeline::Bind(VkCommandBuffer commandBuffer)
@@ -26,6 +27,15 @@ namespace Engine
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
 	}
 
+	bool Pipeline::HasPushConstantRange(const VkPushConstantRange& range) const
+	{
+		// Pushed stages must match the declared ones exactly, vkCmdPushConstants requires every stage of an overlapping range
+		for (const VkPushConstantRange& declared : m_configInfo.pushConstantRanges)
+			if (declared.stageFlags == range.stageFlags && declared.offset <= range.offset && range.offset + range.size <= declared.offset + declared.size)
+				return true;
+		return false;
+	}
+
 	void Pipeline::DefaultPipelineConfig(PipelineConfigInfo& configInfo)
 	{
 		configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -92,23 +102,86 @@ namespace Engine
 		configInfo.dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
 		configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
 		configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
+
+		configInfo.bindingDescriptions = Model::PackedVertex::GetBindingDescriptions();
+		configInfo.attributeDescriptions = Model::PackedVertex::GetAttributeDescriptions();
+	}
+
+	void Pipeline::CopyConfig(const PipelineConfigInfo& source, PipelineConfigInfo& destination)
+	{
+		destination.viewportInfo = source.viewportInfo;
+		destination.inputAssemblyInfo = source.inputAssemblyInfo;
+		destination.rasterizationInfo = source.rasterizationInfo;
+		destination.multisampleInfo = source.multisampleInfo;
+		destination.colorBlendAttachment = source.colorBlendAttachment;
+		destination.colorBlendInfo = source.colorBlendInfo;
+		destination.depthStencilInfo = source.depthStencilInfo;
+		destination.dynamicStateEnables = source.dynamicStateEnables;
+		destination.dynamicStateInfo = source.dynamicStateInfo;
+		destination.bindingDescriptions = source.bindingDescriptions;
+		destination.attributeDescriptions = source.attributeDescriptions;
+		destination.pushConstantRanges = source.pushConstantRanges;
+		destination.pipelineLayout = source.pipelineLayout;
+		destination.renderPass = source.renderPass;
+		destination.subpass = source.subpass;
+
+		// Pointers to storage outside of the configuration are kept as they are
+		if (source.colorBlendInfo.pAttachments == &source.colorBlendAttachment)
+			destination.colorBlendInfo.pAttachments = &destination.colorBlendAttachment;
+		if (source.dynamicStateInfo.pDynamicStates == source.dynamicStateEnables.data())
+			destination.dynamicStateInfo.pDynamicStates = destination.dynamicStateEnables.data();
 	}
 
-	void Pipeline::CreateGraphicsPipeline(const std::string& vertexShaderPath, const std::string fragmentShaderPath, const PipelineConfigInfo& configInfos)
+	bool Pipeline::Reload()
 	{
+		PROFILE_FUNCTION();
+		VkPipeline pipeline;
+		try
+		{
+			pipeline = CreateGraphicsPipeline();
+		}
+		catch (const std::exception& exception)
+		{
+			std::cerr << "Reloading " << m_vertexShaderPath << " and " << m_fragmentShaderPath << " failed, keeping the current pipeline : " << exception.what() << std::endl;
+			return false;
+		}
+
+		// A reload that was never swapped in is replaced, nothing recorded it
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		if (m_pendingPipeline != VK_NULL_HANDLE)
+			vkDestroyPipeline(m_device.GetDevice(), m_pendingPipeline, nullptr);
+		m_pendingPipeline = pipeline;
+		return true;
+	}
+
+	VkPipeline Pipeline::SwapPending()
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		if (m_pendingPipeline == VK_NULL_HANDLE)
+			return VK_NULL_HANDLE;
+
+		VkPipeline replaced = m_graphicsPipeline;
+		m_graphicsPipeline = m_pendingPipeline;
+		m_pendingPipeline = VK_NULL_HANDLE;
+		return replaced;
+	}
+
+	VkPipeline Pipeline::CreateGraphicsPipeline()
+	{
+		PROFILE_FUNCTION();
+		const PipelineConfigInfo& configInfos = m_configInfo;
 		assert(configInfos.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline with a null pipeline layout !");
 		assert(configInfos.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline with a null render pass !");
 
-		std::vector<char> vertCode = ReadFile(vertexShaderPath);
-		std::vector<char> fragCode = ReadFile(fragmentShaderPath);
-
-		CreateShaderModule(vertCode, &m_vertexShaderModule);
-		CreateShaderModule(fragCode, &m_fragmentShaderModule);
+		// Modules are only needed while the pipeline is created, the cache shares them between pipelines and rebuilds
+		ShaderCache& shaderCache = m_device.GetShaderCache();
+		VkShaderModule vertexShaderModule = shaderCache.GetModule(m_vertexShaderPath);
+		VkShaderModule fragmentShaderModule = shaderCache.GetModule(m_fragmentShaderPath);
 
 		VkPipelineShaderStageCreateInfo shaderStages[2] = {};
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = m_vertexShaderModule;
+		shaderStages[0].module = vertexShaderModule;
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
@@ -116,20 +189,18 @@ namespace Engine
 
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = m_fragmentShaderModule;
+		shaderStages[1].module = fragmentShaderModule;
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
 		shaderStages[1].pSpecializationInfo = nullptr;
 
-		auto bindingDescriptions = Model::Vertex::GetBindingDescriptions();
-		auto attributeDescriptions = Model::Vertex::GetAttributeDescriptions();
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(configInfos.attributeDescriptions.size());
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(configInfos.bindingDescriptions.size());
+		vertexInputInfo.pVertexAttributeDescriptions = configInfos.attributeDescriptions.data();
+		vertexInputInfo.pVertexBindingDescriptions = configInfos.bindingDescriptions.data();
 
 		VkGraphicsPipelineCreateInfo pipelineInfo = {};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -149,34 +220,38 @@ namespace Engine
 		pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-		if (vkCreateGraphicsPipelines(m_device.GetDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create graphics pipeline !");
+		VkPipeline pipeline;
+		m_device.GetPipelineCache().CreateGraphicsPipeline(pipelineInfo, pipeline);
+		return pipeline;
 	}
 
-	void Pipeline::CreateShaderModule(const std::vector<char> code, VkShaderModule* module)
+	ComputePipeline::ComputePipeline(Device& device, const std::string& computeShaderPath, VkPipelineLayout pipelineLayout)
+		: m_device(device)
 	{
-		VkShaderModuleCreateInfo createInfo = {};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		PROFILE_FUNCTION();
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline with a null pipeline layout !");
 
-		if (vkCreateShaderModule(m_device.GetDevice(), &createInfo, nullptr, module) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create shader module !");
-	}
 
-	std::vector<char> Pipeline::ReadFile(const std::string& filePath)
-	{
-		std::fstream file(filePath, std::ios::in | std::ios::ate | std::ios::binary);
-		if (!file.is_open())
-			throw std::runtime_error("Failed to open file : " + filePath);
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = m_device.GetShaderCache().GetModule(computeShaderPath);
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		std::vector<char> buffer(fileSize);
+		m_device.GetPipelineCache().CreateComputePipeline(pipelineInfo, m_computePipeline);
+	}
 
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-		file.close();
+	ComputePipeline::~ComputePipeline()
+	{
+		vkDestroyPipeline(m_device.GetDevice(), m_computePipeline, nullptr);
+	}
 
-		return buffer;
+	void ComputePipeline::Bind(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
 	}
 }
@@ -2,11 +2,38 @@
 
 #include "Device.h"
 
+#include <cassert>
+#include <mutex>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace Engine
 {
+	// Every device supports at least this many bytes of push constants
+	constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 128;
+
+	// A push constant struct declares where it lives, next to its members :
+	//   static constexpr VkShaderStageFlags PUSH_CONSTANT_STAGES = VK_SHADER_STAGE_VERTEX_BIT;
+	//   static constexpr uint32_t PUSH_CONSTANT_OFFSET = 0;
+	// The layout ranges and every push are derived from it, a struct that does not fit fails to compile
+	template<typename T>
+	constexpr VkPushConstantRange PushConstantRange()
+	{
+		static_assert(std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T>, "Push constants are copied as raw bytes !");
+		static_assert(T::PUSH_CONSTANT_OFFSET % 4 == 0 && sizeof(T) % 4 == 0, "Push constant offset and size must be multiples of 4 !");
+		static_assert(T::PUSH_CONSTANT_OFFSET + sizeof(T) <= MAX_PUSH_CONSTANT_SIZE, "Push constants do not fit in the guaranteed 128 bytes !");
+		return { T::PUSH_CONSTANT_STAGES, T::PUSH_CONSTANT_OFFSET, static_cast<uint32_t>(sizeof(T)) };
+	}
+
+	// Structs pushed to the same stages must not overlap
+	template<typename A, typename B>
+	constexpr bool PushConstantsOverlap()
+	{
+		return (A::PUSH_CONSTANT_STAGES & B::PUSH_CONSTANT_STAGES) != 0
+			&& A::PUSH_CONSTANT_OFFSET < B::PUSH_CONSTANT_OFFSET + sizeof(B) && B::PUSH_CONSTANT_OFFSET < A::PUSH_CONSTANT_OFFSET + sizeof(A);
+	}
+
 	struct PipelineConfigInfo
 	{
 		PipelineConfigInfo() = default;
@@ -22,11 +49,20 @@ namespace Engine
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo = {};
 		std::vector<VkDynamicState> dynamicStateEnables = {};
 		VkPipelineDynamicStateCreateInfo dynamicStateInfo = {};
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions = {};
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions = {};
 		VkPipelineLayout pipelineLayout = nullptr;
+		// The push constant ranges pipelineLayout was created with, Pipeline::PushConstants checks pushes against them
+		std::vector<VkPushConstantRange> pushConstantRanges = {};
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+
+		template<typename T>
+		void AddPushConstants() { pushConstantRanges.push_back(PushConstantRange<T>()); }
 	};
 
+	// Shader modules come from the device ShaderCache. The configuration is kept so the pipeline can be rebuilt when its
+	// shaders change, see ShaderHotReload
 	class Pipeline
 	{
 	public:
@@ -38,16 +74,63 @@ namespace Engine
 
 		void Bind(VkCommandBuffer commandBuffer);
 		static void DefaultPipelineConfig(PipelineConfigInfo& configInfo);
+		// Copies every state and points the copy at its own color blend attachment and dynamic states
+		static void CopyConfig(const PipelineConfigInfo& source, PipelineConfigInfo& destination);
+
+		// Builds a new pipeline from the current shader files, from any thread. Bind keeps using the old one until
+		// SwapPending, a failure is logged and leaves the pipeline as it was. Returns whether a new pipeline is pending
+		bool Reload();
+		// Render thread, outside of any recording : makes the reloaded pipeline current. Returns the replaced one, to be
+		// destroyed once the frames using it completed, or VK_NULL_HANDLE when nothing was reloaded
+		VkPipeline SwapPending();
+
+		const std::string& GetVertexShaderPath() const { return m_vertexShaderPath; }
+		const std::string& GetFragmentShaderPath() const { return m_fragmentShaderPath; }
+
+		// Small per draw data recorded straight into the command buffer, nothing is written to memory
+		template<typename T>
+		void PushConstants(VkCommandBuffer commandBuffer, const T& constants)
+		{
+			assert(HasPushConstantRange(PushConstantRange<T>()) && "Push constants outside of the ranges of the pipeline !");
+			PushConstants(commandBuffer, m_configInfo.pipelineLayout, constants);
+		}
+
+		// For callers holding only the layout, its ranges are not checked
+		template<typename T>
+		static void PushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const T& constants)
+		{
+			constexpr VkPushConstantRange range = PushConstantRange<T>();
+			vkCmdPushConstants(commandBuffer, pipelineLayout, range.stageFlags, range.offset, range.size, &constants);
+		}
 
 	private:
-		void CreateGraphicsPipeline(const std::string& vertexShaderPath, const std::string fragmentShaderPath, const PipelineConfigInfo& configInfos);
-		void CreateShaderModule(const std::vector<char> code, VkShaderModule* module);
-		static std::vector<char> ReadFile(const std::string& filePath);
+		VkPipeline CreateGraphicsPipeline();
+		bool HasPushConstantRange(const VkPushConstantRange& range) const;
 
 	private:
 		Device& m_device;
+		std::string m_vertexShaderPath;
+		std::string m_fragmentShaderPath;
+		PipelineConfigInfo m_configInfo;
 		VkPipeline m_graphicsPipeline;
-		VkShaderModule m_vertexShaderModule;
-		VkShaderModule m_fragmentShaderModule;
+
+		std::mutex m_pendingMutex;
+		VkPipeline m_pendingPipeline = VK_NULL_HANDLE;
+	};
+
+	class ComputePipeline
+	{
+	public:
+		ComputePipeline(Device& device, const std::string& computeShaderPath, VkPipelineLayout pipelineLayout);
+		~ComputePipeline();
+
+		ComputePipeline(const ComputePipeline&) = delete;
+		ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+		void Bind(VkCommandBuffer commandBuffer);
+
+	private:
+		Device& m_device;
+		VkPipeline m_computePipeline;
 	};
 }
@@ -0,0 +1,167 @@
+#include "PipelineCache.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace Engine
+{
+	// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE : headerSize, headerVersion, vendorID, deviceID, then the cache UUID
+	static constexpr size_t CACHE_HEADER_SIZE = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+
+	PipelineCache::PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& path)
+		: m_device(device), m_properties(properties), m_path(path)
+	{
+		std::vector<char> initialData = LoadValidatedData();
+		m_stats.loadedBytes = initialData.size();
+
+		VkPipelineCacheCreateInfo cacheInfo = {};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = initialData.size();
+		cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+		if (vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &m_cache) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create pipeline cache !");
+	}
+
+	PipelineCache::~PipelineCache()
+	{
+		Save();
+		PrintStats();
+		vkDestroyPipelineCache(m_device, m_cache, nullptr);
+	}
+
+	void PipelineCache::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& pipelineInfo, VkPipeline& pipeline)
+	{
+		// Creations on other threads would grow the cache in between, each one is measured alone
+		std::lock_guard<std::mutex> creationLock(m_creationMutex);
+		size_t sizeBefore = GetDataSize();
+		auto start = std::chrono::high_resolution_clock::now();
+
+		if (vkCreateGraphicsPipelines(m_device, m_cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create graphics pipeline !");
+		RecordCreation(sizeBefore, start);
+	}
+
+	void PipelineCache::CreateComputePipeline(const VkComputePipelineCreateInfo& pipelineInfo, VkPipeline& pipeline)
+	{
+		// Creations on other threads would grow the cache in between, each one is measured alone
+		std::lock_guard<std::mutex> creationLock(m_creationMutex);
+		size_t sizeBefore = GetDataSize();
+		auto start = std::chrono::high_resolution_clock::now();
+
+		if (vkCreateComputePipelines(m_device, m_cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create compute pipeline !");
+		RecordCreation(sizeBefore, start);
+	}
+
+	void PipelineCache::RecordCreation(size_t sizeBefore, std::chrono::high_resolution_clock::time_point start)
+	{
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		size_t sizeAfter = GetDataSize();
+
+		// A hit leaves the cache untouched. Drivers which never fill the cache only have the header, count those as cold
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (sizeAfter == sizeBefore && sizeBefore > CACHE_HEADER_SIZE)
+		{
+			m_stats.warmCreations++;
+			m_stats.warmMilliseconds += milliseconds;
+		}
+		else
+		{
+			m_stats.coldCreations++;
+			m_stats.coldMilliseconds += milliseconds;
+		}
+	}
+
+	bool PipelineCache::Save()
+	{
+		size_t dataSize = GetDataSize();
+		std::vector<char> data(dataSize);
+		if (dataSize == 0 || vkGetPipelineCacheData(m_device, m_cache, &dataSize, data.data()) != VK_SUCCESS)
+		{
+			std::cerr << "Failed to read pipeline cache data" << std::endl;
+			return false;
+		}
+
+		// Written next to the real file then renamed, a crash while saving never leaves a truncated cache behind
+		std::string temporaryPath = m_path + ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.is_open() || !file.write(data.data(), static_cast<std::streamsize>(dataSize)))
+			{
+				std::cerr << "Failed to write pipeline cache : " << temporaryPath << std::endl;
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, m_path, error);
+		if (error)
+		{
+			std::cerr << "Failed to save pipeline cache : " << error.message() << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	PipelineCacheStats PipelineCache::GetStats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	void PipelineCache::PrintStats()
+	{
+		PipelineCacheStats stats = GetStats();
+		std::cout << "Pipeline cache : " << stats.loadedBytes << " bytes loaded" << std::endl;
+		if (stats.coldCreations > 0)
+			std::cout << "\tCold : " << stats.coldCreations << " pipelines, " << stats.coldMilliseconds / stats.coldCreations << " ms average" << std::endl;
+		if (stats.warmCreations > 0)
+			std::cout << "\tWarm : " << stats.warmCreations << " pipelines, " << stats.warmMilliseconds / stats.warmCreations << " ms average" << std::endl;
+	}
+
+	std::vector<char> PipelineCache::LoadValidatedData()
+	{
+		std::ifstream file(m_path, std::ios::in | std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+			return {};
+
+		std::vector<char> data(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		if (!file || data.size() < CACHE_HEADER_SIZE)
+		{
+			std::cerr << "Ignoring truncated pipeline cache : " << m_path << std::endl;
+			return {};
+		}
+
+		uint32_t headerSize, headerVersion, vendorID, deviceID;
+		memcpy(&headerSize, data.data(), sizeof(uint32_t));
+		memcpy(&headerVersion, data.data() + 4, sizeof(uint32_t));
+		memcpy(&vendorID, data.data() + 8, sizeof(uint32_t));
+		memcpy(&deviceID, data.data() + 12, sizeof(uint32_t));
+		const char* uuid = data.data() + 16;
+
+		// A cache from another GPU or driver is useless at best, some drivers crash on it
+		if (headerSize < CACHE_HEADER_SIZE || headerSize > data.size() || headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			|| vendorID != m_properties.vendorID || deviceID != m_properties.deviceID
+			|| memcmp(uuid, m_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+		{
+			std::cout << "Pipeline cache " << m_path << " was created by another device or driver, starting with an empty cache" << std::endl;
+			return {};
+		}
+		return data;
+	}
+
+	size_t PipelineCache::GetDataSize()
+	{
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(m_device, m_cache, &dataSize, nullptr) != VK_SUCCESS)
+			return 0;
+		return dataSize;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	struct PipelineCacheStats
+	{
+		// Cold creations grew the cache (the driver compiled the shaders), warm ones were served from it
+		uint32_t coldCreations = 0;
+		uint32_t warmCreations = 0;
+		double coldMilliseconds = 0.0;
+		double warmMilliseconds = 0.0;
+		size_t loadedBytes = 0;
+	};
+
+	class PipelineCache
+	{
+	public:
+		static constexpr const char* DEFAULT_PATH = "pipeline_cache.bin";
+
+		PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& path = DEFAULT_PATH);
+		~PipelineCache();
+
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache& operator=(const PipelineCache&) = delete;
+
+		VkPipelineCache GetCache() { return m_cache; }
+
+		// Creates the pipeline through the cache and records how long the driver took. Creations are serialized so each one
+		// is classified from its own change of the cache size
+		void CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& pipelineInfo, VkPipeline& pipeline);
+		void CreateComputePipeline(const VkComputePipelineCreateInfo& pipelineInfo, VkPipeline& pipeline);
+
+		// Writes the cache to disk, returns false (without throwing) on failure so it can run on shutdown
+		bool Save();
+
+		PipelineCacheStats GetStats();
+		void PrintStats();
+
+	private:
+		std::vector<char> LoadValidatedData();
+		size_t GetDataSize();
+		void RecordCreation(size_t sizeBefore, std::chrono::high_resolution_clock::time_point start);
+
+	private:
+		VkDevice m_device;
+		VkPhysicalDeviceProperties m_properties;
+		std::string m_path;
+		VkPipelineCache m_cache = VK_NULL_HANDLE;
+
+		std::mutex m_creationMutex;
+		std::mutex m_mutex;
+		PipelineCacheStats m_stats;
+	};
+}
@@ -0,0 +1,850 @@
+#include "RenderGraph.h"
+#include "CpuProfiler.h"
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+namespace Engine
+{
+	namespace
+	{
+		struct AccessInfo
+		{
+			VkImageLayout layout;
+			VkPipelineStageFlags stages;
+			VkAccessFlags access;
+			bool write;
+		};
+
+		AccessInfo GetAccessInfo(RenderGraphAccess access, VkPipelineStageFlags stages, VkAttachmentLoadOp loadOp)
+		{
+			bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+			switch (access)
+			{
+			case RenderGraphAccess::ColorAttachment:
+				return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, stages, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (load ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0u), true };
+			case RenderGraphAccess::DepthAttachment:
+				return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true };
+			case RenderGraphAccess::DepthReadOnly:
+				return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, false };
+			case RenderGraphAccess::SampledRead:
+				return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, stages, VK_ACCESS_SHADER_READ_BIT, false };
+			case RenderGraphAccess::StorageRead:
+				return { VK_IMAGE_LAYOUT_GENERAL, stages, VK_ACCESS_SHADER_READ_BIT, false };
+			case RenderGraphAccess::StorageWrite:
+				return { VK_IMAGE_LAYOUT_GENERAL, stages, VK_ACCESS_SHADER_WRITE_BIT, true };
+			case RenderGraphAccess::TransferRead:
+				return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stages, VK_ACCESS_TRANSFER_READ_BIT, false };
+			case RenderGraphAccess::TransferWrite:
+				return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, stages, VK_ACCESS_TRANSFER_WRITE_BIT, true };
+			}
+			return {};
+		}
+
+		VkImageUsageFlags GetUsage(RenderGraphAccess access)
+		{
+			switch (access)
+			{
+			case RenderGraphAccess::ColorAttachment:
+				return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			case RenderGraphAccess::DepthAttachment:
+			case RenderGraphAccess::DepthReadOnly:
+				return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			case RenderGraphAccess::SampledRead:
+				return VK_IMAGE_USAGE_SAMPLED_BIT;
+			case RenderGraphAccess::StorageRead:
+			case RenderGraphAccess::StorageWrite:
+				return VK_IMAGE_USAGE_STORAGE_BIT;
+			case RenderGraphAccess::TransferRead:
+				return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			case RenderGraphAccess::TransferWrite:
+				return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			}
+			return 0;
+		}
+
+		bool IsAttachment(RenderGraphAccess access)
+		{
+			return access == RenderGraphAccess::ColorAttachment || access == RenderGraphAccess::DepthAttachment || access == RenderGraphAccess::DepthReadOnly;
+		}
+
+		// Attachments that are not loaded write every texel, storage and transfer writes may leave some untouched
+		bool OverwritesContents(RenderGraphAccess access, VkAttachmentLoadOp loadOp)
+		{
+			return (access == RenderGraphAccess::ColorAttachment || access == RenderGraphAccess::DepthAttachment) && loadOp != VK_ATTACHMENT_LOAD_OP_LOAD;
+		}
+
+		bool ReadsContents(RenderGraphAccess access, VkAttachmentLoadOp loadOp)
+		{
+			if (IsAttachment(access))
+				return loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+			return access != RenderGraphAccess::StorageWrite && access != RenderGraphAccess::TransferWrite;
+		}
+
+		bool IsDepthFormat(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// Barriers on combined formats must name both aspects, views of depth attachments only name the depth
+		VkImageAspectFlags GetBarrierAspect(VkFormat format)
+		{
+			if (format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT)
+				return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			return IsDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+
+		// What reads an imported image once the graph is done with it
+		AccessInfo GetFinalAccess(VkImageLayout layout)
+		{
+			switch (layout)
+			{
+			case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+				// The present waits on the submit semaphore, which already covers every stage
+				return { layout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, false };
+			case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+				return { layout, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, false };
+			default:
+				return { layout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, false };
+			}
+		}
+	}
+
+	RenderGraphPass::RenderGraphPass(const char* name, uint32_t index, Callback callback)
+		: m_name(name), m_index(index), m_callback(std::move(callback))
+	{
+	}
+
+	RenderGraphPass& RenderGraphPass::WriteColor(RenderGraphResource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clearColor)
+	{
+		VkClearValue clearValue = {};
+		clearValue.color = clearColor;
+		return AddUse(resource, RenderGraphAccess::ColorAttachment, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, loadOp, clearValue);
+	}
+
+	RenderGraphPass& RenderGraphPass::WriteDepth(RenderGraphResource resource, VkAttachmentLoadOp loadOp, VkClearDepthStencilValue clearDepth)
+	{
+		VkClearValue clearValue = {};
+		clearValue.depthStencil = clearDepth;
+		return AddUse(resource, RenderGraphAccess::DepthAttachment, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, loadOp, clearValue);
+	}
+
+	RenderGraphPass& RenderGraphPass::ReadDepth(RenderGraphResource resource)
+	{
+		return AddUse(resource, RenderGraphAccess::DepthReadOnly, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+	}
+
+	RenderGraphPass& RenderGraphPass::ReadTexture(RenderGraphResource resource, VkPipelineStageFlags stages)
+	{
+		return AddUse(resource, RenderGraphAccess::SampledRead, stages);
+	}
+
+	RenderGraphPass& RenderGraphPass::ReadStorage(RenderGraphResource resource, VkPipelineStageFlags stages)
+	{
+		return AddUse(resource, RenderGraphAccess::StorageRead, stages);
+	}
+
+	RenderGraphPass& RenderGraphPass::WriteStorage(RenderGraphResource resource, VkPipelineStageFlags stages)
+	{
+		return AddUse(resource, RenderGraphAccess::StorageWrite, stages);
+	}
+
+	RenderGraphPass& RenderGraphPass::ReadTransfer(RenderGraphResource resource)
+	{
+		return AddUse(resource, RenderGraphAccess::TransferRead, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	}
+
+	RenderGraphPass& RenderGraphPass::WriteTransfer(RenderGraphResource resource)
+	{
+		return AddUse(resource, RenderGraphAccess::TransferWrite, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	}
+
+	RenderGraphPass& RenderGraphPass::SetSideEffects()
+	{
+		m_sideEffects = true;
+		return *this;
+	}
+
+	RenderGraphPass& RenderGraphPass::UseSecondaryCommandBuffers()
+	{
+		m_secondaryCommandBuffers = true;
+		return *this;
+	}
+
+	RenderGraphPass& RenderGraphPass::AddUse(RenderGraphResource resource, RenderGraphAccess access, VkPipelineStageFlags stages, VkAttachmentLoadOp loadOp, VkClearValue clearValue)
+	{
+		assert(std::none_of(m_uses.begin(), m_uses.end(), [&](const Use& use) { return use.resource == resource; }) && "An image is used at most once per pass !");
+		m_uses.push_back({ resource, access, stages, loadOp, clearValue });
+		return *this;
+	}
+
+	RenderGraph::RenderGraph(Device& device)
+		: m_device(device)
+	{
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		// Views and framebuffers of the transients belong to the resource cache, render passes stay cached for the next graph
+		ResourceCache& resourceCache = m_device.GetResourceCache();
+		for (const Resource& resource : m_resources)
+		{
+			if (resource.imported || resource.image == VK_NULL_HANDLE)
+				continue;
+			resourceCache.ReleaseImage(resource.image);
+			vkDestroyImage(m_device.GetDevice(), resource.image, nullptr);
+		}
+		for (Bucket& bucket : m_buckets)
+			m_device.FreeMemory(bucket.memory);
+	}
+
+	RenderGraphResource RenderGraph::ImportImage(const char* name, VkFormat format, VkExtent2D extent, VkImageLayout initialLayout, VkPipelineStageFlags initialStages, VkImageLayout finalLayout)
+	{
+		assert(!m_compiled && "Images must be declared before compiling the render graph !");
+		Resource resource = {};
+		resource.name = name;
+		resource.format = format;
+		resource.extent = extent;
+		resource.imported = true;
+		resource.initialState = { initialLayout, initialStages, 0, false, initialStages, 0 };
+		resource.finalLayout = finalLayout;
+		m_resources.push_back(resource);
+		return static_cast<RenderGraphResource>(m_resources.size() - 1);
+	}
+
+	RenderGraphResource RenderGraph::CreateImage(const char* name, VkFormat format, VkExtent2D extent)
+	{
+		assert(!m_compiled && "Images must be declared before compiling the render graph !");
+		Resource resource = {};
+		resource.name = name;
+		resource.format = format;
+		resource.extent = extent;
+		resource.imported = false;
+		m_resources.push_back(resource);
+		return static_cast<RenderGraphResource>(m_resources.size() - 1);
+	}
+
+	RenderGraphPass& RenderGraph::AddPass(const char* name, RenderGraphPass::Callback callback)
+	{
+		assert(!m_compiled && "Passes must be declared before compiling the render graph !");
+		return m_passes.emplace_back(name, static_cast<uint32_t>(m_passes.size()), std::move(callback));
+	}
+
+	void RenderGraph::Compile()
+	{
+		PROFILE_FUNCTION();
+		assert(!m_compiled && "Render graph already compiled !");
+
+		std::vector<uint32_t> livePasses = Cull(m_passes, m_resources);
+		ComputeUsage(livePasses, m_passes, m_resources);
+		CreateTransientImages();
+		m_plan = PlanPasses(livePasses, m_passes, m_resources, m_buckets);
+		CreateRenderPasses();
+
+		m_plannedPasses.assign(m_passes.size(), NOT_USED);
+		for (uint32_t i = 0; i < m_plan.passes.size(); i++)
+			m_plannedPasses[m_plan.passes[i].pass] = i;
+
+		m_stats.passCount = static_cast<uint32_t>(livePasses.size());
+		m_stats.culledPassCount = static_cast<uint32_t>(m_passes.size() - livePasses.size());
+		m_stats.barrierCount = static_cast<uint32_t>(m_plan.finalBarriers.size());
+		for (const PlannedPass& planned : m_plan.passes)
+			m_stats.barrierCount += static_cast<uint32_t>(planned.barriers.size()) + (planned.aliasBarrier.srcAccess != 0 ? 1 : 0);
+		m_compiled = true;
+
+		std::cout << "Render graph : " << m_stats.passCount << " passes (" << m_stats.culledPassCount << " culled), " << m_stats.barrierCount << " barriers, "
+			<< m_stats.transientCount << " transient images in " << m_stats.allocatedBytes / 1024 << " KB instead of " << m_stats.transientBytes / 1024 << " KB" << std::endl;
+	}
+
+	std::vector<uint32_t> RenderGraph::Cull(const std::deque<RenderGraphPass>& passes, const std::vector<Resource>& resources)
+	{
+		// Walked backward from the imported images : a pass lives when one of its writes is read later or leaves the graph
+		std::vector<bool> needed(resources.size());
+		for (size_t i = 0; i < resources.size(); i++)
+			needed[i] = resources[i].imported;
+
+		std::vector<uint32_t> livePasses;
+		for (size_t i = passes.size(); i-- > 0;)
+		{
+			const RenderGraphPass& pass = passes[i];
+			bool live = pass.m_sideEffects || std::any_of(pass.m_uses.begin(), pass.m_uses.end(), [&](const RenderGraphPass::Use& use)
+			{
+				return GetAccessInfo(use.access, use.stages, use.loadOp).write && needed[use.resource];
+			});
+			if (!live)
+				continue;
+			livePasses.push_back(static_cast<uint32_t>(i));
+
+			// A full overwrite hides what earlier passes wrote, unless the pass reads it first
+			for (const auto& use : pass.m_uses)
+				if (OverwritesContents(use.access, use.loadOp))
+					needed[use.resource] = false;
+			for (const auto& use : pass.m_uses)
+				if (ReadsContents(use.access, use.loadOp))
+					needed[use.resource] = true;
+		}
+		std::reverse(livePasses.begin(), livePasses.end());
+		return livePasses;
+	}
+
+	void RenderGraph::ComputeUsage(const std::vector<uint32_t>& livePasses, const std::deque<RenderGraphPass>& passes, std::vector<Resource>& resources)
+	{
+		for (Resource& resource : resources)
+		{
+			resource.firstUse = NOT_USED;
+			resource.lastUse = NOT_USED;
+			resource.usage = 0;
+		}
+
+		for (uint32_t position = 0; position < livePasses.size(); position++)
+		{
+			for (const auto& use : passes[livePasses[position]].m_uses)
+			{
+				Resource& resource = resources[use.resource];
+				if (resource.firstUse == NOT_USED)
+					resource.firstUse = position;
+				resource.lastUse = position;
+				resource.usage |= GetUsage(use.access);
+			}
+		}
+	}
+
+	std::vector<RenderGraph::Bucket> RenderGraph::Alias(std::vector<Resource>& resources, const std::vector<VkMemoryRequirements>& requirements)
+	{
+		std::vector<RenderGraphResource> order;
+		for (RenderGraphResource i = 0; i < resources.size(); i++)
+			if (!resources[i].imported && resources[i].firstUse != NOT_USED)
+				order.push_back(i);
+
+		// Largest first, so smaller images fill the memory of larger ones rather than the other way around
+		std::stable_sort(order.begin(), order.end(), [&](RenderGraphResource a, RenderGraphResource b) { return requirements[a].size > requirements[b].size; });
+
+		std::vector<Bucket> buckets;
+		for (RenderGraphResource i : order)
+		{
+			const Resource& resource = resources[i];
+			const VkMemoryRequirements& requirement = requirements[i];
+			auto fits = [&](const Bucket& bucket)
+			{
+				if ((bucket.requirements.memoryTypeBits & requirement.memoryTypeBits) == 0)
+					return false;
+				return std::none_of(bucket.resources.begin(), bucket.resources.end(), [&](RenderGraphResource other)
+				{
+					return resources[other].firstUse <= resource.lastUse && resource.firstUse <= resources[other].lastUse;
+				});
+			};
+
+			auto it = std::find_if(buckets.begin(), buckets.end(), fits);
+			if (it == buckets.end())
+			{
+				it = buckets.emplace(buckets.end());
+				it->requirements = requirement;
+			}
+			else
+			{
+				it->requirements.size = std::max(it->requirements.size, requirement.size);
+				it->requirements.alignment = std::max(it->requirements.alignment, requirement.alignment);
+				it->requirements.memoryTypeBits &= requirement.memoryTypeBits;
+			}
+			it->resources.push_back(i);
+			resources[i].bucket = static_cast<uint32_t>(it - buckets.begin());
+		}
+
+		for (Bucket& bucket : buckets)
+			std::sort(bucket.resources.begin(), bucket.resources.end(), [&](RenderGraphResource a, RenderGraphResource b) { return resources[a].firstUse < resources[b].firstUse; });
+		return buckets;
+	}
+
+	RenderGraph::Plan RenderGraph::PlanPasses(const std::vector<uint32_t>& livePasses, const std::deque<RenderGraphPass>& passes, const std::vector<Resource>& resources, const std::vector<Bucket>& buckets)
+	{
+		// Reads of the same layout need nothing between them when the barrier after the last write already covered their
+		// stages, otherwise they wait on that write again. The next write or layout change waits for all of them. Only
+		// writes have caches to flush
+		auto apply = [](ImageState& state, const RenderGraphPass::Use& use, bool discard, std::vector<Barrier>* barriers)
+		{
+			AccessInfo next = GetAccessInfo(use.access, use.stages, use.loadOp);
+			if (state.layout == next.layout && !state.write && !next.write)
+			{
+				bool covered = (next.stages & ~state.stages) == 0 && (next.access & ~state.access) == 0;
+				if (!covered && barriers != nullptr)
+				{
+					barriers->push_back({ use.resource, discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout, next.layout,
+						state.writeStages != 0 ? state.writeStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, next.stages, state.writeAccess, next.access });
+				}
+				state.stages |= next.stages;
+				state.access |= next.access;
+				return;
+			}
+			if (barriers != nullptr)
+			{
+				barriers->push_back({ use.resource, discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout, next.layout,
+					state.stages != 0 ? state.stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, next.stages, state.write ? state.access : 0u, next.access });
+			}
+			if (next.write)
+				state = { next.layout, next.stages, next.access, true, next.stages, next.access };
+			else
+				state = { next.layout, next.stages, next.access, false, state.writeStages, state.writeAccess };
+		};
+
+		// Transients start a frame where the previous user of their memory left it : the previous image of the bucket, or
+		// the last one of the previous frame for the first
+		std::vector<ImageState> finalStates(resources.size());
+		for (uint32_t pass : livePasses)
+			for (const auto& use : passes[pass].m_uses)
+				apply(finalStates[use.resource], use, false, nullptr);
+
+		std::vector<ImageState> states(resources.size());
+		for (size_t i = 0; i < resources.size(); i++)
+			if (resources[i].imported)
+				states[i] = resources[i].initialState;
+		for (const Bucket& bucket : buckets)
+			for (size_t i = 0; i < bucket.resources.size(); i++)
+				states[bucket.resources[i]] = finalStates[bucket.resources[(i + bucket.resources.size() - 1) % bucket.resources.size()]];
+
+		Plan plan;
+		for (uint32_t position = 0; position < livePasses.size(); position++)
+		{
+			PlannedPass planned;
+			planned.pass = livePasses[position];
+			for (const auto& use : passes[planned.pass].m_uses)
+			{
+				const Resource& resource = resources[use.resource];
+				bool firstUse = resource.firstUse == position;
+				assert(!(firstUse && !resource.imported && ReadsContents(use.access, use.loadOp)) && "Transient image read before being written !");
+				bool discard = OverwritesContents(use.access, use.loadOp) || (firstUse && (!resource.imported || resource.initialState.layout == VK_IMAGE_LAYOUT_UNDEFINED));
+
+				// Writes left by the previous image of the bucket are flushed by the alias barrier, the image barrier only
+				// waits for their stages before its layout transition
+				ImageState& state = states[use.resource];
+				if (firstUse && !resource.imported && buckets[resource.bucket].resources.size() > 1 && state.write)
+				{
+					AccessInfo next = GetAccessInfo(use.access, use.stages, use.loadOp);
+					planned.aliasBarrier.srcStages |= state.stages;
+					planned.aliasBarrier.srcAccess |= state.access;
+					planned.aliasBarrier.dstStages |= next.stages;
+					planned.aliasBarrier.dstAccess |= next.access;
+					state.write = false;
+				}
+				apply(state, use, discard, &planned.barriers);
+
+				if (!IsAttachment(use.access))
+					continue;
+
+				// Stored only when the next pass touching the image needs what this one leaves in it
+				bool store = resource.imported;
+				for (uint32_t next = position + 1; next <= resource.lastUse; next++)
+				{
+					const auto& nextUses = passes[livePasses[next]].m_uses;
+					auto nextUse = std::find_if(nextUses.begin(), nextUses.end(), [&](const RenderGraphPass::Use& other) { return other.resource == use.resource; });
+					if (nextUse == nextUses.end())
+						continue;
+					store = !OverwritesContents(nextUse->access, nextUse->loadOp);
+					break;
+				}
+
+				assert((planned.attachments.empty() || (planned.extent.width == resource.extent.width && planned.extent.height == resource.extent.height)) && "Attachments of a pass must share their extent !");
+				planned.extent = resource.extent;
+				VkImageLayout layout = GetAccessInfo(use.access, use.stages, use.loadOp).layout;
+				planned.attachments.push_back({ use.resource, layout, use.loadOp, store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE, use.clearValue });
+			}
+			plan.passes.push_back(std::move(planned));
+		}
+
+		for (RenderGraphResource i = 0; i < resources.size(); i++)
+		{
+			const Resource& resource = resources[i];
+			const ImageState& state = states[i];
+			if (!resource.imported || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || (state.layout == resource.finalLayout && !state.write))
+				continue;
+
+			AccessInfo finalAccess = GetFinalAccess(resource.finalLayout);
+			plan.finalBarriers.push_back({ i, state.layout, resource.finalLayout, state.stages != 0 ? state.stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, finalAccess.stages,
+				state.write ? state.access : 0u, finalAccess.access });
+		}
+		return plan;
+	}
+
+	void RenderGraph::CreateTransientImages()
+	{
+		std::vector<VkMemoryRequirements> requirements(m_resources.size());
+		for (size_t i = 0; i < m_resources.size(); i++)
+		{
+			Resource& resource = m_resources[i];
+			if (resource.imported || resource.firstUse == NOT_USED)
+				continue;
+
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent = { resource.extent.width, resource.extent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = resource.format;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = resource.usage;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateImage(m_device.GetDevice(), &imageInfo, nullptr, &resource.image) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create render graph image !");
+			vkGetImageMemoryRequirements(m_device.GetDevice(), resource.image, &requirements[i]);
+			m_stats.transientCount++;
+			m_stats.transientBytes += requirements[i].size;
+		}
+
+		m_buckets = Alias(m_resources, requirements);
+		for (Bucket& bucket : m_buckets)
+		{
+			bucket.memory = m_device.GetAllocator().Allocate(bucket.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+			m_stats.allocatedBytes += bucket.requirements.size;
+
+			for (RenderGraphResource i : bucket.resources)
+			{
+				Resource& resource = m_resources[i];
+				if (vkBindImageMemory(m_device.GetDevice(), resource.image, bucket.memory.memory, bucket.memory.offset) != VK_SUCCESS)
+					throw std::runtime_error("Failed to bind render graph image memory !");
+
+				VkImageViewCreateInfo viewInfo = {};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = resource.image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = resource.format;
+				viewInfo.subresourceRange = { IsDepthFormat(resource.format) ? static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_DEPTH_BIT) : VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+				resource.view = m_device.GetResourceCache().GetImageView(viewInfo);
+			}
+		}
+	}
+
+	void RenderGraph::CreateRenderPasses()
+	{
+		for (PlannedPass& planned : m_plan.passes)
+		{
+			if (planned.attachments.empty())
+				continue;
+
+			std::vector<VkAttachmentDescription> descriptions;
+			std::vector<VkAttachmentReference> colorReferences;
+			VkAttachmentReference depthReference = { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED };
+			for (const Attachment& attachment : planned.attachments)
+			{
+				// Layouts change in the barriers before the pass, the pass itself keeps them
+				VkAttachmentDescription description = {};
+				description.format = m_resources[attachment.resource].format;
+				description.samples = VK_SAMPLE_COUNT_1_BIT;
+				description.loadOp = attachment.loadOp;
+				description.storeOp = attachment.storeOp;
+				description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				description.initialLayout = attachment.layout;
+				description.finalLayout = attachment.layout;
+
+				VkAttachmentReference reference = { static_cast<uint32_t>(descriptions.size()), attachment.layout };
+				if (IsDepthFormat(description.format))
+					depthReference = reference;
+				else
+					colorReferences.push_back(reference);
+				descriptions.push_back(description);
+			}
+
+			VkSubpassDescription subpass = {};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+			subpass.pColorAttachments = colorReferences.data();
+			subpass.pDepthStencilAttachment = depthReference.attachment != VK_ATTACHMENT_UNUSED ? &depthReference : nullptr;
+
+			VkRenderPassCreateInfo renderPassInfo = {};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+			renderPassInfo.pAttachments = descriptions.data();
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+
+			planned.renderPass = m_device.GetResourceCache().GetRenderPass(renderPassInfo);
+			planned.renderPassKey = RenderPassKey::FromCreateInfo(renderPassInfo);
+		}
+	}
+
+	void RenderGraph::SetImportedImage(RenderGraphResource resource, VkImage image, VkImageView view)
+	{
+		assert(m_resources[resource].imported && "Only imported images are set from outside the render graph !");
+		m_resources[resource].image = image;
+		m_resources[resource].view = view;
+	}
+
+	void RenderGraph::Execute(VkCommandBuffer commandBuffer, GpuProfiler* profiler)
+	{
+		PROFILE_FUNCTION();
+		assert(m_compiled && "Render graph executed before being compiled !");
+
+		std::vector<VkImageView> views;
+		std::vector<VkClearValue> clearValues;
+		for (const PlannedPass& planned : m_plan.passes)
+		{
+			RenderGraphPass& pass = m_passes[planned.pass];
+			std::optional<GpuProfiler::Scope> scope;
+			if (profiler != nullptr)
+				scope.emplace(*profiler, commandBuffer, pass.m_name);
+
+			RecordBarriers(commandBuffer, planned.barriers, planned.aliasBarrier);
+			RenderGraphPassContext context = { commandBuffer, planned.renderPass, VK_NULL_HANDLE, planned.extent };
+			if (planned.renderPass == VK_NULL_HANDLE)
+			{
+				pass.m_callback(context);
+				continue;
+			}
+
+			views.clear();
+			clearValues.clear();
+			for (const Attachment& attachment : planned.attachments)
+			{
+				views.push_back(m_resources[attachment.resource].view);
+				clearValues.push_back(attachment.clearValue);
+			}
+
+			// Imported views change from frame to frame, the cache keeps a framebuffer for each of them
+			VkFramebufferCreateInfo framebufferInfo = {};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = planned.renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+			framebufferInfo.pAttachments = views.data();
+			framebufferInfo.width = planned.extent.width;
+			framebufferInfo.height = planned.extent.height;
+			framebufferInfo.layers = 1;
+			context.framebuffer = m_device.GetResourceCache().GetFramebuffer(framebufferInfo);
+
+			VkRenderPassBeginInfo renderInfo = {};
+			renderInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderInfo.renderPass = planned.renderPass;
+			renderInfo.framebuffer = context.framebuffer;
+			renderInfo.renderArea.offset = { 0, 0 };
+			renderInfo.renderArea.extent = planned.extent;
+			renderInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderInfo.pClearValues = clearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderInfo, pass.m_secondaryCommandBuffers ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+			pass.m_callback(context);
+			vkCmdEndRenderPass(commandBuffer);
+		}
+
+		RecordBarriers(commandBuffer, m_plan.finalBarriers, AliasBarrier());
+	}
+
+	void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers, const AliasBarrier& aliasBarrier) const
+	{
+		if (barriers.empty() && aliasBarrier.srcAccess == 0)
+			return;
+
+		std::vector<VkImageMemoryBarrier> imageBarriers(barriers.size());
+		VkPipelineStageFlags srcStages = aliasBarrier.srcStages;
+		VkPipelineStageFlags dstStages = aliasBarrier.dstStages;
+		for (size_t i = 0; i < barriers.size(); i++)
+		{
+			const Barrier& barrier = barriers[i];
+			const Resource& resource = m_resources[barrier.resource];
+			assert(resource.image != VK_NULL_HANDLE && "Imported image not set before executing the render graph !");
+
+			VkImageMemoryBarrier& imageBarrier = imageBarriers[i];
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = barrier.srcAccess;
+			imageBarrier.dstAccessMask = barrier.dstAccess;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = resource.image;
+			imageBarrier.subresourceRange = { GetBarrierAspect(resource.format), 0, 1, 0, 1 };
+			srcStages |= barrier.srcStages;
+			dstStages |= barrier.dstStages;
+		}
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = aliasBarrier.srcAccess;
+		memoryBarrier.dstAccessMask = aliasBarrier.dstAccess;
+		uint32_t memoryBarrierCount = aliasBarrier.srcAccess != 0 ? 1 : 0;
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, memoryBarrierCount, &memoryBarrier, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	VkRenderPass RenderGraph::GetRenderPass(uint32_t pass) const
+	{
+		assert(m_compiled && "Render graph not compiled !");
+		uint32_t planned = m_plannedPasses[pass];
+		return planned != NOT_USED ? m_plan.passes[planned].renderPass : VK_NULL_HANDLE;
+	}
+
+	RenderPassKey RenderGraph::GetRenderPassKey(uint32_t pass) const
+	{
+		assert(m_compiled && "Render graph not compiled !");
+		uint32_t planned = m_plannedPasses[pass];
+		return planned != NOT_USED ? m_plan.passes[planned].renderPassKey : RenderPassKey();
+	}
+
+	bool RenderGraph::RunSelfTest()
+	{
+		bool success = true;
+		auto check = [&](bool condition, const char* name)
+		{
+			if (!condition)
+				std::cerr << "Render graph self test failed : " << name << std::endl;
+			success &= condition;
+		};
+
+		std::vector<Resource> resources;
+		auto addImage = [&](const char* name, VkFormat format, bool imported)
+		{
+			Resource resource = {};
+			resource.name = name;
+			resource.format = format;
+			resource.extent = { 256, 256 };
+			resource.imported = imported;
+			if (imported)
+			{
+				resource.initialState = { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, false, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0 };
+				resource.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			}
+			resources.push_back(resource);
+			return static_cast<RenderGraphResource>(resources.size() - 1);
+		};
+		RenderGraphResource backbuffer = addImage("Backbuffer", VK_FORMAT_B8G8R8A8_SRGB, true);
+		RenderGraphResource shadow = addImage("Shadow", VK_FORMAT_D32_SFLOAT, false);
+		RenderGraphResource albedo = addImage("Albedo", VK_FORMAT_R8G8B8A8_UNORM, false);
+		RenderGraphResource depth = addImage("Depth", VK_FORMAT_D24_UNORM_S8_UINT, false);
+		RenderGraphResource unused = addImage("Unused", VK_FORMAT_R8G8B8A8_UNORM, false);
+		RenderGraphResource hdr = addImage("Hdr", VK_FORMAT_R16G16B16A16_SFLOAT, false);
+		RenderGraphResource ldr = addImage("Ldr", VK_FORMAT_R8G8B8A8_UNORM, false);
+		RenderGraphResource scratch = addImage("Scratch", VK_FORMAT_R8G8B8A8_UNORM, false);
+
+		std::deque<RenderGraphPass> passes;
+		auto addPass = [&](const char* name) -> RenderGraphPass& { return passes.emplace_back(name, static_cast<uint32_t>(passes.size()), [](const RenderGraphPassContext&) {}); };
+		addPass("Shadow").WriteDepth(shadow, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		addPass("GBuffer").WriteColor(albedo, VK_ATTACHMENT_LOAD_OP_CLEAR).WriteDepth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		addPass("Orphan").WriteColor(unused, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		addPass("Overwritten").WriteColor(backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		addPass("Lighting").ReadTexture(albedo).ReadTexture(shadow).WriteColor(hdr, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		addPass("Tonemap").ReadTexture(hdr).ReadTexture(albedo).WriteColor(ldr, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		addPass("Overlay").ReadTexture(ldr).ReadDepth(depth).ReadTexture(albedo, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT).WriteColor(backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		addPass("Capture").ReadTransfer(backbuffer).SetSideEffects();
+		addPass("Scratch").WriteStorage(scratch).SetSideEffects();
+
+		// Nothing reads the orphan, the overlay clears over what the overwritten pass drew, the capture and scratch passes only have side effects
+		std::vector<uint32_t> livePasses = Cull(passes, resources);
+		check(livePasses == std::vector<uint32_t>({ 0, 1, 4, 5, 6, 7, 8 }), "culling");
+		if (!success)
+			return false;
+
+		ComputeUsage(livePasses, passes, resources);
+		check(resources[unused].firstUse == NOT_USED, "culled image usage");
+		check(resources[shadow].firstUse == 0 && resources[shadow].lastUse == 2, "shadow lifetime");
+		check(resources[albedo].firstUse == 1 && resources[albedo].lastUse == 4, "albedo lifetime");
+		check(resources[depth].firstUse == 1 && resources[depth].lastUse == 4, "depth lifetime");
+		check(resources[depth].usage == VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, "depth usage");
+		check(resources[albedo].usage == (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT), "albedo usage");
+
+		// Depth is the largest, the HDR target lives in another memory type. The LDR target starts after the shadow map is last
+		// read, the scratch image after the depth
+		std::vector<VkMemoryRequirements> requirements(resources.size(), { 1024 * 1024, 256, 1 });
+		requirements[depth].size = 2 * 1024 * 1024;
+		requirements[hdr].memoryTypeBits = 2;
+		std::vector<Bucket> buckets = Alias(resources, requirements);
+		check(buckets.size() == 4, "bucket count");
+		check(resources[ldr].bucket == resources[shadow].bucket, "ldr aliases shadow");
+		check(resources[scratch].bucket == resources[depth].bucket, "scratch aliases depth");
+		VkDeviceSize allocatedBytes = 0;
+		for (const Bucket& bucket : buckets)
+		{
+			allocatedBytes += bucket.requirements.size;
+			check(bucket.requirements.memoryTypeBits != 0, "bucket memory type");
+			for (size_t i = 0; i < bucket.resources.size(); i++)
+				for (size_t j = i + 1; j < bucket.resources.size(); j++)
+					check(resources[bucket.resources[i]].lastUse < resources[bucket.resources[j]].firstUse, "aliased lifetimes overlap");
+		}
+		check(allocatedBytes == 5 * 1024 * 1024, "aliased size");
+
+		Plan plan = PlanPasses(livePasses, passes, resources, buckets);
+		check(plan.passes.size() == livePasses.size(), "planned pass count");
+		if (!success)
+			return false;
+
+		auto findBarrier = [&](uint32_t position, RenderGraphResource resource) -> const Barrier*
+		{
+			for (const Barrier& barrier : plan.passes[position].barriers)
+				if (barrier.resource == resource)
+					return &barrier;
+			return nullptr;
+		};
+		auto findAttachment = [&](uint32_t position, RenderGraphResource resource) -> const Attachment*
+		{
+			for (const Attachment& attachment : plan.passes[position].attachments)
+				if (attachment.resource == resource)
+					return &attachment;
+			return nullptr;
+		};
+
+		// The shadow map takes its memory back from the LDR target of the previous frame, last sampled by the overlay
+		const Barrier* barrier = findBarrier(0, shadow);
+		check(barrier != nullptr && barrier->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && barrier->newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+			&& barrier->srcStages == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT && barrier->srcAccess == 0, "transient first use");
+		check(plan.passes[0].aliasBarrier.srcAccess == 0, "aliased read handoff");
+
+		// The depth takes its memory back from the storage writes of the scratch pass, a different image : they are flushed by
+		// a global barrier, the depth barrier only waits for them
+		barrier = findBarrier(1, depth);
+		check(barrier != nullptr && barrier->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && barrier->srcStages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT && barrier->srcAccess == 0, "aliased image barrier");
+		const AliasBarrier& aliasBarrier = plan.passes[1].aliasBarrier;
+		check(aliasBarrier.srcStages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT && aliasBarrier.srcAccess == VK_ACCESS_SHADER_WRITE_BIT
+			&& aliasBarrier.dstStages == (VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT)
+			&& aliasBarrier.dstAccess == (VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT), "aliased write handoff");
+
+		// Both reads of the lighting pass and its target go in one batch, the second read of the albedo needs nothing
+		check(plan.passes[2].barriers.size() == 3, "lighting barriers");
+		barrier = findBarrier(2, albedo);
+		check(barrier != nullptr && barrier->oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL && barrier->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			&& barrier->srcAccess == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT && barrier->dstAccess == VK_ACCESS_SHADER_READ_BIT, "read after write");
+		check(findBarrier(3, albedo) == nullptr && plan.passes[3].barriers.size() == 2, "read after read");
+
+		// The vertex stage was not in the scope of the barrier after the G-buffer, the overlay waits on that write again
+		barrier = findBarrier(4, albedo);
+		check(barrier != nullptr && barrier->oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && barrier->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			&& barrier->srcStages == VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT && barrier->srcAccess == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+			&& barrier->dstStages == VK_PIPELINE_STAGE_VERTEX_SHADER_BIT && barrier->dstAccess == VK_ACCESS_SHADER_READ_BIT, "read after read in new stages");
+
+		barrier = findBarrier(4, depth);
+		check(barrier != nullptr && barrier->newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL && (barrier->srcAccess & VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT) != 0, "read only depth");
+		barrier = findBarrier(4, backbuffer);
+		check(barrier != nullptr && barrier->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && barrier->srcStages == VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, "imported first use");
+		barrier = findBarrier(5, backbuffer);
+		check(barrier != nullptr && barrier->newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && barrier->srcAccess == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, "transfer after write");
+
+		// A read leaves nothing to flush before the present
+		check(plan.finalBarriers.size() == 1 && plan.finalBarriers[0].oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && plan.finalBarriers[0].newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+			&& plan.finalBarriers[0].srcAccess == 0, "final layout");
+
+		// Depth survives the G-buffer for the overlay test, nothing reads it after. The backbuffer is stored for the capture
+		const Attachment* attachment = findAttachment(1, depth);
+		check(attachment != nullptr && attachment->storeOp == VK_ATTACHMENT_STORE_OP_STORE, "depth store");
+		attachment = findAttachment(4, depth);
+		check(attachment != nullptr && attachment->loadOp == VK_ATTACHMENT_LOAD_OP_LOAD && attachment->storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE, "depth discard");
+		attachment = findAttachment(4, backbuffer);
+		check(attachment != nullptr && attachment->storeOp == VK_ATTACHMENT_STORE_OP_STORE, "backbuffer store");
+		check(plan.passes[5].attachments.empty(), "transfer pass attachments");
+
+		if (success)
+			std::cout << "Render graph self test passed" << std::endl;
+		return success;
+	}
+}
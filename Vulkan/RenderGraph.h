@@ -0,0 +1,238 @@
+#pragma once
+
+#include "Device.h"
+#include "RenderPassKey.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace Engine
+{
+	class GpuProfiler;
+
+	using RenderGraphResource = uint32_t;
+
+	enum class RenderGraphAccess
+	{
+		ColorAttachment,
+		DepthAttachment,
+		// Depth test without depth writes
+		DepthReadOnly,
+		SampledRead,
+		StorageRead,
+		StorageWrite,
+		TransferRead,
+		TransferWrite
+	};
+
+	struct RenderGraphPassContext
+	{
+		VkCommandBuffer commandBuffer;
+		// Begun before the callback and ended after it, null for passes without attachments
+		VkRenderPass renderPass;
+		VkFramebuffer framebuffer;
+		VkExtent2D extent;
+	};
+
+	struct RenderGraphStats
+	{
+		uint32_t passCount = 0;
+		uint32_t culledPassCount = 0;
+		// Image and memory barriers of one execution, a pass records all of its own with a single vkCmdPipelineBarrier
+		uint32_t barrierCount = 0;
+		uint32_t transientCount = 0;
+		// What the transients would take with one allocation each
+		VkDeviceSize transientBytes = 0;
+		VkDeviceSize allocatedBytes = 0;
+	};
+
+	// What a pass reads and writes, the graph derives its barriers, layouts, load/store ops and the lifetimes of the images
+	// from it. An image appears at most once per pass
+	class RenderGraphPass
+	{
+	public:
+		using Callback = std::function<void(const RenderGraphPassContext&)>;
+
+		// The name is a string literal, GPU profiler scopes keep it for frames
+		RenderGraphPass(const char* name, uint32_t index, Callback callback);
+
+		RenderGraphPass& WriteColor(RenderGraphResource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clearColor = {});
+		RenderGraphPass& WriteDepth(RenderGraphResource resource, VkAttachmentLoadOp loadOp, VkClearDepthStencilValue clearDepth = { 1.0f, 0 });
+		RenderGraphPass& ReadDepth(RenderGraphResource resource);
+		RenderGraphPass& ReadTexture(RenderGraphResource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		RenderGraphPass& ReadStorage(RenderGraphResource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		RenderGraphPass& WriteStorage(RenderGraphResource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		RenderGraphPass& ReadTransfer(RenderGraphResource resource);
+		RenderGraphPass& WriteTransfer(RenderGraphResource resource);
+		// Never culled, for passes whose results leave the graph another way (buffers, readbacks)
+		RenderGraphPass& SetSideEffects();
+		// The render pass is begun for vkCmdExecuteCommands only
+		RenderGraphPass& UseSecondaryCommandBuffers();
+
+		const char* GetName() const { return m_name; }
+		uint32_t GetIndex() const { return m_index; }
+
+	private:
+		friend class RenderGraph;
+
+		struct Use
+		{
+			RenderGraphResource resource;
+			RenderGraphAccess access;
+			VkPipelineStageFlags stages;
+			VkAttachmentLoadOp loadOp;
+			VkClearValue clearValue;
+		};
+
+		RenderGraphPass& AddUse(RenderGraphResource resource, RenderGraphAccess access, VkPipelineStageFlags stages, VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_LOAD, VkClearValue clearValue = {});
+
+	private:
+		const char* m_name;
+		uint32_t m_index;
+		Callback m_callback;
+		std::vector<Use> m_uses;
+		bool m_sideEffects = false;
+		bool m_secondaryCommandBuffers = false;
+	};
+
+	// Frame described as passes over images, declared once and compiled. Compile culls the passes nothing depends on, plans
+	// the barriers between the remaining ones in declaration order and places the transient images whose lifetimes do not
+	// overlap in the same memory. Imported images are what leaves the graph : every write to them is kept, their handles
+	// are set again before each execution. Transients live as long as the graph and are shared by all frames in flight,
+	// the first barrier of a frame waits on the last use of their memory. Render thread only
+	class RenderGraph
+	{
+	public:
+		RenderGraph(Device& device);
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		// The image is in initialLayout when the graph executes, its last writes are visible to initialStages. It is left in finalLayout
+		RenderGraphResource ImportImage(const char* name, VkFormat format, VkExtent2D extent, VkImageLayout initialLayout, VkPipelineStageFlags initialStages, VkImageLayout finalLayout);
+		RenderGraphResource CreateImage(const char* name, VkFormat format, VkExtent2D extent);
+		RenderGraphPass& AddPass(const char* name, RenderGraphPass::Callback callback);
+
+		void Compile();
+		void SetImportedImage(RenderGraphResource resource, VkImage image, VkImageView view);
+		void Execute(VkCommandBuffer commandBuffer, GpuProfiler* profiler = nullptr);
+
+		// Null for culled passes and passes without attachments. Pipelines created against it stay valid for any graph with a compatible key
+		VkRenderPass GetRenderPass(uint32_t pass) const;
+		RenderPassKey GetRenderPassKey(uint32_t pass) const;
+		const RenderGraphStats& GetStats() const { return m_stats; }
+
+		// CPU only checks of culling, barrier planning and aliasing, usable on machines without a GPU
+		static bool RunSelfTest();
+
+	private:
+		static constexpr uint32_t NOT_USED = ~0u;
+
+		struct ImageState
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			// Every access since the last barrier
+			VkPipelineStageFlags stages = 0;
+			VkAccessFlags access = 0;
+			bool write = false;
+			// Last write, later reads not covered by the barrier after it wait on it again
+			VkPipelineStageFlags writeStages = 0;
+			VkAccessFlags writeAccess = 0;
+		};
+
+		struct Resource
+		{
+			const char* name;
+			VkFormat format;
+			VkExtent2D extent;
+			bool imported;
+			ImageState initialState;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkImageUsageFlags usage = 0;
+			// Positions in the live pass order
+			uint32_t firstUse = NOT_USED;
+			uint32_t lastUse = NOT_USED;
+			uint32_t bucket = NOT_USED;
+		};
+
+		// Memory shared by transients with disjoint lifetimes, all bound at its start
+		struct Bucket
+		{
+			// By first use
+			std::vector<RenderGraphResource> resources;
+			VkMemoryRequirements requirements;
+			MemoryAllocation memory;
+		};
+
+		struct Barrier
+		{
+			RenderGraphResource resource;
+			VkImageLayout oldLayout, newLayout;
+			VkPipelineStageFlags srcStages, dstStages;
+			VkAccessFlags srcAccess, dstAccess;
+		};
+
+		// Image barriers only order the memory of their own image, writes to the previous image of a bucket are made
+		// available by a global barrier before the next one takes the memory
+		struct AliasBarrier
+		{
+			VkPipelineStageFlags srcStages = 0, dstStages = 0;
+			VkAccessFlags srcAccess = 0, dstAccess = 0;
+		};
+
+		struct Attachment
+		{
+			RenderGraphResource resource;
+			VkImageLayout layout;
+			VkAttachmentLoadOp loadOp;
+			VkAttachmentStoreOp storeOp;
+			VkClearValue clearValue;
+		};
+
+		struct PlannedPass
+		{
+			uint32_t pass;
+			std::vector<Barrier> barriers;
+			AliasBarrier aliasBarrier;
+			std::vector<Attachment> attachments;
+			VkExtent2D extent = {};
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			RenderPassKey renderPassKey;
+		};
+
+		struct Plan
+		{
+			std::vector<PlannedPass> passes;
+			// Imported images to their final layouts
+			std::vector<Barrier> finalBarriers;
+		};
+
+		// Device independent steps of Compile
+		static std::vector<uint32_t> Cull(const std::deque<RenderGraphPass>& passes, const std::vector<Resource>& resources);
+		static void ComputeUsage(const std::vector<uint32_t>& livePasses, const std::deque<RenderGraphPass>& passes, std::vector<Resource>& resources);
+		static std::vector<Bucket> Alias(std::vector<Resource>& resources, const std::vector<VkMemoryRequirements>& requirements);
+		static Plan PlanPasses(const std::vector<uint32_t>& livePasses, const std::deque<RenderGraphPass>& passes, const std::vector<Resource>& resources, const std::vector<Bucket>& buckets);
+
+		void CreateTransientImages();
+		void CreateRenderPasses();
+		void RecordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers, const AliasBarrier& aliasBarrier) const;
+
+	private:
+		Device& m_device;
+		std::vector<Resource> m_resources;
+		std::deque<RenderGraphPass> m_passes;
+		std::vector<Bucket> m_buckets;
+		Plan m_plan;
+		std::vector<uint32_t> m_plannedPasses;
+		RenderGraphStats m_stats;
+		bool m_compiled = false;
+	};
+}
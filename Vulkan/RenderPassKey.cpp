@@ -0,0 +1,75 @@
+#include "RenderPassKey.h"
+
+namespace Engine
+{
+	static RenderPassKey::AttachmentSlot ToSlot(const VkRenderPassCreateInfo& renderPassInfo, const VkAttachmentReference* reference)
+	{
+		RenderPassKey::AttachmentSlot slot;
+		if (reference == nullptr || reference->attachment == VK_ATTACHMENT_UNUSED)
+			return slot;
+
+		slot.format = renderPassInfo.pAttachments[reference->attachment].format;
+		slot.samples = renderPassInfo.pAttachments[reference->attachment].samples;
+		return slot;
+	}
+
+	static std::vector<RenderPassKey::AttachmentSlot> ToSlots(const VkRenderPassCreateInfo& renderPassInfo, const VkAttachmentReference* references, uint32_t count)
+	{
+		std::vector<RenderPassKey::AttachmentSlot> slots;
+		if (references == nullptr)
+			return slots;
+
+		for (uint32_t i = 0; i < count; i++)
+			slots.push_back(ToSlot(renderPassInfo, &references[i]));
+
+		// Trailing unused references do not change compatibility, drop them so both passes compare the same
+		while (!slots.empty() && slots.back() == RenderPassKey::AttachmentSlot())
+			slots.pop_back();
+		return slots;
+	}
+
+	bool RenderPassKey::Subpass::operator==(const Subpass& other) const
+	{
+		return bindPoint == other.bindPoint && inputs == other.inputs && colors == other.colors && resolves == other.resolves && depthStencil == other.depthStencil;
+	}
+
+	bool RenderPassKey::Dependency::operator==(const Dependency& other) const
+	{
+		return srcSubpass == other.srcSubpass && dstSubpass == other.dstSubpass && srcStageMask == other.srcStageMask && dstStageMask == other.dstStageMask
+			&& srcAccessMask == other.srcAccessMask && dstAccessMask == other.dstAccessMask && dependencyFlags == other.dependencyFlags;
+	}
+
+	RenderPassKey RenderPassKey::FromCreateInfo(const VkRenderPassCreateInfo& renderPassInfo)
+	{
+		RenderPassKey key;
+		for (uint32_t i = 0; i < renderPassInfo.subpassCount; i++)
+		{
+			const VkSubpassDescription& description = renderPassInfo.pSubpasses[i];
+
+			Subpass subpass;
+			subpass.bindPoint = description.pipelineBindPoint;
+			subpass.inputs = ToSlots(renderPassInfo, description.pInputAttachments, description.inputAttachmentCount);
+			subpass.colors = ToSlots(renderPassInfo, description.pColorAttachments, description.colorAttachmentCount);
+			subpass.resolves = ToSlots(renderPassInfo, description.pResolveAttachments, description.colorAttachmentCount);
+			subpass.depthStencil = ToSlot(renderPassInfo, description.pDepthStencilAttachment);
+			key.subpasses.push_back(subpass);
+		}
+
+		// Dependencies only take part in compatibility when the pass has more than one subpass
+		if (renderPassInfo.subpassCount > 1)
+		{
+			for (uint32_t i = 0; i < renderPassInfo.dependencyCount; i++)
+			{
+				const VkSubpassDependency& dependency = renderPassInfo.pDependencies[i];
+				key.dependencies.push_back({ dependency.srcSubpass, dependency.dstSubpass, dependency.srcStageMask, dependency.dstStageMask,
+					dependency.srcAccessMask, dependency.dstAccessMask, dependency.dependencyFlags });
+			}
+		}
+		return key;
+	}
+
+	bool RenderPassKey::IsCompatibleWith(const RenderPassKey& other) const
+	{
+		return !IsEmpty() && subpasses == other.subpasses && dependencies == other.dependencies;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+	// What the spec uses to decide if two render passes are compatible : the format and sample count behind every attachment reference
+	// of every subpass, and the dependencies when there are several subpasses. Load/store ops, layouts and the extent are ignored,
+	// so a pipeline created against one pass can be used with any pass sharing its key
+	struct RenderPassKey
+	{
+		struct AttachmentSlot
+		{
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			VkSampleCountFlagBits samples = static_cast<VkSampleCountFlagBits>(0);
+
+			bool operator==(const AttachmentSlot& other) const { return format == other.format && samples == other.samples; }
+		};
+
+		struct Subpass
+		{
+			VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			std::vector<AttachmentSlot> inputs;
+			std::vector<AttachmentSlot> colors;
+			std::vector<AttachmentSlot> resolves;
+			AttachmentSlot depthStencil;
+
+			bool operator==(const Subpass& other) const;
+		};
+
+		struct Dependency
+		{
+			uint32_t srcSubpass, dstSubpass;
+			VkPipelineStageFlags srcStageMask, dstStageMask;
+			VkAccessFlags srcAccessMask, dstAccessMask;
+			VkDependencyFlags dependencyFlags;
+
+			bool operator==(const Dependency& other) const;
+		};
+
+		std::vector<Subpass> subpasses;
+		std::vector<Dependency> dependencies;
+
+		static RenderPassKey FromCreateInfo(const VkRenderPassCreateInfo& renderPassInfo);
+		bool IsCompatibleWith(const RenderPassKey& other) const;
+		bool IsEmpty() const { return subpasses.empty(); }
+	};
+}
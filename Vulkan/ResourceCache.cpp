@@ -0,0 +1,306 @@
+#include "ResourceCache.h"
+#include "CpuProfiler.h"
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace Engine
+{
+	namespace
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
+		template<typename T>
+		void Push(std::vector<uint64_t>& key, T value)
+		{
+			if constexpr (std::is_pointer_v<T>)
+				key.push_back(reinterpret_cast<uint64_t>(value));
+			else if constexpr (std::is_same_v<T, float>)
+			{
+				uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				key.push_back(bits);
+			}
+			else
+				key.push_back(static_cast<uint64_t>(value));
+		}
+
+		void PushReferences(std::vector<uint64_t>& key, const VkAttachmentReference* references, uint32_t count)
+		{
+			Push(key, references != nullptr ? count : 0u);
+			for (uint32_t i = 0; references != nullptr && i < count; i++)
+			{
+				Push(key, references[i].attachment);
+				Push(key, references[i].layout);
+			}
+		}
+
+		double ElapsedMilliseconds(Clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+
+		void PrintCounters(const char* name, const ResourceCacheCounters& counters)
+		{
+			std::cout << "  " << name << " : " << counters.objectCount << " alive, " << counters.hits << " hits, " << counters.misses << " misses, "
+				<< counters.createMilliseconds << " ms creating" << std::endl;
+		}
+	}
+
+	size_t ResourceCache::KeyHash::operator()(const Key& key) const
+	{
+		return static_cast<size_t>(ShaderCache::Hash(key.data(), key.size() * sizeof(uint64_t)));
+	}
+
+	ResourceCache::ResourceCache(VkDevice device)
+		: m_device(device)
+	{
+	}
+
+	ResourceCache::~ResourceCache()
+	{
+		if (m_stats.samplers.hits + m_stats.imageViews.hits + m_stats.renderPasses.hits + m_stats.framebuffers.hits > 0)
+		{
+			std::cout << "Resource cache :" << std::endl;
+			PrintCounters("samplers     ", m_stats.samplers);
+			PrintCounters("image views  ", m_stats.imageViews);
+			PrintCounters("render passes", m_stats.renderPasses);
+			PrintCounters("framebuffers ", m_stats.framebuffers);
+		}
+
+		for (auto& [key, entry] : m_framebuffers)
+			vkDestroyFramebuffer(m_device, entry.framebuffer, nullptr);
+		for (auto& [key, entry] : m_imageViews)
+			vkDestroyImageView(m_device, entry.view, nullptr);
+		for (auto& [key, renderPass] : m_renderPasses)
+			vkDestroyRenderPass(m_device, renderPass, nullptr);
+		for (auto& [key, sampler] : m_samplers)
+			vkDestroySampler(m_device, sampler, nullptr);
+	}
+
+	VkSampler ResourceCache::GetSampler(const VkSamplerCreateInfo& samplerInfo)
+	{
+		assert(samplerInfo.pNext == nullptr && "Cached samplers cannot chain extension structures !");
+		Key key;
+		Push(key, samplerInfo.flags);
+		Push(key, samplerInfo.magFilter);
+		Push(key, samplerInfo.minFilter);
+		Push(key, samplerInfo.mipmapMode);
+		Push(key, samplerInfo.addressModeU);
+		Push(key, samplerInfo.addressModeV);
+		Push(key, samplerInfo.addressModeW);
+		Push(key, samplerInfo.mipLodBias);
+		Push(key, samplerInfo.anisotropyEnable);
+		Push(key, samplerInfo.maxAnisotropy);
+		Push(key, samplerInfo.compareEnable);
+		Push(key, samplerInfo.compareOp);
+		Push(key, samplerInfo.minLod);
+		Push(key, samplerInfo.maxLod);
+		Push(key, samplerInfo.borderColor);
+		Push(key, samplerInfo.unnormalizedCoordinates);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_samplers.find(key);
+		if (it != m_samplers.end())
+		{
+			m_stats.samplers.hits++;
+			return it->second;
+		}
+
+		auto start = Clock::now();
+		VkSampler sampler;
+		if (vkCreateSampler(m_device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create sampler !");
+		m_stats.samplers.createMilliseconds += ElapsedMilliseconds(start);
+		m_stats.samplers.misses++;
+		m_stats.samplers.objectCount++;
+		m_samplers.emplace(std::move(key), sampler);
+		return sampler;
+	}
+
+	VkImageView ResourceCache::GetImageView(const VkImageViewCreateInfo& viewInfo)
+	{
+		assert(viewInfo.pNext == nullptr && "Cached image views cannot chain extension structures !");
+		Key key;
+		Push(key, viewInfo.flags);
+		Push(key, viewInfo.image);
+		Push(key, viewInfo.viewType);
+		Push(key, viewInfo.format);
+		Push(key, viewInfo.components.r);
+		Push(key, viewInfo.components.g);
+		Push(key, viewInfo.components.b);
+		Push(key, viewInfo.components.a);
+		Push(key, viewInfo.subresourceRange.aspectMask);
+		Push(key, viewInfo.subresourceRange.baseMipLevel);
+		Push(key, viewInfo.subresourceRange.levelCount);
+		Push(key, viewInfo.subresourceRange.baseArrayLayer);
+		Push(key, viewInfo.subresourceRange.layerCount);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_imageViews.find(key);
+		if (it != m_imageViews.end())
+		{
+			m_stats.imageViews.hits++;
+			return it->second.view;
+		}
+
+		auto start = Clock::now();
+		VkImageView view;
+		if (vkCreateImageView(m_device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create image view !");
+		m_stats.imageViews.createMilliseconds += ElapsedMilliseconds(start);
+		m_stats.imageViews.misses++;
+		m_stats.imageViews.objectCount++;
+		m_imageViews.emplace(std::move(key), ImageViewEntry{ view, viewInfo.image });
+		return view;
+	}
+
+	VkRenderPass ResourceCache::GetRenderPass(const VkRenderPassCreateInfo& renderPassInfo)
+	{
+		assert(renderPassInfo.pNext == nullptr && "Cached render passes cannot chain extension structures !");
+		Key key;
+		Push(key, renderPassInfo.flags);
+		Push(key, renderPassInfo.attachmentCount);
+		for (uint32_t i = 0; i < renderPassInfo.attachmentCount; i++)
+		{
+			const VkAttachmentDescription& attachment = renderPassInfo.pAttachments[i];
+			Push(key, attachment.flags);
+			Push(key, attachment.format);
+			Push(key, attachment.samples);
+			Push(key, attachment.loadOp);
+			Push(key, attachment.storeOp);
+			Push(key, attachment.stencilLoadOp);
+			Push(key, attachment.stencilStoreOp);
+			Push(key, attachment.initialLayout);
+			Push(key, attachment.finalLayout);
+		}
+
+		Push(key, renderPassInfo.subpassCount);
+		for (uint32_t i = 0; i < renderPassInfo.subpassCount; i++)
+		{
+			const VkSubpassDescription& subpass = renderPassInfo.pSubpasses[i];
+			Push(key, subpass.flags);
+			Push(key, subpass.pipelineBindPoint);
+			PushReferences(key, subpass.pInputAttachments, subpass.inputAttachmentCount);
+			PushReferences(key, subpass.pColorAttachments, subpass.colorAttachmentCount);
+			PushReferences(key, subpass.pResolveAttachments, subpass.colorAttachmentCount);
+			PushReferences(key, subpass.pDepthStencilAttachment, 1);
+			Push(key, subpass.preserveAttachmentCount);
+			for (uint32_t j = 0; j < subpass.preserveAttachmentCount; j++)
+				Push(key, subpass.pPreserveAttachments[j]);
+		}
+
+		Push(key, renderPassInfo.dependencyCount);
+		for (uint32_t i = 0; i < renderPassInfo.dependencyCount; i++)
+		{
+			const VkSubpassDependency& dependency = renderPassInfo.pDependencies[i];
+			Push(key, dependency.srcSubpass);
+			Push(key, dependency.dstSubpass);
+			Push(key, dependency.srcStageMask);
+			Push(key, dependency.dstStageMask);
+			Push(key, dependency.srcAccessMask);
+			Push(key, dependency.dstAccessMask);
+			Push(key, dependency.dependencyFlags);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_renderPasses.find(key);
+		if (it != m_renderPasses.end())
+		{
+			m_stats.renderPasses.hits++;
+			return it->second;
+		}
+
+		auto start = Clock::now();
+		VkRenderPass renderPass;
+		if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create render pass !");
+		m_stats.renderPasses.createMilliseconds += ElapsedMilliseconds(start);
+		m_stats.renderPasses.misses++;
+		m_stats.renderPasses.objectCount++;
+		m_renderPasses.emplace(std::move(key), renderPass);
+		return renderPass;
+	}
+
+	VkFramebuffer ResourceCache::GetFramebuffer(const VkFramebufferCreateInfo& framebufferInfo)
+	{
+		assert(framebufferInfo.pNext == nullptr && "Cached framebuffers cannot chain extension structures !");
+		Key key;
+		Push(key, framebufferInfo.flags);
+		Push(key, framebufferInfo.renderPass);
+		Push(key, framebufferInfo.attachmentCount);
+		for (uint32_t i = 0; i < framebufferInfo.attachmentCount; i++)
+			Push(key, framebufferInfo.pAttachments[i]);
+		Push(key, framebufferInfo.width);
+		Push(key, framebufferInfo.height);
+		Push(key, framebufferInfo.layers);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_framebuffers.find(key);
+		if (it != m_framebuffers.end())
+		{
+			m_stats.framebuffers.hits++;
+			return it->second.framebuffer;
+		}
+
+		auto start = Clock::now();
+		VkFramebuffer framebuffer;
+		if (vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create framebuffer !");
+		m_stats.framebuffers.createMilliseconds += ElapsedMilliseconds(start);
+		m_stats.framebuffers.misses++;
+		m_stats.framebuffers.objectCount++;
+		FramebufferEntry entry = { framebuffer, std::vector<VkImageView>(framebufferInfo.pAttachments, framebufferInfo.pAttachments + framebufferInfo.attachmentCount) };
+		m_framebuffers.emplace(std::move(key), std::move(entry));
+		return framebuffer;
+	}
+
+	void ResourceCache::ReleaseImage(VkImage image)
+	{
+		PROFILE_FUNCTION();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::vector<VkImageView> views;
+		for (auto it = m_imageViews.begin(); it != m_imageViews.end();)
+		{
+			if (it->second.image != image)
+			{
+				++it;
+				continue;
+			}
+			views.push_back(it->second.view);
+			it = m_imageViews.erase(it);
+		}
+		if (views.empty())
+			return;
+
+		// A framebuffer is invalid as soon as one of its attachments is destroyed
+		for (auto it = m_framebuffers.begin(); it != m_framebuffers.end();)
+		{
+			const std::vector<VkImageView>& attachments = it->second.attachments;
+			if (std::none_of(attachments.begin(), attachments.end(), [&](VkImageView view) { return std::find(views.begin(), views.end(), view) != views.end(); }))
+			{
+				++it;
+				continue;
+			}
+			vkDestroyFramebuffer(m_device, it->second.framebuffer, nullptr);
+			m_stats.framebuffers.objectCount--;
+			it = m_framebuffers.erase(it);
+		}
+
+		for (VkImageView view : views)
+			vkDestroyImageView(m_device, view, nullptr);
+		m_stats.imageViews.objectCount -= static_cast<uint32_t>(views.size());
+	}
+
+	ResourceCacheStats ResourceCache::GetStats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine
+{
+	struct ResourceCacheCounters
+	{
+		uint32_t objectCount = 0;
+		// Requests served by an object created earlier from an identical create info
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		// Spent in the driver by the misses
+		double createMilliseconds = 0.0;
+	};
+
+	struct ResourceCacheStats
+	{
+		ResourceCacheCounters samplers;
+		ResourceCacheCounters imageViews;
+		ResourceCacheCounters renderPasses;
+		ResourceCacheCounters framebuffers;
+	};
+
+	// Hash consed samplers, image views, render passes and framebuffers : every create info field is part of the key, so
+	// identical requests get the same object and only the first one reaches the driver. The cache owns the objects, callers
+	// never destroy them. Samplers and render passes live as long as the device, a recreated swap chain gets its render
+	// pass back. Views and framebuffers name their images, call ReleaseImage before destroying an image since the driver
+	// may give its handle to the next one. Extension structures are not hashed, create infos must not chain any. Thread safe
+	class ResourceCache
+	{
+	public:
+		ResourceCache(VkDevice device);
+		~ResourceCache();
+
+		ResourceCache(const ResourceCache&) = delete;
+		ResourceCache& operator=(const ResourceCache&) = delete;
+
+		VkSampler GetSampler(const VkSamplerCreateInfo& samplerInfo);
+		VkImageView GetImageView(const VkImageViewCreateInfo& viewInfo);
+		VkRenderPass GetRenderPass(const VkRenderPassCreateInfo& renderPassInfo);
+		VkFramebuffer GetFramebuffer(const VkFramebufferCreateInfo& framebufferInfo);
+
+		// Destroys the views of the image and the framebuffers using them, the GPU must be done with all of them
+		void ReleaseImage(VkImage image);
+
+		ResourceCacheStats GetStats();
+
+	private:
+		// Create info fields widened to 64 bits, handles included
+		using Key = std::vector<uint64_t>;
+
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const;
+		};
+
+		struct ImageViewEntry
+		{
+			VkImageView view;
+			VkImage image;
+		};
+
+		struct FramebufferEntry
+		{
+			VkFramebuffer framebuffer;
+			std::vector<VkImageView> attachments;
+		};
+
+	private:
+		VkDevice m_device;
+
+		std::mutex m_mutex;
+		std::unordered_map<Key, VkSampler, KeyHash> m_samplers;
+		std::unordered_map<Key, ImageViewEntry, KeyHash> m_imageViews;
+		std::unordered_map<Key, VkRenderPass, KeyHash> m_renderPasses;
+		std::unordered_map<Key, FramebufferEntry, KeyHash> m_framebuffers;
+		ResourceCacheStats m_stats;
+	};
+}
@@ -0,0 +1,93 @@
+#include "ShaderCache.h"
+#include "CpuProfiler.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace Engine
+{
+	ShaderCache::ShaderCache(VkDevice device)
+		: m_device(device)
+	{
+	}
+
+	ShaderCache::~ShaderCache()
+	{
+		if (m_stats.hits + m_stats.misses > 0)
+			std::cout << "Shader cache : " << m_stats.moduleCount << " modules, " << m_stats.hits << " hits, " << m_stats.misses << " misses" << std::endl;
+		for (auto& [hash, entries] : m_modules)
+			for (Entry& entry : entries)
+				vkDestroyShaderModule(m_device, entry.module, nullptr);
+	}
+
+	VkShaderModule ShaderCache::GetModule(const std::string& path)
+	{
+		PROFILE_FUNCTION();
+		return GetModule(ReadSpirv(path));
+	}
+
+	VkShaderModule ShaderCache::GetModule(const std::vector<uint32_t>& code)
+	{
+		uint64_t hash = Hash(code.data(), code.size() * sizeof(uint32_t));
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::vector<Entry>& entries = m_modules[hash];
+		for (const Entry& entry : entries)
+			if (entry.code == code)
+			{
+				m_stats.hits++;
+				return entry.module;
+			}
+
+		VkShaderModuleCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size() * sizeof(uint32_t);
+		createInfo.pCode = code.data();
+
+		VkShaderModule module;
+		if (vkCreateShaderModule(m_device, &createInfo, nullptr, &module) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create shader module !");
+
+		m_stats.misses++;
+		m_stats.moduleCount++;
+		entries.push_back({ code, module });
+		return module;
+	}
+
+	ShaderCacheStats ShaderCache::GetStats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	std::vector<uint32_t> ShaderCache::ReadSpirv(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open file : " + path);
+
+		// Read as words, vkCreateShaderModule wants its code 4 byte aligned
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0)
+			throw std::runtime_error(path + " is not a SPIR-V module !");
+
+		std::vector<uint32_t> code(fileSize / sizeof(uint32_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(fileSize));
+		if (!file.good())
+			throw std::runtime_error("Failed to read file : " + path);
+		return code;
+	}
+
+	uint64_t ShaderCache::Hash(const void* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= static_cast<const uint8_t*>(data)[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
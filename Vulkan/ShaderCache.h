@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine
+{
+	struct ShaderCacheStats
+	{
+		uint32_t moduleCount = 0;
+		// Requests served by a module created earlier from the same SPIR-V, whatever the file it came from
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+	};
+
+	// Shader modules keyed by a hash of their SPIR-V, a hit is compared word for word with the code kept by the entry. Pipelines sharing a shader, or rebuilt with an unchanged one, reuse the
+	// same module instead of reading and creating it again. Modules are kept until the cache is destroyed, a module replaced
+	// by a hot reload stays too, a development session only creates a handful
+	class ShaderCache
+	{
+	public:
+		ShaderCache(VkDevice device);
+		~ShaderCache();
+
+		ShaderCache(const ShaderCache&) = delete;
+		ShaderCache& operator=(const ShaderCache&) = delete;
+
+		// Reads the file on every call, so a changed file gives a new module. Thread safe
+		VkShaderModule GetModule(const std::string& path);
+		VkShaderModule GetModule(const std::vector<uint32_t>& code);
+
+		ShaderCacheStats GetStats();
+
+		// Throws if the file cannot be read or is not made of 32 bit words
+		static std::vector<uint32_t> ReadSpirv(const std::string& path);
+		// 64 bit FNV-1a
+		static uint64_t Hash(const void* data, size_t size);
+
+	private:
+		struct Entry
+		{
+			std::vector<uint32_t> code;
+			VkShaderModule module;
+		};
+
+		VkDevice m_device;
+
+		std::mutex m_mutex;
+		// Modules whose code collides on the hash share a bucket
+		std::unordered_map<uint64_t, std::vector<Entry>> m_modules;
+		ShaderCacheStats m_stats;
+	};
+}
@@ -0,0 +1,168 @@
+#include "ShaderHotReload.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace Engine
+{
+	ShaderHotReload::ShaderHotReload(Device& device, uint32_t framesInFlight, const std::string& compiler)
+		: m_device(device), m_framesInFlight(framesInFlight), m_compiler(compiler)
+	{
+		m_thread = std::thread(&ShaderHotReload::WatchLoop, this);
+	}
+
+	ShaderHotReload::~ShaderHotReload()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_condition.notify_all();
+		m_thread.join();
+
+		for (const RetiredPipeline& retired : m_retired)
+			vkDestroyPipeline(m_device.GetDevice(), retired.pipeline, nullptr);
+	}
+
+	void ShaderHotReload::Watch(Pipeline& pipeline)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pipelines.push_back(&pipeline);
+		AddFile(pipeline.GetVertexShaderPath());
+		AddFile(pipeline.GetFragmentShaderPath());
+	}
+
+	void ShaderHotReload::Unwatch(Pipeline& pipeline)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_pipelines.erase(std::remove(m_pipelines.begin(), m_pipelines.end(), &pipeline), m_pipelines.end());
+		// A rebuild in progress still uses the pipeline, the caller destroys it once this returns
+		m_condition.wait(lock, [&]() { return m_rebuilding != &pipeline; });
+
+		// A pending rebuild is destroyed with the pipeline
+		std::lock_guard<std::mutex> reloadedLock(m_reloadedMutex);
+		m_reloaded.erase(std::remove(m_reloaded.begin(), m_reloaded.end(), &pipeline), m_reloaded.end());
+	}
+
+	void ShaderHotReload::Update(uint64_t frameNumber)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_reloadedMutex);
+			for (Pipeline* pipeline : m_reloaded)
+			{
+				VkPipeline replaced = pipeline->SwapPending();
+				if (replaced == VK_NULL_HANDLE)
+					continue;
+				m_retired.push_back({ replaced, frameNumber });
+				m_reloadCount++;
+			}
+			m_reloaded.clear();
+		}
+
+		// Replaced before frame N, last recorded by frame N - 1 which completed once frame N - 1 + framesInFlight starts
+		auto completed = [&](const RetiredPipeline& retired) { return frameNumber + 1 >= retired.frameNumber + m_framesInFlight; };
+		for (const RetiredPipeline& retired : m_retired)
+			if (completed(retired))
+				vkDestroyPipeline(m_device.GetDevice(), retired.pipeline, nullptr);
+		m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(), completed), m_retired.end());
+	}
+
+	void ShaderHotReload::AddFile(const std::string& spirvPath)
+	{
+		if (m_files.count(spirvPath) != 0)
+			return;
+
+		// Current times are the baseline, only later edits trigger a reload
+		WatchedFile file;
+		std::filesystem::path source = spirvPath;
+		if (source.extension() == ".spv")
+			file.sourcePath = source.replace_extension().string();
+		Poll(spirvPath, file);
+		m_files.emplace(spirvPath, file);
+	}
+
+	bool ShaderHotReload::Poll(const std::string& spirvPath, WatchedFile& file)
+	{
+		std::error_code error;
+		if (!file.sourcePath.empty())
+		{
+			auto sourceTime = std::filesystem::last_write_time(file.sourcePath, error);
+			if (!error && sourceTime != file.sourceTime)
+			{
+				bool firstPoll = file.sourceTime == std::filesystem::file_time_type();
+				file.sourceTime = sourceTime;
+				// A failed compilation leaves the SPIR-V untouched, the next edit of the source tries again
+				if (!firstPoll)
+					Compile(file.sourcePath, spirvPath);
+			}
+		}
+
+		auto spirvTime = std::filesystem::last_write_time(spirvPath, error);
+		if (error || spirvTime == file.spirvTime)
+			return false;
+		bool changed = file.spirvTime != std::filesystem::file_time_type();
+		file.spirvTime = spirvTime;
+		return changed;
+	}
+
+	bool ShaderHotReload::Compile(const std::string& sourcePath, const std::string& spirvPath)
+	{
+		PROFILE_FUNCTION();
+		std::string command = m_compiler + " \"" + sourcePath + "\" -o \"" + spirvPath + "\"";
+		std::cout << "Shader hot reload : " << command << std::endl;
+		if (std::system(command.c_str()) != 0)
+		{
+			std::cerr << "Shader hot reload : compiling " << sourcePath << " failed, the current pipelines are kept" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void ShaderHotReload::WatchLoop()
+	{
+		PROFILE_THREAD_NAME("ShaderHotReload");
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_condition.wait_for(lock, POLL_INTERVAL, [&]() { return m_stopping; }))
+		{
+			// Polled and compiled on a copy, Watch and Unwatch never wait for the compiler
+			std::map<std::string, WatchedFile> files = m_files;
+			lock.unlock();
+			std::vector<std::string> changed;
+			for (auto& [spirvPath, file] : files)
+				if (Poll(spirvPath, file))
+					changed.push_back(spirvPath);
+			lock.lock();
+
+			for (const auto& [spirvPath, file] : files)
+				m_files[spirvPath] = file;
+			if (changed.empty())
+				continue;
+
+			// The shader cache hashes the new SPIR-V, an unchanged stage reuses its module
+			std::vector<Pipeline*> pipelines = m_pipelines;
+			for (Pipeline* pipeline : pipelines)
+			{
+				bool usesChanged = std::find(changed.begin(), changed.end(), pipeline->GetVertexShaderPath()) != changed.end()
+					|| std::find(changed.begin(), changed.end(), pipeline->GetFragmentShaderPath()) != changed.end();
+				// Skips pipelines unwatched while another one was rebuilt
+				if (!usesChanged || std::find(m_pipelines.begin(), m_pipelines.end(), pipeline) == m_pipelines.end())
+					continue;
+
+				m_rebuilding = pipeline;
+				lock.unlock();
+				bool reloaded = pipeline->Reload();
+				lock.lock();
+				m_rebuilding = nullptr;
+				m_condition.notify_all();
+				if (!reloaded)
+					continue;
+
+				std::lock_guard<std::mutex> reloadedLock(m_reloadedMutex);
+				if (std::find(m_reloaded.begin(), m_reloaded.end(), pipeline) == m_reloaded.end())
+					m_reloaded.push_back(pipeline);
+			}
+		}
+	}
+}
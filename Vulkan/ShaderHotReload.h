@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Device.h"
+#include "Pipeline.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Engine
+{
+	// Watches the shaders of the registered pipelines. A thread polls their GLSL sources (the SPIR-V path without ".spv") and
+	// the SPIR-V files, recompiles changed sources and rebuilds the pipelines using them, all off the render thread. Update
+	// swaps the rebuilt pipelines in at the start of a frame, draws use the old one until then and the frame never waits
+	class ShaderHotReload
+	{
+	public:
+		static constexpr std::chrono::milliseconds POLL_INTERVAL{ 250 };
+
+		// compiler is invoked as : compiler "source" -o "spirv"
+		ShaderHotReload(Device& device, uint32_t framesInFlight, const std::string& compiler = "glslc");
+		// Pipelines replaced by a reload are destroyed, the GPU must be idle
+		~ShaderHotReload();
+
+		ShaderHotReload(const ShaderHotReload&) = delete;
+		ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+
+		// The pipeline must be unwatched before it is destroyed. Unwatch waits for a rebuild of that pipeline in progress, never
+		// for a shader compilation
+		void Watch(Pipeline& pipeline);
+		void Unwatch(Pipeline& pipeline);
+
+		// Render thread, once the fence of the frame is signaled and before recording : swaps in the rebuilt pipelines and
+		// destroys the replaced ones no frame in flight can use anymore
+		void Update(uint64_t frameNumber);
+		uint32_t GetReloadCount() const { return m_reloadCount; }
+
+	private:
+		struct WatchedFile
+		{
+			std::string sourcePath;
+			std::filesystem::file_time_type sourceTime;
+			std::filesystem::file_time_type spirvTime;
+		};
+
+		struct RetiredPipeline
+		{
+			VkPipeline pipeline;
+			uint64_t frameNumber;
+		};
+
+		void WatchLoop();
+		void AddFile(const std::string& spirvPath);
+		// Returns whether the SPIR-V file changed since the last poll
+		bool Poll(const std::string& spirvPath, WatchedFile& file);
+		bool Compile(const std::string& sourcePath, const std::string& spirvPath);
+
+	private:
+		Device& m_device;
+		uint32_t m_framesInFlight;
+		std::string m_compiler;
+
+		// Guards the watch lists only, the watch thread releases it while compiling and rebuilding
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stopping = false;
+		std::vector<Pipeline*> m_pipelines;
+		std::map<std::string, WatchedFile> m_files;
+		// Rebuilt outside the lock, Unwatch waits until it is another one
+		Pipeline* m_rebuilding = nullptr;
+
+		// Rebuilt pipelines waiting for Update, only touched by the render thread and the watch thread under this lock
+		std::mutex m_reloadedMutex;
+		std::vector<Pipeline*> m_reloaded;
+
+		std::vector<RetiredPipeline> m_retired;
+		uint32_t m_reloadCount = 0;
+		std::thread m_thread;
+	};
+}
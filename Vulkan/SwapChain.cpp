@@ -1,6 +1,8 @@
 #include "SwapChain.h"
+#include "CpuProfiler.h"
 
-#include <array>
+#include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -10,14 +12,14 @@
 
 namespace Engine {
 
-	SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent)
-		: m_device{ deviceRef }, m_windowExtent{ extent }
+	SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, uint32_t framesInFlight)
+		: m_device{ deviceRef }, m_windowExtent{ extent }, m_framesInFlight(framesInFlight)
 	{
 		Init();
 	}
 
-	SwapChain::SwapChain(Device& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous)
-		: m_device(deviceRef), m_windowExtent(windowExtent), m_oldSwapChain(previous)
+	SwapChain::SwapChain(Device& deviceRef, VkExtent2D windowExtent, uint32_t framesInFlight, std::shared_ptr<SwapChain> previous)
+		: m_device(deviceRef), m_windowExtent(windowExtent), m_framesInFlight(framesInFlight), m_oldSwapChain(previous)
 	{
 		Init();
 		m_oldSwapChain = nullptr;
@@ -25,8 +27,10 @@ namespace Engine {
 
 	SwapChain::~SwapChain()
 	{
-		for (auto imageView : m_swapChainImageViews)
-			vkDestroyImageView(m_device.GetDevice(), imageView, nullptr);
+		// Views belong to the resource cache, they go away with the images they name along with the framebuffers of the render graph
+		ResourceCache& resourceCache = m_device.GetResourceCache();
+		for (auto image : m_swapChainImages)
+			resourceCache.ReleaseImage(image);
 		m_swapChainImageViews.clear();
 
 		if (m_swapChain != nullptr)
@@ -35,40 +39,58 @@ namespace Engine {
 			m_swapChain = nullptr;
 		}
 
-		for (int i = 0; i < m_depthImages.size(); i++)
+		for (size_t i = 0; i < m_offscreenImageMemorys.size(); i++)
 		{
-			vkDestroyImageView(m_device.GetDevice(), m_depthImageViews[i], nullptr);
-			vkDestroyImage(m_device.GetDevice(), m_depthImages[i], nullptr);
-			vkFreeMemory(m_device.GetDevice(), m_depthImageMemorys[i], nullptr);
+			vkDestroyImage(m_device.GetDevice(), m_swapChainImages[i], nullptr);
+			m_device.FreeMemory(m_offscreenImageMemorys[i]);
 		}
 
-		for (auto framebuffer : m_swapChainFramebuffers)
-			vkDestroyFramebuffer(m_device.GetDevice(), framebuffer, nullptr);
-		vkDestroyRenderPass(m_device.GetDevice(), m_renderPass, nullptr);
-
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		for (size_t i = 0; i < m_framesInFlight; i++)
 		{
-			vkDestroySemaphore(m_device.GetDevice(), m_renderFinishedSemaphores[i], nullptr);
 			vkDestroySemaphore(m_device.GetDevice(), m_imageAvailableSemaphores[i], nullptr);
 			vkDestroyFence(m_device.GetDevice(), m_inFlightFences[i], nullptr);
 		}
+		for (auto semaphore : m_renderFinishedSemaphores)
+			vkDestroySemaphore(m_device.GetDevice(), semaphore, nullptr);
 	}
 
 	VkResult SwapChain::AcquireNextImage(uint32_t* imageIndex)
 	{
+		PROFILE_FUNCTION();
+		auto waitStart = std::chrono::high_resolution_clock::now();
 		vkWaitForFences(m_device.GetDevice(), 1, &m_inFlightFences[m_currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		m_lastFenceWaitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+
+		// Offscreen images belong to a frame in flight, the fence above is the only thing to wait for
+		if (m_offscreen)
+		{
+			*imageIndex = static_cast<uint32_t>(m_currentFrame);
+			return VK_SUCCESS;
+		}
+
+		// The frame fence is all we wait on : resources are keyed by frame in flight, so the GPU is done with them once it is signaled
 		return vkAcquireNextImageKHR(m_device.GetDevice(), m_swapChain, std::numeric_limits<uint64_t>::max(), m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, imageIndex);
 	}
 
 	VkResult SwapChain::SubmitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex)
 	{
-		if (m_imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
-			vkWaitForFences(m_device.GetDevice(), 1, &m_imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-		m_imagesInFlight[*imageIndex] = m_inFlightFences[m_currentFrame];
-
+		PROFILE_FUNCTION();
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+		if (m_offscreen)
+		{
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = buffers;
+
+			vkResetFences(m_device.GetDevice(), 1, &m_inFlightFences[m_currentFrame]);
+			if (m_device.QueueSubmit(m_device.GraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS)
+				throw std::runtime_error("Failed to submit draw command buffer !");
+
+			m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
+			return VK_SUCCESS;
+		}
+
 		VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphores[m_currentFrame] };
 		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		submitInfo.waitSemaphoreCount = 1;
@@ -77,12 +99,12 @@ namespace Engine {
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = buffers;
 
-		VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[m_currentFrame] };
+		VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[*imageIndex] };
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
 		vkResetFences(m_device.GetDevice(), 1, &m_inFlightFences[m_currentFrame]);
-		if (vkQueueSubmit(m_device.GraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS)
+		if (m_device.QueueSubmit(m_device.GraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS)
 			throw std::runtime_error("Failed to submit draw command buffer !");
 
 		VkPresentInfoKHR presentInfo = {};
@@ -94,24 +116,29 @@ namespace Engine {
 		presentInfo.pSwapchains = swapChains;
 		presentInfo.pImageIndices = imageIndex;
 
-		auto result = vkQueuePresentKHR(m_device.PresentQueue(), &presentInfo);
-		m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		auto result = m_device.QueuePresent(presentInfo);
+		m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
 
 		return result;
 	}
 
 	void SwapChain::Init()
 	{
+		PROFILE_FUNCTION();
 		CreateSwapChain();
 		CreateImageViews();
-		CreateRenderPass();
-		CreateDepthResources();
-		CreateFramebuffers();
 		CreateSyncObjects();
 	}
 
 	void SwapChain::CreateSwapChain()
 	{
+		m_offscreen = !m_device.CanPresent();
+		if (m_offscreen)
+		{
+			CreateOffscreenImages();
+			return;
+		}
+
 		SwapChainSupportDetails swapChainSupport = m_device.GetSwapChainSupport();
 		VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
 		VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.presentModes);
@@ -131,6 +158,11 @@ namespace Engine {
 		createInfo.imageArrayLayers = 1;
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+		// Needed to read frames back, headless surfaces of software drivers support it
+		m_readbackSupported = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+		if (m_readbackSupported)
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
 		QueueFamilyIndices indices = m_device.FindPhysicalQueueFamilies();
 		uint32_t queueFamilyIndices[] = { indices.graphicsFamily, indices.presentFamily };
 
@@ -168,158 +200,109 @@ namespace Engine {
 		m_swapChainExtent = extent;
 	}
 
-	void SwapChain::CreateImageViews()
+	void SwapChain::CreateOffscreenImages()
 	{
-		m_swapChainImageViews.resize(m_swapChainImages.size());
-		for (size_t i = 0; i < m_swapChainImages.size(); i++)
-		{
-			VkImageViewCreateInfo viewInfo = {};
-			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			viewInfo.image = m_swapChainImages[i];
-			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			viewInfo.format = m_swapChainImageFormat;
-			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			viewInfo.subresourceRange.baseMipLevel = 0;
-			viewInfo.subresourceRange.levelCount = 1;
-			viewInfo.subresourceRange.baseArrayLayer = 0;
-			viewInfo.subresourceRange.layerCount = 1;
-
-			if (vkCreateImageView(m_device.GetDevice(), &viewInfo, nullptr, &m_swapChainImageViews[i]) != VK_SUCCESS)
-				throw std::runtime_error("failed to create texture image view!");
-		}
-	}
-
-	void SwapChain::CreateRenderPass()
-	{
-		VkAttachmentDescription depthAttachment = {};
-		depthAttachment.format = FindDepthFormat();
-		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference depthAttachmentRef = {};
-		depthAttachmentRef.attachment = 1;
-		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentDescription colorAttachment = {};
-		colorAttachment.format = GetSwapChainImageFormat();
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkAttachmentReference colorAttachmentRef = {};
-		colorAttachmentRef.attachment = 0;
-		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef;
-		subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.srcAccessMask = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstSubpass = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-		std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
-		VkRenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		renderPassInfo.pAttachments = attachments.data();
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
-
-		if (vkCreateRenderPass(m_device.GetDevice(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create render pass !");
-	}
-
-	void SwapChain::CreateFramebuffers()
-	{
-		m_swapChainFramebuffers.resize(ImageCount());
-		for (size_t i = 0; i < ImageCount(); i++)
-		{
-			std::array<VkImageView, 2> attachments = { m_swapChainImageViews[i], m_depthImageViews[i] };
-
-			VkExtent2D swapChainExtent = GetSwapChainExtent();
-			VkFramebufferCreateInfo framebufferInfo = {};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = m_renderPass;
-			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-			framebufferInfo.pAttachments = attachments.data();
-			framebufferInfo.width = swapChainExtent.width;
-			framebufferInfo.height = swapChainExtent.height;
-			framebufferInfo.layers = 1;
-
-			if (vkCreateFramebuffer(m_device.GetDevice(), &framebufferInfo, nullptr, &m_swapChainFramebuffers[i]) != VK_SUCCESS)
-				throw std::runtime_error("Failed to create framebuffer !");
-		}
-	}
-
-	void SwapChain::CreateDepthResources()
-	{
-		VkFormat depthFormat = FindDepthFormat();
-		VkExtent2D swapChainExtent = GetSwapChainExtent();
-
-		m_depthImages.resize(ImageCount());
-		m_depthImageMemorys.resize(ImageCount());
-		m_depthImageViews.resize(ImageCount());
-
-		for (int i = 0; i < m_depthImages.size(); i++)
+		m_swapChainImageFormat = m_device.FindSupportedFormat({ VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM },
+			VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+		m_swapChainExtent = m_windowExtent;
+		m_readbackSupported = true;
+
+		m_swapChainImages.resize(m_framesInFlight);
+		m_offscreenImageMemorys.resize(m_framesInFlight);
+		for (uint32_t i = 0; i < m_framesInFlight; i++)
 		{
 			VkImageCreateInfo imageInfo = {};
 			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 			imageInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageInfo.extent.width = swapChainExtent.width;
-			imageInfo.extent.height = swapChainExtent.height;
+			imageInfo.extent.width = m_swapChainExtent.width;
+			imageInfo.extent.height = m_swapChainExtent.height;
 			imageInfo.extent.depth = 1;
 			imageInfo.mipLevels = 1;
 			imageInfo.arrayLayers = 1;
-			imageInfo.format = depthFormat;
+			imageInfo.format = m_swapChainImageFormat;
 			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageInfo.flags = 0;
 
-			m_device.CreateImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImages[i], m_depthImageMemorys[i]);
+			m_device.CreateImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_swapChainImages[i], m_offscreenImageMemorys[i]);
+		}
+	}
+
+	void SwapChain::RecordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkBuffer dstBuffer)
+	{
+		assert(m_readbackSupported && "Swap chain images cannot be read back !");
+
+		VkImageLayout renderedLayout = m_offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		VkImageMemoryBarrier toTransfer = {};
+		toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		toTransfer.oldLayout = renderedLayout;
+		toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.image = m_swapChainImages[imageIndex];
+		toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+		VkBufferImageCopy region = {};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageExtent = { m_swapChainExtent.width, m_swapChainExtent.height, 1 };
+		vkCmdCopyImageToBuffer(commandBuffer, m_swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstBuffer, 1, &region);
+
+		VkBufferMemoryBarrier toHost = {};
+		toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toHost.buffer = dstBuffer;
+		toHost.offset = 0;
+		toHost.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+
+		// Swap chain images go back to the layout the present expects
+		if (!m_offscreen)
+		{
+			VkImageMemoryBarrier toPresent = toTransfer;
+			toPresent.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			toPresent.dstAccessMask = 0;
+			toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &toPresent);
+		}
+	}
 
-			VkImageViewCreateInfo viewInfo{};
+	void SwapChain::CreateImageViews()
+	{
+		m_swapChainImageViews.resize(m_swapChainImages.size());
+		for (size_t i = 0; i < m_swapChainImages.size(); i++)
+		{
+			VkImageViewCreateInfo viewInfo = {};
 			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			viewInfo.image = m_depthImages[i];
+			viewInfo.image = m_swapChainImages[i];
 			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			viewInfo.format = depthFormat;
-			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			viewInfo.format = m_swapChainImageFormat;
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			viewInfo.subresourceRange.baseMipLevel = 0;
 			viewInfo.subresourceRange.levelCount = 1;
 			viewInfo.subresourceRange.baseArrayLayer = 0;
 			viewInfo.subresourceRange.layerCount = 1;
 
-			if (vkCreateImageView(m_device.GetDevice(), &viewInfo, nullptr, &m_depthImageViews[i]) != VK_SUCCESS)
-				throw std::runtime_error("Failed to create texture image view !");
+			m_swapChainImageViews[i] = m_device.GetResourceCache().GetImageView(viewInfo);
 		}
 	}
 
 	void SwapChain::CreateSyncObjects()
 	{
-		m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		m_imagesInFlight.resize(ImageCount(), VK_NULL_HANDLE);
+		assert(m_framesInFlight >= 1 && m_framesInFlight <= MAX_FRAMES_IN_FLIGHT && "Invalid number of frames in flight !");
+
+		m_imageAvailableSemaphores.resize(m_framesInFlight);
+		m_inFlightFences.resize(m_framesInFlight);
+		m_renderFinishedSemaphores.resize(ImageCount());
 
 		VkSemaphoreCreateInfo semaphoreInfo = {};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -328,12 +311,15 @@ namespace Engine {
 		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		for (size_t i = 0; i < m_framesInFlight; i++) {
 			if (vkCreateSemaphore(m_device.GetDevice(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS
-				|| vkCreateSemaphore(m_device.GetDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS
 				|| vkCreateFence(m_device.GetDevice(), &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS)
 				throw std::runtime_error("failed to create synchronization objects for a frame!");
 		}
+
+		for (size_t i = 0; i < ImageCount(); i++)
+			if (vkCreateSemaphore(m_device.GetDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create synchronization objects for a frame!");
 	}
 
 	VkSurfaceFormatKHR SwapChain::ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
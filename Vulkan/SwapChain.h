@@ -12,19 +12,23 @@ namespace Engine {
 
 	class SwapChain {
 	public:
-		static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+		static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+		static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
 
-		SwapChain(Device& deviceRef, VkExtent2D windowExtent);
-		SwapChain(Device& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
+		SwapChain(Device& deviceRef, VkExtent2D windowExtent, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+		SwapChain(Device& deviceRef, VkExtent2D windowExtent, uint32_t framesInFlight, std::shared_ptr<SwapChain> previous);
 		~SwapChain();
 
 		SwapChain(const SwapChain&) = delete;
 		SwapChain&& operator=(const SwapChain&) = delete;
 
-		VkFramebuffer GetFrameBuffer(int index) { return m_swapChainFramebuffers[index]; }
-		VkRenderPass GetRenderPass() { return m_renderPass; }
+		VkImage GetImage(int index) { return m_swapChainImages[index]; }
 		VkImageView GetImageView(int index) { return m_swapChainImageViews[index]; }
 		size_t ImageCount() { return m_swapChainImages.size(); }
+		uint32_t GetCurrentFrame() { return static_cast<uint32_t>(m_currentFrame); }
+		uint32_t GetFramesInFlight() { return m_framesInFlight; }
+		// Time the CPU spent blocked on the fence of the frame in the last AcquireNextImage
+		double GetLastFenceWaitMilliseconds() { return m_lastFenceWaitMilliseconds; }
 		VkFormat GetSwapChainImageFormat() { return m_swapChainImageFormat; }
 		VkExtent2D GetSwapChainExtent() { return m_swapChainExtent; }
 		uint32_t Width() { return m_swapChainExtent.width; }
@@ -36,13 +40,18 @@ namespace Engine {
 		VkResult AcquireNextImage(uint32_t* imageIndex);
 		VkResult SubmitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
 
+		// Offscreen swap chains render into plain images (one per frame in flight) and never present
+		bool IsOffscreen() { return m_offscreen; }
+		bool SupportsReadback() { return m_readbackSupported; }
+		VkDeviceSize GetReadbackSize() { return static_cast<VkDeviceSize>(m_swapChainExtent.width) * m_swapChainExtent.height * 4; }
+		// Records a copy of the rendered image into dstBuffer, after the render pass. The pixels are readable once the frame fence is signaled
+		void RecordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkBuffer dstBuffer);
+
 	private:
 		void Init();
 		void CreateSwapChain();
+		void CreateOffscreenImages();
 		void CreateImageViews();
-		void CreateDepthResources();
-		void CreateRenderPass();
-		void CreateFramebuffers();
 		void CreateSyncObjects();
 
 		// Helper Functions
@@ -53,25 +62,26 @@ namespace Engine {
 	private:
 		Device& m_device;
 		VkExtent2D m_windowExtent;
-		VkSwapchainKHR m_swapChain;
+		uint32_t m_framesInFlight;
+		VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
 		std::shared_ptr<SwapChain> m_oldSwapChain;
 		size_t m_currentFrame = 0;
+		double m_lastFenceWaitMilliseconds = 0.0;
 
-		std::vector<VkFramebuffer> m_swapChainFramebuffers;
-		VkRenderPass m_renderPass;
 		VkFormat m_swapChainImageFormat;
 		VkExtent2D m_swapChainExtent;
 
-		std::vector<VkImage> m_depthImages;
-		std::vector<VkDeviceMemory> m_depthImageMemorys;
-		std::vector<VkImageView> m_depthImageViews;
 		std::vector<VkImage> m_swapChainImages;
+		std::vector<MemoryAllocation> m_offscreenImageMemorys;
+		bool m_offscreen = false;
+		bool m_readbackSupported = false;
 		std::vector<VkImageView> m_swapChainImageViews;
 
+		// Indexed by frame in flight
 		std::vector<VkSemaphore> m_imageAvailableSemaphores;
-		std::vector<VkSemaphore> m_renderFinishedSemaphores;
 		std::vector<VkFence> m_inFlightFences;
-		std::vector<VkFence> m_imagesInFlight;
+		// Indexed by swap chain image, the presentation engine may still wait on it when the frame fence is signaled
+		std::vector<VkSemaphore> m_renderFinishedSemaphores;
 	};
 
 }  // namespace lve
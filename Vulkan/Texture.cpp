@@ -0,0 +1,236 @@
+#include "Texture.h"
+#include "CpuProfiler.h"
+#include "UploadArena.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Engine
+{
+	namespace
+	{
+		bool IsAstc(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+			case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+			case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+			case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+			case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+			case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+				return true;
+			default:
+				return false;
+			}
+		}
+	}
+
+	Texture::Texture(Device& device, const TextureImage& image, bool srgb, bool generateMips)
+		: m_device(device)
+	{
+		PROFILE_FUNCTION();
+		assert(image.width > 0 && image.height > 0 && image.texels.size() == static_cast<size_t>(image.width) * image.height * 4 && "Texture image must hold RGBA8 texels !");
+
+		// Linear blits need the filter feature on top of the blit ones, formats without them get their chain from the CPU
+		VkFormat format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(m_device.GetPhysicalDevice(), format, &properties);
+		VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+		bool gpuMips = (properties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+		m_format = m_device.FindSupportedFormat({ format }, VK_IMAGE_TILING_OPTIMAL, features);
+		m_extent = { image.width, image.height };
+		m_mipCount = generateMips ? ComputeMipCount(image.width, image.height) : 1;
+		bool blitMips = m_mipCount > 1 && gpuMips;
+		CreateImage(VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | (blitMips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0));
+		CreateImageView();
+
+		UploadArena& uploadArena = m_device.GetUploadArena();
+		if (m_mipCount > 1 && !blitMips)
+		{
+			std::vector<TextureImage> mips = TextureEncoder::GenerateMipChain(image, srgb);
+			for (uint32_t level = 0; level < m_mipCount; level++)
+				uploadArena.UploadImage(m_image, level, { mips[level].width, mips[level].height, 1 }, mips[level].texels.data(), mips[level].texels.size(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			return;
+		}
+
+		VkImageLayout uploadLayout = blitMips ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		uploadArena.UploadImage(m_image, 0, { image.width, image.height, 1 }, image.texels.data(), image.texels.size(), uploadLayout);
+		if (blitMips)
+		{
+			// Captured by value so the commands do not reference the texture. They still use its image, ~Texture requires the batch to be flushed
+			VkImage textureImage = m_image;
+			VkExtent2D extent = m_extent;
+			uint32_t mipCount = m_mipCount;
+			uploadArena.RecordAfterCopies([=](VkCommandBuffer commandBuffer) { RecordMipGeneration(commandBuffer, textureImage, extent, mipCount); });
+		}
+	}
+
+	Texture::Texture(Device& device, std::shared_ptr<const TextureAsset> asset, uint32_t firstMip)
+		: m_device(device), m_asset(std::move(asset)), m_firstMip(firstMip)
+	{
+		PROFILE_FUNCTION();
+		assert(m_firstMip < m_asset->GetMipCount() && "Texture first mip is out of range !");
+
+		m_encoding = SelectEncoding(m_device, *m_asset);
+		m_format = m_asset->GetFormat(m_encoding);
+		m_extent = m_asset->GetMipExtent(m_firstMip);
+		m_mipCount = m_asset->GetMipCount() - m_firstMip;
+		CreateImage(VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		CreateImageView();
+
+		// Straight from the mapping, the arena copies each level once into staging memory
+		UploadArena& uploadArena = m_device.GetUploadArena();
+		for (uint32_t level = 0; level < m_mipCount; level++)
+		{
+			VkExtent2D extent = m_asset->GetMipExtent(m_firstMip + level);
+			uploadArena.UploadImage(m_image, level, { extent.width, extent.height, 1 }, m_asset->GetMipData(m_encoding, m_firstMip + level),
+				m_asset->GetMipSize(m_encoding, m_firstMip + level), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+	}
+
+	Texture::~Texture()
+	{
+		assert(!m_device.GetUploadArena().HasPendingCopies(m_image) && "Texture destroyed before its upload was flushed !");
+		m_device.GetResourceCache().ReleaseImage(m_image);
+		vkDestroyImage(m_device.GetDevice(), m_image, nullptr);
+		m_device.FreeMemory(m_imageMemory);
+	}
+
+	VkDeviceSize Texture::GetChainBytes(uint32_t firstMip) const
+	{
+		if (!m_asset)
+			return m_imageMemory.size;
+
+		VkDeviceSize bytes = 0;
+		for (uint32_t mip = firstMip; mip < m_asset->GetMipCount(); mip++)
+			bytes += m_asset->GetMipSize(m_encoding, mip);
+		return bytes;
+	}
+
+	VkDeviceSize Texture::QueryResidentBytes(uint32_t firstMip) const
+	{
+		if (!m_asset)
+			return m_imageMemory.size;
+
+		VkImageCreateInfo imageInfo = GetImageInfo(m_asset->GetMipExtent(firstMip), m_asset->GetMipCount() - firstMip, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		VkImage image;
+		if (vkCreateImage(m_device.GetDevice(), &imageInfo, nullptr, &image) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create image !");
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(m_device.GetDevice(), image, &requirements);
+		vkDestroyImage(m_device.GetDevice(), image, nullptr);
+		return requirements.size;
+	}
+
+	uint32_t Texture::ComputeMipCount(uint32_t width, uint32_t height)
+	{
+		uint32_t mipCount = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+			mipCount++;
+		return mipCount;
+	}
+
+	uint32_t Texture::SelectEncoding(Device& device, const TextureAsset& asset)
+	{
+		// Block compressed formats also need their device feature, format properties alone may report them on devices without it
+		const VkPhysicalDeviceFeatures& features = device.GetEnabledFeatures();
+		std::vector<VkFormat> candidates;
+		for (uint32_t i = 0; i < asset.GetEncodingCount(); i++)
+		{
+			VkFormat format = asset.GetFormat(i);
+			bool compressed = TextureAsset::GetFormatInfo(format).blockWidth > 1;
+			if (compressed && (IsAstc(format) ? !features.textureCompressionASTC_LDR : !features.textureCompressionBC))
+				continue;
+			candidates.push_back(format);
+		}
+
+		VkFormat format = device.FindSupportedFormat(candidates, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+		for (uint32_t i = 0; i < asset.GetEncodingCount(); i++)
+			if (asset.GetFormat(i) == format)
+				return i;
+		return 0;
+	}
+
+	VkImageCreateInfo Texture::GetImageInfo(VkExtent2D extent, uint32_t mipCount, VkImageUsageFlags usage) const
+	{
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { extent.width, extent.height, 1 };
+		imageInfo.mipLevels = mipCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = m_format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		return imageInfo;
+	}
+
+	void Texture::CreateImage(VkImageUsageFlags usage)
+	{
+		m_device.CreateImageWithInfo(GetImageInfo(m_extent, m_mipCount, usage), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image, m_imageMemory);
+	}
+
+	void Texture::CreateImageView()
+	{
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = m_image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = m_format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mipCount, 0, 1 };
+		m_imageView = m_device.GetResourceCache().GetImageView(viewInfo);
+	}
+
+	void Texture::RecordMipGeneration(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, uint32_t mipCount)
+	{
+		// Mip 0 is already a transfer source. Each level is written from the previous one, then becomes the source of the next
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+
+		int32_t width = static_cast<int32_t>(extent.width);
+		int32_t height = static_cast<int32_t>(extent.height);
+		for (uint32_t level = 1; level < mipCount; level++)
+		{
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			int32_t nextWidth = std::max(width / 2, 1);
+			int32_t nextHeight = std::max(height / 2, 1);
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+			blit.srcOffsets[1] = { width, height, 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+			vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			width = nextWidth;
+			height = nextHeight;
+		}
+
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1 };
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+}
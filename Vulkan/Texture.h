@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Device.h"
+#include "TextureAsset.h"
+#include "TextureEncoder.h"
+
+#include <memory>
+
+namespace Engine
+{
+	// A sampled 2D image with its mip chain in device local memory. Like Model, the texels go through the upload arena :
+	// flush it before the first frame sampling the texture and before destroying it. The texture must outlive every frame
+	// that samples it and its upload batch
+	class Texture
+	{
+	public:
+		// Uploads mip 0 as RGBA8 and blits the rest of the chain on the GPU, or uploads a chain built on the CPU when the
+		// format cannot be blitted
+		Texture(Device& device, const TextureImage& image, bool srgb = true, bool generateMips = true);
+		// Uploads mips [firstMip, mip count) of the first encoding of the asset the device samples, block compressed
+		// formats first. Mip firstMip becomes mip 0 of the image, the asset is kept to stream other mips in later
+		Texture(Device& device, std::shared_ptr<const TextureAsset> asset, uint32_t firstMip = 0);
+		~Texture();
+
+		Texture(const Texture&) = delete;
+		Texture& operator=(const Texture&) = delete;
+
+		VkImage GetImage() const { return m_image; }
+		VkImageView GetImageView() const { return m_imageView; }
+		VkFormat GetFormat() const { return m_format; }
+		VkExtent2D GetExtent() const { return m_extent; }
+		uint32_t GetMipCount() const { return m_mipCount; }
+		// Mip of the asset held by mip 0 of the image, 0 for textures created from an image
+		uint32_t GetFirstMip() const { return m_firstMip; }
+		const std::shared_ptr<const TextureAsset>& GetAsset() const { return m_asset; }
+		// Device memory of the image, what streaming budgets count
+		VkDeviceSize GetResidentBytes() const { return m_imageMemory.size; }
+		// Texel bytes of the asset chain starting at firstMip in the encoding this texture uses
+		VkDeviceSize GetChainBytes(uint32_t firstMip) const;
+		// Device memory a texture of the same asset starting at firstMip would take, GetResidentBytes for textures created
+		// from an image. Queried from a temporary image, no memory is allocated
+		VkDeviceSize QueryResidentBytes(uint32_t firstMip) const;
+
+		static uint32_t ComputeMipCount(uint32_t width, uint32_t height);
+		// The first encoding of the asset the device can sample with linear filtering
+		static uint32_t SelectEncoding(Device& device, const TextureAsset& asset);
+
+	private:
+		VkImageCreateInfo GetImageInfo(VkExtent2D extent, uint32_t mipCount, VkImageUsageFlags usage) const;
+		void CreateImage(VkImageUsageFlags usage);
+		void CreateImageView();
+		static void RecordMipGeneration(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, uint32_t mipCount);
+
+	private:
+		Device& m_device;
+		std::shared_ptr<const TextureAsset> m_asset;
+		uint32_t m_encoding = 0;
+		uint32_t m_firstMip = 0;
+
+		VkFormat m_format = VK_FORMAT_UNDEFINED;
+		VkExtent2D m_extent = {};
+		uint32_t m_mipCount = 1;
+		VkImage m_image = VK_NULL_HANDLE;
+		MemoryAllocation m_imageMemory;
+		VkImageView m_imageView = VK_NULL_HANDLE;
+	};
+}
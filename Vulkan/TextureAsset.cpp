@@ -0,0 +1,283 @@
+#include "TextureAsset.h"
+#include "CpuProfiler.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace Engine
+{
+	namespace
+	{
+		uint64_t AlignUp(uint64_t value)
+		{
+			return (value + TextureAsset::ALIGNMENT - 1) / TextureAsset::ALIGNMENT * TextureAsset::ALIGNMENT;
+		}
+
+		void WritePadded(std::ofstream& file, const void* data, uint64_t size, uint64_t& position)
+		{
+			static const char padding[TextureAsset::ALIGNMENT] = {};
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+			position += size;
+			uint64_t aligned = AlignUp(position);
+			file.write(padding, static_cast<std::streamsize>(aligned - position));
+			position = aligned;
+		}
+
+		std::vector<uint8_t> EncodeMip(VkFormat format, const TextureImage& mip)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+				return mip.texels;
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+				return TextureEncoder::EncodeBc1(mip);
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+				return TextureEncoder::EncodeBc3(mip);
+			default:
+				throw std::runtime_error("No encoder for texture format " + std::to_string(format) + " !");
+			}
+		}
+
+		// Quality of mip 0 after a round trip through the reference decoder, RGBA8 is lossless
+		double MeasurePsnr(VkFormat format, const TextureImage& mip, const std::vector<uint8_t>& encoded)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+				return TextureEncoder::ComputePsnr(mip, TextureEncoder::DecodeBc1(encoded.data(), mip.width, mip.height), false);
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+				return TextureEncoder::ComputePsnr(mip, TextureEncoder::DecodeBc3(encoded.data(), mip.width, mip.height), true);
+			default:
+				return std::numeric_limits<double>::infinity();
+			}
+		}
+	}
+
+	TextureAsset::TextureAsset(const std::string& path)
+		: m_file(path)
+	{
+		PROFILE_FUNCTION();
+		if (m_file.GetSize() < sizeof(TextureFileHeader))
+			throw std::runtime_error("Texture file " + path + " is too small !");
+		m_header = reinterpret_cast<const TextureFileHeader*>(m_file.GetData());
+		Validate();
+	}
+
+	void TextureAsset::Validate() const
+	{
+		const TextureFileHeader& header = *m_header;
+		const std::string& path = m_file.GetPath();
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+			throw std::runtime_error(path + " is not a texture file !");
+		if (header.version != VERSION)
+			throw std::runtime_error("Texture file " + path + " has version " + std::to_string(header.version) + ", expected " + std::to_string(VERSION) + " !");
+		if (header.width == 0 || header.height == 0 || header.encodingCount == 0)
+			throw std::runtime_error("Texture file " + path + " is empty !");
+		if (header.mipCount == 0 || header.mipCount > TextureEncoding::MAX_MIP_COUNT || std::max(header.width, header.height) >> (header.mipCount - 1) == 0)
+			throw std::runtime_error("Texture file " + path + " has an invalid mip count !");
+
+		auto checkBlob = [&](uint64_t offset, uint64_t size)
+		{
+			if (offset % ALIGNMENT != 0 || offset < sizeof(TextureFileHeader) || offset + size > m_file.GetSize())
+				throw std::runtime_error("Texture file " + path + " is truncated or corrupted !");
+		};
+		checkBlob(header.encodingOffset, static_cast<uint64_t>(header.encodingCount) * sizeof(TextureEncoding));
+
+		// Mip sizes are fixed by the format, a smaller blob would make the copy read past it
+		for (uint32_t i = 0; i < header.encodingCount; i++)
+		{
+			const TextureEncoding& encoding = GetEncodings()[i];
+			VkFormat format = static_cast<VkFormat>(encoding.format);
+			if (GetFormatInfo(format).blockBytes == 0)
+				throw std::runtime_error("Texture file " + path + " uses unknown format " + std::to_string(encoding.format) + " !");
+			for (uint32_t mip = 0; mip < header.mipCount; mip++)
+			{
+				if (encoding.mipSizes[mip] != ComputeMipSize(format, GetMipExtent(mip)))
+					throw std::runtime_error("Texture file " + path + " has an invalid mip size !");
+				checkBlob(encoding.mipOffsets[mip], encoding.mipSizes[mip]);
+			}
+		}
+	}
+
+	TextureFormatInfo TextureAsset::GetFormatInfo(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return { 1, 1, 4 };
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			return { 4, 4, 8 };
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+			return { 4, 4, 16 };
+		case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+			return { 6, 6, 16 };
+		case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+			return { 8, 8, 16 };
+		default:
+			return {};
+		}
+	}
+
+	VkDeviceSize TextureAsset::ComputeMipSize(VkFormat format, VkExtent2D extent)
+	{
+		TextureFormatInfo info = GetFormatInfo(format);
+		assert(info.blockBytes != 0 && "Unsupported texture format !");
+		VkDeviceSize blocksX = (extent.width + info.blockWidth - 1) / info.blockWidth;
+		VkDeviceSize blocksY = (extent.height + info.blockHeight - 1) / info.blockHeight;
+		return blocksX * blocksY * info.blockBytes;
+	}
+
+	std::vector<VkFormat> TextureAsset::DefaultFormats(bool transparent, bool srgb)
+	{
+		if (transparent)
+			return { srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK, srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM };
+		return { srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK, srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM };
+	}
+
+	void TextureAsset::Write(const std::string& path, const TextureImage& image, bool srgb, std::vector<VkFormat> formats)
+	{
+		PROFILE_FUNCTION();
+		if (image.width == 0 || image.height == 0 || image.texels.size() != static_cast<size_t>(image.width) * image.height * 4)
+			throw std::runtime_error("Cannot write an empty texture to " + path + " !");
+
+		std::vector<TextureImage> mips = TextureEncoder::GenerateMipChain(image, srgb);
+		if (mips.size() > TextureEncoding::MAX_MIP_COUNT)
+			throw std::runtime_error("Texture " + path + " is too large, at most " + std::to_string(TextureEncoding::MAX_MIP_COUNT) + " mips are supported !");
+		if (formats.empty())
+			formats = DefaultFormats(TextureEncoder::HasTransparency(image), srgb);
+
+		TextureFileHeader header = {};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.width = image.width;
+		header.height = image.height;
+		header.mipCount = static_cast<uint32_t>(mips.size());
+		header.encodingCount = static_cast<uint32_t>(formats.size());
+		header.srgb = srgb ? 1 : 0;
+		header.encodingOffset = AlignUp(sizeof(TextureFileHeader));
+
+		// Every encoding is kept in memory until the offsets are known, texture files are written offline
+		std::vector<TextureEncoding> encodings(formats.size());
+		std::vector<std::vector<std::vector<uint8_t>>> blobs(formats.size());
+		uint64_t offset = AlignUp(header.encodingOffset + sizeof(TextureEncoding) * encodings.size());
+		for (size_t i = 0; i < formats.size(); i++)
+		{
+			encodings[i] = {};
+			encodings[i].format = static_cast<uint32_t>(formats[i]);
+			for (uint32_t mip = 0; mip < header.mipCount; mip++)
+			{
+				blobs[i].push_back(EncodeMip(formats[i], mips[mip]));
+				encodings[i].mipOffsets[mip] = offset;
+				encodings[i].mipSizes[mip] = blobs[i].back().size();
+				offset = AlignUp(offset + blobs[i].back().size());
+			}
+
+			double psnr = MeasurePsnr(formats[i], mips[0], blobs[i][0]);
+			std::cout << std::fixed << std::setprecision(2) << "Texture " << path << " : format " << formats[i] << ", " << offset - encodings[i].mipOffsets[0] << " bytes, ";
+			if (std::isinf(psnr))
+				std::cout << "lossless" << std::endl;
+			else
+				std::cout << psnr << " dB PSNR on mip 0" << std::endl;
+		}
+		header.fileSize = offset;
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open texture file " + path + " for writing !");
+
+		uint64_t position = 0;
+		WritePadded(file, &header, sizeof(header), position);
+		WritePadded(file, encodings.data(), encodings.size() * sizeof(TextureEncoding), position);
+		for (const auto& encoding : blobs)
+			for (const auto& blob : encoding)
+				WritePadded(file, blob.data(), blob.size(), position);
+
+		if (!file.good() || position != header.fileSize)
+			throw std::runtime_error("Failed to write texture file " + path + " !");
+	}
+
+	void TextureAsset::ConvertPpm(const std::string& ppmPath, const std::string& texturePath)
+	{
+		PROFILE_FUNCTION();
+		std::ifstream file(ppmPath, std::ios::binary);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open PPM file " + ppmPath + " !");
+
+		// Header tokens are separated by whitespace and may be followed by comments up to the end of the line
+		auto readToken = [&]()
+		{
+			std::string token;
+			while (file >> token && token[0] == '#')
+				file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+			return token;
+		};
+
+		if (readToken() != "P6")
+			throw std::runtime_error(ppmPath + " is not a binary PPM file !");
+		TextureImage image;
+		uint32_t maxValue = 0;
+		try
+		{
+			image.width = static_cast<uint32_t>(std::stoul(readToken()));
+			image.height = static_cast<uint32_t>(std::stoul(readToken()));
+			maxValue = static_cast<uint32_t>(std::stoul(readToken()));
+		}
+		catch (const std::exception&)
+		{
+			throw std::runtime_error("PPM file " + ppmPath + " has an invalid header !");
+		}
+		if (image.width == 0 || image.height == 0 || maxValue != 255)
+			throw std::runtime_error("PPM file " + ppmPath + " must have 8 bit channels and a non empty size !");
+		// A single whitespace separates the header from the texels
+		file.get();
+
+		std::vector<uint8_t> rgb(static_cast<size_t>(image.width) * image.height * 3);
+		if (!file.read(reinterpret_cast<char*>(rgb.data()), static_cast<std::streamsize>(rgb.size())))
+			throw std::runtime_error("PPM file " + ppmPath + " is truncated !");
+
+		image.texels.resize(static_cast<size_t>(image.width) * image.height * 4);
+		for (size_t i = 0; i < static_cast<size_t>(image.width) * image.height; i++)
+		{
+			image.texels[i * 4 + 0] = rgb[i * 3 + 0];
+			image.texels[i * 4 + 1] = rgb[i * 3 + 1];
+			image.texels[i * 4 + 2] = rgb[i * 3 + 2];
+			image.texels[i * 4 + 3] = 255;
+		}
+
+		Write(texturePath, image, true);
+	}
+}
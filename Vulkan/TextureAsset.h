@@ -0,0 +1,95 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "TextureEncoder.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	// Little endian, every mip level starts on a TextureAsset::ALIGNMENT boundary so it is copied straight from the mapping
+	struct TextureFileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipCount;
+		uint32_t encodingCount;
+		// 1 when the colors are sRGB encoded, every encoding then uses an sRGB format when there is one
+		uint32_t srgb;
+		uint32_t reserved;
+		uint64_t encodingOffset;
+		uint64_t fileSize;
+	};
+
+	// The whole mip chain in a single format, mip 0 first. Rows of blocks are tightly packed
+	struct TextureEncoding
+	{
+		static constexpr uint32_t MAX_MIP_COUNT = 16;
+
+		// A VkFormat
+		uint32_t format;
+		uint32_t reserved;
+		uint64_t mipOffsets[MAX_MIP_COUNT];
+		uint64_t mipSizes[MAX_MIP_COUNT];
+	};
+
+	struct TextureFormatInfo
+	{
+		uint32_t blockWidth = 0;
+		uint32_t blockHeight = 0;
+		// 0 for formats a texture file cannot hold
+		uint32_t blockBytes = 0;
+	};
+
+	// A texture file mapped in memory. It holds the same mip chain in several encodings, ordered by preference : block
+	// compressed ones first and RGBA8 last, which every device samples. Texture picks the first one the device supports
+	class TextureAsset
+	{
+	public:
+		static constexpr char MAGIC[4] = { 'V', 'K', 'T', 'X' };
+		static constexpr uint32_t VERSION = 1;
+		static constexpr uint64_t ALIGNMENT = 64;
+
+		// Throws if the file is not a valid texture file
+		TextureAsset(const std::string& path);
+
+		TextureAsset(const TextureAsset&) = delete;
+		TextureAsset& operator=(const TextureAsset&) = delete;
+
+		const TextureFileHeader& GetHeader() const { return *m_header; }
+		uint32_t GetMipCount() const { return m_header->mipCount; }
+		bool IsSrgb() const { return m_header->srgb != 0; }
+		uint32_t GetEncodingCount() const { return m_header->encodingCount; }
+		const TextureEncoding& GetEncoding(uint32_t encoding) const { return GetEncodings()[encoding]; }
+		VkFormat GetFormat(uint32_t encoding) const { return static_cast<VkFormat>(GetEncodings()[encoding].format); }
+		const uint8_t* GetMipData(uint32_t encoding, uint32_t mip) const { return m_file.GetData() + GetEncodings()[encoding].mipOffsets[mip]; }
+		VkDeviceSize GetMipSize(uint32_t encoding, uint32_t mip) const { return GetEncodings()[encoding].mipSizes[mip]; }
+		VkExtent2D GetMipExtent(uint32_t mip) const { return { std::max(m_header->width >> mip, 1u), std::max(m_header->height >> mip, 1u) }; }
+		size_t GetFileSize() const { return m_file.GetSize(); }
+
+		static TextureFormatInfo GetFormatInfo(VkFormat format);
+		static VkDeviceSize ComputeMipSize(VkFormat format, VkExtent2D extent);
+		// The encodings Write produces by default : BC1, or BC3 when some texels are transparent, then RGBA8
+		static std::vector<VkFormat> DefaultFormats(bool transparent, bool srgb);
+
+		// Builds the mip chain on the CPU and writes it once per format, an empty list writes DefaultFormats. Only RGBA8,
+		// BC1 and BC3 have an encoder, files with other formats come from external tools
+		static void Write(const std::string& path, const TextureImage& image, bool srgb, std::vector<VkFormat> formats = {});
+		// Binary PPM (P6) with 8 bit channels, the texture is opaque and sRGB
+		static void ConvertPpm(const std::string& ppmPath, const std::string& texturePath);
+
+	private:
+		const TextureEncoding* GetEncodings() const { return reinterpret_cast<const TextureEncoding*>(m_file.GetData() + m_header->encodingOffset); }
+		void Validate() const;
+
+	private:
+		MappedFile m_file;
+		const TextureFileHeader* m_header = nullptr;
+	};
+}
@@ -0,0 +1,376 @@
+#include "TextureEncoder.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace Engine
+{
+	namespace
+	{
+		using Block = std::array<uint8_t, TextureEncoder::BLOCK_DIMENSION * TextureEncoder::BLOCK_DIMENSION * 4>;
+
+		float SrgbToLinear(uint8_t value)
+		{
+			float c = value / 255.0f;
+			return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		uint8_t LinearToSrgb(float value)
+		{
+			float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+			return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+		}
+
+		uint32_t BlockCount(uint32_t texels)
+		{
+			return (texels + TextureEncoder::BLOCK_DIMENSION - 1) / TextureEncoder::BLOCK_DIMENSION;
+		}
+
+		void ExtractBlock(const TextureImage& image, uint32_t blockX, uint32_t blockY, Block& block)
+		{
+			for (uint32_t y = 0; y < TextureEncoder::BLOCK_DIMENSION; y++)
+				for (uint32_t x = 0; x < TextureEncoder::BLOCK_DIMENSION; x++)
+				{
+					uint32_t sourceX = std::min(blockX * TextureEncoder::BLOCK_DIMENSION + x, image.width - 1);
+					uint32_t sourceY = std::min(blockY * TextureEncoder::BLOCK_DIMENSION + y, image.height - 1);
+					std::memcpy(&block[(y * TextureEncoder::BLOCK_DIMENSION + x) * 4], &image.texels[(static_cast<size_t>(sourceY) * image.width + sourceX) * 4], 4);
+				}
+		}
+
+		uint16_t PackRgb565(const float color[3])
+		{
+			uint32_t r = static_cast<uint32_t>(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+			uint32_t g = static_cast<uint32_t>(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+			uint32_t b = static_cast<uint32_t>(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		void UnpackRgb565(uint16_t packed, int color[3])
+		{
+			int r = (packed >> 11) & 31;
+			int g = (packed >> 5) & 63;
+			int b = packed & 31;
+			color[0] = (r << 3) | (r >> 2);
+			color[1] = (g << 2) | (g >> 4);
+			color[2] = (b << 3) | (b >> 2);
+		}
+
+		// BC1 uses four colors whenever c0 > c1 and makes the last one transparent black otherwise, BC2 and BC3 always use four
+		void Bc1Palette(uint16_t c0, uint16_t c1, bool fourColors, int palette[4][4])
+		{
+			UnpackRgb565(c0, palette[0]);
+			UnpackRgb565(c1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				if (fourColors)
+				{
+					palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+				}
+				else
+				{
+					palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+					palette[3][c] = 0;
+				}
+			}
+			palette[0][3] = palette[1][3] = palette[2][3] = 255;
+			palette[3][3] = fourColors ? 255 : 0;
+		}
+
+		void EncodeColorBlock(const Block& block, uint8_t* output)
+		{
+			constexpr int texelCount = TextureEncoder::BLOCK_DIMENSION * TextureEncoder::BLOCK_DIMENSION;
+			float mean[3] = {};
+			for (int i = 0; i < texelCount; i++)
+				for (int c = 0; c < 3; c++)
+					mean[c] += block[i * 4 + c] / static_cast<float>(texelCount);
+
+			float covariance[6] = {};
+			for (int i = 0; i < texelCount; i++)
+			{
+				float d[3] = { block[i * 4] - mean[0], block[i * 4 + 1] - mean[1], block[i * 4 + 2] - mean[2] };
+				covariance[0] += d[0] * d[0];
+				covariance[1] += d[0] * d[1];
+				covariance[2] += d[0] * d[2];
+				covariance[3] += d[1] * d[1];
+				covariance[4] += d[1] * d[2];
+				covariance[5] += d[2] * d[2];
+			}
+
+			// Principal axis by power iteration, a few steps are enough for 16 points
+			float axis[3] = { 1.0f, 1.0f, 1.0f };
+			for (int iteration = 0; iteration < 8; iteration++)
+			{
+				float next[3] = {
+					covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+					covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+					covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+				};
+				float length = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+				if (length < 1e-6f)
+					break;
+				for (int c = 0; c < 3; c++)
+					axis[c] = next[c] / length;
+			}
+
+			float minProjection = std::numeric_limits<float>::max();
+			float maxProjection = std::numeric_limits<float>::lowest();
+			for (int i = 0; i < texelCount; i++)
+			{
+				float projection = (block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2];
+				minProjection = std::min(minProjection, projection);
+				maxProjection = std::max(maxProjection, projection);
+			}
+
+			// Endpoints are inset by 1/16 of the range, the extremes are rarely worth an exact palette entry
+			float axisLengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			float inset = (maxProjection - minProjection) / 16.0f;
+			float endpoints[2][3];
+			for (int c = 0; c < 3; c++)
+			{
+				endpoints[0][c] = mean[c] + axis[c] * (maxProjection - inset) / axisLengthSquared;
+				endpoints[1][c] = mean[c] + axis[c] * (minProjection + inset) / axisLengthSquared;
+			}
+
+			uint16_t c0 = PackRgb565(endpoints[0]);
+			uint16_t c1 = PackRgb565(endpoints[1]);
+			if (c0 < c1)
+				std::swap(c0, c1);
+
+			uint32_t indices = 0;
+			if (c0 != c1)
+			{
+				int palette[4][4];
+				Bc1Palette(c0, c1, true, palette);
+				for (int i = 0; i < texelCount; i++)
+				{
+					int bestIndex = 0;
+					int bestDistance = std::numeric_limits<int>::max();
+					for (int p = 0; p < 4; p++)
+					{
+						int distance = 0;
+						for (int c = 0; c < 3; c++)
+							distance += (block[i * 4 + c] - palette[p][c]) * (block[i * 4 + c] - palette[p][c]);
+						if (distance < bestDistance)
+						{
+							bestDistance = distance;
+							bestIndex = p;
+						}
+					}
+					indices |= static_cast<uint32_t>(bestIndex) << (i * 2);
+				}
+			}
+
+			std::memcpy(output, &c0, sizeof(c0));
+			std::memcpy(output + 2, &c1, sizeof(c1));
+			std::memcpy(output + 4, &indices, sizeof(indices));
+		}
+
+		void EncodeAlphaBlock(const Block& block, uint8_t* output)
+		{
+			constexpr int texelCount = TextureEncoder::BLOCK_DIMENSION * TextureEncoder::BLOCK_DIMENSION;
+			uint8_t a0 = 0;
+			uint8_t a1 = 255;
+			for (int i = 0; i < texelCount; i++)
+			{
+				a0 = std::max(a0, block[i * 4 + 3]);
+				a1 = std::min(a1, block[i * 4 + 3]);
+			}
+
+			// a0 > a1 selects the 8 value mode : both endpoints and 6 interpolated values
+			uint64_t indices = 0;
+			if (a0 != a1)
+			{
+				int palette[8] = { a0, a1 };
+				for (int p = 1; p < 7; p++)
+					palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+				for (int i = 0; i < texelCount; i++)
+				{
+					int bestIndex = 0;
+					for (int p = 1; p < 8; p++)
+						if (std::abs(block[i * 4 + 3] - palette[p]) < std::abs(block[i * 4 + 3] - palette[bestIndex]))
+							bestIndex = p;
+					indices |= static_cast<uint64_t>(bestIndex) << (i * 3);
+				}
+			}
+
+			output[0] = a0;
+			output[1] = a1;
+			for (int i = 0; i < 6; i++)
+				output[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+		}
+
+		void DecodeColorBlock(const uint8_t* input, bool alwaysFourColors, Block& block)
+		{
+			uint16_t c0, c1;
+			uint32_t indices;
+			std::memcpy(&c0, input, sizeof(c0));
+			std::memcpy(&c1, input + 2, sizeof(c1));
+			std::memcpy(&indices, input + 4, sizeof(indices));
+
+			int palette[4][4];
+			Bc1Palette(c0, c1, alwaysFourColors || c0 > c1, palette);
+			for (uint32_t i = 0; i < TextureEncoder::BLOCK_DIMENSION * TextureEncoder::BLOCK_DIMENSION; i++)
+				for (int c = 0; c < 4; c++)
+					block[i * 4 + c] = static_cast<uint8_t>(palette[(indices >> (i * 2)) & 3][c]);
+		}
+
+		void DecodeAlphaBlock(const uint8_t* input, Block& block)
+		{
+			int a0 = input[0];
+			int a1 = input[1];
+			int palette[8] = { a0, a1 };
+			for (int p = 1; p < 7; p++)
+				palette[p + 1] = a0 > a1 ? ((7 - p) * a0 + p * a1) / 7 : (p < 5 ? ((5 - p) * a0 + p * a1) / 5 : (p == 5 ? 0 : 255));
+
+			uint64_t indices = 0;
+			for (int i = 0; i < 6; i++)
+				indices |= static_cast<uint64_t>(input[2 + i]) << (i * 8);
+			for (uint32_t i = 0; i < TextureEncoder::BLOCK_DIMENSION * TextureEncoder::BLOCK_DIMENSION; i++)
+				block[i * 4 + 3] = static_cast<uint8_t>(palette[(indices >> (i * 3)) & 7]);
+		}
+
+		template<typename EncodeFunction>
+		std::vector<uint8_t> EncodeBlocks(const TextureImage& image, size_t blockBytes, EncodeFunction encode)
+		{
+			assert(image.width > 0 && image.height > 0 && image.texels.size() == static_cast<size_t>(image.width) * image.height * 4 && "Invalid texture image !");
+			uint32_t blocksX = BlockCount(image.width);
+			uint32_t blocksY = BlockCount(image.height);
+			std::vector<uint8_t> output(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+			Block block;
+			for (uint32_t y = 0; y < blocksY; y++)
+				for (uint32_t x = 0; x < blocksX; x++)
+				{
+					ExtractBlock(image, x, y, block);
+					encode(block, &output[(static_cast<size_t>(y) * blocksX + x) * blockBytes]);
+				}
+			return output;
+		}
+
+		template<typename DecodeFunction>
+		TextureImage DecodeBlocks(const uint8_t* blocks, uint32_t width, uint32_t height, size_t blockBytes, DecodeFunction decode)
+		{
+			TextureImage image;
+			image.width = width;
+			image.height = height;
+			image.texels.resize(static_cast<size_t>(width) * height * 4);
+
+			uint32_t blocksX = BlockCount(width);
+			Block block;
+			for (uint32_t y = 0; y < BlockCount(height); y++)
+				for (uint32_t x = 0; x < blocksX; x++)
+				{
+					decode(blocks + (static_cast<size_t>(y) * blocksX + x) * blockBytes, block);
+					for (uint32_t texelY = 0; texelY < TextureEncoder::BLOCK_DIMENSION && y * TextureEncoder::BLOCK_DIMENSION + texelY < height; texelY++)
+						for (uint32_t texelX = 0; texelX < TextureEncoder::BLOCK_DIMENSION && x * TextureEncoder::BLOCK_DIMENSION + texelX < width; texelX++)
+						{
+							size_t destination = (static_cast<size_t>(y * TextureEncoder::BLOCK_DIMENSION + texelY) * width + x * TextureEncoder::BLOCK_DIMENSION + texelX) * 4;
+							std::memcpy(&image.texels[destination], &block[(texelY * TextureEncoder::BLOCK_DIMENSION + texelX) * 4], 4);
+						}
+				}
+			return image;
+		}
+	}
+
+	std::vector<TextureImage> TextureEncoder::GenerateMipChain(const TextureImage& image, bool srgb)
+	{
+		PROFILE_FUNCTION();
+		std::array<float, 256> toLinear;
+		for (int i = 0; i < 256; i++)
+			toLinear[i] = srgb ? SrgbToLinear(static_cast<uint8_t>(i)) : i / 255.0f;
+
+		std::vector<TextureImage> mips = { image };
+		while (mips.back().width > 1 || mips.back().height > 1)
+		{
+			const TextureImage& source = mips.back();
+			TextureImage mip;
+			mip.width = std::max(source.width / 2, 1u);
+			mip.height = std::max(source.height / 2, 1u);
+			mip.texels.resize(static_cast<size_t>(mip.width) * mip.height * 4);
+
+			// A dimension already at 1 is only halved along the other one
+			uint32_t stepX = source.width > 1 ? 2 : 1;
+			uint32_t stepY = source.height > 1 ? 2 : 1;
+			for (uint32_t y = 0; y < mip.height; y++)
+				for (uint32_t x = 0; x < mip.width; x++)
+				{
+					float sum[4] = {};
+					for (uint32_t dy = 0; dy < stepY; dy++)
+						for (uint32_t dx = 0; dx < stepX; dx++)
+						{
+							const uint8_t* texel = &source.texels[(static_cast<size_t>(y * stepY + dy) * source.width + x * stepX + dx) * 4];
+							for (int c = 0; c < 3; c++)
+								sum[c] += toLinear[texel[c]];
+							sum[3] += texel[3];
+						}
+
+					float weight = 1.0f / (stepX * stepY);
+					uint8_t* destination = &mip.texels[(static_cast<size_t>(y) * mip.width + x) * 4];
+					for (int c = 0; c < 3; c++)
+						destination[c] = srgb ? LinearToSrgb(sum[c] * weight) : static_cast<uint8_t>(sum[c] * weight * 255.0f + 0.5f);
+					destination[3] = static_cast<uint8_t>(sum[3] * weight + 0.5f);
+				}
+			mips.push_back(std::move(mip));
+		}
+		return mips;
+	}
+
+	bool TextureEncoder::HasTransparency(const TextureImage& image)
+	{
+		for (size_t i = 3; i < image.texels.size(); i += 4)
+			if (image.texels[i] != 255)
+				return true;
+		return false;
+	}
+
+	std::vector<uint8_t> TextureEncoder::EncodeBc1(const TextureImage& image)
+	{
+		return EncodeBlocks(image, BC1_BLOCK_BYTES, [](const Block& block, uint8_t* output) { EncodeColorBlock(block, output); });
+	}
+
+	std::vector<uint8_t> TextureEncoder::EncodeBc3(const TextureImage& image)
+	{
+		return EncodeBlocks(image, BC3_BLOCK_BYTES, [](const Block& block, uint8_t* output)
+		{
+			EncodeAlphaBlock(block, output);
+			EncodeColorBlock(block, output + 8);
+		});
+	}
+
+	TextureImage TextureEncoder::DecodeBc1(const uint8_t* blocks, uint32_t width, uint32_t height)
+	{
+		return DecodeBlocks(blocks, width, height, BC1_BLOCK_BYTES, [](const uint8_t* input, Block& block) { DecodeColorBlock(input, false, block); });
+	}
+
+	TextureImage TextureEncoder::DecodeBc3(const uint8_t* blocks, uint32_t width, uint32_t height)
+	{
+		return DecodeBlocks(blocks, width, height, BC3_BLOCK_BYTES, [](const uint8_t* input, Block& block)
+		{
+			DecodeColorBlock(input + 8, true, block);
+			DecodeAlphaBlock(input, block);
+		});
+	}
+
+	double TextureEncoder::ComputePsnr(const TextureImage& reference, const TextureImage& image, bool withAlpha)
+	{
+		assert(reference.width == image.width && reference.height == image.height && "Images to compare must have the same size !");
+		double squaredError = 0.0;
+		size_t sampleCount = 0;
+		for (size_t i = 0; i < reference.texels.size(); i++)
+		{
+			if (i % 4 == 3 && !withAlpha)
+				continue;
+			double difference = static_cast<double>(reference.texels[i]) - image.texels[i];
+			squaredError += difference * difference;
+			sampleCount++;
+		}
+		if (squaredError == 0.0)
+			return std::numeric_limits<double>::infinity();
+		return 10.0 * std::log10(255.0 * 255.0 / (squaredError / sampleCount));
+	}
+}
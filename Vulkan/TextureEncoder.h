@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+	// RGBA8 texels of a single mip level, rows tightly packed
+	struct TextureImage
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> texels;
+	};
+
+	namespace TextureEncoder
+	{
+		// Every block compressed format works on 4x4 texel blocks
+		constexpr uint32_t BLOCK_DIMENSION = 4;
+		constexpr size_t BC1_BLOCK_BYTES = 8;
+		constexpr size_t BC3_BLOCK_BYTES = 16;
+
+		// Box filtered chain down to 1x1, mip 0 is a copy of the image. sRGB colors are averaged in linear space so mips
+		// do not darken, alpha is always linear
+		std::vector<TextureImage> GenerateMipChain(const TextureImage& image, bool srgb);
+		bool HasTransparency(const TextureImage& image);
+
+		// Blocks in row major order, partial blocks on the right and bottom edges repeat the last column and row.
+		// Endpoints are the extremes of the colors along their principal axis, BC1 only uses its opaque 4 color mode
+		std::vector<uint8_t> EncodeBc1(const TextureImage& image);
+		// BC1 colors with a BC4 alpha block in front
+		std::vector<uint8_t> EncodeBc3(const TextureImage& image);
+
+		// Reference decoders, the hardware decodes the same values up to rounding of the interpolated colors
+		TextureImage DecodeBc1(const uint8_t* blocks, uint32_t width, uint32_t height);
+		TextureImage DecodeBc3(const uint8_t* blocks, uint32_t width, uint32_t height);
+		// Peak signal to noise ratio in dB over the color channels, and alpha when withAlpha is set
+		double ComputePsnr(const TextureImage& reference, const TextureImage& image, bool withAlpha);
+	}
+}
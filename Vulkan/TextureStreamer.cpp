@@ -0,0 +1,212 @@
+#include "TextureStreamer.h"
+#include "BindlessHeap.h"
+#include "CpuProfiler.h"
+#include "UploadArena.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <queue>
+
+namespace Engine
+{
+	namespace
+	{
+		constexpr uint32_t NO_REQUEST = ~0u;
+	}
+
+	TextureStreamer::TextureStreamer(Device& device, BindlessHeap& bindlessHeap, uint32_t framesInFlight, VkDeviceSize budget)
+		: m_device(device), m_bindlessHeap(bindlessHeap), m_framesInFlight(framesInFlight), m_budget(budget)
+	{
+		if (m_budget == 0)
+		{
+			VkPhysicalDeviceMemoryProperties memoryProperties;
+			vkGetPhysicalDeviceMemoryProperties(m_device.GetPhysicalDevice(), &memoryProperties);
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+				if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+					m_budget = std::max(m_budget, memoryProperties.memoryHeaps[i].size / 2);
+		}
+		CreateSampler();
+		std::cout << "Texture streaming : " << m_budget / (1024 * 1024) << " MB budget" << std::endl;
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		// Textures loaded since the last Update still have queued uploads, their images must not go before them
+		m_device.GetUploadArena().WaitIdle();
+		for (const Entry& entry : m_entries)
+			m_bindlessHeap.ReleaseTexture(entry.bindlessIndex);
+	}
+
+	void TextureStreamer::CreateSampler()
+	{
+		VkSamplerCreateInfo samplerInfo = {};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.anisotropyEnable = m_device.GetEnabledFeatures().samplerAnisotropy;
+		samplerInfo.maxAnisotropy = std::min(16.0f, m_device.Properties.limits.maxSamplerAnisotropy);
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		m_sampler = m_device.GetResourceCache().GetSampler(samplerInfo);
+	}
+
+	TextureStreamer::Handle TextureStreamer::Load(const std::string& path)
+	{
+		PROFILE_FUNCTION();
+		auto asset = std::make_shared<const TextureAsset>(path);
+		uint32_t tailMip = ComputeTailMip(*asset);
+		return Add(std::make_unique<Texture>(m_device, std::move(asset), tailMip));
+	}
+
+	uint32_t TextureStreamer::ComputeTailMip(const TextureAsset& asset)
+	{
+		uint32_t tailMip = 0;
+		while (tailMip + 1 < asset.GetMipCount())
+		{
+			VkExtent2D extent = asset.GetMipExtent(tailMip);
+			if (std::max(extent.width, extent.height) <= RESIDENT_TAIL_DIMENSION)
+				break;
+			tailMip++;
+		}
+		return tailMip;
+	}
+
+	TextureStreamer::Handle TextureStreamer::Add(std::unique_ptr<Texture> texture)
+	{
+		Entry entry;
+		entry.bindlessIndex = m_bindlessHeap.RegisterTexture(texture->GetImageView(), m_sampler);
+		entry.tailMip = texture->GetFirstMip();
+		for (uint32_t mip = 0; mip <= entry.tailMip; mip++)
+			entry.residentBytes.push_back(texture->QueryResidentBytes(mip));
+		entry.pendingMip = NO_REQUEST;
+		entry.wantedMip = entry.tailMip;
+		entry.lastRequestFrame = m_frameNumber;
+		entry.texture = std::move(texture);
+		m_entries.push_back(std::move(entry));
+		return static_cast<Handle>(m_entries.size() - 1);
+	}
+
+	void TextureStreamer::Request(Handle handle, uint32_t mip)
+	{
+		Entry& entry = m_entries[handle];
+		entry.pendingMip = std::min(entry.pendingMip, std::min(mip, entry.tailMip));
+	}
+
+	void TextureStreamer::Update(uint64_t frameNumber)
+	{
+		PROFILE_FUNCTION();
+		m_frameNumber = frameNumber;
+		m_uploadedBytes = 0;
+
+		// Same rule as the bindless indices : no frame still in flight can sample a texture retired that long ago
+		std::erase_if(m_retired, [&](const RetiredTexture& retired) { return frameNumber >= retired.frameNumber + m_framesInFlight; });
+
+		for (Entry& entry : m_entries)
+		{
+			if (entry.pendingMip != NO_REQUEST)
+			{
+				entry.wantedMip = entry.pendingMip;
+				entry.lastRequestFrame = frameNumber;
+				entry.pendingMip = NO_REQUEST;
+			}
+			else if (frameNumber > entry.lastRequestFrame + EVICTION_DELAY_FRAMES)
+				entry.wantedMip = entry.tailMip;
+		}
+
+		// Downgrades always go through to honor the budget, upgrades share what is left of the frame upload limit
+		std::vector<uint32_t> targets = ComputeTargets();
+		bool changed = false;
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			Entry& entry = m_entries[i];
+			if (entry.texture->GetAsset() && targets[i] > entry.texture->GetFirstMip())
+			{
+				m_uploadedBytes += entry.texture->GetChainBytes(targets[i]);
+				Replace(entry, targets[i]);
+				changed = true;
+			}
+		}
+
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			Entry& entry = m_entries[i];
+			if (!entry.texture->GetAsset() || targets[i] >= entry.texture->GetFirstMip())
+				continue;
+
+			VkDeviceSize bytes = entry.texture->GetChainBytes(targets[i]);
+			if (m_uploadedBytes > 0 && m_uploadedBytes + bytes > UPLOAD_BYTES_PER_FRAME)
+				continue;
+			m_uploadedBytes += bytes;
+			Replace(entry, targets[i]);
+			changed = true;
+		}
+
+		// Same queue as the frame submit, the copies and layout transitions complete before the frame samples the images
+		if (changed)
+			m_device.GetUploadArena().Flush();
+	}
+
+	std::vector<uint32_t> TextureStreamer::ComputeTargets()
+	{
+		std::vector<uint32_t> targets(m_entries.size());
+		VkDeviceSize total = 0;
+		// Least recently requested first, each is coarsened down to its tail before the next one is touched
+		using Candidate = std::pair<uint64_t, uint32_t>;
+		std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+		for (uint32_t i = 0; i < m_entries.size(); i++)
+		{
+			const Entry& entry = m_entries[i];
+			targets[i] = entry.texture->GetAsset() ? entry.wantedMip : entry.texture->GetFirstMip();
+			total += entry.residentBytes[targets[i]];
+			if (targets[i] < entry.tailMip)
+				candidates.push({ entry.lastRequestFrame, i });
+		}
+
+		while (total > m_budget && !candidates.empty())
+		{
+			uint32_t i = candidates.top().second;
+			candidates.pop();
+			const Entry& entry = m_entries[i];
+			total -= entry.residentBytes[targets[i]];
+			targets[i]++;
+			total += entry.residentBytes[targets[i]];
+			if (targets[i] < entry.tailMip)
+				candidates.push({ entry.lastRequestFrame, i });
+		}
+		return targets;
+	}
+
+	void TextureStreamer::Replace(Entry& entry, uint32_t firstMip)
+	{
+		auto texture = std::make_unique<Texture>(m_device, entry.texture->GetAsset(), firstMip);
+		uint32_t bindlessIndex = m_bindlessHeap.RegisterTexture(texture->GetImageView(), m_sampler);
+		m_bindlessHeap.ReleaseTexture(entry.bindlessIndex);
+		if (firstMip < entry.texture->GetFirstMip())
+			m_upgradeCount++;
+		else
+			m_downgradeCount++;
+
+		m_retired.push_back({ std::move(entry.texture), m_frameNumber });
+		entry.texture = std::move(texture);
+		entry.bindlessIndex = bindlessIndex;
+	}
+
+	TextureStreamingStats TextureStreamer::GetStats() const
+	{
+		TextureStreamingStats stats;
+		stats.textureCount = static_cast<uint32_t>(m_entries.size());
+		for (const Entry& entry : m_entries)
+			stats.residentBytes += entry.texture->GetResidentBytes();
+		stats.budget = m_budget;
+		stats.uploadedBytes = m_uploadedBytes;
+		stats.upgradeCount = m_upgradeCount;
+		stats.downgradeCount = m_downgradeCount;
+		return stats;
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Texture.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	class BindlessHeap;
+
+	struct TextureStreamingStats
+	{
+		uint32_t textureCount = 0;
+		VkDeviceSize residentBytes = 0;
+		VkDeviceSize budget = 0;
+		// Last Update only
+		VkDeviceSize uploadedBytes = 0;
+		uint64_t upgradeCount = 0;
+		uint64_t downgradeCount = 0;
+	};
+
+	// Keeps every texture of the scene registered in the bindless heap and its finest resident mip within a memory budget.
+	// Textures loaded from files start with their small mips only, finer ones stream in once requested. A change of
+	// resident mips re-creates the image from the mapped asset and moves the texture to a new bindless index, so shaders
+	// must read GetBindlessIndex every frame. Render thread only
+	class TextureStreamer
+	{
+	public:
+		using Handle = uint32_t;
+
+		// Textures are loaded with the mips up to this size resident, what is sampled before any request
+		static constexpr uint32_t RESIDENT_TAIL_DIMENSION = 128;
+		// Bounds the staging copies of a frame, a single upgrade larger than this still goes through alone
+		static constexpr VkDeviceSize UPLOAD_BYTES_PER_FRAME = 16ull * 1024 * 1024;
+		// Textures not requested for that many frames fall back to their tail
+		static constexpr uint64_t EVICTION_DELAY_FRAMES = 120;
+
+		// A budget of 0 uses half of the largest device local heap. It bounds the device memory of the images, tails included
+		TextureStreamer(Device& device, BindlessHeap& bindlessHeap, uint32_t framesInFlight, VkDeviceSize budget = 0);
+		~TextureStreamer();
+
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		Handle Load(const std::string& path);
+		// Textures without an asset are registered but never streamed
+		Handle Add(std::unique_ptr<Texture> texture);
+		// The finest mip the frame wants, the finest of the requests of a frame wins
+		void Request(Handle handle, uint32_t mip);
+
+		// Once per frame before BindlessHeap::BeginFrame, so the fallback sets see the new indices the same frame. Moves
+		// resident mips toward the requests within the budget and flushes the upload arena
+		void Update(uint64_t frameNumber);
+
+		// Changes with the resident mips : draws read it every frame after Update, never keep it across frames
+		uint32_t GetBindlessIndex(Handle handle) const { return m_entries[handle].bindlessIndex; }
+		const Texture& GetTexture(Handle handle) const { return *m_entries[handle].texture; }
+		uint32_t GetTextureCount() const { return static_cast<uint32_t>(m_entries.size()); }
+		VkSampler GetSampler() const { return m_sampler; }
+		TextureStreamingStats GetStats() const;
+
+		// Finest mip no larger than RESIDENT_TAIL_DIMENSION, the last mip for tiny textures
+		static uint32_t ComputeTailMip(const TextureAsset& asset);
+
+	private:
+		struct Entry
+		{
+			std::unique_ptr<Texture> texture;
+			uint32_t bindlessIndex;
+			uint32_t tailMip;
+			// Device memory of the image by first mip, up to the tail
+			std::vector<VkDeviceSize> residentBytes;
+			// Finest mip requested since the last Update, ~0 when there was none
+			uint32_t pendingMip;
+			uint32_t wantedMip;
+			uint64_t lastRequestFrame;
+		};
+
+		struct RetiredTexture
+		{
+			std::unique_ptr<Texture> texture;
+			uint64_t frameNumber;
+		};
+
+		void CreateSampler();
+		std::vector<uint32_t> ComputeTargets();
+		void Replace(Entry& entry, uint32_t firstMip);
+
+	private:
+		Device& m_device;
+		BindlessHeap& m_bindlessHeap;
+		uint32_t m_framesInFlight;
+		VkDeviceSize m_budget;
+		VkSampler m_sampler = VK_NULL_HANDLE;
+
+		std::vector<Entry> m_entries;
+		std::vector<RetiredTexture> m_retired;
+		uint64_t m_frameNumber = 0;
+		VkDeviceSize m_uploadedBytes = 0;
+		uint64_t m_upgradeCount = 0;
+		uint64_t m_downgradeCount = 0;
+	};
+}
@@ -0,0 +1,337 @@
+#include "UploadArena.h"
+#include "CpuProfiler.h"
+#include "Device.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace Engine
+{
+	static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	UploadArena::UploadArena(Device& device, VkDeviceSize capacity)
+		: m_device(device), m_capacity(capacity)
+	{
+		m_device.CreateBuffer(m_capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_stagingBuffer, m_stagingMemory);
+
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = m_device.FindPhysicalQueueFamilies().graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(m_device.GetDevice(), &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create upload command pool !");
+	}
+
+	UploadArena::~UploadArena()
+	{
+		WaitIdle();
+		for (const auto& batch : m_freeBatches)
+			vkDestroyFence(m_device.GetDevice(), batch.fence, nullptr);
+		vkDestroyCommandPool(m_device.GetDevice(), m_commandPool, nullptr);
+
+		vkDestroyBuffer(m_device.GetDevice(), m_stagingBuffer, nullptr);
+		m_device.FreeMemory(m_stagingMemory);
+	}
+
+	void UploadArena::Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// Big uploads are split so a single copy never needs more than a part of the ring
+		const VkDeviceSize maxChunkSize = m_capacity / 4;
+		const char* src = static_cast<const char*>(data);
+		while (size > 0)
+		{
+			VkDeviceSize chunkSize = std::min(size, maxChunkSize);
+			VkDeviceSize srcOffset = AllocateRange(chunkSize);
+
+			memcpy(static_cast<char*>(m_stagingMemory.mappedData) + srcOffset, src, static_cast<size_t>(chunkSize));
+			m_pendingCopies.push_back({ dstBuffer, srcOffset, dstOffset, chunkSize });
+
+			src += chunkSize;
+			dstOffset += chunkSize;
+			size -= chunkSize;
+		}
+	}
+
+	void UploadArena::UploadImage(VkImage dstImage, uint32_t mipLevel, VkExtent3D extent, const void* data, VkDeviceSize size, VkImageLayout finalLayout)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// A buffer to image copy cannot be split at any byte like a buffer copy, large levels bypass the ring instead
+		PendingImageCopy copy = { dstImage, mipLevel, extent, m_stagingBuffer, 0, finalLayout };
+		void* destination;
+		if (size > m_capacity / 4)
+		{
+			DedicatedStaging staging;
+			m_device.CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging.buffer, staging.memory);
+			m_pendingDedicatedStaging.push_back(staging);
+			copy.srcBuffer = staging.buffer;
+			destination = staging.memory.mappedData;
+		}
+		else
+		{
+			copy.srcOffset = AllocateRange(size);
+			destination = static_cast<char*>(m_stagingMemory.mappedData) + copy.srcOffset;
+		}
+
+		memcpy(destination, data, static_cast<size_t>(size));
+		m_pendingImageCopies.push_back(copy);
+	}
+
+	void UploadArena::RecordAfterCopies(std::function<void(VkCommandBuffer)> commands)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_afterCopies.push_back(std::move(commands));
+	}
+
+	bool UploadArena::HasPendingCopies(VkImage image)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return std::any_of(m_pendingImageCopies.begin(), m_pendingImageCopies.end(), [&](const PendingImageCopy& copy) { return copy.dstImage == image; });
+	}
+
+	uint64_t UploadArena::Flush()
+	{
+		PROFILE_FUNCTION();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return FlushLocked();
+	}
+
+	bool UploadArena::IsComplete(uint64_t batch)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		RetireCompletedBatches(false);
+		return batch <= m_lastCompletedBatch;
+	}
+
+	void UploadArena::Wait(uint64_t batch)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		WaitLocked(batch);
+	}
+
+	void UploadArena::WaitIdle()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		WaitLocked(FlushLocked());
+	}
+
+	VkDeviceSize UploadArena::AllocateRange(VkDeviceSize size)
+	{
+		assert(size <= m_capacity / 2 && "Staging allocation too large for the upload ring !");
+
+		VkDeviceSize offset;
+		while (!TryAllocateRange(size, offset))
+		{
+			// The ring is full : submit what is pending so it can be recycled, then wait for the oldest batch
+			if (HasPendingWork() && m_inFlightBatches.empty())
+				FlushLocked();
+			RetireCompletedBatches(true);
+		}
+		return offset;
+	}
+
+	bool UploadArena::TryAllocateRange(VkDeviceSize size, VkDeviceSize& offset)
+	{
+		if (!HasPendingWork() && m_inFlightBatches.empty())
+			m_head = m_tail = 0;
+
+		VkDeviceSize alignedHead = (m_head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+		bool empty = !HasPendingWork() && m_inFlightBatches.empty();
+
+		if (empty || m_head > m_tail)
+		{
+			if (alignedHead + size <= m_capacity)
+			{
+				offset = alignedHead;
+				m_head = offset + size;
+				return true;
+			}
+
+			// Wrap around, the end of the ring is wasted until the batches before it retire
+			if (size < m_tail)
+			{
+				offset = 0;
+				m_head = size;
+				return true;
+			}
+			return false;
+		}
+
+		if (alignedHead + size < m_tail)
+		{
+			offset = alignedHead;
+			m_head = offset + size;
+			return true;
+		}
+		return false;
+	}
+
+	uint64_t UploadArena::FlushLocked()
+	{
+		if (!HasPendingWork())
+			return m_nextBatchId - 1;
+
+		Batch batch;
+		if (!m_freeBatches.empty())
+		{
+			batch = m_freeBatches.back();
+			m_freeBatches.pop_back();
+			vkResetCommandBuffer(batch.commandBuffer, 0);
+			vkResetFences(m_device.GetDevice(), 1, &batch.fence);
+		}
+		else
+		{
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = m_commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(m_device.GetDevice(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate upload command buffer !");
+
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			if (vkCreateFence(m_device.GetDevice(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create upload fence !");
+		}
+		batch.id = m_nextBatchId++;
+		batch.ringEnd = m_head;
+		batch.dedicatedStaging = std::move(m_pendingDedicatedStaging);
+		m_pendingDedicatedStaging.clear();
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+		// Consecutive copies to the same buffer are merged into a single vkCmdCopyBuffer
+		std::vector<VkBufferCopy> regions;
+		for (size_t i = 0; i < m_pendingCopies.size(); i++)
+		{
+			const PendingCopy& copy = m_pendingCopies[i];
+			regions.push_back({ copy.srcOffset, copy.dstOffset, copy.size });
+
+			if (i + 1 == m_pendingCopies.size() || m_pendingCopies[i + 1].dstBuffer != copy.dstBuffer)
+			{
+				vkCmdCopyBuffer(batch.commandBuffer, m_stagingBuffer, copy.dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+				regions.clear();
+			}
+		}
+		RecordImageCopies(batch.commandBuffer);
+		for (const auto& commands : m_afterCopies)
+			commands(batch.commandBuffer);
+
+		// Make the copies visible to every later submission reading vertex, index, uniform or storage data
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to record upload command buffer !");
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+		if (m_device.QueueSubmit(m_device.GraphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit upload command buffer !");
+
+		m_pendingCopies.clear();
+		m_pendingImageCopies.clear();
+		m_afterCopies.clear();
+		uint64_t batchId = batch.id;
+		m_inFlightBatches.push_back(std::move(batch));
+		m_submitCount++;
+		return batchId;
+	}
+
+	void UploadArena::RecordImageCopies(VkCommandBuffer commandBuffer)
+	{
+		if (m_pendingImageCopies.empty())
+			return;
+
+		std::vector<VkImageMemoryBarrier> barriers(m_pendingImageCopies.size());
+		for (size_t i = 0; i < m_pendingImageCopies.size(); i++)
+		{
+			VkImageMemoryBarrier& barrier = barriers[i];
+			barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = m_pendingImageCopies[i].dstImage;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, m_pendingImageCopies[i].mipLevel, 1, 0, 1 };
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+		for (const PendingImageCopy& copy : m_pendingImageCopies)
+		{
+			VkBufferImageCopy region = {};
+			region.bufferOffset = copy.srcOffset;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, copy.mipLevel, 0, 1 };
+			region.imageExtent = copy.extent;
+			vkCmdCopyBufferToImage(commandBuffer, copy.srcBuffer, copy.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+
+		// Levels kept as transfer sources are read by the commands recorded after the copies, the others by shaders
+		for (size_t i = 0; i < m_pendingImageCopies.size(); i++)
+		{
+			VkImageLayout finalLayout = m_pendingImageCopies[i].finalLayout;
+			barriers[i].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barriers[i].newLayout = finalLayout;
+			barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barriers[i].dstAccessMask = finalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+	}
+
+	void UploadArena::WaitLocked(uint64_t batch)
+	{
+		assert(batch < m_nextBatchId && "Waiting on a batch that was never flushed !");
+		while (m_lastCompletedBatch < batch)
+			RetireCompletedBatches(true);
+	}
+
+	void UploadArena::RetireCompletedBatches(bool waitOldest)
+	{
+		while (!m_inFlightBatches.empty())
+		{
+			Batch& batch = m_inFlightBatches.front();
+			if (waitOldest)
+			{
+				vkWaitForFences(m_device.GetDevice(), 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+				waitOldest = false;
+			}
+			else if (vkGetFenceStatus(m_device.GetDevice(), batch.fence) != VK_SUCCESS)
+			{
+				break;
+			}
+
+			m_tail = batch.ringEnd;
+			m_lastCompletedBatch = batch.id;
+			for (DedicatedStaging& staging : batch.dedicatedStaging)
+			{
+				vkDestroyBuffer(m_device.GetDevice(), staging.buffer, nullptr);
+				m_device.FreeMemory(staging.memory);
+			}
+			batch.dedicatedStaging.clear();
+			m_freeBatches.push_back(batch);
+			m_inFlightBatches.pop_front();
+		}
+	}
+}
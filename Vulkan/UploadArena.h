@@ -0,0 +1,108 @@
+#pragma once
+
+#include "MemoryAllocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Engine
+{
+	class Device;
+
+	class UploadArena
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_CAPACITY = 32ull * 1024 * 1024;
+
+		UploadArena(Device& device, VkDeviceSize capacity = DEFAULT_CAPACITY);
+		~UploadArena();
+
+		UploadArena(const UploadArena&) = delete;
+		UploadArena& operator=(const UploadArena&) = delete;
+
+		// Copies data into the staging ring and queues a GPU copy to dstBuffer. Nothing is submitted until Flush()
+		void Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+		// Same for the texels of a whole mip level, tightly packed. The previous content of the level is discarded, it is in
+		// finalLayout once the batch executed. Levels too large for the ring get their own staging buffer, freed with the batch
+		void UploadImage(VkImage dstImage, uint32_t mipLevel, VkExtent3D extent, const void* data, VkDeviceSize size, VkImageLayout finalLayout);
+		// Recorded after every copy of the next batch, for GPU work on the uploaded data such as mip generation
+		void RecordAfterCopies(std::function<void(VkCommandBuffer)> commands);
+		// Whether copies to the image are queued and not flushed yet, an image must not be destroyed while they are
+		bool HasPendingCopies(VkImage image);
+
+		// Submits every queued copy in a single command buffer and returns the batch id to wait on
+		uint64_t Flush();
+		bool IsComplete(uint64_t batch);
+		void Wait(uint64_t batch);
+		void WaitIdle();
+
+		uint64_t GetSubmitCount() const { return m_submitCount; }
+
+	private:
+		struct PendingCopy
+		{
+			VkBuffer dstBuffer;
+			VkDeviceSize srcOffset;
+			VkDeviceSize dstOffset;
+			VkDeviceSize size;
+		};
+
+		struct PendingImageCopy
+		{
+			VkImage dstImage;
+			uint32_t mipLevel;
+			VkExtent3D extent;
+			VkBuffer srcBuffer;
+			VkDeviceSize srcOffset;
+			VkImageLayout finalLayout;
+		};
+
+		struct DedicatedStaging
+		{
+			VkBuffer buffer;
+			MemoryAllocation memory;
+		};
+
+		struct Batch
+		{
+			uint64_t id;
+			VkCommandBuffer commandBuffer;
+			VkFence fence;
+			VkDeviceSize ringEnd;
+			std::vector<DedicatedStaging> dedicatedStaging;
+		};
+
+		VkDeviceSize AllocateRange(VkDeviceSize size);
+		bool TryAllocateRange(VkDeviceSize size, VkDeviceSize& offset);
+		bool HasPendingWork() const { return !m_pendingCopies.empty() || !m_pendingImageCopies.empty() || !m_afterCopies.empty(); }
+		void RecordImageCopies(VkCommandBuffer commandBuffer);
+		uint64_t FlushLocked();
+		void WaitLocked(uint64_t batch);
+		void RetireCompletedBatches(bool waitOldest);
+
+	private:
+		Device& m_device;
+		std::mutex m_mutex;
+
+		VkBuffer m_stagingBuffer;
+		MemoryAllocation m_stagingMemory;
+		VkDeviceSize m_capacity;
+		VkDeviceSize m_head = 0;
+		VkDeviceSize m_tail = 0;
+
+		VkCommandPool m_commandPool;
+		std::vector<PendingCopy> m_pendingCopies;
+		std::vector<PendingImageCopy> m_pendingImageCopies;
+		std::vector<DedicatedStaging> m_pendingDedicatedStaging;
+		std::vector<std::function<void(VkCommandBuffer)>> m_afterCopies;
+		std::deque<Batch> m_inFlightBatches;
+		std::vector<Batch> m_freeBatches;
+		uint64_t m_nextBatchId = 1;
+		uint64_t m_lastCompletedBatch = 0;
+		uint64_t m_submitCount = 0;
+	};
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace Engine
+{
+	// Quantized attribute storage, the vertex fetch converts them back to floats so shaders still read vecN
+	struct Snorm16x2
+	{
+		int16_t x = 0;
+		int16_t y = 0;
+	};
+
+	struct Unorm8x4
+	{
+		uint8_t x = 0;
+		uint8_t y = 0;
+		uint8_t z = 0;
+		uint8_t w = 0;
+	};
+
+	// Unit vector folded onto an octahedron, 4 bytes instead of 12. Shaders unfold it, see Quantize::FromOctahedral
+	struct OctahedralNormal
+	{
+		int16_t x = 0;
+		int16_t y = 0;
+	};
+
+	static_assert(sizeof(Snorm16x2) == 4 && sizeof(Unorm8x4) == 4 && sizeof(OctahedralNormal) == 4, "Quantized attributes must be tightly packed !");
+
+	template<typename T>
+	struct VertexFormatOf;
+
+	template<> struct VertexFormatOf<float> { static constexpr VkFormat value = VK_FORMAT_R32_SFLOAT; };
+	template<> struct VertexFormatOf<glm::vec2> { static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT; };
+	template<> struct VertexFormatOf<glm::vec3> { static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT; };
+	template<> struct VertexFormatOf<glm::vec4> { static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT; };
+	template<> struct VertexFormatOf<uint32_t> { static constexpr VkFormat value = VK_FORMAT_R32_UINT; };
+	template<> struct VertexFormatOf<Snorm16x2> { static constexpr VkFormat value = VK_FORMAT_R16G16_SNORM; };
+	template<> struct VertexFormatOf<Unorm8x4> { static constexpr VkFormat value = VK_FORMAT_R8G8B8A8_UNORM; };
+	template<> struct VertexFormatOf<OctahedralNormal> { static constexpr VkFormat value = VK_FORMAT_R16G16_SNORM; };
+
+	namespace Quantize
+	{
+		inline int16_t ToSnorm16(float value)
+		{
+			return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+		}
+
+		inline uint8_t ToUnorm8(float value)
+		{
+			return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+		}
+
+		inline Snorm16x2 ToSnorm16x2(glm::vec2 value)
+		{
+			return { ToSnorm16(value.x), ToSnorm16(value.y) };
+		}
+
+		inline Unorm8x4 ToUnorm8x4(glm::vec4 value)
+		{
+			return { ToUnorm8(value.x), ToUnorm8(value.y), ToUnorm8(value.z), ToUnorm8(value.w) };
+		}
+
+		inline OctahedralNormal ToOctahedral(glm::vec3 normal)
+		{
+			// Project on the octahedron |x| + |y| + |z| = 1, the lower half is folded over the diagonals
+			glm::vec3 n = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+			glm::vec2 folded = { n.x, n.y };
+			if (n.z < 0.0f)
+			{
+				folded.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+				folded.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+			}
+			return { ToSnorm16(folded.x), ToSnorm16(folded.y) };
+		}
+
+		// Same math as the shader side decode
+		inline glm::vec3 FromOctahedral(OctahedralNormal encoded)
+		{
+			glm::vec2 folded = { std::max(encoded.x / 32767.0f, -1.0f), std::max(encoded.y / 32767.0f, -1.0f) };
+			glm::vec3 n = { folded.x, folded.y, 1.0f - std::abs(folded.x) - std::abs(folded.y) };
+			float t = std::max(-n.z, 0.0f);
+			n.x += n.x >= 0.0f ? -t : t;
+			n.y += n.y >= 0.0f ? -t : t;
+			return glm::normalize(n);
+		}
+	}
+
+	// One member of a vertex, spelled VERTEX_ATTRIBUTE(Vertex, member) since offsetof needs the member name
+	template<typename Vertex, typename T, size_t Offset>
+	struct VertexAttribute
+	{
+		using VertexType = Vertex;
+		static constexpr VkFormat FORMAT = VertexFormatOf<T>::value;
+		static constexpr uint32_t OFFSET = static_cast<uint32_t>(Offset);
+	};
+
+	// Vertex input description generated from the members of Vertex, in location order. Formats and offsets are resolved at
+	// compile time from the members, a member without a VertexFormatOf specialization does not compile
+	template<typename Vertex, typename... Attributes>
+	class VertexLayout
+	{
+	public:
+		static_assert(sizeof...(Attributes) > 0, "A vertex layout needs at least one attribute !");
+		static_assert(std::is_standard_layout_v<Vertex>, "Vertex layout offsets need a standard layout vertex !");
+		static_assert((std::is_same_v<typename Attributes::VertexType, Vertex> && ...), "Vertex layout attributes must be members of the vertex !");
+
+		static constexpr uint32_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+		static constexpr std::array<VkFormat, sizeof...(Attributes)> FORMATS = { Attributes::FORMAT... };
+		static constexpr std::array<uint32_t, sizeof...(Attributes)> OFFSETS = { Attributes::OFFSET... };
+
+		static std::vector<VkVertexInputBindingDescription> GetBindingDescriptions(uint32_t binding, VkVertexInputRate inputRate)
+		{
+			std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+			bindingDescriptions[0].binding = binding;
+			bindingDescriptions[0].stride = sizeof(Vertex);
+			bindingDescriptions[0].inputRate = inputRate;
+			return bindingDescriptions;
+		}
+
+		static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions(uint32_t binding, uint32_t firstLocation)
+		{
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions(sizeof...(Attributes));
+			for (uint32_t i = 0; i < attributeDescriptions.size(); i++)
+			{
+				attributeDescriptions[i].binding = binding;
+				attributeDescriptions[i].location = firstLocation + i;
+				attributeDescriptions[i].format = FORMATS[i];
+				attributeDescriptions[i].offset = OFFSETS[i];
+			}
+			return attributeDescriptions;
+		}
+	};
+}
+
+#define VERTEX_ATTRIBUTE(Vertex, member) ::Engine::VertexAttribute<Vertex, decltype(Vertex::member), offsetof(Vertex, member)>
@@ -21,6 +21,7 @@ namespace Engine
 		bool HasWindowResized() { return m_frameBufferResized; }
 		void ResetWindowResizedFlag() { m_frameBufferResized = false; }
 		void CreateWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
+		void Resize(VkExtent2D extent) { glfwSetWindowSize(m_window, static_cast<int>(extent.width), static_cast<int>(extent.height)); }
 		VkExtent2D GetExtent() { return { static_cast<uint32_t>(m_windowSize.first), static_cast<uint32_t>(m_windowSize.second) }; }
 
 	private:
@@ -1,17 +1,202 @@
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 #include "Application.h"
+#include "Benchmark.h"
+#include "CpuProfiler.h"
+#include "MeshAsset.h"
+#include "TextureAsset.h"
+
+static bool WritePpm(const std::string& path, const std::vector<uint8_t>& pixels, VkExtent2D extent, VkFormat format)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	bool bgra = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+	file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+	for (size_t i = 0; i + 3 < pixels.size(); i += 4)
+	{
+		char rgb[3] = {
+			static_cast<char>(pixels[i + (bgra ? 2 : 0)]),
+			static_cast<char>(pixels[i + 1]),
+			static_cast<char>(pixels[i + (bgra ? 0 : 2)])
+		};
+		file.write(rgb, 3);
+	}
+	return file.good();
+}
 
 int main(int argc, char* argv[])
 {
-	Engine::Application app;
+	// CPU only checks, usable on machines without a GPU
+	if (argc > 1 && std::string(argv[1]) == "--test-recording")
+		return Engine::CommandRecorder::RunPartitionSelfTest() ? EXIT_SUCCESS : EXIT_FAILURE;
+	if (argc > 1 && std::string(argv[1]) == "--test-scheduler")
+		return Engine::JobScheduler::RunSelfTest() ? EXIT_SUCCESS : EXIT_FAILURE;
+	if (argc > 1 && std::string(argv[1]) == "--test-render-graph")
+		return Engine::RenderGraph::RunSelfTest() ? EXIT_SUCCESS : EXIT_FAILURE;
+	if (argc > 1 && std::string(argv[1]) == "--bench-scheduler")
+	{
+		Engine::JobScheduler::RunBenchmark();
+		return EXIT_SUCCESS;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-simplify")
+	{
+		Engine::Benchmark::RunSimplify();
+		return EXIT_SUCCESS;
+	}
+
+	// Asset tools, the mesh and texture files are the outputs of --convert-mesh and --convert-texture or generated ones when omitted
 	try
 	{
+		if (argc > 3 && std::string(argv[1]) == "--convert-mesh")
+		{
+			Engine::MeshAsset::ConvertObj(argv[2], argv[3]);
+			return EXIT_SUCCESS;
+		}
+		if (argc > 1 && std::string(argv[1]) == "--bench-mesh-load")
+		{
+			Engine::Benchmark::RunMeshLoad(argc > 2 ? argv[2] : "");
+			return EXIT_SUCCESS;
+		}
+		if (argc > 3 && std::string(argv[1]) == "--convert-texture")
+		{
+			Engine::TextureAsset::ConvertPpm(argv[2], argv[3]);
+			return EXIT_SUCCESS;
+		}
+		if (argc > 1 && std::string(argv[1]) == "--bench-texture-load")
+		{
+			Engine::Benchmark::RunTextureLoad(argc > 2 ? argv[2] : "");
+			return EXIT_SUCCESS;
+		}
+		if (argc > 1 && std::string(argv[1]) == "--test-texture-streaming")
+		{
+			uint64_t budgetMegabytes = argc > 3 && std::string(argv[2]) == "--texture-budget" ? std::stoull(argv[3]) : 16;
+			return Engine::Benchmark::RunTextureStreamingTest(budgetMegabytes) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& execpt)
+	{
+		std::cerr << "Exception: " << execpt.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Engine::ApplicationConfig config;
+	Engine::BenchmarkConfig benchmarkConfig;
+	bool benchmark = false;
+	std::string screenshotPath;
+	std::string gpuTracePath;
+	std::string cpuTracePath;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--headless")
+			config.headless = true;
+		else if (arg == "--frames-in-flight" && i + 1 < argc)
+			config.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg == "--frames" && i + 1 < argc)
+			config.frameLimit = std::stoull(argv[++i]);
+		else if (arg == "--screenshot" && i + 1 < argc)
+			screenshotPath = argv[++i];
+		else if (arg == "--gpu-trace" && i + 1 < argc)
+			gpuTracePath = argv[++i];
+		else if (arg == "--cpu-trace" && i + 1 < argc)
+			cpuTracePath = argv[++i];
+		else if (arg == "--mesh" && i + 1 < argc)
+			config.meshFiles.push_back(argv[++i]);
+		else if (arg == "--stream-mesh" && i + 1 < argc)
+			config.streamedMeshFiles.push_back(argv[++i]);
+		else if (arg == "--texture" && i + 1 < argc)
+			config.textureFiles.push_back(argv[++i]);
+		else if (arg == "--texture-budget" && i + 1 < argc)
+			config.textureBudgetMegabytes = std::stoull(argv[++i]);
+		else if (arg == "--gpu-culling")
+			config.gpuCulling = true;
+		else if (arg == "--backface-culling")
+			config.backfaceCulling = true;
+		else if (arg == "--hot-reload")
+			config.hotReloadShaders = true;
+		else if (arg == "--shader-compiler" && i + 1 < argc)
+			config.shaderCompiler = argv[++i];
+		else if (arg == "--no-lods")
+			config.generateLods = false;
+		else if (arg == "--lod-error" && i + 1 < argc)
+			config.lodPixelError = std::stof(argv[++i]);
+		else if (arg == "--benchmark")
+			benchmark = true;
+		else if (arg == "--scene" && i + 1 < argc)
+			benchmarkConfig.scenes.push_back(argv[++i]);
+		else if (arg == "--output" && i + 1 < argc)
+			benchmarkConfig.outputPath = argv[++i];
+	}
+
+	// Scripted scenes over a fixed number of frames, --frames sets the measured frames
+	if (benchmark)
+	{
+		if (config.frameLimit > 0)
+			benchmarkConfig.measuredFrames = config.frameLimit;
+		benchmarkConfig.application = config;
+		try
+		{
+			bool success = Engine::Benchmark::Run(benchmarkConfig);
+			if (!cpuTracePath.empty())
+				Engine::CpuProfiler::WriteChromeTrace(cpuTracePath);
+			return success ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		catch (const std::exception& execpt)
+		{
+			std::cerr << "Exception: " << execpt.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Nothing would ever stop a headless run otherwise
+	if (config.headless && config.frameLimit == 0)
+		config.frameLimit = 300;
+
+	// Only the latest frame is kept, it is written once the application stopped
+	std::vector<uint8_t> lastFrame;
+	VkExtent2D lastExtent = {};
+	VkFormat lastFormat = VK_FORMAT_UNDEFINED;
+	if (!screenshotPath.empty())
+	{
+		config.onFrameReadback = [&](const Engine::ReadbackFrame& frame)
+		{
+			lastFrame.assign(frame.pixels, frame.pixels + static_cast<size_t>(frame.extent.width) * frame.extent.height * 4);
+			lastExtent = frame.extent;
+			lastFormat = frame.format;
+		};
+	}
+
+	try
+	{
+		Engine::Application app(config);
 		app.Run();
+		if (!gpuTracePath.empty())
+			app.GetGpuProfiler().WriteChromeTrace(gpuTracePath);
+		if (!cpuTracePath.empty())
+			Engine::CpuProfiler::WriteChromeTrace(cpuTracePath);
 	}
 	catch (const std::exception& execpt)
 	{
 		std::cerr << "Exception: " << execpt.what() << std::endl;
 		return EXIT_FAILURE;
 	}
+
+	if (!screenshotPath.empty())
+	{
+		if (lastFrame.empty())
+		{
+			std::cerr << "No frame was read back, the surface does not allow transfers from its images" << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!WritePpm(screenshotPath, lastFrame, lastExtent, lastFormat))
+		{
+			std::cerr << "Failed to write " << screenshotPath << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,24 @@
+#version 450
+
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec3 color;
+
+layout (location = 2) in vec2 instanceOffset;
+layout (location = 3) in vec2 instanceScale;
+layout (location = 4) in vec4 instanceColor;
+
+// Positions are quantized to [-1, 1] over the bounds of their mesh
+layout (push_constant) uniform PositionDecode
+{
+	vec2 scale;
+	vec2 offset;
+} decode;
+
+layout (location = 0) out vec3 fragColor;
+
+void main()
+{
+	vec2 meshPosition = position * decode.scale + decode.offset;
+	gl_Position = vec4(meshPosition * instanceScale + instanceOffset, 0.0, 1.0);
+	fragColor = color * instanceColor.rgb;
+}
@@ -3,10 +3,26 @@
 layout (location = 0) in vec2 position;
 layout (location = 1) in vec3 color;
 
+// Positions are quantized to [-1, 1] over the bounds of their mesh
+layout (push_constant) uniform PositionDecode
+{
+	vec2 scale;
+	vec2 offset;
+} decode;
+
+// Per draw data, allocated in the frame arena and selected by a dynamic offset
+layout (set = 1, binding = 0) uniform DrawData
+{
+	vec2 offset;
+	vec2 scale;
+	vec4 color;
+} draw;
+
 layout (location = 0) out vec3 fragColor;
 
 void main()
 {
-	gl_Position = vec4(position, 0.0, 1.0);
-	fragColor = color;
-} 
\ No newline at end of file
+	vec2 meshPosition = position * decode.scale + decode.offset;
+	gl_Position = vec4(meshPosition * draw.scale + draw.offset, 0.0, 1.0);
+	fragColor = color * draw.color.rgb;
+}
\ No newline at end of file
@@ -3,6 +3,8 @@
 pushd "C:\Dev\Vulkan\Vulkan\shaders"
 	C:\Dev\Libraries\VulkanSDK\1.3.204.1\Bin\glslc.exe simple_shader.vert -o simple_shader.vert.spv
 	C:\Dev\Libraries\VulkanSDK\1.3.204.1\Bin\glslc.exe simple_shader.frag -o simple_shader.frag.spv
+	C:\Dev\Libraries\VulkanSDK\1.3.204.1\Bin\glslc.exe instanced_shader.vert -o instanced_shader.vert.spv
+	C:\Dev\Libraries\VulkanSDK\1.3.204.1\Bin\glslc.exe cull_clusters.comp -o cull_clusters.comp.spv
 popd
 
 pause
\ No newline at end of file